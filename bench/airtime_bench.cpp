@@ -0,0 +1,178 @@
+/**
+ * @file airtime_bench.cpp
+ * @brief Host check of the time on air model (src/airtime.h) and the duty
+ * cycle budget (src/dutycycle.h)
+ *
+ * The constexpr model is checked at compile time against figures of the
+ * Semtech LoRa calculator, then against the datasheet formula in double
+ * precision for every SF, bandwidth, coding rate, length, CRC and header
+ * mode. The budget is driven by motion storms, alarm frames every 1..10 s on
+ * top of the scheduled uplink every 900 s, with millis() wrapping during the
+ * run. Every hour long window over the frames sent must stay within 1 %, and
+ * no scheduled uplink may be held back.
+ *
+ *   g++ -O2 -I src bench/airtime_bench.cpp -o airtime_bench && ./airtime_bench
+ */
+#include "airtime.h"
+#include "dutycycle.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+static_assert(airtimeUs(7, 0, 1, 8, 10, true, false) == 41216, "SF7 10 bytes");
+static_assert(airtimeUs(9, 0, 1, 8, 20, true, false) == 185344, "SF9 20 bytes");
+static_assert(airtimeUs(12, 0, 1, 8, 64, true, false) == 2793472, "SF12 64 bytes, low data rate optimisation");
+static_assert(airtimeMs(7, 0, 1, 8, 20, true, false) == 57, "SF7 20 bytes");
+
+#define BENCH_HOURS 6
+#define BENCH_STORMS 20
+#define BENCH_SEND_INTERVAL_MS 900000UL
+
+/** The formula of the SX1261/2 datasheet in double precision */
+static double referenceUs(int sf, int bw, int cr, int preamble, int len, bool crc, bool implicitHeader)
+{
+	double tSym = pow(2, sf) / (125000.0 * (1 << bw)) * 1e6;
+	int de = tSym > 16000 ? 1 : 0;
+	double num = 8.0 * len - 4.0 * sf + 28 + (crc ? 16 : 0) - (implicitHeader ? 20 : 0);
+	double payloadSymb = 8 + fmax(ceil(num / (4.0 * (sf - 2 * de))), 0) * (cr + 4);
+	return (preamble + 4.25) * tSym + payloadSymb * tSym;
+}
+
+struct Frame
+{
+	double start; // ms since the run started
+	double end;
+	bool alarm;
+};
+
+/**
+ * @brief Most time on air within any hour, the worst window starts with a frame
+ */
+static double worstHourMs(const std::vector<Frame> &frames)
+{
+	double worst = 0;
+	size_t last = 0;
+	for (size_t first = 0; first < frames.size(); first++)
+	{
+		double windowEnd = frames[first].start + DUTY_WINDOW_MS;
+		double sum = 0;
+		for (last = first; last < frames.size() && frames[last].start < windowEnd; last++)
+		{
+			sum += fmin(frames[last].end, windowEnd) - frames[last].start;
+		}
+		worst = fmax(worst, sum);
+	}
+	return worst;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	srand(1);
+	unsigned long failures = 0;
+
+	// Model against the double precision formula
+	unsigned long cases = 0;
+	double worstErr = 0;
+	for (int sf = 7; sf <= 12; sf++)
+		for (int bw = 0; bw <= 2; bw++)
+			for (int cr = 1; cr <= 4; cr++)
+				for (int len = 0; len <= 255; len++)
+					for (int flags = 0; flags < 4; flags++)
+					{
+						bool crc = flags & 1, implicitHeader = flags & 2;
+						double err = fabs(airtimeUs(sf, bw, cr, 8, len, crc, implicitHeader) -
+										  referenceUs(sf, bw, cr, 8, len, crc, implicitHeader));
+						worstErr = fmax(worstErr, err);
+						failures += err >= 1.0;
+						cases++;
+					}
+	printf("airtimeUs: %lu configurations, max error %.3f us\n", cases, worstErr);
+
+	// Motion storms, the budget alone decides what goes out
+	printf("storm  alarms  sf  alarms sent  held back  scheduled held back  worst hour ms  budget use\n");
+	for (int storm = 0; storm < BENCH_STORMS; storm++)
+	{
+		uint8_t sf = storm % 2 ? 7 : 10;
+		uint32_t maxGapMs = 1000 + rand() % 9000;
+		DutyCycle duty;
+		dutyInit(&duty);
+		// Start half an hour before millis() wraps
+		uint32_t base = 0xFFFFFFFFUL - 1800000UL;
+		std::vector<Frame> sent;
+		unsigned long alarms = 0;
+		double busyUntil = 0;
+		double nextScheduled = BENCH_SEND_INTERVAL_MS;
+		double nextAlarm = 0;
+		while (true)
+		{
+			bool alarm = nextAlarm < nextScheduled;
+			double t = alarm ? nextAlarm : nextScheduled;
+			if (t > BENCH_HOURS * 3600000.0)
+			{
+				break;
+			}
+			if (alarm)
+			{
+				nextAlarm += 1000 + rand() % maxGapMs;
+				alarms++;
+			}
+			else
+			{
+				nextScheduled += BENCH_SEND_INTERVAL_MS;
+			}
+			if (t < busyUntil)
+			{
+				continue; // still on air, the firmware supersedes
+			}
+			uint8_t len = 15 + rand() % 30;
+			uint32_t ms = airtimeMs(sf, 0, 1, 8, len, true, false);
+			if (!dutyAllow(&duty, base + (uint32_t)t, ms, alarm))
+			{
+				continue;
+			}
+			double end = t + airtimeUs(sf, 0, 1, 8, len, true, false) / 1000.0;
+			dutyCharge(&duty, base + (uint32_t)ceil(end), ms);
+			sent.push_back({t, end, alarm});
+			busyUntil = end;
+		}
+		double worst = worstHourMs(sent);
+		failures += worst > DUTY_BUDGET_MS || duty.blockedScheduled != 0;
+		unsigned long alarmsSent = 0;
+		for (const Frame &f : sent)
+		{
+			alarmsSent += f.alarm;
+		}
+		printf("%5d %7lu %3d %12lu %10lu %20lu %14.0f %10.1f%%\n", storm, alarms, sf, alarmsSent,
+			   (unsigned long)duty.blockedAlarm, (unsigned long)duty.blockedScheduled, worst,
+			   100.0 * worst / DUTY_BUDGET_MS);
+	}
+
+	// Cost of the check the firmware runs per frame
+	DutyCycle duty;
+	dutyInit(&duty);
+	const int calls = 10000000;
+	unsigned long allowed = 0;
+	double t0 = seconds();
+	for (int i = 0; i < calls; i++)
+	{
+		uint32_t now = (uint32_t)i * 97;
+		if (dutyAllow(&duty, now, 57, i & 1))
+		{
+			dutyCharge(&duty, now, 57);
+			allowed++;
+		}
+	}
+	double t1 = seconds();
+	printf("dutyAllow + dutyCharge %.1f ns/call (%lu allowed)\n", (t1 - t0) / calls * 1e9, allowed);
+	printf("%lu failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+/**
+ * @file chain_bench.cpp
+ * @brief Line of relaying nodes (main.h IS_CHAIN_ELEMENT), end-to-end latency,
+ * delivery and collision rate of the chain frames
+ *
+ * Event driven model of nodes 1..N in a line with the gateway behind node N.
+ * Every node hears its two neighbours only, the gateway hears node N, so the
+ * neighbours of a node are hidden from each other. Each node takes a record
+ * every SEND_INTERVAL at its own phase, and every minute as a stress case. Frames are the real chain frames
+ * of src/payload.cpp on radioProfileChain (src/radioprofile.h). Before each
+ * transmission a node runs an 8 symbol CAD, which finds the channel busy when
+ * a neighbour is on air, and backs off with lbtBackoffMs() of src/lbt.h. A
+ * frame is lost at a receiver that is in CAD or on air itself, or when
+ * another of its neighbours is on air at the same time, there is no capture
+ * effect.
+ *
+ * The policies:
+ *   forward      what lora.cpp does: a relay appends its record to the frame
+ *                of node N-1 and sends it on right away, a scheduled frame
+ *                after a forward that carried its record is skipped
+ *   next slot    the first firmware's idea: a relay keeps the frame it
+ *                received and sends it with its record at its next
+ *                scheduled uplink, a second frame replaces the kept one
+ *
+ * Latency runs from the time a record is appended to the gateway receiving
+ * it. A record is lost if its frame collides, is dropped after LBT_RETRY_MAX
+ * busy CADs or is replaced before it was sent.
+ *
+ *   g++ -O2 -I src bench/chain_bench.cpp src/payload.cpp -o chain_bench && ./chain_bench
+ */
+#include "lbt.h"
+#include "payload.h"
+#include "radioprofile.h"
+#include <algorithm>
+#include <math.h>
+#include <queue>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define BENCH_DAYS 7.0
+#define BENCH_SEEDS 4
+/** Samples per record aggregate, SEND_INTERVAL / BSEC_LP_PERIOD_MS */
+#define BENCH_SAMPLES 300
+/** Spread of a node's send times around its interval */
+#define BENCH_JITTER_MS 1000.0
+
+enum Policy
+{
+	POLICY_FORWARD,
+	POLICY_NEXT_SLOT,
+	POLICIES
+};
+
+static const char *const policyNames[POLICIES] = {"forward", "next slot"};
+
+static const RadioProfile &profile = radioProfileChain;
+
+enum
+{
+	EV_SCHEDULE,
+	EV_CAD_START,
+	EV_CAD_DONE,
+	EV_TX_DONE
+};
+
+struct Event
+{
+	double t;
+	int node;
+	int kind;
+	int generation;
+	bool operator<(const Event &o) const { return t > o.t; }
+};
+
+/** Time a record was appended, per record of a frame */
+typedef std::vector<double> Born;
+
+struct Tx
+{
+	double start;
+	double end;
+	bool cad; // the radio listens, nothing on air
+};
+
+struct Node
+{
+	uint8_t frame[PAYLOAD_CHAIN_MAX_SIZE];
+	uint8_t len;
+	Born born;
+	bool pending;  // frame waits for CAD or backoff
+	bool sending;  // on air
+	bool carried;  // a forward carried this node's record since its last scheduled frame
+	bool forward;  // the frame is a forward of the previous node's
+	int retry;	   // busy CADs of the frame
+	int generation;
+	double cadStart;
+	double txStart;
+	// next slot policy: frame of the previous node kept for the next uplink
+	uint8_t kept[PAYLOAD_CHAIN_MAX_SIZE];
+	uint8_t keptLen;
+	Born keptBorn;
+	uint16_t seq;
+};
+
+struct Result
+{
+	unsigned long records;
+	unsigned long delivered;
+	unsigned long frames;
+	unsigned long collided;	 // frames lost to another neighbour of the receiver
+	unsigned long deaf;		 // frames lost because the receiver was in CAD or on air
+	unsigned long dropped;	 // frames dropped after LBT_RETRY_MAX busy CADs
+	unsigned long replaced;	 // records replaced before they were sent
+	unsigned long full;		 // forwards without the relay's record
+	double airMs;
+	std::vector<double> latencyS;
+};
+
+static double uniform(void)
+{
+	return rand() / ((double)RAND_MAX + 1.0);
+}
+
+static double frameMs(uint8_t len)
+{
+	return airtimeUs(profile.sf, profile.bandwidth, profile.codingRate, profile.preamble, len, true, false) / 1000.0;
+}
+
+/**
+ * @brief Append the record of node id, a steady indoor climate with the spread
+ * of one interval in the aggregate
+ */
+static uint8_t appendRecord(Node &me, int id, uint8_t *frame, uint8_t len, int16_t rssi, int8_t snr)
+{
+	TxdPayload p;
+	memset(&p, 0, sizeof(p));
+	p.id = id;
+	p.bat_perc = 80 + rand() % 20;
+	p.temperature = 1800 + rand() % 800;
+	p.humidity = 3500 + rand() % 2000;
+	p.bar_press = 10050 + rand() % 200;
+	p.inc_z = rand() % 5;
+	p.iaq = 25 + rand() % 150;
+	p.iaqAccuracy = 3;
+	p.co2equivalent = 500 + rand() % 1000;
+	p.breathVocEquivalent = rand() % 5;
+	p.gasPercentage = rand() % 100;
+	p.sentPackets = me.seq++;
+	PayloadAggregate agg;
+	agg.samples = BENCH_SAMPLES;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		int32_t v = payloadChannel(&p, i);
+		int32_t spread = 1 + abs(v) / 50;
+		agg.min[i] = v - rand() % spread;
+		agg.max[i] = v + rand() % spread;
+		agg.mean[i] = v + rand() % spread / 4;
+	}
+	return payloadChainAppend(frame, len, PAYLOAD_CHAIN_MAX_SIZE, &p, &agg, NULL, rssi, snr);
+}
+
+static bool overlaps(const Tx &a, double start, double end)
+{
+	return a.start < end && a.end > start;
+}
+
+/**
+ * @brief Run nodes relays for BENCH_DAYS, each taking a record every interval
+ */
+static void run(int nodes, double intervalS, Policy policy, Result &r)
+{
+	const double cadMs = 8 * profile.symbolUs() / 1000.0;
+	const double intervalMs = intervalS * 1000.0;
+	const double endMs = BENCH_DAYS * 86400000.0;
+	std::priority_queue<Event> q;
+	std::vector<Node> node(nodes + 1);
+	// Transmissions and CADs of the last seconds, per node
+	std::vector<std::vector<Tx>> busy(nodes + 1);
+
+	for (int n = 1; n <= nodes; n++)
+	{
+		q.push({uniform() * intervalMs, n, EV_SCHEDULE, 0});
+	}
+	auto startFrame = [&](Node &me, int id, double t) {
+		// A frame still backing off is replaced, its records are lost
+		if (me.pending)
+		{
+			r.replaced += me.born.size();
+		}
+		me.pending = true;
+		me.retry = 0;
+		me.generation++;
+		q.push({t, id, EV_CAD_START, me.generation});
+	};
+	// Node id is on air, or with cad also in CAD, some time between start and end
+	auto onAir = [&](int id, double start, double end, bool cad) {
+		if (id < 1 || id > nodes)
+		{
+			return false;
+		}
+		for (const Tx &tx : busy[id])
+		{
+			if ((cad || !tx.cad) && overlaps(tx, start, end))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	while (!q.empty() && q.top().t < endMs)
+	{
+		Event e = q.top();
+		q.pop();
+		Node &me = node[e.node];
+		for (std::vector<Tx> &b : busy)
+		{
+			b.erase(std::remove_if(b.begin(), b.end(), [&](const Tx &tx) { return tx.end < e.t - 10000.0; }), b.end());
+		}
+		switch (e.kind)
+		{
+		case EV_SCHEDULE:
+		{
+			q.push({e.t + intervalMs - BENCH_JITTER_MS / 2 + uniform() * BENCH_JITTER_MS, e.node, EV_SCHEDULE, 0});
+			if (policy == POLICY_FORWARD && (me.sending || me.pending) && me.forward)
+			{
+				// A forward on its way holds the frame and this node's record
+				me.carried = false;
+				break;
+			}
+			if (policy == POLICY_FORWARD && me.carried)
+			{
+				me.carried = false;
+				break;
+			}
+			if (me.pending)
+			{
+				r.replaced += me.born.size();
+				me.pending = false;
+			}
+			me.born.clear();
+			me.len = payloadChainStart(me.frame, e.node);
+			me.forward = policy == POLICY_NEXT_SLOT && me.keptLen;
+			if (me.forward)
+			{
+				memcpy(me.frame, me.kept, me.keptLen);
+				me.len = me.keptLen;
+				me.born = me.keptBorn;
+				me.keptLen = 0;
+			}
+			uint8_t len = appendRecord(me, e.node, me.frame, me.len, me.forward ? -95 : 0, me.forward ? 6 : 0);
+			if (len)
+			{
+				me.len = len;
+				me.born.push_back(e.t);
+				r.records++;
+			}
+			else
+			{
+				r.full++;
+			}
+			if (me.forward)
+			{
+				payloadChainForward(me.frame, e.node);
+			}
+			startFrame(me, e.node, e.t);
+			break;
+		}
+		case EV_CAD_START:
+			if (!me.pending || e.generation != me.generation)
+			{
+				break;
+			}
+			me.cadStart = e.t;
+			busy[e.node].push_back({e.t, e.t + cadMs, true});
+			q.push({e.t + cadMs, e.node, EV_CAD_DONE, me.generation});
+			break;
+		case EV_CAD_DONE:
+		{
+			if (!me.pending || e.generation != me.generation)
+			{
+				break;
+			}
+			bool channelBusy = onAir(e.node - 1, me.cadStart, e.t, false) || onAir(e.node + 1, me.cadStart, e.t, false);
+			if (!channelBusy)
+			{
+				me.pending = false;
+				me.sending = true;
+				me.txStart = e.t;
+				double end = e.t + frameMs(me.len);
+				busy[e.node].push_back({e.t, end, false});
+				r.frames++;
+				r.airMs += end - e.t;
+				q.push({end, e.node, EV_TX_DONE, me.generation});
+				break;
+			}
+			if (me.retry >= LBT_RETRY_MAX)
+			{
+				me.pending = false;
+				r.dropped++;
+				r.replaced += me.born.size();
+				break;
+			}
+			q.push({e.t + lbtBackoffMs(me.retry, (uint32_t)rand()), e.node, EV_CAD_START, me.generation});
+			me.retry++;
+			break;
+		}
+		case EV_TX_DONE:
+		{
+			me.sending = false;
+			if (e.node == nodes)
+			{
+				// The gateway hears node N only
+				for (double born : me.born)
+				{
+					r.delivered++;
+					r.latencyS.push_back((e.t - born) / 1000.0);
+				}
+				break;
+			}
+			int rx = e.node + 1;
+			Node &next = node[rx];
+			// Node N-1 of the receiver is on air with this frame, the receiver's other neighbour is hidden
+			bool deaf = onAir(rx, me.txStart, e.t, true);
+			bool collided = onAir(rx + 1, me.txStart, e.t, false);
+			if (deaf || collided)
+			{
+				r.deaf += deaf;
+				r.collided += !deaf;
+				break;
+			}
+			if (policy == POLICY_NEXT_SLOT)
+			{
+				r.replaced += next.keptLen ? next.keptBorn.size() : 0;
+				memcpy(next.kept, me.frame, me.len);
+				next.keptLen = me.len;
+				next.keptBorn = me.born;
+				break;
+			}
+			// lora.cpp chainForward(): the forward supersedes a frame in backoff
+			if (next.pending)
+			{
+				r.replaced += next.born.size();
+				next.pending = false;
+			}
+			memcpy(next.frame, me.frame, me.len);
+			next.born = me.born;
+			next.forward = true;
+			uint8_t len = appendRecord(next, rx, next.frame, me.len, -95, 6);
+			next.carried = len != 0;
+			if (len)
+			{
+				next.len = len;
+				next.born.push_back(e.t);
+				r.records++;
+			}
+			else
+			{
+				next.len = me.len;
+				r.full++;
+			}
+			payloadChainForward(next.frame, rx);
+			startFrame(next, rx, e.t);
+			break;
+		}
+		}
+	}
+	// Records still in a frame or kept at the end are not counted
+	for (int n = 1; n <= nodes; n++)
+	{
+		r.records -= node[n].pending || node[n].sending ? node[n].born.size() : 0;
+		r.records -= policy == POLICY_NEXT_SLOT && node[n].keptLen ? node[n].keptBorn.size() : 0;
+	}
+}
+
+static double percentile(std::vector<double> &v, double p)
+{
+	if (v.empty())
+	{
+		return 0;
+	}
+	std::sort(v.begin(), v.end());
+	return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+int main(void)
+{
+	printf("radioProfileChain: SF%d, %d symbol preamble, %u ms for 1 record, %u ms for %d bytes\n", profile.sf,
+		   profile.preamble, profile.frameMs(50), profile.frameMs(PAYLOAD_CHAIN_MAX_SIZE), PAYLOAD_CHAIN_MAX_SIZE);
+	printf("%d seeds x %.0f days\n", BENCH_SEEDS, BENCH_DAYS);
+	static const int counts[] = {2, 3, 4, 6, 8};
+	static const double intervals[] = {900.0, 60.0};
+	for (double interval : intervals)
+	{
+		printf("record every %.0f s per node\n", interval);
+		printf("nodes policy     delivered  latency s mean    p95    max  collided  deaf  dropped  replaced  full  "
+			   "air s/h/node\n");
+		for (int nodes : counts)
+		{
+			for (int p = 0; p < POLICIES; p++)
+			{
+				Result r = Result();
+				for (int seed = 1; seed <= BENCH_SEEDS; seed++)
+				{
+					srand(seed);
+					run(nodes, interval, (Policy)p, r);
+				}
+				double mean = 0;
+				for (double l : r.latencyS)
+				{
+					mean += l;
+				}
+				mean /= r.latencyS.empty() ? 1 : r.latencyS.size();
+				double frames = r.frames ? r.frames : 1;
+				printf("%5d %-10s %8.2f%% %15.2f %6.2f %6.1f %8.2f%% %4.2f%% %7.2f%% %9lu %5lu %13.2f\n", nodes,
+					   policyNames[p], 100.0 * r.delivered / (r.records ? r.records : 1), mean,
+					   percentile(r.latencyS, 0.95), percentile(r.latencyS, 1.0), 100.0 * r.collided / frames,
+					   100.0 * r.deaf / frames, 100.0 * r.dropped / frames, r.replaced, r.full,
+					   r.airMs / 1000.0 / (BENCH_SEEDS * BENCH_DAYS * 24.0) / nodes);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,420 @@
+/**
+ * @file fixedpoint_bench.cpp
+ * @brief Host check of the fixed-point conversions (src/fixedpoint.h) and the
+ * payload codecs (src/payload.h)
+ *
+ * Sweeps fixedTemperature(), fixedHumidity() and fixedPressure() over the
+ * sensor range and compares them with the same conversion in double
+ * precision. Single precision may only be off by one where the exact value is
+ * within float rounding of a half step. The integer bme68x path,
+ * fixedHumidityMilli(), fixedPressurePa() and the centi-degC temperature
+ * through BSEC's float input, must match exactly. Then round-trips random
+ * payloads through v2 key and delta frames, hand-built v1 frames and legacy
+ * frames, and times the conversion against the int/dec split it replaced.
+ *
+ *   g++ -O2 -I src bench/fixedpoint_bench.cpp src/payload.cpp -o fixedpoint_bench && ./fixedpoint_bench
+ */
+#include "fixedpoint.h"
+#include "payload.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_PAYLOADS 100000
+#define BENCH_ROUNDS 200
+#define BENCH_VALUES 4096
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int32_t randomRange(int32_t lo, int32_t hi)
+{
+	return lo + (int32_t)(rand() % (hi - lo + 1));
+}
+
+/** v * scale in double, rounded half away from zero and clamped */
+static int32_t exactScale(float v, double scale, int32_t lo, int32_t hi)
+{
+	double s = (double)v * scale;
+	if (!(s > lo))
+	{
+		return lo;
+	}
+	if (s >= hi)
+	{
+		return hi;
+	}
+	return (int32_t)lround(s);
+}
+
+/** True if the exact product is within float rounding of a half step or a clamp bound */
+static bool nearHalf(float v, double scale)
+{
+	double s = (double)v * scale;
+	double frac = fabs(s - trunc(s));
+	return fabs(frac - 0.5) <= fabs(s) * 1.2e-7 + 1e-9;
+}
+
+struct SweepResult
+{
+	unsigned long values;
+	unsigned long nearHalf;
+	unsigned long mismatches;
+};
+
+/**
+ * @brief Compare fn(v) with the double reference for v = from + k * step
+ */
+static SweepResult sweep(int32_t (*fn)(float), double scale, int32_t lo, int32_t hi, double from, double to,
+						 double step)
+{
+	SweepResult r = {0, 0, 0};
+	long n = lround((to - from) / step);
+	for (long k = 0; k <= n; k++)
+	{
+		float v = (float)(from + k * step);
+		int32_t got = fn(v);
+		int32_t want = exactScale(v, scale, lo, hi);
+		r.values++;
+		if (got != want)
+		{
+			if (abs(got - want) == 1 && nearHalf(v, scale))
+			{
+				r.nearHalf++;
+			}
+			else
+			{
+				if (r.mismatches < 5)
+				{
+					printf("  %.9g gives %ld, want %ld\n", (double)v, (long)got, (long)want);
+				}
+				r.mismatches++;
+			}
+		}
+	}
+	return r;
+}
+
+static int32_t temperatureFn(float v)
+{
+	return fixedTemperature(v);
+}
+
+static int32_t humidityFn(float v)
+{
+	return fixedHumidity(v);
+}
+
+static int32_t pressureFn(float v)
+{
+	return fixedPressure(v);
+}
+
+static unsigned long report(const char *name, SweepResult r)
+{
+	printf("%-16s %9lu values: %lu off by one at a half step, %lu mismatches\n", name, r.values, r.nearHalf,
+		   r.mismatches);
+	return r.mismatches;
+}
+
+/** Integer bme68x results against the double reference, all must match */
+static unsigned long checkInteger(void)
+{
+	unsigned long mismatches = 0;
+	for (int32_t centi = -4000; centi <= 8500; centi++)
+	{
+		// BSEC takes the integer temperature as float degC, the node gets it back
+		mismatches += fixedTemperature(centi / 100.0f) != centi;
+	}
+	for (uint32_t milli = 0; milli <= 120000; milli++)
+	{
+		double want = floor(milli / 10.0 + 0.5);
+		mismatches += fixedHumidityMilli(milli) != (want > 10000 ? 10000 : want);
+	}
+	for (uint32_t pa = 0; pa <= 700000; pa++)
+	{
+		double want = floor(pa / 10.0 + 0.5);
+		mismatches += fixedPressurePa(pa) != (want > UINT16_MAX ? UINT16_MAX : want);
+	}
+	printf("integer bme68x   %9d values: %lu mismatches\n", 12501 + 120001 + 700001, mismatches);
+	return mismatches;
+}
+
+static void randomPayload(TxdPayload *p)
+{
+	p->id = (uint8_t)randomRange(1, 0x9F);
+	p->bat_perc = (uint8_t)randomRange(0, 100);
+	p->temperature = (int16_t)randomRange(-4000, 8500);
+	p->humidity = (uint16_t)randomRange(0, 10000);
+	p->bar_press = (uint16_t)randomRange(3000, 11000);
+	p->inc_x = (int8_t)randomRange(-90, 90);
+	p->inc_y = (int8_t)randomRange(-90, 90);
+	p->inc_z = (uint8_t)randomRange(0, 180);
+	p->iaq = (uint16_t)randomRange(0, 500);
+	p->iaqAccuracy = (uint8_t)randomRange(0, 3);
+	p->co2equivalent = (uint16_t)randomRange(400, 10000);
+	p->breathVocEquivalent = (uint16_t)randomRange(0, 1000);
+	p->gasPercentage = (uint8_t)randomRange(0, 100);
+	p->sentPackets = (uint16_t)randomRange(0, UINT16_MAX);
+	p->accAlarm = rand() % 4 == 0;
+}
+
+/** Next payload of the same node, a few channels moved */
+static void nextPayload(const TxdPayload *ref, TxdPayload *p)
+{
+	*p = *ref;
+	p->sentPackets = ref->sentPackets + (uint16_t)randomRange(1, 3);
+	p->temperature += (int16_t)randomRange(-50, 50);
+	p->humidity = (uint16_t)randomRange(0, 10000);
+	p->iaq = (uint16_t)(rand() % 2 ? ref->iaq : randomRange(0, 500));
+	p->iaqAccuracy = (uint8_t)randomRange(0, 3);
+	p->accAlarm = rand() % 4 == 0;
+}
+
+static void randomAggregate(const TxdPayload *p, PayloadAggregate *agg)
+{
+	memset(agg, 0, sizeof(*agg));
+	agg->samples = (uint16_t)randomRange(1, 1200);
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+		{
+			int32_t v = payloadChannel(p, i);
+			agg->min[i] = v - randomRange(0, 300);
+			agg->max[i] = v + randomRange(0, 300);
+			agg->mean[i] = randomRange(agg->min[i], agg->max[i]);
+		}
+	}
+}
+
+static bool sameAggregate(const PayloadAggregate *a, const PayloadAggregate *b)
+{
+	if (a->samples != b->samples)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if ((PAYLOAD_AGGREGATE_MASK & (1 << i)) &&
+			(a->min[i] != b->min[i] || a->max[i] != b->max[i] || a->mean[i] != b->mean[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Key frame, then a delta against it, both with random aggregate and shock */
+static unsigned long checkV2(void)
+{
+	unsigned long mismatches = 0;
+	for (int n = 0; n < BENCH_PAYLOADS; n++)
+	{
+		TxdPayload ref, cur, out;
+		PayloadAggregate agg, aggOut;
+		PayloadShock shock = {(uint16_t)randomRange(0, 16000), (uint16_t)randomRange(0, 4000),
+							  (uint16_t)randomRange(0, 1280)};
+		PayloadShock shockOut;
+		uint8_t frame[PAYLOAD_MAX_SIZE];
+		randomPayload(&ref);
+		randomAggregate(&ref, &agg);
+		bool withAgg = rand() % 2;
+		uint8_t size = payloadEncode(&ref, NULL, withAgg ? &agg : NULL, &shock, frame);
+		if (size > PAYLOAD_MAX_SIZE || payloadIsDelta(frame, size) ||
+			!payloadDecode(frame, size, NULL, &out, &aggOut, &shockOut) || memcmp(&out, &ref, sizeof(out)) != 0 ||
+			(withAgg ? !sameAggregate(&agg, &aggOut) : aggOut.samples != 0) ||
+			(ref.accAlarm && memcmp(&shock, &shockOut, sizeof(shock)) != 0))
+		{
+			mismatches++;
+			continue;
+		}
+
+		nextPayload(&ref, &cur);
+		randomAggregate(&cur, &agg);
+		size = payloadEncode(&cur, &ref, withAgg ? &agg : NULL, &shock, frame);
+		TxdPayload stale = ref;
+		stale.sentPackets--;
+		if (!payloadDecode(frame, size, &ref, &out, &aggOut, &shockOut) || memcmp(&out, &cur, sizeof(out)) != 0 ||
+			(withAgg && !sameAggregate(&agg, &aggOut)) ||
+			(cur.accAlarm && memcmp(&shock, &shockOut, sizeof(shock)) != 0) ||
+			(payloadIsDelta(frame, size) && payloadDecode(frame, size, &stale, &out, NULL, NULL)))
+		{
+			mismatches++;
+		}
+	}
+	printf("v2 key and delta %9d frames: %lu mismatches\n", BENCH_PAYLOADS, mismatches);
+	return mismatches;
+}
+
+static uint8_t putVarint(uint8_t *frame, uint8_t pos, uint32_t v)
+{
+	while (v >= 0x80)
+	{
+		frame[pos++] = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	frame[pos++] = (uint8_t)v;
+	return pos;
+}
+
+/** A v1 frame as the firmware before format v2 sent it, pressure in hPa */
+static uint8_t encodeV1(const TxdPayload *cur, const TxdPayload *ref, uint8_t *frame)
+{
+	frame[0] = PAYLOAD_FORMAT_V1 | (ref != NULL ? PAYLOAD_FLAG_DELTA : 0) |
+			   (cur->iaqAccuracy & PAYLOAD_ACCURACY_MASK);
+	frame[1] = cur->id;
+	uint8_t pos = putVarint(frame, 2, cur->sentPackets);
+	int32_t v[PAYLOAD_CHANNELS], r[PAYLOAD_CHANNELS];
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		v[i] = payloadChannel(cur, i);
+		r[i] = ref != NULL ? payloadChannel(ref, i) : 0;
+		if (i == PAYLOAD_CH_BAR_PRESS)
+		{
+			v[i] /= 10;
+			r[i] /= 10;
+		}
+	}
+	if (ref == NULL)
+	{
+		for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+		{
+			pos = putVarint(frame, pos, (uint32_t)v[i]);
+		}
+		return pos;
+	}
+	pos = putVarint(frame, pos, (uint16_t)(cur->sentPackets - ref->sentPackets));
+	uint16_t changed = 0;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		changed |= v[i] != r[i] ? 1 << i : 0;
+	}
+	pos = putVarint(frame, pos, changed);
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (changed & (1 << i))
+		{
+			int32_t d = v[i] - r[i];
+			pos = putVarint(frame, pos, (uint32_t)(d << 1) ^ (uint32_t)(d >> 31));
+		}
+	}
+	return pos;
+}
+
+/** Hand-built v1 key and delta frames, pressure in whole hPa */
+static unsigned long checkV1(void)
+{
+	unsigned long mismatches = 0;
+	for (int n = 0; n < BENCH_PAYLOADS; n++)
+	{
+		TxdPayload ref, cur, out, outRef;
+		uint8_t frame[PAYLOAD_MAX_SIZE + 8];
+		randomPayload(&ref);
+		ref.accAlarm = 0;
+		ref.bar_press -= ref.bar_press % 10;
+		uint8_t size = encodeV1(&ref, NULL, frame);
+		if (!payloadDecode(frame, size, NULL, &outRef, NULL, NULL) || memcmp(&outRef, &ref, sizeof(ref)) != 0)
+		{
+			mismatches++;
+			continue;
+		}
+		nextPayload(&ref, &cur);
+		cur.accAlarm = 0;
+		cur.bar_press = (uint16_t)(ref.bar_press + 10 * randomRange(-3, 3));
+		size = encodeV1(&cur, &outRef, frame);
+		mismatches += !payloadDecode(frame, size, &outRef, &out, NULL, NULL) || memcmp(&out, &cur, sizeof(cur)) != 0;
+	}
+	printf("v1 key and delta %9d frames: %lu mismatches\n", BENCH_PAYLOADS, mismatches);
+	return mismatches;
+}
+
+/** Legacy frames, the layout of the first firmware, pressure rounded to hPa */
+static unsigned long checkLegacy(void)
+{
+	unsigned long mismatches = 0;
+	for (int n = 0; n < BENCH_PAYLOADS; n++)
+	{
+		TxdPayload cur, out;
+		uint8_t frame[PAYLOAD_LEGACY_SIZE];
+		randomPayload(&cur);
+		payloadEncodeLegacy(&cur, frame);
+		TxdPayload want = cur;
+		want.bar_press = (uint16_t)((cur.bar_press + 5) / 10 * 10);
+		int tempInt = (int)floor(cur.temperature / 100.0);
+		if (frame[0] != cur.id || (int8_t)frame[2] != tempInt || frame[3] != cur.temperature - tempInt * 100 ||
+			frame[4] != cur.humidity / 100 || frame[5] != cur.humidity % 100 ||
+			!payloadDecode(frame, PAYLOAD_LEGACY_SIZE, NULL, &out, NULL, NULL) ||
+			memcmp(&out, &want, sizeof(out)) != 0)
+		{
+			mismatches++;
+		}
+	}
+	printf("legacy           %9d frames: %lu mismatches\n", BENCH_PAYLOADS, mismatches);
+	return mismatches;
+}
+
+/** The conversion of the first firmware, truncated integer and hundredths parts */
+static void truncatedSplit(float degC, float pct, uint8_t *t, uint8_t *h)
+{
+	uint8_t tInt = degC;
+	uint8_t tDec = (degC - tInt) * 100;
+	uint8_t hInt = pct;
+	uint8_t hDec = (pct - hInt) * 100;
+	*t = tInt + tDec;
+	*h = hInt + hDec;
+}
+
+int main(void)
+{
+	srand(1);
+	unsigned long failures = 0;
+	failures += report("fixedTemperature", sweep(temperatureFn, 100.0, INT16_MIN, INT16_MAX, -45.0, 90.0, 1e-5));
+	failures += report("fixedHumidity", sweep(humidityFn, 100.0, 0, 10000, -5.0, 105.0, 1e-5));
+	failures += report("fixedPressure", sweep(pressureFn, 0.1, 0, UINT16_MAX, 29000.0, 111000.0, 0.01));
+	// Out of range and NaN clamp, BSEC reports NaN before its first result
+	failures += fixedTemperature(NAN) != INT16_MIN || fixedTemperature(1e6f) != INT16_MAX ||
+				fixedHumidity(NAN) != 0 || fixedHumidity(-1.0f) != 0 || fixedPressure(1e7f) != UINT16_MAX;
+	failures += checkInteger();
+	failures += checkV2();
+	failures += checkV1();
+	failures += checkLegacy();
+
+	float degC[BENCH_VALUES], pct[BENCH_VALUES];
+	for (int i = 0; i < BENCH_VALUES; i++)
+	{
+		degC[i] = randomRange(0, 4000) / 100.0f + 0.003f;
+		pct[i] = randomRange(0, 10000) / 100.0f + 0.003f;
+	}
+	// Timing, the checksum keeps the calls alive
+	unsigned sum = 0;
+	double t0 = seconds();
+	for (int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for (int i = 0; i < BENCH_VALUES; i++)
+		{
+			uint8_t t, h;
+			truncatedSplit(degC[i], pct[i], &t, &h);
+			sum += t + h;
+		}
+	}
+	double t1 = seconds();
+	for (int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for (int i = 0; i < BENCH_VALUES; i++)
+		{
+			sum += fixedTemperature(degC[i]) + fixedHumidity(pct[i]);
+		}
+	}
+	double t2 = seconds();
+	double calls = (double)BENCH_ROUNDS * BENCH_VALUES;
+	printf("int/dec split %.1f ns/reading, fixedpoint.h %.1f ns/reading (checksum %u)\n",
+		   (t1 - t0) / calls * 1e9, (t2 - t1) / calls * 1e9, sum);
+
+	return failures == 0 ? 0 : 1;
+}
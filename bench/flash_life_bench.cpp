@@ -0,0 +1,153 @@
+/**
+ * @file flash_life_bench.cpp
+ * @brief Flash lifetime projection of the BSEC state saves on arduino_NVM
+ *
+ * Runs NVRAM and VirtualPage against the simulated flash of [env:native]
+ * (sim/NativeSim/SimFlash.cpp), which counts the erase cycles of every page
+ * and charges the nRF52840 NVMC program and erase times. For a few amounts of
+ * changed state bytes it saves the BSEC state record until the most used page
+ * reaches the rated FLASH_ERASE_CYCLES (or BENCH_MAX_SAVES, then the rate is
+ * extrapolated) and projects the years at the save cadence of
+ * src/bsec_bme.cpp. The erase counter VirtualPage.wear_level() reads from the
+ * page headers is checked against the counters of the simulated flash, and
+ * every save is read back. The second table runs NVRAM.clean_up_step() after
+ * every save like OnTxDone() does, the worst save then has no page erase.
+ * Build it with the flags of the firmware env:
+ *
+ *   NVM="-DNATIVE_SIM -Isim/NativeSim -Ilib/arduino_NVM-0.9.1/src lib/arduino_NVM-0.9.1/src/NVRAM.cpp \
+ *        lib/arduino_NVM-0.9.1/src/VirtualPage.cpp sim/NativeSim/SimFlash.cpp"
+ *   g++ -O2 -DVNM_VIRTUAL_PAGE_SKIP_FROM_TOP=19 -DNVRAM_INDEX -DNVRAM_INDEX_CELLS=256 -DNVRAM_WRITE_COMBINE \
+ *       bench/flash_life_bench.cpp $NVM -o flash_life && ./flash_life [saves per day]
+ */
+#include "NativeSim.h"
+#include <NVRAM.h>
+
+/** BSEC_MAX_STATE_BLOB_SIZE of BSEC 1.4.8 + 3, see src/bsec_bme.cpp */
+#define BENCH_RECORD_SIZE 142
+/** STATE_SAVE_PERIOD of src/bsec_bme.cpp is 6 h */
+#define BENCH_SAVES_PER_DAY 4.0
+#define BENCH_MAX_SAVES 500000UL
+
+NativeSimStats nativeSimStats;
+/** No virtual clock here, the flash busy time is read from nativeSimStats */
+void nativeSimAdvanceUs(uint32_t us)
+{
+	(void)us;
+}
+
+static unsigned long failures = 0;
+
+/** Highest erase count of any flash page since base was taken */
+static uint32_t maxErases(const uint32_t *base)
+{
+	uint32_t max = 0;
+	for (size_t p = 0; p < Flash.page_count(); p++)
+	{
+		uint32_t e = nativeSimFlashPageErases(p) - base[p];
+		if (e > max)
+		{
+			max = e;
+		}
+	}
+	return max;
+}
+
+static void runScenario(int changed, double savesPerDay, bool gc)
+{
+	static uint8_t record[BENCH_RECORD_SIZE];
+	uint8_t readBack[BENCH_RECORD_SIZE];
+
+	static uint32_t base[256];
+	for (size_t p = 0; p < Flash.page_count(); p++)
+	{
+		base[p] = nativeSimFlashPageErases(p);
+	}
+	uint32_t wearBase = VirtualPage.wear_level();
+
+	unsigned long saves = 0;
+	uint64_t worstUs = 0;
+	uint64_t worstGcUs = 0;
+	uint64_t busyStart = nativeSimStats.flashBusyUs;
+	uint32_t worn = 0;
+	while (saves < BENCH_MAX_SAVES)
+	{
+		for (int k = 0; k < changed; k++)
+		{
+			uint16_t at = changed == BENCH_RECORD_SIZE ? k : rand() % BENCH_RECORD_SIZE;
+			record[at] = (uint8_t)(record[at] + 1 + rand() % 255);
+		}
+		uint64_t t0 = nativeSimStats.flashBusyUs;
+		if (!NVRAM.write_block(record, 0, sizeof(record)))
+		{
+			failures++;
+			break;
+		}
+		uint64_t us = nativeSimStats.flashBusyUs - t0;
+		if (us > worstUs)
+		{
+			worstUs = us;
+		}
+		saves++;
+		// There are many uplinks between two saves, one step each
+		while (gc)
+		{
+			t0 = nativeSimStats.flashBusyUs;
+			bool more = NVRAM.clean_up_step(BENCH_RECORD_SIZE);
+			us = nativeSimStats.flashBusyUs - t0;
+			if (us > worstGcUs)
+			{
+				worstGcUs = us;
+			}
+			if (!more)
+			{
+				break;
+			}
+		}
+		if ((saves & 63) == 0)
+		{
+			NVRAM.read_block(readBack, 0, sizeof(readBack));
+			failures += memcmp(readBack, record, sizeof(record)) != 0;
+			worn = maxErases(base);
+			if (worn >= FLASH_ERASE_CYCLES)
+			{
+				break;
+			}
+		}
+	}
+	worn = maxErases(base);
+
+	// wear_level() is percent*100 of the most erased page, from the page headers
+	uint32_t wear = VirtualPage.wear_level() - wearBase;
+	uint32_t expected = (uint32_t)((uint64_t)worn * 10000 / FLASH_ERASE_CYCLES);
+	if (wear + 1 < expected || wear > expected + 1)
+	{
+		printf("wear_level() %u, simulated flash says %u\n", wear, expected);
+		failures++;
+	}
+
+	double savesPerErase = worn ? (double)saves / worn : 0;
+	double years = savesPerErase * FLASH_ERASE_CYCLES / savesPerDay / 365.0;
+	printf("%8d %10lu %9u %12.1f %10u.%02u %9.1f %9.2f %9.1f %9.1f\n", changed, saves, worn, savesPerErase,
+		   wear / 100, wear % 100, years, (nativeSimStats.flashBusyUs - busyStart) / 1000.0 / saves,
+		   worstUs / 1000.0, worstGcUs / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+	double savesPerDay = argc > 1 ? atof(argv[1]) : BENCH_SAVES_PER_DAY;
+	srand(1);
+	printf("%d byte state record, %.1f saves/day, %u byte pages, %d rated erase cycles\n", BENCH_RECORD_SIZE,
+		   savesPerDay, (unsigned)Flash.page_size(), FLASH_ERASE_CYCLES);
+	static const int changedBytes[] = {4, 16, 64, BENCH_RECORD_SIZE};
+	for (int gc = 0; gc < 2; gc++)
+	{
+		printf(gc ? "with NVRAM.clean_up_step() between saves\n" : "erase on demand\n");
+		printf(" changed      saves    erases  saves/erase   wear_level     years   ms/save  worst ms    gc ms\n");
+		for (unsigned i = 0; i < sizeof(changedBytes) / sizeof(changedBytes[0]); i++)
+		{
+			runScenario(changedBytes[i], savesPerDay, gc);
+		}
+	}
+	printf("%lu failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file lbt_contention_bench.cpp
+ * @brief N nodes on one channel, delivery ratio and energy per delivered frame
+ * of the listen-before-talk policies
+ *
+ * Event driven model of N nodes on one SF7/125 kHz channel, all in range of
+ * each other and of the receiver. In the first table every node sends a frame
+ * at random intervals around BENCH_INTERVAL_S. In the second all nodes send
+ * within BENCH_SPREAD_MS of a common trigger every BENCH_INTERVAL_S, like
+ * nodes powered up together with the fixed SEND_INTERVAL, or a knock felt by
+ * all of them. Before each transmission a node runs an 8 symbol CAD, which
+ * finds the channel busy when another node transmits during the CAD. Frames that overlap on air are both lost, there is no
+ * capture effect. A new frame replaces one still in backoff. Energy counts
+ * the radio only: CAD in RX and the PA at TX_OUTPUT_POWER, with the figures
+ * of sim/NativeSim/SimRadio.cpp.
+ *
+ * The policies: the old firmware that drops a frame on a busy CAD, a fixed
+ * retry delay without jitter, and lbtBackoffMs() of src/lbt.h.
+ *
+ *   g++ -O2 -I src bench/lbt_contention_bench.cpp -o lbt_contention && ./lbt_contention
+ */
+#include "lbt.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <queue>
+#include <vector>
+
+#define BENCH_FRAME_BYTES 20
+#define BENCH_INTERVAL_S 30.0
+#define BENCH_HOURS 24.0
+#define BENCH_SPREAD_MS 500.0
+/** SX1262 CAD/RX and TX at 22 dBm supply power, RAK4631 at 3.3 V */
+#define BENCH_RX_MW (4.6 * 3.3)
+#define BENCH_TX_MW (118.0 * 3.3)
+/** CAD done to PA on */
+#define BENCH_TURNAROUND_MS 0.3
+
+enum Policy
+{
+	POLICY_DROP,
+	POLICY_FIXED,
+	POLICY_BACKOFF,
+	POLICIES
+};
+
+static const char *const policyNames[POLICIES] = {"drop on busy", "fixed 100 ms", "lbt.h backoff"};
+
+static double symbolMs(void)
+{
+	return (1 << 7) / 125000.0 * 1000.0;
+}
+
+/** Semtech time-on-air formula, SF7, CR 4/5, 8 symbol preamble, CRC on */
+static double airtimeMs(int bytes)
+{
+	double num = 8.0 * bytes - 4.0 * 7 + 28.0 + 16.0;
+	double payloadSymb = 8.0 + fmax(ceil(num / (4.0 * 7)) * 5, 0.0);
+	return (8 + 4.25 + payloadSymb) * symbolMs();
+}
+
+struct Event
+{
+	double t;
+	int node;
+	int kind;
+	bool operator<(const Event &o) const { return t > o.t; }
+};
+
+enum
+{
+	EV_FRAME,
+	EV_CAD_START,
+	EV_CAD_DONE,
+	EV_TX_DONE
+};
+
+struct Tx
+{
+	double start;
+	double end;
+	int node;
+	bool lost;
+};
+
+struct Node
+{
+	bool pending;	 // a frame waits for CAD or backoff
+	bool sending;	 // on air
+	int retry;		 // busy CADs of the frame
+	int generation;	 // bumped when a frame is replaced, stale events are ignored
+	int cadGen;		 // generation of the scheduled CAD
+	double born;	 // time the frame was generated
+	double cadStart; // start of the running CAD
+	size_t tx;		 // index into the transmissions while sending
+};
+
+struct Result
+{
+	unsigned long frames;
+	unsigned long delivered;
+	unsigned long dropped;
+	unsigned long superseded;
+	unsigned long collided;
+	double energyMj;
+	double latencyMs;
+};
+
+static double uniform(void)
+{
+	return rand() / ((double)RAND_MAX + 1.0);
+}
+
+static Result run(int nodes, Policy policy, bool common)
+{
+	const double airMs = airtimeMs(BENCH_FRAME_BYTES);
+	const double cadMs = 8 * symbolMs();
+	const double endMs = BENCH_HOURS * 3600000.0;
+	std::priority_queue<Event> q;
+	std::vector<Node> node(nodes);
+	std::vector<Tx> txs;
+	Result r = {};
+
+	for (int n = 0; n < nodes; n++)
+	{
+		node[n] = Node();
+		q.push({uniform() * (common ? BENCH_SPREAD_MS : BENCH_INTERVAL_S * 1000.0), n, EV_FRAME});
+	}
+	while (!q.empty() && q.top().t < endMs)
+	{
+		Event e = q.top();
+		q.pop();
+		Node &me = node[e.node];
+		switch (e.kind)
+		{
+		case EV_FRAME:
+			if (common)
+			{
+				// Next trigger, again within the spread
+				double next = (floor(e.t / (BENCH_INTERVAL_S * 1000.0)) + 1) * BENCH_INTERVAL_S * 1000.0;
+				q.push({next + uniform() * BENCH_SPREAD_MS, e.node, EV_FRAME});
+			}
+			else
+			{
+				// Next frame in 0.5..1.5 intervals
+				q.push({e.t + (0.5 + uniform()) * BENCH_INTERVAL_S * 1000.0, e.node, EV_FRAME});
+			}
+			r.frames++;
+			if (me.sending)
+			{
+				// The firmware builds the next frame only after TxDone
+				r.superseded++;
+				break;
+			}
+			if (me.pending)
+			{
+				r.superseded++;
+			}
+			me.pending = true;
+			me.retry = 0;
+			me.generation++;
+			me.born = e.t;
+			me.cadGen = me.generation;
+			q.push({e.t, e.node, EV_CAD_START});
+			break;
+		case EV_CAD_START:
+			if (!me.pending || me.cadGen != me.generation)
+			{
+				break;
+			}
+			me.cadStart = e.t;
+			r.energyMj += BENCH_RX_MW * cadMs / 1000.0;
+			q.push({e.t + cadMs, e.node, EV_CAD_DONE});
+			break;
+		case EV_CAD_DONE:
+		{
+			if (!me.pending || me.cadGen != me.generation)
+			{
+				break;
+			}
+			bool busy = false;
+			for (size_t i = txs.size(); i-- > 0 && txs[i].end > me.cadStart - airMs;)
+			{
+				if (txs[i].start < e.t && txs[i].end > me.cadStart)
+				{
+					busy = true;
+					break;
+				}
+			}
+			if (!busy)
+			{
+				me.pending = false;
+				me.sending = true;
+				double start = e.t + BENCH_TURNAROUND_MS;
+				txs.push_back({start, start + airMs, e.node, false});
+				me.tx = txs.size() - 1;
+				// Anything already on air overlaps with this one
+				for (size_t i = txs.size() - 1; i-- > 0 && txs[i].end > start - airMs;)
+				{
+					if (txs[i].end > start)
+					{
+						txs[i].lost = true;
+						txs.back().lost = true;
+					}
+				}
+				r.energyMj += BENCH_TX_MW * airMs / 1000.0;
+				q.push({start + airMs, e.node, EV_TX_DONE});
+				break;
+			}
+			if (policy == POLICY_DROP || me.retry >= LBT_RETRY_MAX)
+			{
+				me.pending = false;
+				r.dropped++;
+				break;
+			}
+			double delay = policy == POLICY_FIXED ? LBT_BACKOFF_MIN_MS : lbtBackoffMs(me.retry, (uint32_t)rand());
+			me.retry++;
+			q.push({e.t + delay, e.node, EV_CAD_START});
+			break;
+		}
+		case EV_TX_DONE:
+			me.sending = false;
+			if (txs[me.tx].lost)
+			{
+				r.collided++;
+			}
+			else
+			{
+				r.delivered++;
+				r.latencyMs += e.t - me.born;
+			}
+			break;
+		}
+	}
+	return r;
+}
+
+int main(void)
+{
+	srand(1);
+	printf("%d byte frames, %.1f ms on air, one every %.0f s per node, %.0f h\n", BENCH_FRAME_BYTES,
+		   airtimeMs(BENCH_FRAME_BYTES), BENCH_INTERVAL_S, BENCH_HOURS);
+	static const int counts[] = {2, 10, 50, 100, 200};
+	static const int commonCounts[] = {2, 5, 10, 20, 40};
+	for (int common = 0; common < 2; common++)
+	{
+		const int *n = common ? commonCounts : counts;
+		if (common)
+		{
+			printf("common trigger, frames within %.0f ms\n", BENCH_SPREAD_MS);
+		}
+		else
+		{
+			printf("independent nodes\n");
+		}
+		printf("nodes policy          delivered  dropped  collided  superseded  mJ/delivered  latency ms\n");
+		for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+		{
+			for (int p = 0; p < POLICIES; p++)
+			{
+				Result r = run(n[c], (Policy)p, common);
+				double frames = r.frames ? r.frames : 1;
+				printf("%5d %-14s %9.2f%% %7.2f%% %8.2f%% %10.2f%% %13.2f %11.1f\n", n[c], policyNames[p],
+					   100.0 * r.delivered / frames, 100.0 * r.dropped / frames, 100.0 * r.collided / frames,
+					   100.0 * r.superseded / frames, r.delivered ? r.energyMj / r.delivered : 0.0,
+					   r.delivered ? r.latencyMs / r.delivered : 0.0);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file nvram_bench.cpp
+ * @brief Host check and timing of arduino_NVM NVRAM reads and writes, with
+ * and without NVRAM_INDEX and NVRAM_WRITE_COMBINE
+ *
+ * Runs against the simulated flash of [env:native] (sim/NativeSim/SimFlash.cpp).
+ * First the BSEC state pattern of the firmware: a record at cell 0 rewritten
+ * with a few changed bytes and read back, through several page switches. Then
+ * random blocks over all cells. Every read is compared with a RAM shadow, a
+ * mismatch fails the run. Build it with the flag combinations to compare:
+ *
+ *   NVM="-DNATIVE_SIM -Isim/NativeSim -Ilib/arduino_NVM-0.9.1/src lib/arduino_NVM-0.9.1/src/NVRAM.cpp \
+ *        lib/arduino_NVM-0.9.1/src/VirtualPage.cpp sim/NativeSim/SimFlash.cpp"
+ *   g++ -O2 bench/nvram_bench.cpp $NVM -o nvram_scan && ./nvram_scan
+ *   g++ -O2 -DNVRAM_INDEX bench/nvram_bench.cpp $NVM -o nvram_index && ./nvram_index
+ *   g++ -O2 -DNVRAM_INDEX -DNVRAM_WRITE_COMBINE bench/nvram_bench.cpp $NVM -o nvram_wc && ./nvram_wc
+ *
+ * Write enables are the NVMC enable/disable cycles, each one waits for the
+ * NVMC twice on the target.
+ */
+#include "NativeSim.h"
+#include <NVRAM.h>
+#include <time.h>
+
+/** Size of the BSEC state record of src/bsec_bme.cpp with BSEC 1.4.8 */
+#define BENCH_RECORD_SIZE 142
+#define BENCH_RECORD_SAVES 400
+#define BENCH_RANDOM_BLOCKS 4000
+#define BENCH_RANDOM_MAX 64
+
+NativeSimStats nativeSimStats;
+/** No virtual clock here, the flash busy time is read from nativeSimStats */
+void nativeSimAdvanceUs(uint32_t us)
+{
+	(void)us;
+}
+
+static uint8_t shadow[3072];
+static unsigned long failures = 0;
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check(uint16_t idx, uint16_t n, const uint8_t *got)
+{
+	if (memcmp(got, &shadow[idx], n) != 0)
+	{
+		if (failures++ < 5)
+		{
+			printf("mismatch in cells %u..%u\n", idx, idx + n - 1);
+		}
+	}
+}
+
+int main(void)
+{
+	memset(shadow, 0xff, sizeof(shadow));
+	srand(1);
+#ifdef NVRAM_INDEX
+	printf("NVRAM_INDEX on, %d cells\n", NVRAM_INDEX_CELLS);
+#else
+	printf("NVRAM_INDEX off\n");
+#endif
+#ifdef NVRAM_WRITE_COMBINE
+	printf("NVRAM_WRITE_COMBINE on, %d word bursts\n", NVRAM_WRITE_BURST);
+#else
+	printf("NVRAM_WRITE_COMBINE off\n");
+#endif
+
+	// BSEC state: a few bytes change between saves, each save is read back
+	uint8_t record[BENCH_RECORD_SIZE];
+	uint8_t readBack[BENCH_RECORD_SIZE];
+	memset(record, 0, sizeof(record));
+	double readTime = 0, writeTime = 0;
+	uint64_t words = nativeSimStats.flashWords;
+	uint64_t erases = nativeSimStats.flashErases;
+	uint64_t enables = nativeSimStats.flashEnables;
+	for (int save = 0; save < BENCH_RECORD_SAVES; save++)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			record[rand() % BENCH_RECORD_SIZE] = (uint8_t)rand();
+		}
+		double t0 = seconds();
+		if (!NVRAM.write_block(record, 0, sizeof(record)))
+		{
+			failures++;
+		}
+		double t1 = seconds();
+		NVRAM.read_block(readBack, 0, sizeof(readBack));
+		double t2 = seconds();
+		memcpy(shadow, record, sizeof(record));
+		check(0, sizeof(readBack), readBack);
+		writeTime += t1 - t0;
+		readTime += t2 - t1;
+	}
+	printf("%d byte record x %d: read_block %.2f us, write_block %.2f us, %llu words programmed in %llu write "
+		   "enables, %llu erases\n",
+		   BENCH_RECORD_SIZE, BENCH_RECORD_SAVES, readTime / BENCH_RECORD_SAVES * 1e6,
+		   writeTime / BENCH_RECORD_SAVES * 1e6, (unsigned long long)(nativeSimStats.flashWords - words),
+		   (unsigned long long)(nativeSimStats.flashEnables - enables),
+		   (unsigned long long)(nativeSimStats.flashErases - erases));
+
+	// Random blocks anywhere in the NVRAM, crossing the 256 cell ranges
+	uint8_t block[BENCH_RANDOM_MAX];
+	readTime = writeTime = 0;
+	words = nativeSimStats.flashWords;
+	enables = nativeSimStats.flashEnables;
+	for (int i = 0; i < BENCH_RANDOM_BLOCKS; i++)
+	{
+		uint16_t n = 1 + rand() % BENCH_RANDOM_MAX;
+		uint16_t idx = rand() % (NVRAM.length() - n);
+		for (uint16_t k = 0; k < n; k++)
+		{
+			block[k] = (uint8_t)rand();
+		}
+		double t0 = seconds();
+		NVRAM.write_block(block, idx, n);
+		double t1 = seconds();
+		memcpy(&shadow[idx], block, n);
+		uint16_t at = rand() % (NVRAM.length() - BENCH_RANDOM_MAX);
+		NVRAM.read_block(block, at, BENCH_RANDOM_MAX);
+		double t2 = seconds();
+		check(at, BENCH_RANDOM_MAX, block);
+		writeTime += t1 - t0;
+		readTime += t2 - t1;
+	}
+	printf("random blocks x %d: read_block %.2f us, write_block %.2f us, %llu words programmed in %llu write "
+		   "enables\n",
+		   BENCH_RANDOM_BLOCKS, readTime / BENCH_RANDOM_BLOCKS * 1e6, writeTime / BENCH_RANDOM_BLOCKS * 1e6,
+		   (unsigned long long)(nativeSimStats.flashWords - words),
+		   (unsigned long long)(nativeSimStats.flashEnables - enables));
+
+	// Full read back
+	static uint8_t all[3072];
+	NVRAM.read_block(all, 0, NVRAM.length());
+	check(0, NVRAM.length(), all);
+	printf("%lu mismatches\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file tilt_bench.cpp
+ * @brief Host accuracy check and timing of calculateTilt() (src/tilt.h)
+ *
+ * Sweeps tiltAtan2Deg() over every direction on a fine grid, compares it with
+ * libm atan2() in double precision and fails if the error exceeds
+ * TILT_MAX_ERROR_DEG. Then checks the rounded angles of calculateTilt()
+ * against libm over random accelerations and times it against the double
+ * precision pow/sqrt/atan2 version it replaced.
+ *
+ *   g++ -O2 -I src bench/tilt_bench.cpp -o tilt_bench && ./tilt_bench
+ */
+#include "tilt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_VECTORS 4096
+#define BENCH_ROUNDS 2000
+
+/** The calculateTilt() of the first firmware, angles truncated into uint8_t */
+static void libmTilt(float xacc, float yacc, float zacc, uint8_t *xinc, uint8_t *yinc, uint8_t *zinc)
+{
+	*xinc = (180 / M_PI) * atan2(xacc, sqrt(pow(yacc, 2) + pow(zacc, 2)));
+	*yinc = (180 / M_PI) * atan2(yacc, sqrt(pow(xacc, 2) + pow(zacc, 2)));
+	*zinc = (180 / M_PI) * atan2(sqrt(pow(xacc, 2) + pow(yacc, 2)), zacc);
+}
+
+/** Exact angle rounded half away from zero, what calculateTilt() should return */
+static int exactRound(double y, double x)
+{
+	return (int)lround(atan2(y, x) * 180 / M_PI);
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float randomG(void)
+{
+	return (rand() / (float)RAND_MAX) * 4.0f - 2.0f;
+}
+
+int main(void)
+{
+	// Kernel error over the full circle, 0.0001 deg steps
+	static const double radius[3] = {1e-3, 1.0, 16.0};
+	double worst = 0;
+	double worstAt = 0;
+	for (int i = 0; i < 3600000; i++)
+	{
+		double t = (i / 10000.0 - 180.0) * M_PI / 180;
+		for (int k = 0; k < 3; k++)
+		{
+			float y = (float)(radius[k] * sin(t));
+			float x = (float)(radius[k] * cos(t));
+			double err = fabs(tiltAtan2Deg(y, x) - atan2((double)y, (double)x) * 180 / M_PI);
+			if (err > 180)
+			{
+				err = 360 - err; // -180 and 180 are the same direction
+			}
+			if (err > worst)
+			{
+				worst = err;
+				worstAt = t * 180 / M_PI;
+			}
+		}
+	}
+	printf("tiltAtan2Deg max error %.6f deg at %.4f deg, bound %.4f deg\n", worst, worstAt, TILT_MAX_ERROR_DEG);
+
+	// Rounded angles of random accelerations
+	static float acc[BENCH_VECTORS][3];
+	for (int i = 0; i < BENCH_VECTORS; i++)
+	{
+		acc[i][0] = randomG();
+		acc[i][1] = randomG();
+		acc[i][2] = randomG();
+	}
+	unsigned long mismatches = 0;
+	unsigned long truncated = 0;
+	for (int i = 0; i < BENCH_VECTORS; i++)
+	{
+		double x = acc[i][0], y = acc[i][1], z = acc[i][2];
+		int8_t xinc, yinc;
+		uint8_t zinc;
+		calculateTilt(acc[i][0], acc[i][1], acc[i][2], &xinc, &yinc, &zinc);
+		int ex = exactRound(x, sqrt(y * y + z * z));
+		int ey = exactRound(y, sqrt(x * x + z * z));
+		int ez = exactRound(sqrt(x * x + y * y), z);
+		// Off by one only where the exact angle is within the bound of a half degree
+		mismatches += abs(xinc - ex) > 1 || abs(yinc - ey) > 1 || abs(zinc - ez) > 1;
+		uint8_t ox, oy, oz;
+		libmTilt(acc[i][0], acc[i][1], acc[i][2], &ox, &oy, &oz);
+		truncated += ox != (uint8_t)xinc || oy != (uint8_t)yinc || oz != zinc;
+	}
+	printf("calculateTilt %d vectors: %lu off by more than 1 deg, %lu differ from the old truncated uint8_t angles\n",
+		   BENCH_VECTORS, mismatches, truncated);
+
+	// Timing, the checksum keeps the calls alive
+	unsigned sum = 0;
+	double t0 = seconds();
+	for (int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for (int i = 0; i < BENCH_VECTORS; i++)
+		{
+			uint8_t a, b, c;
+			libmTilt(acc[i][0], acc[i][1], acc[i][2], &a, &b, &c);
+			sum += a + b + c;
+		}
+	}
+	double t1 = seconds();
+	for (int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for (int i = 0; i < BENCH_VECTORS; i++)
+		{
+			int8_t a, b;
+			uint8_t c;
+			calculateTilt(acc[i][0], acc[i][1], acc[i][2], &a, &b, &c);
+			sum += a + b + c;
+		}
+	}
+	double t2 = seconds();
+	double calls = (double)BENCH_ROUNDS * BENCH_VECTORS;
+	printf("libm double %.1f ns/call, tilt.h float %.1f ns/call (checksum %u)\n", (t1 - t0) / calls * 1e9,
+		   (t2 - t1) / calls * 1e9, sum);
+
+	return worst <= TILT_MAX_ERROR_DEG && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file decoder.cpp
+ * @brief Host decoder for uplink frames, compact (payload.h), legacy and chain
+ *
+ * Reads one hex frame per line from stdin and prints one JSON object per
+ * frame, per record of a chain frame. Delta frames are resolved against the
+ * last frame of the same node.
+ *
+ *   g++ -I src decoders/decoder.cpp src/payload.cpp -o decoder
+ *   echo 666c160e2e0fc2030000b23200005802000000130000 | ./decoder
+ */
+#include "payload.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+static int hexNibble(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c = (char)tolower(c);
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+static const char *const channelNames[PAYLOAD_CHANNELS] = {
+	"bat_perc", "temperature", "humidity", "bar_press", "inc_x", "inc_y", "inc_z",
+	"iaq", "co2equivalent", "breathVocEquivalent", "gasPercentage"};
+
+/**
+ * @brief Print a channel value, temperature and humidity are in hundredths,
+ * pressure in tenths of hPa
+ */
+static void printChannel(uint8_t i, int32_t v)
+{
+	int a = (int)(v < 0 ? -v : v);
+	if (i == 1 || i == 2)
+	{
+		printf("%s%d.%02d", v < 0 ? "-" : "", a / 100, a % 100);
+	}
+	else if (i == 3)
+	{
+		printf("%s%d.%d", v < 0 ? "-" : "", a / 10, a % 10);
+	}
+	else
+	{
+		printf("%d", (int)v);
+	}
+}
+
+static int parseHex(const char *line, uint8_t *frame, int max)
+{
+	int n = 0;
+	int hi = -1;
+	for (; *line; line++)
+	{
+		int v = hexNibble(*line);
+		if (v < 0)
+			continue;
+		if (hi < 0)
+		{
+			hi = v;
+		}
+		else
+		{
+			if (n == max)
+				return -1;
+			frame[n++] = (uint8_t)(hi << 4 | v);
+			hi = -1;
+		}
+	}
+	return hi < 0 ? n : -1;
+}
+
+static TxdPayload last[256];
+static bool lastValid[256];
+
+/**
+ * @brief Decode one compact or legacy frame and print it as one JSON object
+ *
+ * @param meta further JSON members, "" for none
+ */
+static void printFrame(const uint8_t *frame, uint8_t n, const char *meta)
+{
+	uint8_t id = frame[payloadIsCompact(frame, n) && n > 1 ? 1 : 0];
+	TxdPayload p;
+	PayloadAggregate agg;
+	PayloadShock shock;
+	if (!payloadDecode(frame, n, lastValid[id] ? &last[id] : NULL, &p, &agg, &shock))
+	{
+		printf("{\"id\":%u,\"error\":\"%s\"%s}\n", id,
+			   payloadIsDelta(frame, n) ? "missing reference frame" : "malformed frame", meta);
+		return;
+	}
+	// A resent uplink is older than the frame its gap report came with, the
+	// deltas that follow refer to that one. Further back the node restarted
+	uint16_t behind = lastValid[id] ? (uint16_t)(last[id].sentPackets - p.sentPackets) : 0;
+	if (behind == 0 || behind > PAYLOAD_GAP_WINDOW)
+	{
+		last[id] = p;
+		lastValid[id] = true;
+	}
+	printf("{\"id\":%u,\"format\":\"%s\",\"bat_perc\":%u,\"temperature\":", p.id,
+		   !payloadIsCompact(frame, n) ? "legacy" : payloadIsDelta(frame, n) ? "delta" : "key", p.bat_perc);
+	printChannel(1, p.temperature);
+	printf(",\"humidity\":");
+	printChannel(2, p.humidity);
+	printf(",\"bar_press\":");
+	printChannel(3, p.bar_press);
+	printf(",\"inc_x\":%d,\"inc_y\":%d,\"inc_z\":%u,\"iaq\":%u,\"iaqAccuracy\":%u,"
+		   "\"co2equivalent\":%u,\"breathVocEquivalent\":%u,\"gasPercentage\":%u,\"sentPackets\":%u,"
+		   "\"accAlarm\":%u",
+		   p.inc_x, p.inc_y, p.inc_z, p.iaq, p.iaqAccuracy, p.co2equivalent, p.breathVocEquivalent, p.gasPercentage,
+		   p.sentPackets, p.accAlarm);
+	if (p.accAlarm && payloadIsCompact(frame, n))
+	{
+		printf(",\"shock_peak_mg\":%u,\"shock_rms_mg\":%u,\"shock_ms\":%u", shock.peak, shock.rms, shock.duration);
+	}
+	if (agg.samples > 0)
+	{
+		printf(",\"samples\":%u", agg.samples);
+		for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+		{
+			if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+			{
+				printf(",\"%s_min\":", channelNames[i]);
+				printChannel(i, agg.min[i]);
+				printf(",\"%s_max\":", channelNames[i]);
+				printChannel(i, agg.max[i]);
+				printf(",\"%s_mean\":", channelNames[i]);
+				printChannel(i, agg.mean[i]);
+			}
+		}
+	}
+	printf("%s}\n", meta);
+}
+
+int main(void)
+{
+	char line[1024];
+	while (fgets(line, sizeof(line), stdin))
+	{
+		uint8_t frame[255];
+		int n = parseHex(line, frame, sizeof(frame));
+		if (n <= 0)
+		{
+			continue;
+		}
+		if (!payloadIsChain(frame, (uint8_t)n))
+		{
+			printFrame(frame, (uint8_t)n, "");
+			continue;
+		}
+		// One object per record, with the hop it was added on and the link it came over
+		uint8_t pos = PAYLOAD_CHAIN_HEADER_SIZE;
+		PayloadChainRecord rec;
+		for (uint8_t i = 0; payloadChainNext(frame, (uint8_t)n, &pos, &rec); i++)
+		{
+			char meta[96];
+			snprintf(meta, sizeof(meta), ",\"chain_sender\":%u,\"chain_hops\":%u,\"chain_record\":%u", frame[1],
+					 frame[2], i);
+			if (i > 0)
+			{
+				size_t len = strlen(meta);
+				snprintf(meta + len, sizeof(meta) - len, ",\"chain_rssi\":%d,\"chain_snr\":%d", rec.rssi, rec.snr);
+			}
+			printFrame(rec.frame, rec.size, meta);
+		}
+	}
+	return 0;
+}
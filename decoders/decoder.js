@@ -19,6 +19,9 @@ const structFields = [
     { name: 'accAlarm', size: 1 },
 ];
 
+// Fixed-point channels: payload value / scale is the reading in degC, %RH, hPa
+const fixedPoint = { temperature: 100, humidity: 100, bar_press: 10 };
+
 //Function to decode the data
 function decodePacket(packet) {
     let offset = 0;
@@ -30,9 +33,215 @@ function decodePacket(packet) {
         offset += field.size;
     });
 
+    // Fixed-point channel values, temp_int is signed and temp_dec 0..99
+    const tempInt = decodedData.temp_int > 127 ? decodedData.temp_int - 256 : decodedData.temp_int;
+    decodedData.temperature = tempInt * 100 + decodedData.temp_dec;
+    decodedData.humidity = decodedData.humdity_int * 100 + decodedData.humdity_dec;
+    decodedData.bar_press *= 10;
+    ['inc_x', 'inc_y'].forEach(name => { if (decodedData[name] > 127) decodedData[name] -= 256; });
+    ['temp_int', 'temp_dec', 'humdity_int', 'humdity_dec'].forEach(name => delete decodedData[name]);
+    return decodedData;
+}
+
+// Compact frames, layout documented in src/payload.h
+const FORMAT_V1 = 0xC0;
+const FORMAT_V2 = 0xE0;
+const FORMAT_MASK = 0xE0;
+const FLAG_AGGREGATE = 0x10;
+const FLAG_DELTA = 0x08;
+const FLAG_ACC_ALARM = 0x04;
+const ACCURACY_MASK = 0x03;
+const channels = [
+    { name: 'bat_perc' },
+    { name: 'temperature', signed: true },
+    { name: 'humidity' },
+    { name: 'bar_press', v1Scale: 10 },
+    { name: 'inc_x', signed: true },
+    { name: 'inc_y', signed: true },
+    { name: 'inc_z' },
+    { name: 'iaq' },
+    { name: 'co2equivalent' },
+    { name: 'breathVocEquivalent' },
+    { name: 'gasPercentage' },
+];
+// Channels carrying min/max/mean when FLAG_AGGREGATE is set
+const AGGREGATE_MASK = 0x78e;
+// Chain frames of relaying nodes: header, sender, hops, then records of
+// length, -RSSI and SNR followed by a compact key frame
+const CHAIN = 0xa0;
+const CHAIN_MASK = 0xf0;
+const CHAIN_COUNT_MASK = 0x0f;
+
+// Last decoded frame per node id, in payload units, delta frames are relative to it
+const lastFrame = {};
+// Uplinks before the acknowledged one a gap report covers, PAYLOAD_GAP_WINDOW
+const GAP_WINDOW = 16;
+
+// A resent uplink is older than the frame its gap report came with, the
+// deltas that follow refer to that one. Further back the node restarted
+function keepReference(id, decodedData) {
+    const ref = lastFrame[id];
+    const behind = ref ? (ref.sentPackets - decodedData.sentPackets) & 0xffff : 0;
+    if (behind === 0 || behind > GAP_WINDOW) {
+        lastFrame[id] = decodedData;
+    }
+}
+
+function readVarint(packet, pos) {
+    let value = 0;
+    for (let shift = 0; shift < 32; shift += 7) {
+        if (pos.offset >= packet.length) {
+            throw new Error('truncated frame');
+        }
+        const b = packet[pos.offset++];
+        value += (b & 0x7f) * 2 ** shift;
+        if ((b & 0x80) === 0) {
+            return value;
+        }
+    }
+    throw new Error('varint too long');
+}
+
+function unzigzag(v) {
+    return v % 2 ? -(v + 1) / 2 : v / 2;
+}
+
+// v1 frames carried bar_press in hPa, the temperature as a 32 bit varint and
+// the tilt unsigned
+function fromWire(ch, value, v1) {
+    if (v1) {
+        return ch.v1Scale ? value * ch.v1Scale : value | 0;
+    }
+    return ch.signed ? unzigzag(value) : value;
+}
+
+function toWire(ch, value, v1) {
+    return v1 && ch.v1Scale ? Math.round(value / ch.v1Scale) : value;
+}
+
+function scaled(name, value) {
+    return fixedPoint[name] ? value / fixedPoint[name] : value;
+}
+
+//Function to decode a compact frame
+function decodeCompact(packet) {
+    const header = packet[0];
+    const v1 = (header & FORMAT_MASK) === FORMAT_V1;
+    const id = packet[1];
+    const pos = { offset: 2 };
+    const seq = readVarint(packet, pos);
+    let decodedData;
+    if (header & FLAG_DELTA) {
+        const ref = lastFrame[id];
+        const distance = readVarint(packet, pos);
+        if (!ref || ((seq - distance) & 0xffff) !== ref.sentPackets) {
+            throw new Error('missing reference frame');
+        }
+        const changed = readVarint(packet, pos);
+        decodedData = Object.assign({}, ref);
+        channels.forEach((ch, i) => {
+            if (changed & (1 << i)) {
+                const wire = toWire(ch, ref[ch.name], v1) + unzigzag(readVarint(packet, pos));
+                decodedData[ch.name] = v1 && ch.v1Scale ? wire * ch.v1Scale : wire;
+            }
+        });
+    } else {
+        decodedData = {};
+        channels.forEach(ch => { decodedData[ch.name] = fromWire(ch, readVarint(packet, pos), v1); });
+    }
+    decodedData.id = id;
+    decodedData.sentPackets = seq;
+    decodedData.iaqAccuracy = header & ACCURACY_MASK;
+    decodedData.accAlarm = header & FLAG_ACC_ALARM ? 1 : 0;
+    keepReference(id, decodedData);
+    const result = Object.assign({}, decodedData);
+    if (decodedData.accAlarm && !v1) {
+        // Shock features in mg and ms
+        result.shock_peak_mg = readVarint(packet, pos);
+        result.shock_rms_mg = readVarint(packet, pos);
+        result.shock_ms = readVarint(packet, pos);
+    }
+    if (header & FLAG_AGGREGATE) {
+        result.samples = readVarint(packet, pos);
+        channels.forEach((ch, i) => {
+            if (AGGREGATE_MASK & (1 << i)) {
+                const last = toWire(ch, decodedData[ch.name], v1);
+                const unit = v1 && ch.v1Scale ? ch.v1Scale : 1;
+                ['_min', '_max', '_mean'].forEach(suffix => {
+                    result[ch.name + suffix] = scaled(ch.name, (last + unzigzag(readVarint(packet, pos))) * unit);
+                });
+            }
+        });
+    }
+    return result;
+}
+
+//Function to decode either frame format, readings in degC, %RH and hPa
+function decodeFrame(packet) {
+    const format = packet[0] & FORMAT_MASK;
+    let decodedData;
+    if (format === FORMAT_V1 || format === FORMAT_V2) {
+        decodedData = decodeCompact(packet);
+    } else {
+        decodedData = decodePacket(packet);
+        keepReference(decodedData.id, Object.assign({}, decodedData));
+    }
+    Object.keys(fixedPoint).forEach(name => { decodedData[name] = scaled(name, decodedData[name]); });
     return decodedData;
 }
 
+//Function to decode a chain frame, one object per record, oldest first
+function decodeChain(packet) {
+    const records = [];
+    let offset = 3;
+    while (offset < packet.length) {
+        const len = packet[offset];
+        if (offset + 3 + len > packet.length) {
+            throw new Error('truncated chain record');
+        }
+        const record = decodeFrame(packet.slice(offset + 3, offset + 3 + len));
+        record.chain_sender = packet[1];
+        record.chain_hops = packet[2];
+        record.chain_record = records.length;
+        if (records.length > 0) {
+            // Link the record's node received the frame on
+            record.chain_rssi = -packet[offset + 1];
+            record.chain_snr = packet[offset + 2] > 127 ? packet[offset + 2] - 256 : packet[offset + 2];
+        }
+        records.push(record);
+        offset += 3 + len;
+    }
+    if (records.length !== (packet[0] & CHAIN_COUNT_MASK)) {
+        throw new Error('chain record count');
+    }
+    return records;
+}
+
+//Function to decode any uplink, an array of records for a chain frame
+function decodeUplink(packet) {
+    return (packet[0] & CHAIN_MASK) === CHAIN ? decodeChain(packet) : decodeFrame(packet);
+}
+
+// Command downlink, settings by name, see PAYLOAD_CMD_* in payload.h
+const COMMAND = 0xb2;
+const commandTags = { send_interval: 1, sleep_time: 2, bsec_ulp: 3, radio_profile: 4, listen: 5 };
+
+//Function to encode a command downlink for node id, values in as few bytes as they need
+function encodeCommand(id, settings) {
+    const bytes = [COMMAND, id];
+    for (const [name, value] of Object.entries(settings)) {
+        if (!(name in commandTags)) {
+            throw new Error('unknown command ' + name);
+        }
+        const v = [];
+        for (let rest = value >>> 0; v.length === 0 || rest !== 0; rest = Math.floor(rest / 256)) {
+            v.push(rest & 0xff);
+        }
+        bytes.push(commandTags[name], v.length, ...v);
+    }
+    return Buffer.from(bytes);
+}
+
 // Hex string representing the packet
 const hexPacket = "666c160e2e0fc2030000b23200005802000000130000";
 
@@ -40,6 +249,27 @@ const hexPacket = "666c160e2e0fc2030000b23200005802000000130000";
 const packetBuffer = Buffer.from(hexPacket, 'hex');
 
 // Decode the packet
-const decodedData = decodePacket(packetBuffer);
+const decodedData = decodeFrame(packetBuffer);
+
+console.log(decodedData);
+
+// Compact key frame followed by a delta frame from the same node
+console.log(decodeFrame(Buffer.from('e3661360cc228724944f06045934e4040118', 'hex')));
+console.log(decodeFrame(Buffer.from('eb6614018e0322ae01090a3a', 'hex')));
+
+// Delta frame raised by a shock that tilted the node to -31 deg, peak 505 mg,
+// RMS 134 mg, 160 ms above threshold
+console.log(decodeFrame(Buffer.from('ef6615011043f9038601a001', 'hex')));
+
+// Key frame at -5.25 degC with min/max/mean of 300 samples
+console.log(decodeFrame(Buffer.from('f36615609908b83f834e00005934e4040118ac02050a02050a02050a02050a02050a02050a02050a02', 'hex')));
+
+// Format v1 key and delta frame of node 103, pressure in hPa on the wire
+console.log(decodeFrame(Buffer.from('c3671360a6118724f50703025934e4040118', 'hex')));
+console.log(decodeFrame(Buffer.from('cb6714018e0322ae01010a3a', 'hex')));
+
+// Chain frame node 102 forwarded, node 101's record and its own received at -93 dBm, SNR 6 dB
+console.log(decodeUplink(Buffer.from('a26601120000e3653457e6218424974f00000240e4040128125d06e366115780209a26974f000002478f050128', 'hex')));
 
-console.log(decodedData);
\ No newline at end of file
+// Node 102 to send every 5 minutes and listen between uplinks
+console.log(encodeCommand(102, { send_interval: 300, listen: 1 }).toString('hex'));
@@ -0,0 +1,424 @@
+/**
+ * @file mylog_decode.cpp
+ * @brief Host decoder for deferred myLog records (MYLOG_DEFERRED)
+ *
+ * The firmware only sends a call site index, millis() and the raw arguments.
+ * Format string, file, function and line are read back from the mylog_sites
+ * section of the ELF the capture was produced with, then the line is printed
+ * the way the direct myLog_x() macros would have printed it.
+ *
+ *   g++ decoders/mylog_decode.cpp -o mylog_decode
+ *   ./mylog_decode .pio/build/wiscore_rak4631/firmware.elf capture.bin
+ *   .pio/build/native/program --serial /dev/stdout | ./mylog_decode .pio/build/native/program
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#define MYLOG_SYNC 0xA5
+#define MYLOG_RECORD_HEADER 7
+#define MYLOG_SITE_DROPPED 0xFFFF
+
+/** ELF constants used below, <elf.h> is not available everywhere */
+#define ELF_CLASS64 2
+#define ELF_SHT_RELA 4
+#define ELF_SHT_NOBITS 8
+#define ELF_SHF_ALLOC 2
+#define ELF_EM_X86_64 62
+#define ELF_EM_AARCH64 183
+#define ELF_R_X86_64_RELATIVE 8
+#define ELF_R_AARCH64_RELATIVE 1027
+
+struct Section
+{
+	std::string name;
+	uint32_t type;
+	uint64_t flags;
+	uint64_t addr;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct Site
+{
+	std::string fmt;
+	std::string file;
+	std::string func;
+	uint16_t line;
+	char level;
+};
+
+static std::vector<uint8_t> elf;
+static bool elf64;
+static std::vector<Section> sections;
+/** Pointers filled in by the dynamic loader of a PIE host build */
+static std::map<uint64_t, uint64_t> relocated;
+
+static uint64_t rd(uint64_t offset, int size)
+{
+	uint64_t v = 0;
+	if (offset + size > elf.size())
+	{
+		return 0;
+	}
+	memcpy(&v, &elf[offset], size);
+	return v;
+}
+
+static uint64_t rdPtr(uint64_t offset)
+{
+	return rd(offset, elf64 ? 8 : 4);
+}
+
+static const Section *sectionAt(uint64_t addr)
+{
+	for (const Section &s : sections)
+	{
+		if ((s.flags & ELF_SHF_ALLOC) && s.type != ELF_SHT_NOBITS && addr >= s.addr && addr < s.addr + s.size)
+		{
+			return &s;
+		}
+	}
+	return NULL;
+}
+
+static uint64_t pointerAt(uint64_t addr)
+{
+	std::map<uint64_t, uint64_t>::const_iterator r = relocated.find(addr);
+	if (r != relocated.end())
+	{
+		return r->second;
+	}
+	const Section *s = sectionAt(addr);
+	return s ? rdPtr(s->offset + addr - s->addr) : 0;
+}
+
+static std::string stringAt(uint64_t addr)
+{
+	const Section *s = sectionAt(addr);
+	if (s == NULL)
+	{
+		return "?";
+	}
+	uint64_t off = s->offset + addr - s->addr;
+	uint64_t end = s->offset + s->size;
+	std::string str;
+	while (off < end && elf[off])
+	{
+		str += (char)elf[off++];
+	}
+	return str;
+}
+
+/**
+ * @brief Load the call site table from the mylog_sites section
+ */
+static bool loadSites(const char *path, std::vector<Site> &sites)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+	{
+		perror(path);
+		return false;
+	}
+	uint8_t buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		elf.insert(elf.end(), buf, buf + n);
+	}
+	fclose(f);
+	if (elf.size() < 52 || memcmp(&elf[0], "\177ELF", 4) != 0)
+	{
+		fprintf(stderr, "%s: not an ELF file\n", path);
+		return false;
+	}
+
+	elf64 = elf[4] == ELF_CLASS64;
+	uint16_t machine = (uint16_t)rd(18, 2);
+	uint64_t shoff = elf64 ? rd(40, 8) : rd(32, 4);
+	uint16_t shentsize = (uint16_t)rd(elf64 ? 58 : 46, 2);
+	uint16_t shnum = (uint16_t)rd(elf64 ? 60 : 48, 2);
+	uint16_t shstrndx = (uint16_t)rd(elf64 ? 62 : 50, 2);
+	for (uint16_t i = 0; i < shnum; i++)
+	{
+		uint64_t h = shoff + (uint64_t)i * shentsize;
+		Section s;
+		s.name = std::to_string(rd(h, 4));
+		s.type = (uint32_t)rd(h + 4, 4);
+		s.flags = elf64 ? rd(h + 8, 8) : rd(h + 8, 4);
+		s.addr = elf64 ? rd(h + 16, 8) : rd(h + 12, 4);
+		s.offset = elf64 ? rd(h + 24, 8) : rd(h + 16, 4);
+		s.size = elf64 ? rd(h + 32, 8) : rd(h + 20, 4);
+		sections.push_back(s);
+	}
+	if (shstrndx >= sections.size())
+	{
+		fprintf(stderr, "%s: no section names\n", path);
+		return false;
+	}
+	const Section *sitesSection = NULL;
+	for (Section &s : sections)
+	{
+		uint64_t nameOff = sections[shstrndx].offset + strtoull(s.name.c_str(), NULL, 10);
+		s.name.clear();
+		while (nameOff < elf.size() && elf[nameOff])
+		{
+			s.name += (char)elf[nameOff++];
+		}
+	}
+
+	for (const Section &s : sections)
+	{
+		if (s.name == "mylog_sites")
+		{
+			sitesSection = &s;
+		}
+		if (elf64 && s.type == ELF_SHT_RELA)
+		{
+			for (uint64_t r = s.offset; r + 24 <= s.offset + s.size; r += 24)
+			{
+				uint32_t type = (uint32_t)rd(r + 8, 4);
+				if ((machine == ELF_EM_X86_64 && type == ELF_R_X86_64_RELATIVE) ||
+					(machine == ELF_EM_AARCH64 && type == ELF_R_AARCH64_RELATIVE))
+				{
+					relocated[rd(r, 8)] = rd(r + 16, 8);
+				}
+			}
+		}
+	}
+	if (sitesSection == NULL)
+	{
+		fprintf(stderr, "%s: no mylog_sites section, not built with MYLOG_DEFERRED?\n", path);
+		return false;
+	}
+
+	// struct MyLogSite { const char *fmt, *file, *func; uint16_t line; char level; }
+	uint64_t ptr = elf64 ? 8 : 4;
+	uint64_t size = elf64 ? 32 : 16;
+	for (uint64_t a = sitesSection->addr; a + size <= sitesSection->addr + sitesSection->size; a += size)
+	{
+		uint64_t off = sitesSection->offset + a - sitesSection->addr;
+		Site site;
+		site.fmt = stringAt(pointerAt(a));
+		site.file = stringAt(pointerAt(a + ptr));
+		site.func = stringAt(pointerAt(a + 2 * ptr));
+		site.line = (uint16_t)rd(off + 3 * ptr, 2);
+		site.level = (char)rd(off + 3 * ptr + 2, 1);
+		size_t slash = site.file.find_last_of("/\\");
+		if (slash != std::string::npos)
+		{
+			site.file = site.file.substr(slash + 1);
+		}
+		sites.push_back(site);
+	}
+	return true;
+}
+
+/**
+ * @brief Cursor over the packed arguments of one record
+ */
+struct Args
+{
+	const uint8_t *p;
+	const uint8_t *end;
+
+	bool next(char &tag, int64_t &i, double &f, std::string &s)
+	{
+		if (p >= end)
+		{
+			return false;
+		}
+		tag = (char)*p++;
+		uint32_t u32 = 0;
+		switch (tag)
+		{
+		case 'i':
+		case 'u':
+		case 'p':
+		case 'f':
+			if (end - p < 4)
+				return false;
+			memcpy(&u32, p, 4);
+			p += 4;
+			i = tag == 'i' ? (int64_t)(int32_t)u32 : (int64_t)u32;
+			if (tag == 'f')
+			{
+				float v;
+				memcpy(&v, &u32, 4);
+				f = v;
+			}
+			return true;
+		case 'I':
+		case 'U':
+			if (end - p < 8)
+				return false;
+			memcpy(&i, p, 8);
+			p += 8;
+			return true;
+		case 's':
+			if (p >= end || end - p - 1 < *p)
+				return false;
+			s.assign((const char *)p + 1, *p);
+			p += 1 + *p;
+			return true;
+		default:
+			p = end;
+			return false;
+		}
+	}
+};
+
+/**
+ * @brief printf() the format of a site with the recorded arguments
+ */
+static std::string format(const std::string &fmt, Args args)
+{
+	std::string out;
+	char buf[256];
+	for (size_t i = 0; i < fmt.size(); i++)
+	{
+		if (fmt[i] != '%')
+		{
+			out += fmt[i];
+			continue;
+		}
+		size_t j = i + 1;
+		std::string spec = "%";
+		while (j < fmt.size() && strchr("-+ #0123456789.*", fmt[j]))
+		{
+			if (fmt[j] == '*')
+			{
+				char tag;
+				int64_t v = 0;
+				double f;
+				std::string s;
+				args.next(tag, v, f, s);
+				spec += std::to_string(v);
+			}
+			else
+			{
+				spec += fmt[j];
+			}
+			j++;
+		}
+		while (j < fmt.size() && strchr("hlLqjzt", fmt[j]))
+		{
+			j++;
+		}
+		if (j >= fmt.size())
+		{
+			break;
+		}
+		char conv = fmt[j];
+		i = j;
+		if (conv == '%')
+		{
+			out += '%';
+			continue;
+		}
+		char tag;
+		int64_t v = 0;
+		double f = 0;
+		std::string s;
+		if (!args.next(tag, v, f, s))
+		{
+			out += "<?>";
+			continue;
+		}
+		if (conv == 'c')
+		{
+			snprintf(buf, sizeof(buf), (spec + 'c').c_str(), (int)v);
+		}
+		else if (strchr("diouxX", conv))
+		{
+			spec += conv == 'i' ? std::string("lld") : std::string("ll") + conv;
+			snprintf(buf, sizeof(buf), spec.c_str(), tag == 'f' ? (long long)f : (long long)v);
+		}
+		else if (strchr("fFeEgGaA", conv))
+		{
+			snprintf(buf, sizeof(buf), (spec + conv).c_str(), tag == 'f' ? f : (double)v);
+		}
+		else if (conv == 's')
+		{
+			snprintf(buf, sizeof(buf), (spec + 's').c_str(), tag == 's' ? s.c_str() : "<?>");
+		}
+		else if (conv == 'p')
+		{
+			snprintf(buf, sizeof(buf), "0x%08llx", (unsigned long long)v);
+		}
+		else
+		{
+			snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+		}
+		out += buf;
+	}
+	return out;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "usage: %s firmware.elf [capture.bin]\n", argv[0]);
+		return 1;
+	}
+	std::vector<Site> sites;
+	if (!loadSites(argv[1], sites))
+	{
+		return 1;
+	}
+	FILE *in = argc == 3 ? fopen(argv[2], "rb") : stdin;
+	if (in == NULL)
+	{
+		perror(argv[2]);
+		return 1;
+	}
+
+	int c;
+	unsigned long skipped = 0;
+	while ((c = fgetc(in)) != EOF)
+	{
+		if (c != MYLOG_SYNC)
+		{
+			skipped++;
+			continue;
+		}
+		int len = fgetc(in);
+		uint8_t rec[256];
+		if (len < MYLOG_RECORD_HEADER || fread(rec + 1, 1, len - 1, in) != (size_t)len - 1)
+		{
+			skipped++;
+			continue;
+		}
+		uint16_t id;
+		uint32_t ms;
+		memcpy(&id, &rec[1], 2);
+		memcpy(&ms, &rec[3], 4);
+		Args args = {rec + MYLOG_RECORD_HEADER, rec + len};
+		if (id == MYLOG_SITE_DROPPED)
+		{
+			printf("%10.3f [W][myLog] %s records dropped, ring full\n", ms / 1000.0,
+				   format("%u", args).c_str());
+			continue;
+		}
+		if (id >= sites.size())
+		{
+			// Not a record, or a capture from another build
+			skipped += len + 1;
+			continue;
+		}
+		const Site &site = sites[id];
+		printf("%10.3f [%c][%s:%d]%s: %s\n", ms / 1000.0, site.level, site.file.c_str(), site.line,
+			   site.func.c_str(), format(site.fmt, args).c_str());
+	}
+	if (skipped)
+	{
+		fprintf(stderr, "%lu bytes skipped\n", skipped);
+	}
+	return 0;
+}
@@ -18,6 +18,9 @@
 */
 #include "Flash.h"
 
+// [env:native] links the simulated flash in sim/NativeSim instead
+#ifndef NATIVE_SIM
+
 FlashClass Flash;
 
 uint32_t FlashClass::page_size() const {
@@ -27,7 +30,7 @@ uint32_t FlashClass::page_size() const {
 uint8_t FlashClass::page_size_bits() const {
 #if defined(NRF51)
   return 10;
-#elif defined(NRF52)
+#elif defined(NRF52) || defined(NRF52840)
   return 12;
 #endif
 }
@@ -133,3 +136,5 @@ void FlashClass::wait_for_ready() {
   while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {
   };
 }
+
+#endif
@@ -108,6 +108,45 @@ bool NVRAMClass::write_block(uint8_t *src, uint16_t idx, uint16_t n) {
     bitmap = 0;
   }
 
+#ifdef NVRAM_WRITE_COMBINE
+  // Count the log entries first, a page switch is decided before anything
+  // is written
+  uint16_t changes = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    if (src[i] != get_byte_from_page(vpage, log_start, log_end, idx + i))
+      changes++;
+  }
+  if (changes == 0)
+    return true;
+
+  // Log too short: the new page takes the whole block into its map
+  if (log_end + changes > VirtualPage.length()) {
+    vpage = switch_page(vpage, &log_start, &log_end, src, idx, n);
+    return (vpage != (uint32_t *)~0);
+  }
+
+  // Stage log entries and program them in bursts
+  uint32_t burst[NVRAM_WRITE_BURST];
+  uint16_t staged = 0;
+  while (n > 0) {
+    uint8_t new_value = *src;
+    if (new_value != get_byte_from_page(vpage, log_start, log_end, idx)) {
+      bitmap |= ADDR2BIT(idx);
+      burst[staged++] =
+          (idx << NVRAM_ADDR_POS) | bitmap | (uint32_t)new_value;
+      if (staged == NVRAM_WRITE_BURST) {
+        log_end = write_burst(vpage, log_end, burst, staged);
+        staged = 0;
+      }
+    }
+
+    // calculate next address
+    n--;
+    src++;
+    idx++;
+  }
+  write_burst(vpage, log_end, burst, staged);
+#else
   while (n > 0) {
     // Read cell
     uint8_t old_value = get_byte_from_page(vpage, log_start, log_end, idx);
@@ -126,9 +165,14 @@ bool NVRAMClass::write_block(uint8_t *src, uint16_t idx, uint16_t n) {
         bitmap = 0;
       }
 
-      // Add Entry into log
-      Flash.write(&vpage[log_end], (idx << NVRAM_ADDR_POS) | bitmap |
-                                       ADDR2BIT(idx) | (uint32_t)new_value);
+      // Add Entry into log. The bitmap collects the ranges of every entry
+      // so far, a block crossing a range border must not hide its first part
+      bitmap |= ADDR2BIT(idx);
+      Flash.write(&vpage[log_end],
+                  (idx << NVRAM_ADDR_POS) | bitmap | (uint32_t)new_value);
+#ifdef NVRAM_INDEX
+      index_append(vpage, log_end, idx);
+#endif
       log_end++;
     }
 
@@ -137,9 +181,24 @@ bool NVRAMClass::write_block(uint8_t *src, uint16_t idx, uint16_t n) {
     src++;
     idx++;
   }
+#endif
   return true;
 }
 
+#ifdef NVRAM_WRITE_COMBINE
+uint16_t NVRAMClass::write_burst(uint32_t *vpage, uint16_t log_end,
+                                 uint32_t *burst, uint16_t words) {
+  if (words == 0)
+    return log_end;
+  Flash.write_block(&vpage[log_end], burst, words);
+#ifdef NVRAM_INDEX
+  for (uint16_t i = 0; i < words; i++)
+    index_append(vpage, log_end + i, burst[i] >> NVRAM_ADDR_POS);
+#endif
+  return log_end + words;
+}
+#endif
+
 bool NVRAMClass::write(uint16_t idx, uint8_t value) {
   return (write_block(&value, idx, 1));
 }
@@ -177,8 +236,28 @@ void NVRAMClass::clean_up(uint16_t write_preserve) {
     write_prepare(write_preserve);
 }
 
+bool NVRAMClass::clean_up_step(uint16_t write_preserve) {
+  // Erase released pages first, the page switch below then takes a blank one
+  if (VirtualPage.clean_up())
+    return true;
+
+  uint32_t *vpage = get_page();
+  if ((vpage == (uint32_t *)~0) || (write_preserve == 0))
+    return false;
+
+  // Enough room in the log?
+  uint16_t log_start = vpage[0] + 1;
+  uint16_t log_end = get_log_position(vpage);
+  if (log_end + write_preserve <= VirtualPage.length())
+    return false;
+
+  // The old page is released now and waits for the next step
+  return switch_page(vpage, &log_start, &log_end) != (uint32_t *)~0;
+}
+
 uint32_t *NVRAMClass::switch_page(uint32_t *old_vpage, uint16_t *log_start,
-                                  uint16_t *log_end) {
+                                  uint16_t *log_end, const uint8_t *src,
+                                  uint16_t idx, uint16_t n) {
   // Mark old page as in release
   VirtualPage.release_prepare(old_vpage);
 
@@ -197,21 +276,43 @@ uint32_t *NVRAMClass::switch_page(uint32_t *old_vpage, uint16_t *log_start,
 
 // Build map
 #ifdef FLASH_SUPPORTS_RANDOM_WRITE
+#ifdef NVRAM_WRITE_COMBINE
+  // Copy current values in bursts, runs of blank words are skipped
+  uint32_t burst[NVRAM_WRITE_BURST];
+  for (uint16_t i = 0; i < (NVRAM_LENGTH >> 2); i += NVRAM_WRITE_BURST) {
+    uint16_t words = 0;
+    bool used = false;
+    while ((words < NVRAM_WRITE_BURST) &&
+           (i + words < (NVRAM_LENGTH >> 2))) {
+      burst[words] = map_word(i + words, src, idx, n);
+      if (burst[words] != (uint32_t)~0) {
+        // Value found
+        map_length = i + words + 1;
+        used = true;
+      }
+      words++;
+    }
+    if (used)
+      Flash.write_block(&new_vpage[i + 1], burst, words);
+  }
+  (void)value;
+#else
   // Copy current values
   for (uint16_t i = 0; i < (NVRAM_LENGTH >> 2); i++) {
-    read_block((uint8_t *)&value, i << 2, 4);
+    value = map_word(i, src, idx, n);
     if (value != (uint32_t)~0) {
       // Value found
       map_length = i + 1;
       Flash.write(&new_vpage[i + 1], value);
     }
   }
+#endif
   // Store map length
   Flash.write(new_vpage, map_length);
 #else
   // find map length
   for (uint16_t i = (NVRAM_LENGTH >> 2); i >= 0; i--) {
-    read_block((uint8_t *)&value, i << 2, 4);
+    value = map_word(i, src, idx, n);
     if (value != (uint32_t)~0) {
       // Value found
       map_length = i + 1;
@@ -224,7 +325,7 @@ uint32_t *NVRAMClass::switch_page(uint32_t *old_vpage, uint16_t *log_start,
 
   // Copy current values
   for (uint16_t i = 0; i <= map_length; i++) {
-    read_block((uint8_t *)&value, i << 2, 4);
+    value = map_word(i, src, idx, n);
     if (value != (uint32_t)~0) {
       // Value found
       map_length = i;
@@ -240,9 +341,28 @@ uint32_t *NVRAMClass::switch_page(uint32_t *old_vpage, uint16_t *log_start,
   *log_start = map_length + 1;
   *log_end = *log_start;
 
+#ifdef NVRAM_INDEX
+  // Everything is in the map now
+  memset(index_pos, 0, sizeof(index_pos));
+  index_page = new_vpage;
+  index_log_end = *log_end;
+#endif
+
   return new_vpage;
 }
 
+uint32_t NVRAMClass::map_word(uint16_t i, const uint8_t *src, uint16_t idx,
+                              uint16_t n) {
+  uint32_t value;
+  read_block((uint8_t *)&value, i << 2, 4);
+  for (uint8_t b = 0; b < 4; b++) {
+    uint16_t cell = (i << 2) + b;
+    if ((cell >= idx) && (cell < idx + n))
+      ((uint8_t *)&value)[b] = src[cell - idx];
+  }
+  return value;
+}
+
 uint32_t *NVRAMClass::get_page() {
   uint32_t *vpage = VirtualPage.get(NVRAM_MAGIC);
   // Invalid page?
@@ -251,11 +371,55 @@ uint32_t *NVRAMClass::get_page() {
     vpage = VirtualPage.allocate(NVRAM_MAGIC, VirtualPage.length());
     // Set map length to 0
     Flash.write(&vpage[0], 0x0);
+#ifdef NVRAM_INDEX
+    // May be the address of a page the index was built for before a format
+    index_page = (uint32_t *)~0;
+#endif
   }
+#ifdef NVRAM_INDEX
+  if (vpage != index_page)
+    index_build(vpage);
+#endif
   return vpage;
 }
 
+#ifdef NVRAM_INDEX
+void NVRAMClass::index_build(uint32_t *vpage) {
+  memset(index_pos, 0, sizeof(index_pos));
+  index_page = (uint32_t *)~0;
+  if (vpage == (uint32_t *)~0)
+    return;
+
+  uint16_t log_end = get_log_position(vpage);
+  uint16_t log_start = (log_end == 0) ? 1 : vpage[0] + 1;
+  // Forward, so later entries of a cell overwrite earlier ones. Blank words
+  // decode to cell 4095, above any indexed cell.
+  for (uint16_t pos = log_start; pos < log_end; pos++) {
+    uint16_t idx = vpage[pos] >> NVRAM_ADDR_POS;
+    if (idx < NVRAM_INDEX_CELLS)
+      index_pos[idx] = pos;
+  }
+  index_page = vpage;
+  index_log_end = log_end;
+}
+
+void NVRAMClass::index_append(uint32_t *vpage, uint16_t log_pos,
+                              uint16_t idx) {
+  if (vpage != index_page)
+    return;
+  if (idx < NVRAM_INDEX_CELLS)
+    index_pos[idx] = log_pos;
+  index_log_end = log_pos + 1;
+}
+#endif
+
 uint16_t NVRAMClass::get_log_position(uint32_t *vpage) {
+#ifdef NVRAM_INDEX
+  // Known without the binary search while the index is valid
+  if (vpage == index_page)
+    return index_log_end;
+#endif
+
   uint16_t position_min = vpage[0] + 1;
   uint16_t position_max = VirtualPage.length();
 
@@ -279,6 +443,15 @@ uint16_t NVRAMClass::get_log_position(uint32_t *vpage) {
 
 uint8_t NVRAMClass::get_byte_from_page(uint32_t *vpage, uint16_t log_start,
                                        uint16_t log_end, uint16_t idx) {
+#ifdef NVRAM_INDEX
+  if ((vpage == index_page) && (idx < NVRAM_INDEX_CELLS)) {
+    uint16_t pos = index_pos[idx];
+    if ((pos >= log_start) && (pos < log_end))
+      return (uint8_t)vpage[pos];
+    // Not in the log, skip the scan and look at the map
+    log_end = log_start;
+  }
+#endif
   // mask matching a bit signaling wich address range is in log
   uint32_t address_mask = ADDR2BIT(idx);
   // mask matching the index address
@@ -22,6 +22,31 @@
 #include "VirtualPage.h"
 #include <Arduino.h>
 
+/*
+ * With NVRAM_INDEX a RAM table holds the log position of the newest entry of
+ * each of the first NVRAM_INDEX_CELLS cells. Reads and the compare in
+ * write_block() then cost one flash word instead of a backward log scan per
+ * byte. The table is built once per page by get_page() and kept up to date
+ * on every append and page switch. Costs 2 bytes of RAM per cell, cells
+ * above NVRAM_INDEX_CELLS fall back to the log scan.
+ */
+#if defined(NVRAM_INDEX) && !defined(NVRAM_INDEX_CELLS)
+#define NVRAM_INDEX_CELLS 3072
+#endif
+
+/*
+ * With NVRAM_WRITE_COMBINE write_block() counts the changed cells before it
+ * writes anything. A block that does not fit into the log goes straight into
+ * the map of the next page, so there is at most one page switch and never one
+ * half way through the block. Log entries and map words are programmed with
+ * Flash.write_block() in runs of up to NVRAM_WRITE_BURST words, one NVMC
+ * write enable per run instead of one per byte. Costs 4 bytes of stack per
+ * burst word.
+ */
+#if defined(NVRAM_WRITE_COMBINE) && !defined(NVRAM_WRITE_BURST)
+#define NVRAM_WRITE_BURST 32
+#endif
+
 class NVRAMClass {
 public:
   NVRAMClass(){};
@@ -48,6 +73,13 @@ public:
   // Plan with 0-5000ms.
   void clean_up(uint16_t write_preserve);
 
+  // Incremental clean_up() for idle time, at most one page erase per call.
+  // Erases a released page, or starts a new page when less than
+  // write_preserve log entries are left. Returns true while work is left, a
+  // write of up to write_preserve changed bytes then never erases.
+  // Plan with 0-100ms.
+  bool clean_up_step(uint16_t write_preserve);
+
 private:
   // Return a virtual page
   uint32_t *get_page();
@@ -56,9 +88,32 @@ private:
   // Read a byte from page
   uint8_t get_byte_from_page(uint32_t *vpage, uint16_t log_start,
                              uint16_t log_end, uint16_t idx);
-  // switch a page
+  // switch a page, the block src/idx/n is written into the new map
   uint32_t *switch_page(uint32_t *old_vpage, uint16_t *log_start,
-                        uint16_t *log_end);
+                        uint16_t *log_end, const uint8_t *src = NULL,
+                        uint16_t idx = 0, uint16_t n = 0);
+  // Map word i for a new page: current value with block src/idx/n on top
+  uint32_t map_word(uint16_t i, const uint8_t *src, uint16_t idx, uint16_t n);
+
+#ifdef NVRAM_WRITE_COMBINE
+  // Program words log entries at log_end, returns the new log end
+  uint16_t write_burst(uint32_t *vpage, uint16_t log_end, uint32_t *burst,
+                       uint16_t words);
+#endif
+
+#ifdef NVRAM_INDEX
+  // Build the index from the log of vpage
+  void index_build(uint32_t *vpage);
+  // Log entry for idx was written at log_pos of vpage
+  void index_append(uint32_t *vpage, uint16_t log_pos, uint16_t idx);
+
+  // Page the index belongs to
+  uint32_t *index_page = (uint32_t *)~0;
+  // Log position after the last entry of index_page
+  uint16_t index_log_end = 0;
+  // Log position of the newest entry per cell, 0 if the cell is not in the log
+  uint16_t index_pos[NVRAM_INDEX_CELLS];
+#endif
 };
 
 extern NVRAMClass NVRAM;
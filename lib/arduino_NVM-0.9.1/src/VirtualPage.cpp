@@ -51,7 +51,7 @@ VirtualPageClass VirtualPage;
 #define VNM_VIRTUAL_PAGE_SIZE (1 << (VNM_VIRTUAL_PAGE_SIZE_BITS))
 #define VNM_VIRTUAL_PAGE_ADDRESS_MASK (~(VNM_VIRTUAL_PAGE_SIZE - 1))
 #define VNM_VIRTUAL_PAGE_ALIGN(address)                                        \
-  { address = (uint32_t *)((uint32_t)address & VNM_VIRTUAL_PAGE_ADDRESS_MASK); }
+  { address = (uint32_t *)((uintptr_t)address & VNM_VIRTUAL_PAGE_ADDRESS_MASK); }
 
 /*
  * Defines the position of status words in a page.
@@ -166,6 +166,7 @@ uint32_t *VirtualPageClass::get(uint32_t magic) {
 uint32_t *VirtualPageClass::allocate(uint32_t magic) {
   uint32_t *return_page = (uint32_t *)(~0);
   uint32_t max_erase_cycles = (uint32_t)~0;
+  bool return_blank = false;
 
   // Avoid duplicate allocation of pages, look for the less used page
   for (int i = 1; i <= VNM_VIRTUAL_PAGE_COUNT; i++) {
@@ -184,16 +185,20 @@ uint32_t *VirtualPageClass::allocate(uint32_t magic) {
     }
 
     uint32_t erase_cycles = get_page_erase_cycles(page);
-    // When the page has less erase cycles and is not marked as failed
-    if ((erase_cycles < max_erase_cycles) && (page[OFFSET_MAGIC] > 0) &&
-        (
-            // magic is empty
-            (page[OFFSET_MAGIC] == (uint32_t)~0) ||
-            // marked as released
-            ((page[OFFSET_STATUS_RELEASE_END] & BIT_STATUS_RELEASE_END) ==
-             0))) {
+    // magic is empty, the page needs no erase
+    bool blank = (page[OFFSET_MAGIC] == (uint32_t)~0);
+    // marked as released, the page is erased by build_page()
+    bool released =
+        ((page[OFFSET_STATUS_RELEASE_END] & BIT_STATUS_RELEASE_END) == 0);
+    // When the page is not marked as failed, take a blank page before a
+    // released one and then the page with less erase cycles. With clean_up()
+    // run in idle time the erase is never done here
+    if ((page[OFFSET_MAGIC] > 0) && (blank || released) &&
+        ((blank && !return_blank) ||
+         ((blank == return_blank) && (erase_cycles < max_erase_cycles)))) {
       max_erase_cycles = erase_cycles;
       return_page = page;
+      return_blank = blank;
     }
   }
 
@@ -262,15 +267,16 @@ void VirtualPageClass::fail(uint32_t *address) {
   return;
 }
 
-void VirtualPageClass::clean_up() {
+bool VirtualPageClass::clean_up() {
   // No page found -> try to give back a page prepared for release
   for (int i = 1; i <= VNM_VIRTUAL_PAGE_COUNT; i++) {
     uint32_t *page = get_page_address(i);
     if ((page[OFFSET_STATUS_RELEASE_END] & BIT_STATUS_RELEASE_END) == 0) {
       build_page(get_page_address(i), ~0);
-      return; // a maximum of a page is cleaned -> return
+      return true; // a maximum of a page is cleaned -> return
     }
   }
+  return false;
 }
 
 void VirtualPageClass::format() {
@@ -281,7 +287,7 @@ void VirtualPageClass::format() {
 }
 
 uint32_t *VirtualPageClass::get_page_address(uint16_t page) {
-  return (uint32_t *)((Flash.page_count() << Flash.page_size_bits()) -
+  return (uint32_t *)((uintptr_t)Flash.page_address(Flash.page_count()) -
                       ((page + VNM_VIRTUAL_PAGE_SKIP_FROM_TOP)
                        << VNM_VIRTUAL_PAGE_SIZE_BITS));
 }
@@ -314,6 +320,11 @@ void VirtualPageClass::build_page(uint32_t *address, uint32_t magic) {
 }
 
 uint32_t VirtualPageClass::get_page_erase_cycles(uint32_t *address) {
+  // A page never built by this library has no counter yet. Reading the blank
+  // word as 0x1000000 cycles made allocate() avoid those pages forever and
+  // wear_level() report a fresh chip as worn out
+  if (address[OFFSET_ERASE_COUNTER] == (uint32_t)~0)
+    return 0;
   // Return number of cycles
   return ((uint32_t)address[OFFSET_ERASE_COUNTER] &
           (uint32_t)MASK_ERASE_COUNTER) +
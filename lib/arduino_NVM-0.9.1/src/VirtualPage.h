@@ -76,8 +76,9 @@ public:
   // mark a page as defect
   void fail(uint32_t *address);
 
-  // Prepare released pages for faster reallocation. Plan with 0-100ms.
-  void clean_up();
+  // Prepare released pages for faster reallocation. Erases at most one page,
+  // returns true if it did. Plan with 0-100ms.
+  bool clean_up();
 
   // Release all pages
   void format();
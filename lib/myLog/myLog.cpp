@@ -1,4 +1,7 @@
-#include <Arduino.h>
+#ifdef MYLOG_DEFERRED
+#include <atomic>
+#endif
+#include "myLog.h"
 
 const char *pathToFileNameNRF(const char *path)
 {
@@ -16,3 +19,123 @@ const char *pathToFileNameNRF(const char *path)
 	}
 	return path + pos;
 }
+
+#ifdef MYLOG_DEFERRED
+#ifdef NATIVE_SIM
+#include <NativeSim.h>
+#endif
+
+/** Length byte of the unused tail of the ring when a record wraps to the start */
+#define MYLOG_PAD 0xFF
+
+/* Linker generated start of the call site records. Weak, a build without
+ * any site (log level NONE) has no mylog_sites section and nothing to commit */
+extern const MyLogSite __start_mylog_sites[] __attribute__((weak));
+
+/*
+ * Producers reserve space by advancing head with a CAS and publish a record by
+ * storing its length byte last. The single consumer (myLogDrain()) stops at
+ * the first length byte that is still zero, clears what it sent and then
+ * advances tail, so free space in the ring is always zero.
+ */
+static uint8_t myLogRing[MYLOG_RING_SIZE];
+static std::atomic<uint32_t> myLogHead(0);
+static std::atomic<uint32_t> myLogTail(0);
+static std::atomic<uint32_t> myLogDropped(0);
+
+void myLogCommit(const MyLogSite *site, uint8_t *args, uint8_t size)
+{
+	uint32_t len = MYLOG_RECORD_HEADER + size;
+	uint32_t head = myLogHead.load(std::memory_order_relaxed);
+	uint32_t pos;
+	uint32_t pad;
+	do
+	{
+		pos = head % MYLOG_RING_SIZE;
+		pad = pos + len > MYLOG_RING_SIZE ? MYLOG_RING_SIZE - pos : 0;
+		if (head + pad + len - myLogTail.load(std::memory_order_acquire) > MYLOG_RING_SIZE)
+		{
+			myLogDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	} while (!myLogHead.compare_exchange_weak(head, head + pad + len, std::memory_order_acq_rel,
+											  std::memory_order_relaxed));
+
+	uint8_t *record = &myLogRing[pad ? 0 : pos];
+	uint16_t id = (uint16_t)(site - __start_mylog_sites);
+	uint32_t ms = millis();
+	memcpy(&record[1], &id, 2);
+	memcpy(&record[3], &ms, 4);
+	memcpy(&record[MYLOG_RECORD_HEADER], args, size);
+	__atomic_store_n(&record[0], (uint8_t)len, __ATOMIC_RELEASE);
+	if (pad)
+	{
+		__atomic_store_n(&myLogRing[pos], (uint8_t)MYLOG_PAD, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * @brief Send all published records to Serial, only one caller at a time
+ */
+void myLogDrain(void)
+{
+	uint32_t tail = myLogTail.load(std::memory_order_relaxed);
+	while (tail != myLogHead.load(std::memory_order_acquire))
+	{
+		uint32_t pos = tail % MYLOG_RING_SIZE;
+		uint8_t len = __atomic_load_n(&myLogRing[pos], __ATOMIC_ACQUIRE);
+		if (len == 0)
+		{
+			// Reserved but not yet published
+			break;
+		}
+		if (len == MYLOG_PAD)
+		{
+			myLogRing[pos] = 0;
+			tail += MYLOG_RING_SIZE - pos;
+		}
+		else
+		{
+			Serial.write((uint8_t)MYLOG_SYNC);
+			Serial.write(&myLogRing[pos], len);
+			memset(&myLogRing[pos], 0, len);
+			tail += len;
+		}
+		myLogTail.store(tail, std::memory_order_release);
+	}
+
+	uint32_t dropped = myLogDropped.exchange(0, std::memory_order_relaxed);
+	if (dropped)
+	{
+		uint8_t record[1 + MYLOG_RECORD_HEADER + 5] = {MYLOG_SYNC, MYLOG_RECORD_HEADER + 5, 0xFF, 0xFF};
+		uint32_t ms = millis();
+		memcpy(&record[4], &ms, 4);
+		record[8] = 'u';
+		memcpy(&record[9], &dropped, 4);
+		Serial.write(record, sizeof(record));
+	}
+}
+
+#ifdef NATIVE_SIM
+void myLogBegin(void)
+{
+	// No tasks on the host, the ring is drained whenever the loop task blocks
+	nativeSimSetIdleHook(myLogDrain);
+}
+#else
+static void myLogTask(void *arg)
+{
+	(void)arg;
+	for (;;)
+	{
+		myLogDrain();
+		vTaskDelay(pdMS_TO_TICKS(MYLOG_DRAIN_MS));
+	}
+}
+
+void myLogBegin(void)
+{
+	xTaskCreate(myLogTask, "myLog", 256, NULL, TASK_PRIO_LOW, NULL);
+}
+#endif
+#endif
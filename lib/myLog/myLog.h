@@ -1,3 +1,9 @@
+#ifndef MYLOG_H
+#define MYLOG_H
+
+#ifdef MYLOG_DEFERRED
+#include <type_traits>
+#endif
 #include <Arduino.h>
 
 #define MYLOG_LOG_LEVEL_NONE (0)
@@ -7,6 +13,10 @@
 #define MYLOG_LOG_LEVEL_DEBUG (4)
 #define MYLOG_LOG_LEVEL_VERBOSE (5)
 
+#ifndef MYLOG_LOG_LEVEL
+#define MYLOG_LOG_LEVEL MYLOG_LOG_LEVEL_NONE
+#endif
+
 const char *pathToFileNameNRF(const char *path);
 
 #if __cplusplus
@@ -19,7 +29,162 @@ const char *pathToFileNameNRF(const char *path);
 #endif
 #endif
 
+#ifdef MYLOG_DEFERRED
+/*
+ * Deferred binary logging
+ *
+ * With MYLOG_DEFERRED the myLog_x() macros do not format anything. The format
+ * string, file, function and line of every call site are placed in the
+ * mylog_sites section at compile time, and a call only pushes the site index,
+ * millis() and the raw arguments into a lock-free ring. A low priority task
+ * (myLogBegin()) drains the ring to Serial as binary records, which
+ * decoders/mylog_decode.cpp turns back into text using the firmware ELF.
+ *
+ * Record in the ring and on the wire, little endian:
+ *   [MYLOG_SYNC, wire only] [length] [site index:16] [millis:32] [arguments]
+ * Argument: tag 'i'/'u' + 4 bytes, 'I'/'U' + 8 bytes, 'f' + float,
+ * 'p' + 4 bytes, 's' + length byte + characters (cut at MYLOG_MAX_STRING).
+ * Site index MYLOG_SITE_DROPPED reports records lost to a full ring.
+ */
+#ifndef MYLOG_RING_SIZE
+#define MYLOG_RING_SIZE 2048 // bytes, power of two
+#endif
+#ifndef MYLOG_MAX_RECORD
+#define MYLOG_MAX_RECORD 96 // bytes, arguments beyond are dropped
+#endif
+#ifndef MYLOG_MAX_STRING
+#define MYLOG_MAX_STRING 80
+#endif
+#ifndef MYLOG_DRAIN_MS
+#define MYLOG_DRAIN_MS 50 // drain task period
+#endif
+#define MYLOG_SYNC 0xA5
+#define MYLOG_RECORD_HEADER 7
+#define MYLOG_SITE_DROPPED 0xFFFF
+
+/**
+ * @brief Call site of a deferred log statement, only its index goes on the wire
+ */
+struct MyLogSite
+{
+	const char *fmt;
+	const char *file;
+	const char *func;
+	uint16_t line;
+	char level;
+};
+
+/**
+ * @brief Arguments of one record, packed on the caller's stack
+ */
+struct MyLogArgs
+{
+	uint8_t size;
+	uint8_t buf[MYLOG_MAX_RECORD - MYLOG_RECORD_HEADER];
+};
+
+void myLogBegin(void);
+void myLogDrain(void);
+void myLogCommit(const MyLogSite *site, uint8_t *args, uint8_t size);
+
+inline void myLogPut(MyLogArgs &args, char tag, const void *data, uint8_t size)
+{
+	if (args.size + 1u + size > sizeof(args.buf))
+	{
+		args.size = sizeof(args.buf);
+		return;
+	}
+	args.buf[args.size] = tag;
+	memcpy(&args.buf[args.size + 1], data, size);
+	args.size += 1 + size;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type myLogPack(MyLogArgs &args, T value)
+{
+	if (sizeof(T) > 4)
+	{
+		int64_t v = (int64_t)value;
+		myLogPut(args, std::is_signed<T>::value ? 'I' : 'U', &v, 8);
+	}
+	else
+	{
+		int32_t v = (int32_t)value;
+		myLogPut(args, std::is_signed<T>::value ? 'i' : 'u', &v, 4);
+	}
+}
+
+inline void myLogPack(MyLogArgs &args, double value)
+{
+	float v = (float)value;
+	myLogPut(args, 'f', &v, 4);
+}
+
+inline void myLogPack(MyLogArgs &args, const char *value)
+{
+	if (value == NULL)
+	{
+		value = "(null)";
+	}
+	size_t len = strnlen(value, MYLOG_MAX_STRING);
+	if (args.size + 2u + len > sizeof(args.buf))
+	{
+		args.size = sizeof(args.buf);
+		return;
+	}
+	args.buf[args.size] = 's';
+	args.buf[args.size + 1] = (uint8_t)len;
+	memcpy(&args.buf[args.size + 2], value, len);
+	args.size += 2 + len;
+}
+
+inline void myLogPack(MyLogArgs &args, char *value)
+{
+	myLogPack(args, (const char *)value);
+}
+
+template <typename T>
+inline void myLogPack(MyLogArgs &args, const T *value)
+{
+	uint32_t v = (uint32_t)(uintptr_t)value;
+	myLogPut(args, 'p', &v, 4);
+}
+
+inline void myLogPackAll(MyLogArgs &args)
+{
+	(void)args;
+}
+
+template <typename T, typename... Rest>
+inline void myLogPackAll(MyLogArgs &args, T value, Rest... rest)
+{
+	myLogPack(args, value);
+	myLogPackAll(args, rest...);
+}
+
+template <typename... Args>
+inline void myLogDefer(const MyLogSite *site, Args... values)
+{
+	MyLogArgs args;
+	args.size = 0;
+	myLogPackAll(args, values...);
+	myLogCommit(site, args.buf, args.size);
+}
+
+/* fmt must be a string literal, it is interned in the site record */
+#define MYLOG_DEFER(lvl, fmt, ...)                                                                  \
+	do                                                                                              \
+	{                                                                                               \
+		static const MyLogSite myLogSite __attribute__((used, section("mylog_sites"))) = {          \
+			"" fmt, __FILE__, __FUNCTION__, __LINE__, lvl};                                         \
+		myLogDefer(&myLogSite, ##__VA_ARGS__);                                                      \
+	} while (0)
+#endif
+
 #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_VERBOSE
+#ifdef MYLOG_DEFERRED
+#define myLog_v(...) MYLOG_DEFER('V', __VA_ARGS__)
+#else
 #define myLog_v(...)                         \
 	do                                       \
 	{                                        \
@@ -33,11 +198,15 @@ const char *pathToFileNameNRF(const char *path);
 		PRINTF(__VA_ARGS__);                 \
 		PRINTF("\n");                        \
 	} while (0)
+#endif
 #else
 #define myLog_v(format, ...)
 #endif
 
 #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_DEBUG
+#ifdef MYLOG_DEFERRED
+#define myLog_d(...) MYLOG_DEFER('D', __VA_ARGS__)
+#else
 #define myLog_d(...)                         \
 	do                                       \
 	{                                        \
@@ -51,11 +220,15 @@ const char *pathToFileNameNRF(const char *path);
 		PRINTF(__VA_ARGS__);                 \
 		PRINTF("\n");                        \
 	} while (0)
+#endif
 #else
 #define myLog_d(format, ...)
 #endif
 
 #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_INFO
+#ifdef MYLOG_DEFERRED
+#define myLog_i(...) MYLOG_DEFER('I', __VA_ARGS__)
+#else
 #define myLog_i(...)                         \
 	do                                       \
 	{                                        \
@@ -69,11 +242,15 @@ const char *pathToFileNameNRF(const char *path);
 		PRINTF(__VA_ARGS__);                 \
 		PRINTF("\n");                        \
 	} while (0)
+#endif
 #else
 #define myLog_i(format, ...)
 #endif
 
 #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_WARN
+#ifdef MYLOG_DEFERRED
+#define myLog_w(...) MYLOG_DEFER('W', __VA_ARGS__)
+#else
 #define myLog_w(...)                         \
 	do                                       \
 	{                                        \
@@ -87,11 +264,15 @@ const char *pathToFileNameNRF(const char *path);
 		PRINTF(__VA_ARGS__);                 \
 		PRINTF("\n");                        \
 	} while (0)
+#endif
 #else
 #define myLog_w(format, ...)
 #endif
 
 #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_ERROR
+#ifdef MYLOG_DEFERRED
+#define myLog_e(...) MYLOG_DEFER('E', __VA_ARGS__)
+#else
 #define myLog_e(...)                         \
 	do                                       \
 	{                                        \
@@ -105,6 +286,7 @@ const char *pathToFileNameNRF(const char *path);
 		PRINTF(__VA_ARGS__);                 \
 		PRINTF("\n");                        \
 	} while (0)
+#endif
 #else
 #define myLog_e(format, ...)
 #endif
@@ -112,3 +294,5 @@ const char *pathToFileNameNRF(const char *path);
 #if MYLOG_LOG_LEVEL == MYLOG_LOG_LEVEL_NONE
 #define myLog_n(format, ...)
 #endif
+
+#endif
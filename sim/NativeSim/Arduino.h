@@ -0,0 +1,209 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Adafruit nRF52 Arduino core used by [env:native]
+ *
+ * Only the subset of the core (GPIO, timing, Serial, String, FreeRTOS
+ * semaphores and SoftwareTimer) that the firmware in src/ touches is provided.
+ * Time is virtual: delay() advances the simulated clock instead of sleeping,
+ * so a day of node operation runs in well under a second.
+ */
+#ifndef NATIVE_SIM_ARDUINO_H
+#define NATIVE_SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#ifndef NATIVE_SIM
+#define NATIVE_SIM
+#endif
+
+// Constants
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+#define PI 3.1415926535897932384626433832795
+#define HEX 16
+#define DEC 10
+
+// WisBlock pin mapping
+#define LED_BUILTIN 35
+#define LED_CONN 36
+#define LED_GREEN 35
+#define LED_BLUE 36
+#define WB_IO1 17
+#define WB_IO2 34
+#define WB_IO3 21
+#define WB_IO4 4
+#define WB_IO5 9
+#define WB_IO6 10
+#define WB_A0 5
+#define A0 WB_A0
+#define NATIVE_SIM_PIN_COUNT 48
+
+#define AR_INTERNAL_3_0 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Timing
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+// GPIO
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t val);
+int digitalRead(uint32_t pin);
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+// ADC
+uint32_t analogRead(uint32_t pin);
+void analogReference(uint8_t mode);
+void analogReadResolution(uint8_t res);
+
+// System
+[[noreturn]] void NVIC_SystemReset(void);
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+/**
+ * @brief Minimal Arduino String built on std::string
+ */
+class String
+{
+public:
+	String(const char *s = "") : _s(s ? s : "") {}
+	String(const std::string &s) : _s(s) {}
+	String(char c) : _s(1, c) {}
+	String(int v, int base = DEC) : _s(fmt(v, base)) {}
+	String(unsigned int v, int base = DEC) : _s(fmt(v, base)) {}
+	String(long v, int base = DEC) : _s(fmt(v, base)) {}
+	String(unsigned long v, int base = DEC) : _s(fmt(v, base)) {}
+	String(float v, int decimals = 2) : _s(fmtf(v, decimals)) {}
+	String(double v, int decimals = 2) : _s(fmtf(v, decimals)) {}
+
+	const char *c_str(void) const { return _s.c_str(); }
+	unsigned int length(void) const { return _s.length(); }
+	String &operator+=(const String &rhs)
+	{
+		_s += rhs._s;
+		return *this;
+	}
+	friend String operator+(const String &lhs, const String &rhs) { return String(lhs._s + rhs._s); }
+	friend String operator+(const char *lhs, const String &rhs) { return String(std::string(lhs) + rhs._s); }
+	friend String operator+(const String &lhs, const char *rhs) { return String(lhs._s + rhs); }
+
+private:
+	static std::string fmt(long long v, int base)
+	{
+		char buf[40];
+		snprintf(buf, sizeof(buf), base == HEX ? "%llx" : "%lld", v);
+		return buf;
+	}
+	static std::string fmtf(double v, int decimals)
+	{
+		char buf[40];
+		snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+		return buf;
+	}
+	std::string _s;
+};
+
+/**
+ * @brief Serial port that writes to stdout, or to the --serial file
+ */
+class NativeSimSerial
+{
+public:
+	void begin(unsigned long baud) { (void)baud; }
+	operator bool() const { return true; }
+	size_t write(uint8_t c) { return fputc(c, out()) == EOF ? 0 : 1; }
+	size_t write(const uint8_t *buf, size_t size) { return fwrite(buf, 1, size, out()); }
+	size_t print(const char *s) { return fputs(s, out()) >= 0 ? strlen(s) : 0; }
+	size_t print(const String &s) { return print(s.c_str()); }
+	size_t print(long v, int base = DEC) { return print(String(v, base)); }
+	size_t println(void) { return print("\n"); }
+	size_t println(const char *s) { return print(s) + println(); }
+	size_t println(const String &s) { return print(s) + println(); }
+	size_t println(long v, int base = DEC) { return print(v, base) + println(); }
+	void flush(void) { fflush(out()); }
+	FILE *file = NULL;
+
+private:
+	FILE *out(void) { return file ? file : stdout; }
+};
+extern NativeSimSerial Serial;
+
+// FreeRTOS subset, one tick is one millisecond
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct NativeSimSemaphore;
+typedef NativeSimSemaphore *SemaphoreHandle_t;
+struct NativeSimTimer;
+typedef NativeSimTimer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t xTimer);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem);
+#define xSemaphoreGiveFromISR(sem, pxHigherPriorityTaskWoken) xSemaphoreGive(sem)
+void vTaskDelay(TickType_t ticks);
+/* Timer and radio callbacks never preempt the loop task in the simulation */
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+/**
+ * @brief FreeRTOS software timer wrapper, same interface as the nRF52 core
+ */
+class SoftwareTimer
+{
+public:
+	SoftwareTimer(void) : _handle(NULL) {}
+	void begin(uint32_t ms, TimerCallbackFunction_t callback, void *timerID = NULL, bool repeating = true);
+	TimerHandle_t getHandle(void) { return _handle; }
+	void setID(void *id);
+	void *getID(void);
+	bool start(void);
+	bool stop(void);
+	bool reset(void);
+	bool setPeriod(uint32_t ms);
+	bool startFromISR(void) { return start(); }
+	bool stopFromISR(void) { return stop(); }
+	bool resetFromISR(void) { return reset(); }
+
+private:
+	TimerHandle_t _handle;
+};
+
+/* The sketch entry points, implemented in src/main.cpp */
+void setup(void);
+void loop(void);
+
+#endif
@@ -0,0 +1,973 @@
+/**
+ * @file NativeSim.cpp
+ * @brief Virtual clock, FreeRTOS/Arduino core stand-ins and I2C bus of the
+ * simulated hardware layer
+ */
+#include "NativeSim.h"
+#include <Wire.h>
+#include <SPI.h>
+#include <bsec.h>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+NativeSimStats nativeSimStats;
+NativeSimSerial Serial;
+TwoWire Wire;
+SPIClass SPI;
+
+/** Thrown by NVIC_SystemReset(), caught by the harness which reruns setup() */
+struct NativeSimReset
+{
+};
+
+/** Thrown when the simulated run time is over */
+struct NativeSimStop
+{
+};
+
+static uint64_t simNowUs = 0;
+static uint64_t simBootUs = 0;
+static uint64_t simEndUs = UINT64_MAX;
+static bool simSleeping = false;
+static void (*simIdleHook)(void) = NULL;
+
+struct SimEvent
+{
+	uint64_t dueUs;
+	uint64_t seq;
+	void (*fn)(void *);
+	void *arg;
+};
+static std::vector<SimEvent> simEvents;
+static uint64_t simEventSeq = 0;
+
+struct NativeSimSemaphore
+{
+	int count;
+};
+
+struct NativeSimTimer
+{
+	uint32_t periodMs;
+	TimerCallbackFunction_t callback;
+	void *id;
+	bool repeating;
+	bool active;
+	uint64_t dueUs;
+};
+static std::vector<NativeSimTimer *> simTimers;
+
+static void (*simPinIsr[NATIVE_SIM_PIN_COUNT])(void);
+static uint8_t simPinState[NATIVE_SIM_PIN_COUNT];
+static float simBatteryMv = 3950.0f;
+
+/**
+ * @brief Earliest pending wakeup source, timers and scheduled events
+ */
+static uint64_t simNextDueUs(void)
+{
+	uint64_t due = UINT64_MAX;
+	for (NativeSimTimer *t : simTimers)
+	{
+		if (t->active && t->dueUs < due)
+		{
+			due = t->dueUs;
+		}
+	}
+	for (const SimEvent &e : simEvents)
+	{
+		if (e.dueUs < due)
+		{
+			due = e.dueUs;
+		}
+	}
+	return due;
+}
+
+/**
+ * @brief Run every timer callback and event that is due at the current time
+ */
+static void simFireDue(void)
+{
+	bool fired = true;
+	while (fired)
+	{
+		fired = false;
+		for (NativeSimTimer *t : simTimers)
+		{
+			if (t->active && t->dueUs <= simNowUs)
+			{
+				if (t->repeating)
+				{
+					t->dueUs += (uint64_t)t->periodMs * 1000;
+				}
+				else
+				{
+					t->active = false;
+				}
+				t->callback(t);
+				fired = true;
+			}
+		}
+		auto it = std::min_element(simEvents.begin(), simEvents.end(), [](const SimEvent &a, const SimEvent &b)
+								   { return a.dueUs != b.dueUs ? a.dueUs < b.dueUs : a.seq < b.seq; });
+		if (it != simEvents.end() && it->dueUs <= simNowUs)
+		{
+			SimEvent e = *it;
+			simEvents.erase(it);
+			e.fn(e.arg);
+			fired = true;
+		}
+	}
+}
+
+/**
+ * @brief Move the clock forward to targetUs, firing whatever falls due on the way
+ */
+static void simAdvanceTo(uint64_t targetUs)
+{
+	while (simNowUs < targetUs)
+	{
+		uint64_t due = simNextDueUs();
+		uint64_t step = std::min(due, targetUs);
+		if (step > simEndUs)
+		{
+			simNowUs = simEndUs;
+			throw NativeSimStop();
+		}
+		if (step > simNowUs)
+		{
+			if (simSleeping)
+			{
+				nativeSimStats.sleepMs += (step - simNowUs) / 1000;
+			}
+			else
+			{
+				nativeSimStats.awakeMs += (step - simNowUs) / 1000;
+			}
+			simNowUs = step;
+		}
+		simFireDue();
+	}
+}
+
+uint64_t nativeSimNow(void)
+{
+	return simNowUs / 1000;
+}
+
+void nativeSimAdvance(uint32_t ms)
+{
+	simAdvanceTo(simNowUs + (uint64_t)ms * 1000);
+}
+
+void nativeSimAdvanceUs(uint32_t us)
+{
+	simAdvanceTo(simNowUs + us);
+}
+
+void nativeSimSchedule(uint32_t ms, void (*fn)(void *), void *arg)
+{
+	simEvents.push_back({simNowUs + (uint64_t)ms * 1000, simEventSeq++, fn, arg});
+}
+
+void nativeSimTriggerPin(uint32_t pin)
+{
+	if (pin < NATIVE_SIM_PIN_COUNT && simPinIsr[pin] != NULL)
+	{
+		simPinIsr[pin]();
+	}
+}
+
+void nativeSimSetBatteryMv(float mv)
+{
+	simBatteryMv = mv;
+}
+
+// Arduino core
+unsigned long millis(void)
+{
+	return (unsigned long)((simNowUs - simBootUs) / 1000);
+}
+
+unsigned long micros(void)
+{
+	return (unsigned long)(simNowUs - simBootUs);
+}
+
+void delay(uint32_t ms)
+{
+	nativeSimAdvance(ms);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	nativeSimAdvanceUs(us);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	nativeSimAdvance(ticks);
+}
+
+void pinMode(uint32_t pin, uint32_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(uint32_t pin, uint32_t val)
+{
+	if (pin < NATIVE_SIM_PIN_COUNT)
+	{
+		simPinState[pin] = val ? HIGH : LOW;
+	}
+}
+
+int digitalRead(uint32_t pin)
+{
+	return pin < NATIVE_SIM_PIN_COUNT ? simPinState[pin] : LOW;
+}
+
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode)
+{
+	(void)mode;
+	if (pin < NATIVE_SIM_PIN_COUNT)
+	{
+		simPinIsr[pin] = callback;
+	}
+}
+
+void detachInterrupt(uint32_t pin)
+{
+	if (pin < NATIVE_SIM_PIN_COUNT)
+	{
+		simPinIsr[pin] = NULL;
+	}
+}
+
+uint32_t analogRead(uint32_t pin)
+{
+	(void)pin;
+	// Inverse of REAL_VBAT_MV_PER_LSB in main.h, 12 bit at 3.0V reference
+	return (uint32_t)(simBatteryMv / (1.73f * 0.73242188f));
+}
+
+void analogReference(uint8_t mode)
+{
+	(void)mode;
+}
+
+void analogReadResolution(uint8_t res)
+{
+	(void)res;
+}
+
+void NVIC_SystemReset(void)
+{
+	throw NativeSimReset();
+}
+
+long random(long max)
+{
+	return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max)
+{
+	return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+	srand(seed);
+}
+
+// FreeRTOS
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return new NativeSimSemaphore{0};
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	if (sem == NULL || sem->count > 0)
+	{
+		return pdFALSE;
+	}
+	sem->count = 1;
+	return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem)
+{
+	return sem == NULL ? 0 : sem->count;
+}
+
+/**
+ * @brief Blocking take, the only place where the simulated MCU sleeps
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+	uint64_t limitUs = ticks == portMAX_DELAY ? UINT64_MAX : simNowUs + (uint64_t)ticks * 1000;
+	bool slept = false;
+	while (sem->count == 0)
+	{
+		if (simIdleHook)
+		{
+			simIdleHook();
+		}
+		uint64_t due = simNextDueUs();
+		if (due == UINT64_MAX && limitUs == UINT64_MAX)
+		{
+			fprintf(stderr, "native: loop task blocked forever, no timer or event pending\n");
+			throw NativeSimStop();
+		}
+		if (due >= limitUs)
+		{
+			simSleeping = true;
+			simAdvanceTo(limitUs);
+			simSleeping = false;
+			break;
+		}
+		simSleeping = true;
+		simAdvanceTo(std::max(due, simNowUs));
+		simSleeping = false;
+		slept = true;
+	}
+	if (sem->count == 0)
+	{
+		return pdFALSE;
+	}
+	if (slept && ticks == portMAX_DELAY)
+	{
+		nativeSimStats.wakeups++;
+	}
+	sem->count = 0;
+	return pdTRUE;
+}
+
+void nativeSimSetIdleHook(void (*fn)(void))
+{
+	simIdleHook = fn;
+}
+
+void SoftwareTimer::begin(uint32_t ms, TimerCallbackFunction_t callback, void *timerID, bool repeating)
+{
+	if (_handle == NULL)
+	{
+		_handle = new NativeSimTimer();
+		simTimers.push_back(_handle);
+	}
+	*_handle = {ms, callback, timerID, repeating, false, 0};
+}
+
+void SoftwareTimer::setID(void *id)
+{
+	_handle->id = id;
+}
+
+void *SoftwareTimer::getID(void)
+{
+	return _handle->id;
+}
+
+bool SoftwareTimer::start(void)
+{
+	_handle->active = true;
+	_handle->dueUs = simNowUs + (uint64_t)_handle->periodMs * 1000;
+	return true;
+}
+
+bool SoftwareTimer::stop(void)
+{
+	_handle->active = false;
+	return true;
+}
+
+bool SoftwareTimer::reset(void)
+{
+	return start();
+}
+
+bool SoftwareTimer::setPeriod(uint32_t ms)
+{
+	_handle->periodMs = ms;
+	return start();
+}
+
+// I2C bus
+struct SimI2cSlot
+{
+	NativeSimI2cDevice *device;
+	uint8_t reg;
+};
+static SimI2cSlot simI2c[128];
+
+void nativeSimI2cAttach(uint8_t address, NativeSimI2cDevice *device)
+{
+	simI2c[address & 0x7F] = {device, 0};
+}
+
+void TwoWire::chargeBus(size_t bytes)
+{
+	// start + address + data, 9 clocks per byte
+	nativeSimStats.i2cTransactions++;
+	nativeSimStats.i2cBytes += bytes + 1;
+	nativeSimAdvanceUs((uint32_t)(((bytes + 1) * 9 + 2) * 1000000ULL / _clock));
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	_txAddr = address;
+	_txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (_txLen >= sizeof(_txBuf))
+	{
+		return 0;
+	}
+	_txBuf[_txLen++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+	size_t n = 0;
+	while (n < quantity && write(data[n]))
+	{
+		n++;
+	}
+	return n;
+}
+
+uint8_t TwoWire::endTransmission(bool stopBit)
+{
+	(void)stopBit;
+	chargeBus(_txLen);
+	SimI2cSlot &slot = simI2c[_txAddr & 0x7F];
+	if (slot.device == NULL)
+	{
+		return 2; // address NACK
+	}
+	if (_txLen > 0)
+	{
+		slot.reg = slot.device->decodeAddr(_txBuf[0]);
+		for (size_t i = 1; i < _txLen; i++)
+		{
+			slot.device->writeReg(slot.reg, _txBuf[i]);
+			slot.reg = slot.device->nextReg(slot.reg);
+		}
+	}
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
+{
+	(void)stopBit;
+	_rxPos = 0;
+	_rxLen = 0;
+	SimI2cSlot &slot = simI2c[address & 0x7F];
+	if (slot.device == NULL)
+	{
+		chargeBus(0);
+		return 0;
+	}
+	quantity = std::min(quantity, sizeof(_rxBuf));
+	chargeBus(quantity);
+	for (size_t i = 0; i < quantity; i++)
+	{
+		_rxBuf[_rxLen++] = slot.device->readReg(slot.reg);
+		slot.reg = slot.device->nextReg(slot.reg);
+	}
+	return (uint8_t)_rxLen;
+}
+
+// Harness
+/** Spacing of benchmark calls, the BSEC LP sample period */
+#define NATIVE_SIM_BENCH_PERIOD_MS 3000
+/** Shock applied by --motion, a knock on the enclosure */
+#define SIM_SHOCK_PEAK_G 1.5f
+#define SIM_SHOCK_MS 400
+
+/**
+ * @brief Whatever has to survive a simulated NVIC_SystemReset(), the resume
+ * file carries the flash image right after it
+ */
+struct SimResume
+{
+	uint32_t magic;
+	uint64_t nowUs;
+	uint32_t lastMotionS;
+	uint64_t loops;
+	double loopSumUs;
+	double loopWorstUs;
+	NativeSimStats stats;
+};
+#define SIM_RESUME_MAGIC 0x4E53494DUL
+
+static SimResume simResume;
+static char **simArgv;
+static int simArgc;
+
+/**
+ * @brief Reboot by re-executing the harness, which gives the firmware fresh
+ * zero/initialised globals exactly like the nRF52 after a reset
+ */
+[[noreturn]] static void simReboot(void)
+{
+	char path[] = "/tmp/nativesim-XXXXXX";
+	int fd = mkstemp(path);
+	simResume.magic = SIM_RESUME_MAGIC;
+	simResume.nowUs = simNowUs;
+	simResume.stats = nativeSimStats;
+	size_t flashSize;
+	uint8_t *flash = nativeSimFlashImage(&flashSize);
+	if (fd < 0 || write(fd, &simResume, sizeof(simResume)) != (ssize_t)sizeof(simResume) ||
+		write(fd, flash, flashSize) != (ssize_t)flashSize)
+	{
+		perror("native: cannot save state for reboot");
+		exit(1);
+	}
+	close(fd);
+	std::vector<char *> args(simArgv, simArgv + simArgc);
+	char flag[] = "--resume";
+	args.push_back(flag);
+	args.push_back(path);
+	args.push_back(NULL);
+	Serial.flush();
+	fflush(stdout);
+	execv("/proc/self/exe", args.data());
+	perror("native: reboot failed");
+	exit(1);
+}
+
+static void simLoadResume(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	size_t flashSize;
+	uint8_t *flash = nativeSimFlashImage(&flashSize);
+	if (f == NULL || fread(&simResume, sizeof(simResume), 1, f) != 1 || simResume.magic != SIM_RESUME_MAGIC ||
+		fread(flash, flashSize, 1, f) != 1)
+	{
+		fprintf(stderr, "native: bad resume file %s\n", path);
+		exit(1);
+	}
+	fclose(f);
+	unlink(path);
+	simNowUs = simResume.nowUs;
+	nativeSimStats = simResume.stats;
+}
+
+/**
+ * @brief Load the flash image and erase counters of an earlier run, a missing
+ * file leaves the flash blank
+ */
+static void simLoadFlash(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+	{
+		return;
+	}
+	size_t flashSize;
+	uint8_t *flash = nativeSimFlashImage(&flashSize);
+	if (fread(flash, flashSize, 1, f) != 1)
+	{
+		fprintf(stderr, "native: bad flash file %s\n", path);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static void simSaveFlash(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	size_t flashSize;
+	uint8_t *flash = nativeSimFlashImage(&flashSize);
+	if (f == NULL || fwrite(flash, flashSize, 1, f) != 1)
+	{
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static void simTraceLine(const char *line)
+{
+	printf("%s\n", line);
+}
+
+/**
+ * @brief Boot the firmware and run loop() until the simulated time is over
+ */
+static void simRun(uint64_t endMs, uint32_t motionEveryS)
+{
+	simEndUs = endMs * 1000;
+	try
+	{
+		nativeSimStats.boots++;
+		simBootUs = simNowUs;
+		nativeSimRadioReset();
+		setup();
+		for (;;)
+		{
+			if (motionEveryS && nativeSimNow() / 1000 >= simResume.lastMotionS + motionEveryS)
+			{
+				simResume.lastMotionS = nativeSimNow() / 1000;
+				nativeSimShock(SIM_SHOCK_PEAK_G, SIM_SHOCK_MS);
+				nativeSimTriggerPin(WB_IO5);
+			}
+			struct timespec a, b;
+			clock_gettime(CLOCK_MONOTONIC, &a);
+			loop();
+			clock_gettime(CLOCK_MONOTONIC, &b);
+			double us = (b.tv_sec - a.tv_sec) * 1e6 + (b.tv_nsec - a.tv_nsec) / 1e3;
+			simResume.loops++;
+			simResume.loopSumUs += us;
+			simResume.loopWorstUs = std::max(simResume.loopWorstUs, us);
+		}
+	}
+	catch (const NativeSimReset &)
+	{
+		simReboot();
+	}
+	catch (const NativeSimStop &)
+	{
+	}
+	if (simIdleHook)
+	{
+		simIdleHook();
+	}
+
+	const NativeSimStats &s = nativeSimStats;
+	uint64_t wakes = s.wakeups ? s.wakeups : 1;
+	printf("---- native run: %.1f h simulated ----\n", nativeSimNow() / 3600000.0);
+	printf("boots                 %llu\n", (unsigned long long)s.boots);
+	printf("wakeups               %llu\n", (unsigned long long)s.wakeups);
+	printf("awake ms / wake       %.2f\n", (double)s.awakeMs / wakes);
+	printf("awake duty            %.3f %%\n", 100.0 * s.awakeMs / (s.awakeMs + s.sleepMs + 1));
+	printf("host us / loop()      %.2f mean, %.2f max\n",
+		   simResume.loops ? simResume.loopSumUs / simResume.loops : 0.0, simResume.loopWorstUs);
+	printf("i2c transactions/wake %.2f (%.1f bytes)\n", (double)s.i2cTransactions / wakes,
+		   (double)s.i2cBytes / wakes);
+	printf("bme68x measurements   %llu\n", (unsigned long long)s.bmeMeasurements);
+	printf("iaq accuracy < 3      %.1f min\n", s.bsecUncalibratedMs / 60000.0);
+	printf("flash                 %llu words programmed in %llu write enables, %llu page erases\n",
+		   (unsigned long long)s.flashWords, (unsigned long long)s.flashEnables, (unsigned long long)s.flashErases);
+	printf("flash busy            %.1f ms, most erased page %u cycles\n", s.flashBusyUs / 1000.0,
+		   nativeSimFlashMaxPageErases());
+	printf("radio frames          %llu (%llu bytes, %llu ms on air, %.1f mJ)\n",
+		   (unsigned long long)s.radioTxFrames, (unsigned long long)s.radioTxBytes,
+		   (unsigned long long)s.radioAirtimeMs, s.radioTxEnergyUj / 1000.0);
+	printf("radio cad             %llu (%llu busy)\n", (unsigned long long)s.radioCad,
+		   (unsigned long long)s.radioCadBusy);
+	printf("radio rx frames       %llu (%llu cut off)\n", (unsigned long long)s.radioRxFrames,
+		   (unsigned long long)s.radioRxLost);
+	printf("radio configs         %llu\n", (unsigned long long)s.radioConfigs);
+	printf("gateway rx frames     %llu\n", (unsigned long long)s.gatewayRxFrames);
+	if (s.gatewayUplinks)
+	{
+		printf("gateway uplinks       %llu sent, %.1f %% received, %llu of those resent, %llu gap reports, %llu commands\n",
+			   (unsigned long long)s.gatewayUplinks, 100.0 * s.gatewayReceived / s.gatewayUplinks,
+			   (unsigned long long)s.gatewayRecovered, (unsigned long long)s.gatewayGapReports,
+			   (unsigned long long)s.gatewayCommands);
+		printf("gateway decoded       %llu uplinks, %.1f %% of sent, %llu deltas\n", (unsigned long long)s.gatewayDecoded,
+			   100.0 * s.gatewayDecoded / s.gatewayUplinks, (unsigned long long)s.gatewayDeltas);
+	}
+	if (s.chainFramesIn)
+	{
+		printf("chain frames in       %llu (%llu while not listening)\n", (unsigned long long)s.chainFramesIn,
+			   (unsigned long long)s.chainFramesMissed);
+		printf("chain forwards        %llu (%.2f records each, turnaround %.1f ms mean, %llu ms max)\n",
+			   (unsigned long long)s.chainForwards, (double)s.chainRecordsOut / (s.chainForwards ? s.chainForwards : 1),
+			   (double)s.chainTurnaroundMs / (s.chainForwards ? s.chainForwards : 1),
+			   (unsigned long long)s.chainTurnaroundMaxMs);
+	}
+	printf("---- scheduler since last boot ----\n");
+	schedReport(simTraceLine);
+	rateReport(simTraceLine);
+	printf("---- radio since last boot ----\n");
+	lbtReport(simTraceLine);
+	linkReport(simTraceLine);
+	commandReport(simTraceLine);
+#ifdef IS_CHAIN_ELEMENT
+	chainReport(simTraceLine);
+#endif
+	printf("---- phase trace since last boot ----\n");
+	traceReport(simTraceLine);
+}
+
+/**
+ * @brief Check that the gateway's answers made it back: link feedback
+ * arrived, at least minDeltas uplinks decoded as deltas and, with lossy,
+ * resends filled gaps
+ * @return false with the failed check on stderr
+ */
+static bool simCheck(uint32_t minDeltas, bool lossy)
+{
+	const NativeSimStats &s = nativeSimStats;
+	bool ok = true;
+	if (s.radioRxFrames == 0)
+	{
+		fprintf(stderr, "check: no downlink received\n");
+		ok = false;
+	}
+	if (s.gatewayDeltas < minDeltas)
+	{
+		fprintf(stderr, "check: %llu deltas decoded, %u expected\n", (unsigned long long)s.gatewayDeltas, minDeltas);
+		ok = false;
+	}
+	if (lossy && s.gatewayRecovered == 0)
+	{
+		fprintf(stderr, "check: no uplink recovered through a resend\n");
+		ok = false;
+	}
+	return ok;
+}
+
+/**
+ * @brief Time a BSEC sample and the battery and tilt read in isolation, the
+ * sensor part of the node's wakes
+ */
+static void simBench(uint32_t iterations)
+{
+	simEndUs = UINT64_MAX;
+	nativeSimStats.boots++;
+	simBootUs = simNowUs;
+	nativeSimRadioReset();
+	setup();
+	NativeSimStats before = nativeSimStats;
+	uint64_t t0 = nativeSimNow();
+	struct timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		handleBsecSample();
+		handleLoopActions();
+		nativeSimAdvance(NATIVE_SIM_BENCH_PERIOD_MS);
+		handleBsecReady();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	double hostUs = (b.tv_sec - a.tv_sec) * 1e6 + (b.tv_nsec - a.tv_nsec) / 1e3;
+	double n = iterations ? iterations : 1;
+	printf("---- handleBsecSample() + handleLoopActions() + handleBsecReady() x %u ----\n", iterations);
+	printf("host us / call        %.3f\n", hostUs / n);
+	printf("virtual ms / call     %.2f\n", (nativeSimNow() - t0) / n - NATIVE_SIM_BENCH_PERIOD_MS);
+	printf("i2c transactions/call %.2f\n", (nativeSimStats.i2cTransactions - before.i2cTransactions) / n);
+	printf("bme68x measurements   %llu\n", (unsigned long long)(nativeSimStats.bmeMeasurements - before.bmeMeasurements));
+}
+
+extern Bsec iaqSensor;
+
+/** The 13 outputs the firmware subscribed before bsecSubscribe() */
+static bsec_virtual_sensor_t simBsecAllOutputs[] = {
+	BSEC_OUTPUT_IAQ,
+	BSEC_OUTPUT_STATIC_IAQ,
+	BSEC_OUTPUT_CO2_EQUIVALENT,
+	BSEC_OUTPUT_BREATH_VOC_EQUIVALENT,
+	BSEC_OUTPUT_RAW_TEMPERATURE,
+	BSEC_OUTPUT_RAW_PRESSURE,
+	BSEC_OUTPUT_RAW_HUMIDITY,
+	BSEC_OUTPUT_RAW_GAS,
+	BSEC_OUTPUT_STABILIZATION_STATUS,
+	BSEC_OUTPUT_RUN_IN_STATUS,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY,
+	BSEC_OUTPUT_GAS_PERCENTAGE,
+};
+
+/**
+ * @brief Time iaqSensor.run() with all outputs subscribed and with the ones
+ * the payload carries (bsecSubscribe()). The measurement itself is the same
+ * for both, the difference is the assumed do_steps cost per output of
+ * SimBsec.cpp, which this only plays back
+ */
+static void simBenchBsec(uint32_t iterations)
+{
+	simEndUs = UINT64_MAX;
+	nativeSimStats.boots++;
+	simBootUs = simNowUs;
+	nativeSimRadioReset();
+	setup();
+	double runUs[2] = {0, 0};
+	uint8_t outputs[2];
+	uint32_t runs[2] = {0, 0};
+	for (uint8_t set = 0; set < 2; set++)
+	{
+		if (set == 0)
+		{
+			outputs[set] = sizeof(simBsecAllOutputs) / sizeof(simBsecAllOutputs[0]);
+			iaqSensor.updateSubscription(simBsecAllOutputs, outputs[set], BSEC_SAMPLE_RATE_LP);
+		}
+		else
+		{
+			// A subscription only changes the outputs it names, drop all first
+			iaqSensor.updateSubscription(simBsecAllOutputs, outputs[0], BSEC_SAMPLE_RATE_DISABLED);
+			outputs[set] = bsecSubscribe();
+		}
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			nativeSimAdvance(NATIVE_SIM_BENCH_PERIOD_MS);
+			uint64_t t0 = simNowUs;
+			if (iaqSensor.run())
+			{
+				runUs[set] += simNowUs - t0;
+				runs[set]++;
+			}
+		}
+	}
+	printf("---- iaqSensor.run() x %u ----\n", iterations);
+	for (uint8_t set = 0; set < 2; set++)
+	{
+		printf("%s %2u outputs    %.1f virtual us / run (%u runs)\n", set == 0 ? "all    " : "payload", outputs[set],
+			   runs[set] ? runUs[set] / runs[set] : 0.0, runs[set]);
+	}
+	if (runs[0] && runs[1])
+	{
+		printf("saved                 %.1f virtual us / run, assumed cost per output, not measured\n",
+			   runUs[0] / runs[0] - runUs[1] / runs[1]);
+	}
+}
+
+static void simUsage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [--hours H] [--bench N] [--bench-bsec N] [--motion S] [--busy P] [--vbat MV] [--seed N] [--serial FILE]\n"
+			"       [--flash FILE] [--pathloss DB] [--loss P] [--command T=V,...;...]\n"
+			"       [--upstream S] [--check N]\n"
+			"  --hours H   simulated run time (default 1)\n"
+			"  --bench N   time N sampling cycles instead of a run\n"
+			"  --bench-bsec N  time N iaqSensor.run() calls with all and with the payload's BSEC outputs\n"
+			"  --motion S  shake the LIS3DH and raise its interrupt every S seconds\n"
+			"  --busy P    probability that CAD reports a busy channel\n"
+			"  --vbat MV   battery voltage in mV\n"
+			"  --seed N    random seed\n"
+			"  --serial F  write Serial output to F (deferred myLog records are binary)\n"
+			"  --flash F   start from the flash image in F if it exists, save it there at the end\n"
+			"  --pathloss DB  gateway at DB path loss answers uplinks with link feedback\n"
+			"  --loss P       probability that the gateway misses a frame, with --pathloss\n"
+			"  --command T=V,...  gateway answers the first uplink with these command settings, with --pathloss,\n"
+			"                 commands after ';' answer the following uplinks\n"
+			"  --upstream S   previous node of a chain element sends a chain frame every S seconds\n"
+			"  --check N      exit with 1 unless a downlink arrived, N uplinks decoded as deltas and,\n"
+			"                 with --loss, a resend filled a gap\n",
+			name);
+}
+
+int main(int argc, char **argv)
+{
+	double hours = 1.0;
+	long bench = -1;
+	long benchBsec = -1;
+	uint32_t motion = 0;
+	const char *serialPath = NULL;
+	const char *flashPath = NULL;
+	bool resumed = false;
+	long check = -1;
+	bool lossy = false;
+	simArgv = argv;
+	simArgc = argc;
+	srand(1);
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		if (val == NULL)
+		{
+			simUsage(argv[0]);
+			return 1;
+		}
+		if (!strcmp(arg, "--hours"))
+			hours = atof(val);
+		else if (!strcmp(arg, "--bench"))
+			bench = atol(val);
+		else if (!strcmp(arg, "--bench-bsec"))
+			benchBsec = atol(val);
+		else if (!strcmp(arg, "--motion"))
+			motion = atol(val);
+		else if (!strcmp(arg, "--busy"))
+			nativeSimSetChannelBusy(atof(val));
+		else if (!strcmp(arg, "--vbat"))
+			nativeSimSetBatteryMv(atof(val));
+		else if (!strcmp(arg, "--seed"))
+			srand(atol(val));
+		else if (!strcmp(arg, "--serial"))
+			serialPath = val;
+		else if (!strcmp(arg, "--flash"))
+			flashPath = val;
+		else if (!strcmp(arg, "--pathloss"))
+			nativeSimSetPathLoss(atof(val));
+		else if (!strcmp(arg, "--loss"))
+		{
+			nativeSimSetUplinkLoss(atof(val));
+			lossy = atof(val) > 0;
+		}
+		else if (!strcmp(arg, "--command"))
+		{
+			if (!nativeSimSetCommand(val))
+			{
+				simUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--upstream"))
+			nativeSimSetUpstream(atol(val));
+		else if (!strcmp(arg, "--check"))
+			check = atol(val);
+		else if (!strcmp(arg, "--resume"))
+		{
+			simArgc = i;
+			simLoadResume(val);
+			resumed = true;
+		}
+		else
+		{
+			simUsage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	if (flashPath && !resumed)
+	{
+		// After a reboot the flash comes from the resume file
+		simLoadFlash(flashPath);
+	}
+	if (serialPath)
+	{
+		// Appending after a reboot keeps the capture of the whole run in one file
+		Serial.file = fopen(serialPath, resumed ? "ab" : "wb");
+		if (Serial.file == NULL)
+		{
+			perror(serialPath);
+			return 1;
+		}
+	}
+
+	nativeSimSensorsAttach();
+	if (bench >= 0)
+	{
+		simBench((uint32_t)bench);
+	}
+	else if (benchBsec >= 0)
+	{
+		simBenchBsec((uint32_t)benchBsec);
+	}
+	else
+	{
+		simRun((uint64_t)(hours * 3600000.0), motion);
+	}
+	if (flashPath)
+	{
+		simSaveFlash(flashPath);
+	}
+	if (check >= 0 && !simCheck((uint32_t)check, lossy))
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file NativeSim.h
+ * @brief Control and statistics interface of the simulated hardware layer
+ *
+ * Everything the harness and the per-phase benchmarks need to drive the
+ * firmware on a Linux host: virtual clock, event injection and the counters
+ * that answer wake duration, bytes on air and I2C transactions per cycle.
+ */
+#ifndef NATIVE_SIM_H
+#define NATIVE_SIM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Counters collected while the firmware runs on the host
+ */
+struct NativeSimStats
+{
+	uint64_t boots;				 // setup() runs, 1 + number of NVIC_SystemReset()
+	uint64_t wakeups;			 // loop task wakeups from a blocking semaphore take
+	uint64_t awakeMs;			 // virtual time spent outside blocking semaphore takes
+	uint64_t sleepMs;			 // virtual time spent blocked on a semaphore
+	uint64_t i2cTransactions;	 // endTransmission() + requestFrom() calls
+	uint64_t i2cBytes;			 // bytes moved on the bus, address bytes included
+	uint64_t radioTxFrames;		 // Radio.Send() calls
+	uint64_t radioTxBytes;		 // payload bytes handed to Radio.Send()
+	uint64_t radioAirtimeMs;	 // time on air of all sent frames
+	uint64_t radioTxEnergyUj;	 // PA energy of all sent frames at the configured power
+	uint64_t radioCad;			 // Radio.StartCad() calls
+	uint64_t radioCadBusy;		 // CAD results reporting a busy channel
+	uint64_t radioRxFrames;		 // RxDone callbacks delivered
+	uint64_t radioRxLost;		 // frames lost while they came in: window closed before the header, CAD or TX
+	uint64_t radioConfigs;		 // SetTxConfig()/SetRxConfig() calls
+	uint64_t gatewayRxFrames;	 // uplinks the simulated gateway demodulated
+	uint64_t gatewayUplinks;	 // new uplinks sent while a gateway is simulated, resends not counted
+	uint64_t gatewayReceived;	 // of those the gateway got, first or resent copy
+	uint64_t gatewayRecovered;	 // of those through a resend
+	uint64_t gatewayDecoded;	 // of those the gateway could decode, deltas need their reference
+	uint64_t gatewayDeltas;		 // of those decoded ones sent as deltas
+	uint64_t gatewayGapReports;	 // answers that were gap reports
+	uint64_t gatewayCommands;	 // answers that were command downlinks
+	uint64_t chainFramesIn;		 // chain frames the simulated previous node sent
+	uint64_t chainFramesMissed;	 // of those sent while the radio was not listening
+	uint64_t chainForwards;		 // of those the firmware sent on
+	uint64_t chainRecordsOut;	 // records in the forwarded frames
+	uint64_t chainTurnaroundMs;	 // sum of RxDone to Radio.Send() of the forwards
+	uint64_t chainTurnaroundMaxMs;
+	uint64_t bmeMeasurements;	 // forced mode BME68x conversions
+	uint64_t bsecUncalibratedMs; // sample time BSEC reported IAQ accuracy below 3
+	uint64_t flashErases;		 // flash pages erased
+	uint64_t flashWords;		 // flash words programmed
+	uint64_t flashEnables;		 // NVMC write enable/disable cycles
+	uint64_t flashBusyUs;		 // NVMC program and erase time charged to the clock
+};
+
+extern NativeSimStats nativeSimStats;
+
+/** Virtual milliseconds since the simulation started, unaffected by resets */
+uint64_t nativeSimNow(void);
+/** Advance the virtual clock by ms, firing due timers and radio events */
+void nativeSimAdvance(uint32_t ms);
+/** Charge us of CPU/bus busy time to the virtual clock */
+void nativeSimAdvanceUs(uint32_t us);
+/** Schedule fn to run once the virtual clock reaches nativeSimNow() + ms */
+void nativeSimSchedule(uint32_t ms, void (*fn)(void *), void *arg);
+/** Fire the interrupt attached to pin as if the line toggled */
+void nativeSimTriggerPin(uint32_t pin);
+/** Battery voltage returned through analogRead(PIN_VBAT) */
+void nativeSimSetBatteryMv(float mv);
+/** Daily mean temperature (degC), humidity (%RH) and pressure (Pa) at the BME68x */
+void nativeSimSetClimate(float tempC, float humPct, float pressPa);
+/** Acceleration seen by the simulated LIS3DH, in g */
+void nativeSimSetAccel(float x, float y, float z);
+/** Decaying oscillation of peakG on the LIS3DH x axis for ms from now */
+void nativeSimShock(float peakG, uint32_t ms);
+/** Probability (0..1) that a CAD reports the channel busy */
+void nativeSimSetChannelBusy(float probability);
+/** Path loss node to gateway in dB, 0 leaves the gateway out and the node without link feedback */
+void nativeSimSetPathLoss(float db);
+/** Probability (0..1) that the gateway misses a frame it could demodulate */
+void nativeSimSetUplinkLoss(float probability);
+/** Command downlinks of "TAG=VALUE,...;..." the gateway answers the next uplinks with, one each, false if malformed */
+bool nativeSimSetCommand(const char *settings);
+/** Previous node of a chain element sends a chain frame every seconds, 0 leaves it out */
+void nativeSimSetUpstream(uint32_t seconds);
+/** Start a frame at the radio, true if the radio is listening. RxDone fires after its time on air */
+bool nativeSimInjectRx(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr);
+/** Time on air of a size byte frame at the radio's configuration */
+uint32_t nativeSimRxAirtimeMs(uint16_t size);
+/** Copy of the last frame handed to Radio.Send() */
+uint16_t nativeSimLastTx(uint8_t *buffer, uint16_t maxSize);
+/** Run fn whenever the loop task blocks, where low priority tasks get the CPU on target */
+void nativeSimSetIdleHook(void (*fn)(void));
+
+/* Firmware entry points the benchmark drives, implemented in src/main.cpp */
+void handleBsecSample(void);
+void handleLoopActions(void);
+void handleBsecReady(void);
+/* Payload's BSEC subscription, implemented in src/bsec_bme.cpp */
+uint8_t bsecSubscribe(void);
+/* Wakes and coalesced jobs of the loop task, implemented in src/main.cpp */
+void schedReport(void (*out)(const char *line));
+/* BSEC sample rate transitions, implemented in src/main.cpp */
+void rateReport(void (*out)(const char *line));
+/* Phase timing of the firmware, implemented in src/trace.cpp */
+void traceReport(void (*out)(const char *line));
+/* CAD retry counters of the firmware, implemented in src/lora.cpp */
+void lbtReport(void (*out)(const char *line));
+/* Link adaptation state of the firmware, implemented in src/lora.cpp */
+void linkReport(void (*out)(const char *line));
+/* Relay counters of a chain element, implemented in src/lora.cpp */
+void chainReport(void (*out)(const char *line));
+/* Command downlink counters of the firmware, implemented in src/command.cpp */
+void commandReport(void (*out)(const char *line));
+
+/* Hooks the harness uses to install the simulated devices */
+void nativeSimRadioReset(void);
+/** The radio finished sending frame at power dBm and spreading factor sf */
+void nativeSimGatewayUplink(const uint8_t *frame, uint16_t size, int8_t power, uint8_t sf);
+/** The radio starts to send frame */
+void nativeSimChainSend(const uint8_t *frame, uint16_t size);
+void nativeSimSensorsAttach(void);
+/** RAM image of the simulated flash with its erase counters, carried across NVIC_SystemReset() */
+uint8_t *nativeSimFlashImage(size_t *size);
+/** Erase cycles of flash page page (0 = address 0) */
+uint32_t nativeSimFlashPageErases(size_t page);
+/** Erase cycles of the most erased flash page */
+uint32_t nativeSimFlashMaxPageErases(void);
+
+#endif
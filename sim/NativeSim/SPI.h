@@ -0,0 +1,36 @@
+/**
+ * @file SPI.h
+ * @brief Host stand-in for the SPI driver, nothing on the node uses SPI in
+ * [env:native] but the LIS3DH driver references it
+ */
+#ifndef NATIVE_SIM_SPI_H
+#define NATIVE_SIM_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_CLOCK_DIV4 0x04
+
+class SPIClass
+{
+public:
+	void begin(void) {}
+	void end(void) {}
+	void setBitOrder(uint8_t order) { (void)order; }
+	void setDataMode(uint8_t mode) { (void)mode; }
+	void setClockDivider(uint8_t div) { (void)div; }
+	uint8_t transfer(uint8_t data)
+	{
+		(void)data;
+		return 0xFF;
+	}
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * @file SX126x-RAK4630.h
+ * @brief Host stand-in for the SX126x-Arduino radio driver used by [env:native]
+ *
+ * The simulated radio keeps the modem configuration handed to SetTxConfig,
+ * computes time-on-air with the Semtech formula and delivers TxDone, CadDone
+ * and RxDone callbacks on the virtual clock, the same way the radio IRQ task
+ * does on the RAK4631.
+ */
+#ifndef NATIVE_SIM_SX126X_RAK4630_H
+#define NATIVE_SIM_SX126X_RAK4630_H
+
+#include <Arduino.h>
+
+typedef enum
+{
+	MODEM_FSK = 0,
+	MODEM_LORA,
+} RadioModems_t;
+
+typedef enum
+{
+	RF_IDLE = 0,
+	RF_RX_RUNNING,
+	RF_TX_RUNNING,
+	RF_CAD,
+} RadioState_t;
+
+typedef enum
+{
+	LORA_CAD_01_SYMBOL = 0x00,
+	LORA_CAD_02_SYMBOL = 0x01,
+	LORA_CAD_04_SYMBOL = 0x02,
+	LORA_CAD_08_SYMBOL = 0x03,
+	LORA_CAD_16_SYMBOL = 0x04,
+} RadioLoRaCadSymbols_t;
+
+typedef enum
+{
+	LORA_CAD_ONLY = 0x00,
+	LORA_CAD_RX = 0x01,
+	LORA_CAD_LBT = 0x10,
+} RadioCadExitModes_t;
+
+typedef struct
+{
+	void (*TxDone)(void);
+	void (*TxTimeout)(void);
+	void (*RxDone)(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+	void (*RxTimeout)(void);
+	void (*RxError)(void);
+	void (*PreAmpDetect)(void);
+	void (*FhssChangeChannel)(uint8_t currentChannel);
+	void (*CadDone)(bool channelActivityDetected);
+} RadioEvents_t;
+
+struct Radio_s
+{
+	void (*Init)(RadioEvents_t *events);
+	RadioState_t (*GetStatus)(void);
+	void (*SetModem)(RadioModems_t modem);
+	void (*SetChannel)(uint32_t freq);
+	uint32_t (*Random)(void);
+	void (*SetRxConfig)(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+						uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen,
+						uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted,
+						bool rxContinuous);
+	void (*SetTxConfig)(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate,
+						uint8_t coderate, uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn,
+						uint8_t hopPeriod, bool iqInverted, uint32_t timeout);
+	uint32_t (*TimeOnAir)(RadioModems_t modem, uint8_t pktLen);
+	void (*Send)(uint8_t *buffer, uint8_t size);
+	void (*Sleep)(void);
+	void (*Standby)(void);
+	void (*Rx)(uint32_t timeout);
+	void (*StartCad)(void);
+	void (*SetCadParams)(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode,
+						 uint32_t cadTimeout);
+	int16_t (*Rssi)(RadioModems_t modem);
+	void (*SetRxDutyCycle)(uint32_t rxTime, uint32_t sleepTime);
+	void (*IrqProcess)(void);
+};
+
+extern const struct Radio_s Radio;
+
+uint32_t lora_rak4630_init(void);
+
+#endif
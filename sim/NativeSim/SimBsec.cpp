@@ -0,0 +1,562 @@
+/**
+ * @file SimBsec.cpp
+ * @brief Simulated BSEC core and Arduino wrapper
+ *
+ * The outputs are a plausible function of the inputs, not the Bosch
+ * algorithm. What is modelled faithfully is the call protocol, the sample
+ * rates, the state blob size and the calibration ramp of iaqAccuracy, plus a
+ * per-output CPU cost charged to the virtual clock.
+ */
+#include "NativeSim.h"
+#include <bsec.h>
+#include <algorithm>
+
+/** Magic at the head of the simulated state blob */
+#define SIM_BSEC_STATE_MAGIC 0x53494D42UL
+/** Time in seconds after which iaqAccuracy reaches 1, 2 and 3 */
+#define SIM_BSEC_ACCURACY1_S (5 * 60)
+#define SIM_BSEC_ACCURACY2_S (2 * 3600)
+#define SIM_BSEC_ACCURACY3_S (12 * 3600)
+/** Assumed Cortex-M4F cost of one do_steps call, a guess and not measured
+ * on the node: a base plus a share per output */
+#define SIM_BSEC_STEP_BASE_US 1800
+#define SIM_BSEC_STEP_OUTPUT_US 350
+
+static uint32_t simSubscribed = 0; // bit per bsec_virtual_sensor_t
+static int64_t simIntervalNs = 0;
+static int64_t simNextCallNs = 0;
+static float simSampleRate = BSEC_SAMPLE_RATE_DISABLED;
+static uint32_t simCalibratedS = 0;
+static uint32_t simSamples = 0;
+static float simGasBaseline = 0.0f;
+
+static bool simUsesGas(uint32_t mask)
+{
+	const uint32_t gasOutputs = (1UL << BSEC_OUTPUT_IAQ) | (1UL << BSEC_OUTPUT_STATIC_IAQ) |
+								(1UL << BSEC_OUTPUT_CO2_EQUIVALENT) | (1UL << BSEC_OUTPUT_BREATH_VOC_EQUIVALENT) |
+								(1UL << BSEC_OUTPUT_RAW_GAS) | (1UL << BSEC_OUTPUT_STABILIZATION_STATUS) |
+								(1UL << BSEC_OUTPUT_RUN_IN_STATUS) | (1UL << BSEC_OUTPUT_GAS_PERCENTAGE);
+	return (mask & gasOutputs) != 0;
+}
+
+static uint8_t simAccuracy(void)
+{
+	if (simCalibratedS >= SIM_BSEC_ACCURACY3_S)
+		return 3;
+	if (simCalibratedS >= SIM_BSEC_ACCURACY2_S)
+		return 2;
+	if (simCalibratedS >= SIM_BSEC_ACCURACY1_S)
+		return 1;
+	return 0;
+}
+
+bsec_library_return_t bsec_init(void)
+{
+	simSubscribed = 0;
+	simIntervalNs = 0;
+	simNextCallNs = 0;
+	simSampleRate = BSEC_SAMPLE_RATE_DISABLED;
+	simCalibratedS = 0;
+	simSamples = 0;
+	simGasBaseline = 0.0f;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_version(bsec_version_t *bsec_version_p)
+{
+	*bsec_version_p = {1, 4, 9, 2};
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_update_subscription(const bsec_sensor_configuration_t *requested_virtual_sensors,
+											   uint8_t n_requested_virtual_sensors,
+											   bsec_sensor_configuration_t *required_sensor_settings,
+											   uint8_t *n_required_sensor_settings)
+{
+	float rate = BSEC_SAMPLE_RATE_DISABLED;
+	for (uint8_t i = 0; i < n_requested_virtual_sensors; i++)
+	{
+		const bsec_sensor_configuration_t &req = requested_virtual_sensors[i];
+		if (req.sample_rate == BSEC_SAMPLE_RATE_DISABLED)
+		{
+			simSubscribed &= ~(1UL << req.sensor_id);
+			continue;
+		}
+		if (req.sample_rate != BSEC_SAMPLE_RATE_LP && req.sample_rate != BSEC_SAMPLE_RATE_ULP &&
+			req.sample_rate != BSEC_SAMPLE_RATE_CONTINUOUS)
+		{
+			return BSEC_E_SU_SAMPLERATELIMITS;
+		}
+		if (rate != BSEC_SAMPLE_RATE_DISABLED && rate != req.sample_rate)
+		{
+			return BSEC_E_SU_WRONGDATARATE;
+		}
+		rate = req.sample_rate;
+		simSubscribed |= 1UL << req.sensor_id;
+	}
+	if (rate != BSEC_SAMPLE_RATE_DISABLED && rate != simSampleRate)
+	{
+		simSampleRate = rate;
+		simIntervalNs = (int64_t)llroundf(1.0f / rate) * 1000000000LL;
+		simNextCallNs = 0;
+	}
+	if (simSubscribed == 0)
+	{
+		simSampleRate = BSEC_SAMPLE_RATE_DISABLED;
+		simIntervalNs = 0;
+	}
+
+	static const uint8_t inputs[] = {BSEC_INPUT_PRESSURE, BSEC_INPUT_HUMIDITY, BSEC_INPUT_TEMPERATURE,
+									 BSEC_INPUT_GASRESISTOR, BSEC_INPUT_HEATSOURCE};
+	uint8_t n = 0;
+	for (uint8_t id : inputs)
+	{
+		if (n < *n_required_sensor_settings && simSubscribed != 0 &&
+			(id != BSEC_INPUT_GASRESISTOR || simUsesGas(simSubscribed)))
+		{
+			required_sensor_settings[n++] = {simSampleRate, id};
+		}
+	}
+	*n_required_sensor_settings = n;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control(int64_t time_stamp, bsec_bme_settings_t *sensor_settings)
+{
+	memset(sensor_settings, 0, sizeof(*sensor_settings));
+	if (simIntervalNs == 0)
+	{
+		sensor_settings->next_call = INT64_MAX;
+		return BSEC_OK;
+	}
+	if (time_stamp < simNextCallNs)
+	{
+		sensor_settings->next_call = simNextCallNs;
+		return BSEC_OK;
+	}
+	bsec_library_return_t rslt = BSEC_OK;
+	if (simNextCallNs != 0 && time_stamp > simNextCallNs + simIntervalNs / 2)
+	{
+		rslt = BSEC_W_SC_CALL_TIMING_VIOLATION;
+	}
+	simNextCallNs = (simNextCallNs == 0 || rslt != BSEC_OK) ? time_stamp + simIntervalNs
+															 : simNextCallNs + simIntervalNs;
+	sensor_settings->next_call = simNextCallNs;
+	sensor_settings->trigger_measurement = 1;
+	sensor_settings->temperature_oversampling = BME68X_OS_2X;
+	sensor_settings->pressure_oversampling = BME68X_OS_16X;
+	sensor_settings->humidity_oversampling = BME68X_OS_1X;
+	sensor_settings->process_data = BSEC_PROCESS_TEMPERATURE | BSEC_PROCESS_PRESSURE | BSEC_PROCESS_HUMIDITY;
+	if (simUsesGas(simSubscribed))
+	{
+		sensor_settings->run_gas = 1;
+		sensor_settings->heater_temperature = 320;
+		sensor_settings->heater_duration = 197;
+		sensor_settings->process_data |= BSEC_PROCESS_GAS;
+	}
+	return rslt;
+}
+
+bsec_library_return_t bsec_do_steps(const bsec_input_t *inputs, uint8_t n_inputs, bsec_output_t *outputs,
+									uint8_t *n_outputs)
+{
+	float t = 0, h = 0, p = 0, gas = 0, heat = 0;
+	int64_t ts = 0;
+	for (uint8_t i = 0; i < n_inputs; i++)
+	{
+		ts = inputs[i].time_stamp;
+		switch (inputs[i].sensor_id)
+		{
+		case BSEC_INPUT_TEMPERATURE:
+			t = inputs[i].signal;
+			break;
+		case BSEC_INPUT_HUMIDITY:
+			h = inputs[i].signal;
+			break;
+		case BSEC_INPUT_PRESSURE:
+			p = inputs[i].signal;
+			break;
+		case BSEC_INPUT_GASRESISTOR:
+			gas = inputs[i].signal;
+			break;
+		case BSEC_INPUT_HEATSOURCE:
+			heat = inputs[i].signal;
+			break;
+		default:
+			return BSEC_E_DOSTEPS_INVALIDINPUT;
+		}
+	}
+
+	simSamples++;
+	simCalibratedS += (uint32_t)(simIntervalNs / 1000000000LL);
+	if (gas > 0.0f)
+	{
+		simGasBaseline = simGasBaseline == 0.0f ? gas : 0.99f * simGasBaseline + 0.01f * gas;
+	}
+	float ratio = simGasBaseline > 0.0f ? gas / simGasBaseline : 1.0f;
+	float iaq = std::max(0.0f, std::min(500.0f, 50.0f + 250.0f * (1.0f - ratio)));
+	uint8_t acc = simAccuracy();
+	if (acc < 3)
+	{
+		nativeSimStats.bsecUncalibratedMs += (uint64_t)(simIntervalNs / 1000000LL);
+	}
+	float stab = simCalibratedS >= SIM_BSEC_ACCURACY1_S ? 1.0f : 0.0f;
+
+	uint8_t max = *n_outputs;
+	uint8_t n = 0;
+	auto put = [&](uint8_t id, float value, uint8_t accuracy)
+	{
+		if (n < max && (simSubscribed & (1UL << id)))
+		{
+			outputs[n++] = {ts, value, 1, id, accuracy};
+		}
+	};
+	put(BSEC_OUTPUT_IAQ, iaq, acc);
+	put(BSEC_OUTPUT_STATIC_IAQ, iaq, acc);
+	put(BSEC_OUTPUT_CO2_EQUIVALENT, 500.0f + 6.0f * iaq, acc);
+	put(BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, 0.5f + iaq / 100.0f, acc);
+	put(BSEC_OUTPUT_RAW_TEMPERATURE, t, 0);
+	put(BSEC_OUTPUT_RAW_PRESSURE, p, 0);
+	put(BSEC_OUTPUT_RAW_HUMIDITY, h, 0);
+	put(BSEC_OUTPUT_RAW_GAS, gas, 0);
+	put(BSEC_OUTPUT_STABILIZATION_STATUS, stab, 0);
+	put(BSEC_OUTPUT_RUN_IN_STATUS, stab, 0);
+	put(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, t - heat, 0);
+	put(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, std::min(100.0f, h * 1.05f), 0);
+	put(BSEC_OUTPUT_GAS_PERCENTAGE, std::min(100.0f, 100.0f * ratio / 2.0f), acc);
+	*n_outputs = n;
+
+	nativeSimAdvanceUs(SIM_BSEC_STEP_BASE_US + SIM_BSEC_STEP_OUTPUT_US * n);
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_configuration(const uint8_t *serialized_settings, uint32_t n_serialized_settings,
+											 uint8_t *work_buffer, uint32_t n_work_buffer_size)
+{
+	(void)serialized_settings;
+	(void)work_buffer;
+	if (n_serialized_settings > BSEC_MAX_PROPERTY_BLOB_SIZE || n_work_buffer_size < BSEC_MAX_WORKBUFFER_SIZE)
+	{
+		return BSEC_E_PARSE_SECTIONEXCEEDSWORKBUFFER;
+	}
+	return BSEC_OK;
+}
+
+/*
+ * State layout: magic, calibrated seconds, samples, gas baseline, then model
+ * bytes that only move with the baseline. Like the real blob most bytes are
+ * stable between saves.
+ */
+bsec_library_return_t bsec_get_state(uint8_t state_set_id, uint8_t *serialized_state,
+									 uint32_t n_serialized_state_max, uint8_t *work_buffer,
+									 uint32_t n_work_buffer, uint32_t *n_serialized_state)
+{
+	(void)state_set_id;
+	(void)work_buffer;
+	(void)n_work_buffer;
+	if (n_serialized_state_max < BSEC_MAX_STATE_BLOB_SIZE)
+	{
+		return BSEC_E_SET_INVALIDLENGTH;
+	}
+	uint32_t magic = SIM_BSEC_STATE_MAGIC;
+	memcpy(&serialized_state[0], &magic, 4);
+	memcpy(&serialized_state[4], &simCalibratedS, 4);
+	memcpy(&serialized_state[8], &simSamples, 4);
+	memcpy(&serialized_state[12], &simGasBaseline, 4);
+	uint8_t seed = (uint8_t)((uint32_t)simGasBaseline >> 12);
+	for (uint32_t i = 16; i < BSEC_MAX_STATE_BLOB_SIZE; i++)
+	{
+		serialized_state[i] = (uint8_t)(i * 37 + (i % 16 == 0 ? seed : 0));
+	}
+	*n_serialized_state = BSEC_MAX_STATE_BLOB_SIZE;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state(const uint8_t *serialized_state, uint32_t n_serialized_state,
+									 uint8_t *work_buffer, uint32_t n_work_buffer_size)
+{
+	(void)work_buffer;
+	(void)n_work_buffer_size;
+	uint32_t magic;
+	if (n_serialized_state < BSEC_MAX_STATE_BLOB_SIZE)
+	{
+		return BSEC_E_SET_INVALIDLENGTH;
+	}
+	memcpy(&magic, &serialized_state[0], 4);
+	if (magic != SIM_BSEC_STATE_MAGIC)
+	{
+		return BSEC_E_SET_INVALIDLENGTH;
+	}
+	memcpy(&simCalibratedS, &serialized_state[4], 4);
+	memcpy(&simSamples, &serialized_state[8], 4);
+	memcpy(&simGasBaseline, &serialized_state[12], 4);
+	return BSEC_OK;
+}
+
+// Arduino wrapper
+TwoWire *Bsec::wireObj = NULL;
+
+Bsec::Bsec(void)
+{
+	nextCall = 0;
+	bme68xStatus = BME68X_OK;
+	bsecStatus = BSEC_OK;
+	version = {0, 0, 0, 0};
+	_devAddr = 0;
+	_tempOffset = 0.0f;
+	_lastTime = 0;
+	memset(&_bme68x, 0, sizeof(_bme68x));
+	memset(&_conf, 0, sizeof(_conf));
+	memset(&_heatrConf, 0, sizeof(_heatrConf));
+	memset(&_bmeConf, 0, sizeof(_bmeConf));
+	zeroOutputs();
+}
+
+void Bsec::begin(uint8_t i2cAddr, TwoWire &i2c, bme68x_delay_us_fptr_t idleTask)
+{
+	_devAddr = i2cAddr;
+	wireObj = &i2c;
+	wireObj->begin();
+	_bme68x.intf = BME68X_I2C_INTF;
+	_bme68x.read = i2cRead;
+	_bme68x.write = i2cWrite;
+	_bme68x.delay_us = idleTask;
+	_bme68x.intf_ptr = &_devAddr;
+	_bme68x.amb_temp = 25;
+
+	bme68xStatus = bme68x_init(&_bme68x);
+	if (bme68xStatus != BME68X_OK)
+	{
+		return;
+	}
+	bsecStatus = bsec_init();
+	if (bsecStatus != BSEC_OK)
+	{
+		return;
+	}
+	bsecStatus = bsec_get_version(&version);
+	nextCall = 0;
+	zeroOutputs();
+}
+
+void Bsec::updateSubscription(bsec_virtual_sensor_t sensorList[], uint8_t nSensors, float sampleRate)
+{
+	bsec_sensor_configuration_t virtualSensors[BSEC_NUMBER_OUTPUTS], sensorSettings[BSEC_MAX_PHYSICAL_SENSOR];
+	uint8_t nSensorSettings = BSEC_MAX_PHYSICAL_SENSOR;
+	nSensors = std::min<uint8_t>(nSensors, BSEC_NUMBER_OUTPUTS);
+	for (uint8_t i = 0; i < nSensors; i++)
+	{
+		virtualSensors[i].sensor_id = sensorList[i];
+		virtualSensors[i].sample_rate = sampleRate;
+	}
+	bsecStatus = bsec_update_subscription(virtualSensors, nSensors, sensorSettings, &nSensorSettings);
+}
+
+bool Bsec::run(void)
+{
+	bool newData = false;
+	int64_t currTimeNs = getTimeMs() * INT64_C(1000000);
+	_lastTime = millis();
+	if (currTimeNs < nextCall * INT64_C(1000000))
+	{
+		return false;
+	}
+	bsecStatus = bsec_sensor_control(currTimeNs, &_bmeConf);
+	if (bsecStatus < BSEC_OK)
+	{
+		return false;
+	}
+	nextCall = _bmeConf.next_call / INT64_C(1000000);
+	if (_bmeConf.trigger_measurement)
+	{
+		_conf.os_hum = _bmeConf.humidity_oversampling;
+		_conf.os_temp = _bmeConf.temperature_oversampling;
+		_conf.os_pres = _bmeConf.pressure_oversampling;
+		_conf.filter = BME68X_FILTER_OFF;
+		_conf.odr = BME68X_ODR_NONE;
+		bme68xStatus = bme68x_set_conf(&_conf, &_bme68x);
+		_heatrConf.enable = _bmeConf.run_gas;
+		_heatrConf.heatr_temp = _bmeConf.heater_temperature;
+		_heatrConf.heatr_dur = _bmeConf.heater_duration;
+		bme68xStatus = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &_heatrConf, &_bme68x);
+		bme68xStatus = bme68x_set_op_mode(BME68X_FORCED_MODE, &_bme68x);
+		uint32_t measPeriod = bme68x_get_meas_dur(BME68X_FORCED_MODE, &_conf, &_bme68x);
+		measPeriod += _heatrConf.enable ? (uint32_t)_heatrConf.heatr_dur * 1000 : 0;
+		_bme68x.delay_us(measPeriod, _bme68x.intf_ptr);
+		readProcessData(currTimeNs + (int64_t)measPeriod * 1000);
+		newData = true;
+	}
+	return newData;
+}
+
+void Bsec::readProcessData(int64_t currTimeNs)
+{
+	struct bme68x_data data;
+	uint8_t nFields = 0;
+	bsec_input_t inputs[BSEC_MAX_PHYSICAL_SENSOR];
+	uint8_t nInputs = 0;
+	bsec_output_t outputs[BSEC_NUMBER_OUTPUTS];
+	uint8_t nOutputs = BSEC_NUMBER_OUTPUTS;
+
+	bme68xStatus = bme68x_get_data(BME68X_FORCED_MODE, &data, &nFields, &_bme68x);
+	if (nFields == 0)
+	{
+		return;
+	}
+#ifdef BME68X_USE_FPU
+	float t = data.temperature;
+	float h = data.humidity;
+#else
+	float t = data.temperature / 100.0f;
+	float h = data.humidity / 1000.0f;
+#endif
+	if (_bmeConf.process_data & BSEC_PROCESS_TEMPERATURE)
+	{
+		inputs[nInputs++] = {currTimeNs, _tempOffset, 1, BSEC_INPUT_HEATSOURCE};
+		inputs[nInputs++] = {currTimeNs, t, 1, BSEC_INPUT_TEMPERATURE};
+	}
+	if (_bmeConf.process_data & BSEC_PROCESS_HUMIDITY)
+	{
+		inputs[nInputs++] = {currTimeNs, h, 1, BSEC_INPUT_HUMIDITY};
+	}
+	if (_bmeConf.process_data & BSEC_PROCESS_PRESSURE)
+	{
+		inputs[nInputs++] = {currTimeNs, (float)data.pressure, 1, BSEC_INPUT_PRESSURE};
+	}
+	if ((_bmeConf.process_data & BSEC_PROCESS_GAS) && (data.status & BME68X_GASM_VALID_MSK))
+	{
+		inputs[nInputs++] = {currTimeNs, (float)data.gas_resistance, 1, BSEC_INPUT_GASRESISTOR};
+	}
+
+	bsecStatus = bsec_do_steps(inputs, nInputs, outputs, &nOutputs);
+	if (bsecStatus != BSEC_OK)
+	{
+		return;
+	}
+	zeroOutputs();
+	if (nOutputs > 0)
+	{
+		outputTimestamp = outputs[0].time_stamp / INT64_C(1000000);
+	}
+	for (uint8_t i = 0; i < nOutputs; i++)
+	{
+		switch (outputs[i].sensor_id)
+		{
+		case BSEC_OUTPUT_IAQ:
+			iaq = outputs[i].signal;
+			iaqAccuracy = outputs[i].accuracy;
+			break;
+		case BSEC_OUTPUT_STATIC_IAQ:
+			staticIaq = outputs[i].signal;
+			staticIaqAccuracy = outputs[i].accuracy;
+			break;
+		case BSEC_OUTPUT_CO2_EQUIVALENT:
+			co2Equivalent = outputs[i].signal;
+			co2Accuracy = outputs[i].accuracy;
+			break;
+		case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
+			breathVocEquivalent = outputs[i].signal;
+			breathVocAccuracy = outputs[i].accuracy;
+			break;
+		case BSEC_OUTPUT_RAW_TEMPERATURE:
+			rawTemperature = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_RAW_PRESSURE:
+			pressure = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_RAW_HUMIDITY:
+			rawHumidity = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_RAW_GAS:
+			gasResistance = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_STABILIZATION_STATUS:
+			stabStatus = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_RUN_IN_STATUS:
+			runInStatus = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
+			temperature = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
+			humidity = outputs[i].signal;
+			break;
+		case BSEC_OUTPUT_GAS_PERCENTAGE:
+			gasPercentage = outputs[i].signal;
+			gasPercentageAccuracy = outputs[i].accuracy;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void Bsec::getState(uint8_t *state)
+{
+	uint32_t n = 0;
+	bsecStatus = bsec_get_state(0, state, BSEC_MAX_STATE_BLOB_SIZE, _workBuffer, BSEC_MAX_WORKBUFFER_SIZE, &n);
+}
+
+void Bsec::setState(uint8_t *state)
+{
+	bsecStatus = bsec_set_state(state, BSEC_MAX_STATE_BLOB_SIZE, _workBuffer, BSEC_MAX_WORKBUFFER_SIZE);
+}
+
+void Bsec::setConfig(const uint8_t *config)
+{
+	bsecStatus = bsec_set_configuration(config, BSEC_MAX_PROPERTY_BLOB_SIZE, _workBuffer, BSEC_MAX_WORKBUFFER_SIZE);
+}
+
+int64_t Bsec::getTimeMs(void)
+{
+	static uint32_t lastMillis = 0;
+	static int64_t overflow = 0;
+	uint32_t now = millis();
+	if (now < lastMillis)
+	{
+		overflow += INT64_C(0x100000000);
+	}
+	lastMillis = now;
+	return overflow + now;
+}
+
+void Bsec::zeroOutputs(void)
+{
+	iaq = rawTemperature = pressure = rawHumidity = gasResistance = stabStatus = runInStatus = 0.0f;
+	temperature = humidity = staticIaq = co2Equivalent = breathVocEquivalent = compGasValue = gasPercentage = 0.0f;
+	iaqAccuracy = staticIaqAccuracy = co2Accuracy = breathVocAccuracy = compGasAccuracy = gasPercentageAccuracy = 0;
+	outputTimestamp = 0;
+}
+
+void Bsec::delay_us(uint32_t period, void *intfPtr)
+{
+	(void)intfPtr;
+	delayMicroseconds(period);
+}
+
+int8_t Bsec::i2cRead(uint8_t regAddr, uint8_t *regData, uint32_t length, void *intfPtr)
+{
+	uint8_t devAddr = *(uint8_t *)intfPtr;
+	wireObj->beginTransmission(devAddr);
+	wireObj->write(regAddr);
+	if (wireObj->endTransmission() != 0)
+	{
+		return -1;
+	}
+	wireObj->requestFrom((int)devAddr, (int)length);
+	for (uint32_t i = 0; i < length && wireObj->available(); i++)
+	{
+		regData[i] = (uint8_t)wireObj->read();
+	}
+	return 0;
+}
+
+int8_t Bsec::i2cWrite(uint8_t regAddr, const uint8_t *regData, uint32_t length, void *intfPtr)
+{
+	uint8_t devAddr = *(uint8_t *)intfPtr;
+	wireObj->beginTransmission(devAddr);
+	wireObj->write(regAddr);
+	wireObj->write(regData, length);
+	return wireObj->endTransmission() == 0 ? 0 : -1;
+}
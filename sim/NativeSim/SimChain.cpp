@@ -0,0 +1,123 @@
+/**
+ * @file SimChain.cpp
+ * @brief Simulated previous node of a chain element, NODEID-1 of the
+ * firmware under test
+ *
+ * The neighbour learns the node's id from its first chain frame, then sends
+ * a chain frame about every --upstream seconds, at a random phase: a record of its own upstream
+ * node and its own record, one hop travelled. The frame reaches the node only
+ * while the radio listens, like every injected frame, so a frame sent while
+ * the node is in CAD or on air is lost, and so is one the node's own CAD or
+ * TX cuts off. The radio reports every frame the
+ * node starts to send, a forward is one with this neighbour's records whose
+ * sender is the node. The turnaround is the time from the RxDone of the
+ * neighbour's frame to that send.
+ */
+#include "NativeSim.h"
+#include "payload.h"
+#include <algorithm>
+
+/** Link from the neighbour to the node */
+#define SIM_CHAIN_RSSI_DBM -90
+#define SIM_CHAIN_SNR_DB 8
+/** Link the neighbour received its upstream node's frame on */
+#define SIM_CHAIN_UPSTREAM_RSSI_DBM -96
+#define SIM_CHAIN_UPSTREAM_SNR_DB 5
+/** Samples per record aggregate, one SEND_INTERVAL */
+#define SIM_CHAIN_SAMPLES 300
+/** Spread of the neighbour's send times, its clock is not the node's */
+#define SIM_CHAIN_JITTER_MS 1000
+
+static uint32_t simChainIntervalMs = 0;
+/** Node id of the firmware, 0 until its first chain frame */
+static uint8_t simChainNode = 0;
+static uint16_t simChainSeq = 0;
+/** Virtual time the last frame reached the node, 0 once it was forwarded */
+static uint64_t simChainDeliveredMs = 0;
+
+/**
+ * @brief Record of node id, a steady indoor climate with a little drift
+ */
+static void simChainRecord(uint8_t id, TxdPayload *p, PayloadAggregate *agg)
+{
+	memset(p, 0, sizeof(*p));
+	p->id = id;
+	p->bat_perc = 87;
+	p->temperature = 2150 + rand() % 40;
+	p->humidity = 4500 + rand() % 200;
+	p->bar_press = 10132 + rand() % 10;
+	p->inc_z = 2;
+	p->iaq = 60 + rand() % 20;
+	p->iaqAccuracy = 3;
+	p->co2equivalent = 600 + rand() % 50;
+	p->breathVocEquivalent = 1;
+	p->gasPercentage = 40;
+	p->sentPackets = simChainSeq;
+	agg->samples = SIM_CHAIN_SAMPLES;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		int32_t v = payloadChannel(p, i);
+		agg->min[i] = v - 10;
+		agg->max[i] = v + 10;
+		agg->mean[i] = v;
+	}
+}
+
+static void simChainSend(void *unused)
+{
+	(void)unused;
+	uint8_t frame[PAYLOAD_CHAIN_MAX_SIZE];
+	TxdPayload p;
+	PayloadAggregate agg;
+	uint8_t prev = simChainNode - 1;
+	uint8_t len = payloadChainStart(frame, prev - 1);
+	simChainRecord(prev - 1, &p, &agg);
+	len = payloadChainAppend(frame, len, sizeof(frame), &p, &agg, NULL, 0, 0);
+	payloadChainForward(frame, prev);
+	simChainRecord(prev, &p, &agg);
+	len = payloadChainAppend(frame, len, sizeof(frame), &p, &agg, NULL, SIM_CHAIN_UPSTREAM_RSSI_DBM,
+							 SIM_CHAIN_UPSTREAM_SNR_DB);
+	simChainSeq++;
+	nativeSimStats.chainFramesIn++;
+	if (nativeSimInjectRx(frame, len, SIM_CHAIN_RSSI_DBM, SIM_CHAIN_SNR_DB))
+	{
+		// RxDone comes at the end of the frame
+		simChainDeliveredMs = nativeSimNow() + nativeSimRxAirtimeMs(len);
+	}
+	else
+	{
+		nativeSimStats.chainFramesMissed++;
+	}
+	uint32_t next = simChainIntervalMs - SIM_CHAIN_JITTER_MS / 2 + rand() % SIM_CHAIN_JITTER_MS;
+	nativeSimSchedule(next, simChainSend, NULL);
+}
+
+void nativeSimSetUpstream(uint32_t seconds)
+{
+	simChainIntervalMs = seconds * 1000;
+}
+
+void nativeSimChainSend(const uint8_t *frame, uint16_t size)
+{
+	if (simChainIntervalMs == 0 || size > PAYLOAD_CHAIN_MAX_SIZE || !payloadIsChain(frame, size))
+	{
+		return;
+	}
+	if (simChainNode == 0)
+	{
+		// First chain frame of the node, its neighbour starts at a random phase
+		simChainNode = frame[1];
+		nativeSimSchedule(rand() % simChainIntervalMs, simChainSend, NULL);
+		return;
+	}
+	if (frame[1] != simChainNode || frame[2] == 0 || simChainDeliveredMs == 0)
+	{
+		return;
+	}
+	uint64_t turnaround = nativeSimNow() - simChainDeliveredMs;
+	simChainDeliveredMs = 0;
+	nativeSimStats.chainForwards++;
+	nativeSimStats.chainRecordsOut += frame[0] & PAYLOAD_CHAIN_COUNT_MASK;
+	nativeSimStats.chainTurnaroundMs += turnaround;
+	nativeSimStats.chainTurnaroundMaxMs = std::max(nativeSimStats.chainTurnaroundMaxMs, turnaround);
+}
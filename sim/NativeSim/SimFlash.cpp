@@ -0,0 +1,161 @@
+/**
+ * @file SimFlash.cpp
+ * @brief Simulated nRF52840 flash behind the arduino_NVM FlashClass interface
+ *
+ * The 1 MB code flash is a page aligned RAM image. Like the NVMC, program
+ * operations can only clear bits and erase sets a whole page back to 0xff.
+ * Every word programmed and every page erased is charged to the virtual clock
+ * with the nRF52840 worst case NVMC timing, and each page counts its erase
+ * cycles. The counters are part of the image, so they survive a reboot and
+ * a --flash file like the wear counter VirtualPage keeps in the page header.
+ */
+#include "NativeSim.h"
+#include <Flash.h>
+
+#define SIM_FLASH_PAGE_BITS 12
+#define SIM_FLASH_PAGES 256
+
+/** nRF52840 NVMC timing, tWRITE, tERASEPAGE and tERASEALL maximum in us */
+#define SIM_FLASH_WRITE_US 41
+#define SIM_FLASH_ERASE_PAGE_US 85000
+#define SIM_FLASH_ERASE_ALL_US 169000
+
+FlashClass Flash;
+
+/** Flash contents and the erase cycles of every page */
+struct SimFlashImage
+{
+	alignas(1 << SIM_FLASH_PAGE_BITS) uint32_t words[(SIM_FLASH_PAGES << SIM_FLASH_PAGE_BITS) / 4];
+	uint32_t pageErases[SIM_FLASH_PAGES];
+};
+
+static SimFlashImage simFlash;
+static bool simFlashBlank = false;
+
+static void simFlashInit(void)
+{
+	if (!simFlashBlank)
+	{
+		memset(simFlash.words, 0xff, sizeof(simFlash.words));
+		simFlashBlank = true;
+	}
+}
+
+static void simFlashBusy(uint32_t us)
+{
+	nativeSimStats.flashBusyUs += us;
+	nativeSimAdvanceUs(us);
+}
+
+static void simFlashProgram(uint32_t *address, uint32_t value)
+{
+	*address &= value;
+	nativeSimStats.flashWords++;
+	simFlashBusy(SIM_FLASH_WRITE_US);
+}
+
+uint32_t FlashClass::page_size() const
+{
+	return 1UL << SIM_FLASH_PAGE_BITS;
+}
+
+uint8_t FlashClass::page_size_bits() const
+{
+	return SIM_FLASH_PAGE_BITS;
+}
+
+uint32_t FlashClass::page_count() const
+{
+	return SIM_FLASH_PAGES;
+}
+
+uint32_t FlashClass::specified_erase_cycles() const
+{
+	return FLASH_ERASE_CYCLES;
+}
+
+uint32_t *FlashClass::page_address(size_t page)
+{
+	simFlashInit();
+	return &simFlash.words[(page << SIM_FLASH_PAGE_BITS) / 4];
+}
+
+void FlashClass::erase(uint32_t *address, size_t size)
+{
+	simFlashInit();
+	uintptr_t base = (uintptr_t)simFlash.words;
+	uintptr_t start = ((uintptr_t)address - base) & ~(uintptr_t)(FLASH_PAGE_SIZE - 1);
+	uintptr_t end = (uintptr_t)address - base + size;
+	for (; start < end && start < sizeof(simFlash.words); start += FLASH_PAGE_SIZE)
+	{
+		memset((uint8_t *)simFlash.words + start, 0xff, FLASH_PAGE_SIZE);
+		simFlash.pageErases[start >> SIM_FLASH_PAGE_BITS]++;
+		nativeSimStats.flashErases++;
+		simFlashBusy(SIM_FLASH_ERASE_PAGE_US);
+	}
+}
+
+void FlashClass::erase_all()
+{
+	simFlashBlank = false;
+	simFlashInit();
+	for (int i = 0; i < SIM_FLASH_PAGES; i++)
+	{
+		simFlash.pageErases[i]++;
+	}
+	nativeSimStats.flashErases += SIM_FLASH_PAGES;
+	simFlashBusy(SIM_FLASH_ERASE_ALL_US);
+}
+
+void FlashClass::write(uint32_t *address, uint32_t value)
+{
+	if (*address != value)
+	{
+		nativeSimStats.flashEnables++;
+		simFlashProgram(address, value);
+	}
+}
+
+void FlashClass::write_block(uint32_t *dst_address, uint32_t *src_address, uint16_t word_count)
+{
+	nativeSimStats.flashEnables++;
+	while (word_count > 0)
+	{
+		if (*dst_address != *src_address)
+		{
+			simFlashProgram(dst_address, *src_address);
+		}
+		word_count--;
+		dst_address++;
+		src_address++;
+	}
+}
+
+void FlashClass::wait_for_ready()
+{
+}
+
+uint8_t *nativeSimFlashImage(size_t *size)
+{
+	simFlashInit();
+	*size = sizeof(simFlash);
+	return (uint8_t *)&simFlash;
+}
+
+uint32_t nativeSimFlashPageErases(size_t page)
+{
+	return page < SIM_FLASH_PAGES ? simFlash.pageErases[page] : 0;
+}
+
+uint32_t nativeSimFlashMaxPageErases(void)
+{
+	uint32_t max = 0;
+	for (int i = 0; i < SIM_FLASH_PAGES; i++)
+	{
+		if (simFlash.pageErases[i] > max)
+		{
+			max = simFlash.pageErases[i];
+		}
+	}
+	return max;
+}
@@ -0,0 +1,253 @@
+/**
+ * @file SimGateway.cpp
+ * @brief Simulated gateway that answers every uplink it hears with link
+ * feedback
+ *
+ * Free space between node and gateway is a fixed path loss plus a uniform
+ * fade of up to SIM_GW_FADE_DB per frame, the same in both directions. The
+ * gateway demodulates an uplink if its SNR is above the floor of the SF, and
+ * reports RSSI and SNR in a PAYLOAD_DOWNLINK_LINK frame SIM_GW_REPLY_MS
+ * after the uplink ended. Like the SX126x, the reported SNR saturates.
+ * --loss P drops a demodulated frame with probability P on top, interference
+ * at a lossy site.
+ *
+ * The gateway keeps which of the node's last uplinks arrived. While any of
+ * the PAYLOAD_GAP_WINDOW before the one it answers is missing, the answer is
+ * a gap report. Resent uplinks, the records of the node's own chain frames,
+ * fill the gaps, they get no answer.
+ *
+ * Every new uplink is decoded like decoders/decoder.cpp does it, a delta
+ * against the last frame of the node that decoded. A resent uplink older than
+ * that frame does not replace it.
+ *
+ * --command TAG=VALUE,... has the gateway answer the first uplink it
+ * demodulates with a command downlink of those settings instead. Commands
+ * separated by ';' answer the following uplinks, one each.
+ */
+#include "NativeSim.h"
+#include "payload.h"
+#include <algorithm>
+
+/** Thermal noise in 125 kHz plus a 6 dB noise figure */
+#define SIM_GW_NOISE_FLOOR_DBM -117.0
+#define SIM_GW_SNR_MAX 12
+#define SIM_GW_FADE_DB 3.0
+/** Gateway output power, the EU868 limit */
+#define SIM_GW_POWER_DBM 14
+#define SIM_GW_REPLY_MS PAYLOAD_DOWNLINK_DELAY_MS
+
+/** Uplink sequence numbers the gateway remembers */
+#define SIM_GW_HISTORY 32
+
+static float simPathLoss = 0.0f;
+static float simLoss = 0.0f;
+/** Highest sequence number received, bit i of simGwHave: uplink simGwTop-i arrived */
+static bool simGwKnown = false;
+static uint16_t simGwTop;
+static uint32_t simGwHave;
+/** Delta reference of the node, the last frame that decoded */
+static TxdPayload simGwRef;
+static bool simGwRefValid = false;
+static uint8_t simDownlink[PAYLOAD_MAX_SIZE];
+static uint8_t simDownlinkLen;
+static int16_t simDownlinkRssi;
+static int8_t simDownlinkSnr;
+/** Settings of the command downlinks, each sent once, in order */
+static PayloadCommand simCommand[4][8];
+static uint8_t simCommandCount[4];
+static uint8_t simCommandTotal = 0;
+static uint8_t simCommandNext = 0;
+
+static double simFade(void)
+{
+	return (rand() / (double)RAND_MAX * 2.0 - 1.0) * SIM_GW_FADE_DB;
+}
+
+static double simSnrFloor(uint8_t sf)
+{
+	return -7.5 - 2.5 * (sf - 7);
+}
+
+static void simSendFeedback(void *unused)
+{
+	(void)unused;
+	nativeSimInjectRx(simDownlink, simDownlinkLen, simDownlinkRssi, simDownlinkSnr);
+}
+
+/**
+ * @brief Note uplink seq as received
+ *
+ * @return true the first time
+ */
+static bool simGwMark(uint16_t seq)
+{
+	int16_t ahead = (int16_t)(seq - simGwTop);
+	if (!simGwKnown || ahead <= -SIM_GW_HISTORY)
+	{
+		// First uplink or the node restarted, nothing before it is missed
+		simGwKnown = true;
+		simGwTop = seq;
+		simGwHave = UINT32_MAX;
+		return true;
+	}
+	if (ahead > 0)
+	{
+		simGwHave = ahead >= SIM_GW_HISTORY ? 1 : simGwHave << ahead | 1;
+		simGwTop = seq;
+		return true;
+	}
+	bool fresh = !(simGwHave >> -ahead & 1);
+	simGwHave |= 1UL << -ahead;
+	return fresh;
+}
+
+/**
+ * @brief Gap report bits of the uplinks before seq that did not arrive
+ */
+static uint16_t simGwMissing(uint16_t seq)
+{
+	uint16_t missing = 0;
+	for (uint8_t i = 0; i < PAYLOAD_GAP_WINDOW; i++)
+	{
+		uint16_t back = simGwTop - (uint16_t)(seq - 1 - i);
+		if (back < SIM_GW_HISTORY && !(simGwHave >> back & 1))
+		{
+			missing |= 1U << i;
+		}
+	}
+	return missing;
+}
+
+/**
+ * @brief Decode a new uplink against the node's last frame
+ */
+static void simGwDecode(const uint8_t *frame, uint8_t size)
+{
+	TxdPayload p;
+	if (!payloadDecode(frame, size, simGwRefValid ? &simGwRef : NULL, &p, NULL, NULL))
+	{
+		return;
+	}
+	nativeSimStats.gatewayDecoded++;
+	if (payloadIsDelta(frame, size))
+	{
+		nativeSimStats.gatewayDeltas++;
+	}
+	uint16_t behind = simGwRefValid ? (uint16_t)(simGwRef.sentPackets - p.sentPackets) : 0;
+	if (behind == 0 || behind > PAYLOAD_GAP_WINDOW)
+	{
+		simGwRef = p;
+		simGwRefValid = true;
+	}
+}
+
+void nativeSimSetPathLoss(float db)
+{
+	simPathLoss = db;
+}
+
+void nativeSimSetUplinkLoss(float probability)
+{
+	simLoss = probability;
+}
+
+bool nativeSimSetCommand(const char *settings)
+{
+	simCommandTotal = 0;
+	simCommandNext = 0;
+	memset(simCommandCount, 0, sizeof(simCommandCount));
+	while (*settings)
+	{
+		char *end;
+		unsigned long tag = strtoul(settings, &end, 0);
+		if (simCommandTotal == sizeof(simCommand) / sizeof(simCommand[0]))
+		{
+			return false;
+		}
+		uint8_t &count = simCommandCount[simCommandTotal];
+		if (*end != '=' || count == sizeof(simCommand[0]) / sizeof(simCommand[0][0]))
+		{
+			return false;
+		}
+		simCommand[simCommandTotal][count].tag = tag;
+		simCommand[simCommandTotal][count++].value = strtoul(end + 1, &end, 0);
+		if (*end != ',' && *end != ';' && *end != '\0')
+		{
+			return false;
+		}
+		// ';' ends one command, the next answers the following uplink
+		simCommandTotal += *end != ',';
+		settings = *end ? end + 1 : end;
+	}
+	return simCommandTotal > 0;
+}
+
+void nativeSimGatewayUplink(const uint8_t *frame, uint16_t size, int8_t power, uint8_t sf)
+{
+	PayloadLink link;
+	bool uplink = payloadUplinkSeq(frame, size, &link.id, &link.seq);
+	bool resent = !uplink && size <= PAYLOAD_CHAIN_MAX_SIZE && payloadIsChain(frame, size) && frame[2] == 0;
+	if (simPathLoss <= 0.0f || (!uplink && !resent))
+	{
+		return;
+	}
+	nativeSimStats.gatewayUplinks += uplink;
+	double fade = simFade();
+	double rssi = power - simPathLoss + fade;
+	double snr = rssi - SIM_GW_NOISE_FLOOR_DBM;
+	if (snr < simSnrFloor(sf) || (simLoss > 0.0f && rand() / (double)RAND_MAX < simLoss))
+	{
+		return;
+	}
+	nativeSimStats.gatewayRxFrames++;
+	if (resent)
+	{
+		uint8_t pos = PAYLOAD_CHAIN_HEADER_SIZE;
+		PayloadChainRecord rec;
+		uint8_t id;
+		uint16_t seq;
+		while (payloadChainNext(frame, size, &pos, &rec))
+		{
+			if (payloadUplinkSeq(rec.frame, rec.size, &id, &seq) && simGwMark(seq))
+			{
+				nativeSimStats.gatewayReceived++;
+				nativeSimStats.gatewayRecovered++;
+				simGwDecode(rec.frame, rec.size);
+			}
+		}
+		return;
+	}
+	if (simGwMark(link.seq))
+	{
+		nativeSimStats.gatewayReceived++;
+		simGwDecode(frame, (uint8_t)size);
+	}
+	link.rssi = (int16_t)lround(rssi);
+	link.snr = (int8_t)lround(std::min(snr, (double)SIM_GW_SNR_MAX));
+	link.missing = simGwMissing(link.seq);
+	nativeSimStats.gatewayGapReports += link.missing != 0;
+	simDownlinkLen = payloadEncodeLink(&link, simDownlink);
+	if (simCommandNext < simCommandTotal)
+	{
+		const PayloadCommand *cmd = simCommand[simCommandNext];
+		simDownlinkLen = payloadCommandStart(simDownlink, link.id);
+		for (uint8_t i = 0; i < simCommandCount[simCommandNext]; i++)
+		{
+			simDownlinkLen = payloadCommandAdd(simDownlink, simDownlinkLen, sizeof(simDownlink), cmd[i].tag,
+											   cmd[i].value);
+		}
+		simCommandNext++;
+		nativeSimStats.gatewayCommands++;
+	}
+
+	// The node hears the reply if it is above the floor of the same SF
+	double downRssi = SIM_GW_POWER_DBM - simPathLoss + fade;
+	double downSnr = downRssi - SIM_GW_NOISE_FLOOR_DBM;
+	if (downSnr < simSnrFloor(sf))
+	{
+		return;
+	}
+	simDownlinkRssi = (int16_t)lround(downRssi);
+	simDownlinkSnr = (int8_t)lround(std::min(downSnr, (double)SIM_GW_SNR_MAX));
+	nativeSimSchedule(SIM_GW_REPLY_MS, simSendFeedback, NULL);
+}
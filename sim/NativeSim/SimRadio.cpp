@@ -0,0 +1,371 @@
+/**
+ * @file SimRadio.cpp
+ * @brief Simulated SX1262 behind the SX126x-Arduino Radio interface
+ *
+ * An injected frame is caught if it starts while the radio listens, in an
+ * RX window or the RX duty cycle, and its header comes in before the
+ * window's timeout: like on the SX126x, the header stops the timeout, the
+ * preamble does not. RxDone fires once the frame's time on air is over. A
+ * state change before then, a CAD or TX of the firmware, loses the frame.
+ */
+#include "NativeSim.h"
+#include <SX126x-RAK4630.h>
+#include <algorithm>
+
+/** Largest frame the SX126x FIFO accepts */
+#define SIM_RADIO_MAX_FRAME 255
+
+static RadioEvents_t *simRadioEvents = NULL;
+static RadioState_t simRadioState = RF_IDLE;
+static bool simRadioListening = false;
+static uint32_t simRadioGeneration = 0;
+static float simRadioBusy = 0.0f;
+
+static struct
+{
+	int8_t power;
+	uint32_t bandwidth;
+	uint32_t sf;
+	uint8_t cr;
+	uint16_t preamble;
+	bool fixLen;
+	bool crcOn;
+	uint8_t cadSymbols;
+} simRadioCfg = {14, 0, 7, 1, 8, false, true, LORA_CAD_08_SYMBOL};
+
+static uint8_t simLastTx[SIM_RADIO_MAX_FRAME];
+static uint16_t simLastTxLen = 0;
+static uint8_t simRxFrame[SIM_RADIO_MAX_FRAME];
+static uint16_t simRxLen = 0;
+static int16_t simRxRssi = 0;
+static int8_t simRxSnr = 0;
+
+static double simSymbolMs(void)
+{
+	static const double bwHz[3] = {125000.0, 250000.0, 500000.0};
+	return (double)(1UL << simRadioCfg.sf) / bwHz[std::min<uint32_t>(simRadioCfg.bandwidth, 2)] * 1000.0;
+}
+
+/**
+ * @brief Semtech LoRa time-on-air formula (SX1261/2 datasheet 6.1.4)
+ */
+static uint32_t simTimeOnAir(RadioModems_t modem, uint8_t pktLen)
+{
+	(void)modem;
+	double tSym = simSymbolMs();
+	int de = tSym > 16.0 ? 1 : 0;
+	int sf = (int)simRadioCfg.sf;
+	double num = 8.0 * pktLen - 4.0 * sf + 28.0 + (simRadioCfg.crcOn ? 16.0 : 0.0) - (simRadioCfg.fixLen ? 20.0 : 0.0);
+	double den = 4.0 * (sf - 2 * de);
+	double payloadSymb = 8.0 + std::max(ceil(num / den) * (simRadioCfg.cr + 4), 0.0);
+	double tPreamble = (simRadioCfg.preamble + 4.25) * tSym;
+	return (uint32_t)ceil(tPreamble + payloadSymb * tSym);
+}
+
+/**
+ * @brief SX1262 supply power in mW at the given output power, RAK4631 module
+ */
+static double simTxPowerMw(int8_t dbm)
+{
+	static const struct
+	{
+		int8_t dbm;
+		double ma;
+	} table[] = {{0, 18.0}, {10, 32.0}, {14, 45.0}, {17, 90.0}, {20, 102.0}, {22, 118.0}};
+	double ma = table[5].ma;
+	for (size_t i = 1; i < sizeof(table) / sizeof(table[0]); i++)
+	{
+		if (dbm <= table[i].dbm)
+		{
+			double f = (double)(dbm - table[i - 1].dbm) / (table[i].dbm - table[i - 1].dbm);
+			ma = table[i - 1].ma + std::max(0.0, f) * (table[i].ma - table[i - 1].ma);
+			break;
+		}
+	}
+	return ma * 3.3;
+}
+
+static void simTxDone(void *gen)
+{
+	if ((uintptr_t)gen != simRadioGeneration)
+	{
+		return;
+	}
+	simRadioState = RF_IDLE;
+	nativeSimGatewayUplink(simLastTx, simLastTxLen, simRadioCfg.power, simRadioCfg.sf);
+	if (simRadioEvents && simRadioEvents->TxDone)
+	{
+		simRadioEvents->TxDone();
+	}
+}
+
+static void simCadDone(void *gen)
+{
+	if ((uintptr_t)gen != simRadioGeneration)
+	{
+		return;
+	}
+	simRadioState = RF_IDLE;
+	bool busy = simRadioBusy > 0.0f && (rand() / (float)RAND_MAX) < simRadioBusy;
+	if (busy)
+	{
+		nativeSimStats.radioCadBusy++;
+	}
+	if (simRadioEvents && simRadioEvents->CadDone)
+	{
+		simRadioEvents->CadDone(busy);
+	}
+}
+
+static void simRxDone(void *gen)
+{
+	if ((uintptr_t)gen != simRadioGeneration)
+	{
+		nativeSimStats.radioRxLost++;
+		return;
+	}
+	simRadioState = RF_IDLE;
+	nativeSimStats.radioRxFrames++;
+	if (simRadioEvents && simRadioEvents->RxDone)
+	{
+		simRadioEvents->RxDone(simRxFrame, simRxLen, simRxRssi, simRxSnr);
+	}
+}
+
+static void simRxTimeout(void *gen)
+{
+	if ((uintptr_t)gen != simRadioGeneration)
+	{
+		return;
+	}
+	simRadioListening = false;
+	simRadioState = RF_IDLE;
+	if (simRadioEvents && simRadioEvents->RxTimeout)
+	{
+		simRadioEvents->RxTimeout();
+	}
+}
+
+/** Any state change cancels pending TxDone/CadDone/RxTimeout events */
+static void simNewState(RadioState_t state, bool listening)
+{
+	simRadioGeneration++;
+	simRadioState = state;
+	simRadioListening = listening;
+}
+
+/** Header of the injected frame detected, the window's timeout stops */
+static void simRxHeader(void *gen)
+{
+	if ((uintptr_t)gen != simRadioGeneration)
+	{
+		nativeSimStats.radioRxLost++;
+		return;
+	}
+	simNewState(RF_RX_RUNNING, false);
+	uint32_t headerMs = (uint32_t)ceil((simRadioCfg.preamble + 4.25 + 8) * simSymbolMs());
+	uint32_t toa = simTimeOnAir(MODEM_LORA, (uint8_t)simRxLen);
+	nativeSimSchedule(toa > headerMs ? toa - headerMs : 0, simRxDone, (void *)(uintptr_t)simRadioGeneration);
+}
+
+static void simInit(RadioEvents_t *events)
+{
+	simRadioEvents = events;
+	simNewState(RF_IDLE, false);
+}
+
+static RadioState_t simGetStatus(void)
+{
+	return simRadioState;
+}
+
+static void simSetModem(RadioModems_t modem)
+{
+	(void)modem;
+}
+
+static void simSetChannel(uint32_t freq)
+{
+	(void)freq;
+}
+
+static uint32_t simRandom(void)
+{
+	return (uint32_t)rand();
+}
+
+static void simSetRxConfig(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+						   uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen,
+						   uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted,
+						   bool rxContinuous)
+{
+	(void)modem;
+	(void)bandwidth;
+	(void)datarate;
+	(void)coderate;
+	(void)bandwidthAfc;
+	(void)preambleLen;
+	(void)symbTimeout;
+	(void)fixLen;
+	(void)payloadLen;
+	(void)crcOn;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)rxContinuous;
+	nativeSimStats.radioConfigs++;
+}
+
+static void simSetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate,
+						   uint8_t coderate, uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn,
+						   uint8_t hopPeriod, bool iqInverted, uint32_t timeout)
+{
+	(void)modem;
+	(void)fdev;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)timeout;
+	simRadioCfg.power = power;
+	simRadioCfg.bandwidth = bandwidth;
+	simRadioCfg.sf = datarate;
+	simRadioCfg.cr = coderate;
+	simRadioCfg.preamble = preambleLen;
+	simRadioCfg.fixLen = fixLen;
+	simRadioCfg.crcOn = crcOn;
+	nativeSimStats.radioConfigs++;
+}
+
+static void simSend(uint8_t *buffer, uint8_t size)
+{
+	uint32_t toa = simTimeOnAir(MODEM_LORA, size);
+	memcpy(simLastTx, buffer, size);
+	simLastTxLen = size;
+	nativeSimChainSend(buffer, size);
+	nativeSimStats.radioTxFrames++;
+	nativeSimStats.radioTxBytes += size;
+	nativeSimStats.radioAirtimeMs += toa;
+	nativeSimStats.radioTxEnergyUj += (uint64_t)(simTxPowerMw(simRadioCfg.power) * toa);
+	simNewState(RF_TX_RUNNING, false);
+	nativeSimSchedule(toa, simTxDone, (void *)(uintptr_t)simRadioGeneration);
+}
+
+static void simSleep(void)
+{
+	simNewState(RF_IDLE, false);
+}
+
+static void simStandby(void)
+{
+	simNewState(RF_IDLE, false);
+}
+
+static void simRx(uint32_t timeout)
+{
+	simNewState(RF_RX_RUNNING, true);
+	if (timeout != 0)
+	{
+		nativeSimSchedule(timeout, simRxTimeout, (void *)(uintptr_t)simRadioGeneration);
+	}
+}
+
+static void simStartCad(void)
+{
+	static const uint8_t symbols[5] = {1, 2, 4, 8, 16};
+	uint32_t ms = (uint32_t)ceil(symbols[std::min<uint8_t>(simRadioCfg.cadSymbols, 4)] * simSymbolMs());
+	nativeSimStats.radioCad++;
+	simNewState(RF_CAD, false);
+	nativeSimSchedule(ms, simCadDone, (void *)(uintptr_t)simRadioGeneration);
+}
+
+static void simSetCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode,
+							uint32_t cadTimeout)
+{
+	(void)cadDetPeak;
+	(void)cadDetMin;
+	(void)cadExitMode;
+	(void)cadTimeout;
+	simRadioCfg.cadSymbols = cadSymbolNum;
+}
+
+static int16_t simRssi(RadioModems_t modem)
+{
+	(void)modem;
+	return -120;
+}
+
+static void simSetRxDutyCycle(uint32_t rxTime, uint32_t sleepTime)
+{
+	(void)rxTime;
+	(void)sleepTime;
+	simNewState(RF_RX_RUNNING, true);
+}
+
+static void simIrqProcess(void)
+{
+}
+
+const struct Radio_s Radio = {
+	simInit,
+	simGetStatus,
+	simSetModem,
+	simSetChannel,
+	simRandom,
+	simSetRxConfig,
+	simSetTxConfig,
+	simTimeOnAir,
+	simSend,
+	simSleep,
+	simStandby,
+	simRx,
+	simStartCad,
+	simSetCadParams,
+	simRssi,
+	simSetRxDutyCycle,
+	simIrqProcess,
+};
+
+uint32_t lora_rak4630_init(void)
+{
+	return 0;
+}
+
+void nativeSimRadioReset(void)
+{
+	simRadioEvents = NULL;
+	simNewState(RF_IDLE, false);
+}
+
+void nativeSimSetChannelBusy(float probability)
+{
+	simRadioBusy = probability;
+}
+
+bool nativeSimInjectRx(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr)
+{
+	if (!simRadioListening || size > SIM_RADIO_MAX_FRAME)
+	{
+		return false;
+	}
+	memcpy(simRxFrame, data, size);
+	simRxLen = size;
+	simRxRssi = rssi;
+	simRxSnr = snr;
+	// Receiving, a second frame is not caught. The window keeps running until the header
+	simRadioListening = false;
+	uint32_t headerMs = (uint32_t)ceil((simRadioCfg.preamble + 4.25 + 8) * simSymbolMs());
+	nativeSimSchedule(headerMs, simRxHeader, (void *)(uintptr_t)simRadioGeneration);
+	return true;
+}
+
+uint32_t nativeSimRxAirtimeMs(uint16_t size)
+{
+	return simTimeOnAir(MODEM_LORA, (uint8_t)std::min<uint16_t>(size, SIM_RADIO_MAX_FRAME));
+}
+
+uint16_t nativeSimLastTx(uint8_t *buffer, uint16_t maxSize)
+{
+	uint16_t n = std::min(simLastTxLen, maxSize);
+	memcpy(buffer, simLastTx, n);
+	return n;
+}
@@ -0,0 +1,430 @@
+/**
+ * @file SimSensors.cpp
+ * @brief Simulated LIS3DH and BME68x on the virtual I2C bus
+ *
+ * The LIS3DH is modelled at register level so the unmodified SparkFun driver
+ * runs against it. The BME68x is modelled at driver API level: the bme68x_*
+ * entry points declared in lib/Adafruit_BME680-master/bme68x.h are
+ * implemented here, issue the same number of register transfers as the Bosch
+ * driver and return values from a slow daily climate curve.
+ */
+#include "NativeSim.h"
+#include <Wire.h>
+#include "bme68x.h"
+#include <algorithm>
+
+#define SIM_LIS3DH_ADDR 0x18
+#define SIM_LIS3DH_FIFO 32
+
+/**
+ * @brief LIS3DH register file with live output registers and a 32 sample
+ * FIFO filled at the configured data rate of the virtual clock
+ */
+class SimLis3dh : public NativeSimI2cDevice
+{
+public:
+	SimLis3dh(void)
+	{
+		memset(_regs, 0, sizeof(_regs));
+		_regs[0x0F] = 0x33; // WHO_AM_I
+		_regs[0x20] = 0x07; // CTRL_REG1 default
+	}
+
+	uint8_t decodeAddr(uint8_t addr) override
+	{
+		_autoInc = (addr & 0x80) != 0;
+		return addr & 0x7F;
+	}
+
+	uint8_t nextReg(uint8_t reg) override
+	{
+		if (!_autoInc)
+		{
+			return reg;
+		}
+		// With the FIFO on, burst reads wrap from OUT_Z_H back to OUT_X_L
+		return reg == 0x2D && fifoOn() ? 0x28 : (reg + 1) & 0x7F;
+	}
+
+	uint8_t readReg(uint8_t reg) override
+	{
+		fillFifo();
+		if (reg >= 0x28 && reg <= 0x2D)
+		{
+			int16_t raw;
+			if (fifoOn() && _fifoCount > 0)
+			{
+				raw = _fifo[_fifoTail][(reg - 0x28) / 2];
+				if (reg == 0x2D)
+				{
+					// Reading OUT_Z_H pops the sample
+					_fifoTail = (_fifoTail + 1) % SIM_LIS3DH_FIFO;
+					_fifoCount--;
+				}
+			}
+			else
+			{
+				raw = rawAxis((reg - 0x28) / 2, nativeSimNow());
+			}
+			return (reg & 1) ? (uint8_t)(raw >> 8) : (uint8_t)raw;
+		}
+		if (reg == 0x2F)
+		{
+			// FIFO_SRC_REG: OVRN_FIFO when full, EMPTY, FSS unread samples
+			return (_fifoCount == SIM_LIS3DH_FIFO ? 0x40 | 0x1F : _fifoCount) | (_fifoCount == 0 ? 0x20 : 0);
+		}
+		uint8_t value = _regs[reg];
+		if (reg == 0x31 || reg == 0x35)
+		{
+			// INTx_SRC is cleared on read
+			_regs[reg] = 0;
+		}
+		return value;
+	}
+
+	void writeReg(uint8_t reg, uint8_t value) override
+	{
+		fillFifo();
+		_regs[reg] = value;
+		if (!fifoOn())
+		{
+			// Bypass mode and FIFO_EN off both reset the FIFO
+			_fifoCount = 0;
+		}
+	}
+
+	void setAccel(float x, float y, float z)
+	{
+		_g[0] = x;
+		_g[1] = y;
+		_g[2] = z;
+		// Flag the high events the firmware enables in INT1_CFG
+		_regs[0x31] = 0x40 | (x > 0.5f ? 0x02 : 0) | (y > 0.5f ? 0x08 : 0) | (z > 0.5f ? 0x20 : 0);
+	}
+
+	void shock(float peakG, uint32_t ms)
+	{
+		fillFifo();
+		_shockStart = nativeSimNow();
+		_shockMs = ms;
+		_shockPeak = peakG;
+		_regs[0x31] = 0x40 | 0x02; // X high
+	}
+
+private:
+	bool fifoOn(void)
+	{
+		// FIFO_EN in CTRL_REG5 and a mode other than bypass in FIFO_CTRL_REG
+		return (_regs[0x24] & 0x40) && (_regs[0x2E] & 0xC0);
+	}
+
+	/**
+	 * @brief Push the samples taken since the last access, in stream mode
+	 * the oldest are overwritten
+	 */
+	void fillFifo(void)
+	{
+		static const uint16_t odrHz[16] = {0, 1, 10, 25, 50, 100, 200, 400, 1600, 1344};
+		uint64_t now = nativeSimNow();
+		uint16_t odr = odrHz[_regs[0x20] >> 4];
+		if (odr == 0 || !fifoOn())
+		{
+			_lastSample = now;
+			return;
+		}
+		uint64_t period = 1000 / odr ? 1000 / odr : 1;
+		// Only the last FIFO length of samples can survive
+		if (now > _lastSample + period * SIM_LIS3DH_FIFO)
+		{
+			_lastSample = now - period * SIM_LIS3DH_FIFO;
+		}
+		while (_lastSample + period <= now)
+		{
+			_lastSample += period;
+			uint8_t head = (_fifoTail + _fifoCount) % SIM_LIS3DH_FIFO;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_fifo[head][axis] = rawAxis(axis, _lastSample);
+			}
+			if (_fifoCount < SIM_LIS3DH_FIFO)
+			{
+				_fifoCount++;
+			}
+			else
+			{
+				_fifoTail = (_fifoTail + 1) % SIM_LIS3DH_FIFO;
+			}
+		}
+	}
+
+	int16_t rawAxis(int axis, uint64_t at)
+	{
+		// Scale so LIS3DH::calcAccel() returns g for the range in CTRL_REG4
+		static const float lsbPerG[4] = {15987.0f, 7840.0f, 3883.0f, 1280.0f};
+		float g = _g[axis];
+		if (axis == 0 && at >= _shockStart && at < _shockStart + _shockMs)
+		{
+			// Decaying 6 Hz oscillation, below Nyquist of the 25 Hz data rate
+			float t = (at - _shockStart) / 1000.0f;
+			g += _shockPeak * (1.0f - (at - _shockStart) / (float)_shockMs) * sinf(2.0f * (float)PI * 6.0f * t + 0.5f);
+		}
+		float raw = g * lsbPerG[(_regs[0x23] >> 4) & 0x03];
+		raw = std::max(-32768.0f, std::min(32767.0f, raw));
+		return (int16_t)raw;
+	}
+
+	uint8_t _regs[128];
+	bool _autoInc = false;
+	float _g[3] = {0.0f, 0.0f, 1.0f};
+	int16_t _fifo[SIM_LIS3DH_FIFO][3];
+	uint8_t _fifoTail = 0;
+	uint8_t _fifoCount = 0;
+	uint64_t _lastSample = 0;
+	uint64_t _shockStart = 0;
+	uint32_t _shockMs = 0;
+	float _shockPeak = 0.0f;
+};
+
+/**
+ * @brief BME68x register file, only identification registers are meaningful
+ */
+class SimBme68x : public NativeSimI2cDevice
+{
+public:
+	SimBme68x(void)
+	{
+		memset(_regs, 0, sizeof(_regs));
+		_regs[BME68X_REG_CHIP_ID] = BME68X_CHIP_ID;
+		_regs[BME68X_REG_VARIANT_ID] = BME68X_VARIANT_GAS_HIGH;
+	}
+
+	uint8_t readReg(uint8_t reg) override
+	{
+		return _regs[reg];
+	}
+
+	void writeReg(uint8_t reg, uint8_t value) override
+	{
+		if (reg != BME68X_REG_CHIP_ID && reg != BME68X_REG_VARIANT_ID)
+		{
+			_regs[reg] = value;
+		}
+	}
+
+private:
+	uint8_t _regs[256];
+};
+
+static SimLis3dh simLis3dh;
+static SimBme68x simBme68x;
+
+void nativeSimSensorsAttach(void)
+{
+	nativeSimI2cAttach(SIM_LIS3DH_ADDR, &simLis3dh);
+	nativeSimI2cAttach(BME68X_I2C_ADDR_LOW, &simBme68x);
+}
+
+void nativeSimSetAccel(float x, float y, float z)
+{
+	simLis3dh.setAccel(x, y, z);
+}
+
+void nativeSimShock(float peakG, uint32_t ms)
+{
+	simLis3dh.shock(peakG, ms);
+}
+
+// BME68x driver API
+
+/** Climate seen by the BME68x, a daily sine around these set points */
+static float simTempC = 21.0f;
+static float simHumPct = 45.0f;
+static float simPressPa = 101325.0f;
+
+static struct bme68x_conf simConf;
+static struct bme68x_heatr_conf simHeatr;
+static uint64_t simMeasReadyMs = 0;
+static bool simMeasPending = false;
+static uint8_t simMeasIndex = 0;
+
+void nativeSimSetClimate(float tempC, float humPct, float pressPa)
+{
+	simTempC = tempC;
+	simHumPct = humPct;
+	simPressPa = pressPa;
+}
+
+static int8_t simRead(struct bme68x_dev *dev, uint8_t reg, uint8_t *data, uint32_t len)
+{
+	dev->intf_rslt = dev->read(reg, data, len, dev->intf_ptr);
+	return dev->intf_rslt == 0 ? BME68X_OK : BME68X_E_COM_FAIL;
+}
+
+static int8_t simWrite(struct bme68x_dev *dev, uint8_t reg, const uint8_t *data, uint32_t len)
+{
+	dev->intf_rslt = dev->write(reg, data, len, dev->intf_ptr);
+	return dev->intf_rslt == 0 ? BME68X_OK : BME68X_E_COM_FAIL;
+}
+
+int8_t bme68x_init(struct bme68x_dev *dev)
+{
+	uint8_t buf[BME68X_LEN_COEFF1];
+	uint8_t cmd = BME68X_SOFT_RESET_CMD;
+	if (dev == NULL || dev->read == NULL || dev->write == NULL || dev->delay_us == NULL)
+	{
+		return BME68X_E_NULL_PTR;
+	}
+	if (simWrite(dev, BME68X_REG_SOFT_RESET, &cmd, 1) != BME68X_OK)
+	{
+		return BME68X_E_COM_FAIL;
+	}
+	dev->delay_us(BME68X_PERIOD_RESET, dev->intf_ptr);
+	if (simRead(dev, BME68X_REG_CHIP_ID, &dev->chip_id, 1) != BME68X_OK)
+	{
+		return BME68X_E_COM_FAIL;
+	}
+	if (dev->chip_id != BME68X_CHIP_ID)
+	{
+		return BME68X_E_DEV_NOT_FOUND;
+	}
+	simRead(dev, BME68X_REG_VARIANT_ID, buf, 1);
+	dev->variant_id = buf[0];
+	simRead(dev, BME68X_REG_COEFF1, buf, BME68X_LEN_COEFF1);
+	simRead(dev, BME68X_REG_COEFF2, buf, BME68X_LEN_COEFF2);
+	return simRead(dev, BME68X_REG_COEFF3, buf, BME68X_LEN_COEFF3);
+}
+
+int8_t bme68x_soft_reset(struct bme68x_dev *dev)
+{
+	uint8_t cmd = BME68X_SOFT_RESET_CMD;
+	int8_t rslt = simWrite(dev, BME68X_REG_SOFT_RESET, &cmd, 1);
+	dev->delay_us(BME68X_PERIOD_RESET, dev->intf_ptr);
+	return rslt;
+}
+
+int8_t bme68x_set_op_mode(const uint8_t op_mode, struct bme68x_dev *dev)
+{
+	uint8_t ctrl;
+	simRead(dev, BME68X_REG_CTRL_MEAS, &ctrl, 1);
+	ctrl = (ctrl & ~BME68X_MODE_MSK) | (op_mode & BME68X_MODE_MSK);
+	int8_t rslt = simWrite(dev, BME68X_REG_CTRL_MEAS, &ctrl, 1);
+	if (rslt == BME68X_OK && op_mode == BME68X_FORCED_MODE)
+	{
+		simMeasPending = true;
+		simMeasReadyMs = nativeSimNow() + bme68x_get_meas_dur(op_mode, &simConf, dev) / 1000;
+		simMeasReadyMs += simHeatr.enable ? simHeatr.heatr_dur : 0;
+		nativeSimStats.bmeMeasurements++;
+	}
+	return rslt;
+}
+
+int8_t bme68x_get_op_mode(uint8_t *op_mode, struct bme68x_dev *dev)
+{
+	uint8_t ctrl;
+	int8_t rslt = simRead(dev, BME68X_REG_CTRL_MEAS, &ctrl, 1);
+	*op_mode = ctrl & BME68X_MODE_MSK;
+	return rslt;
+}
+
+uint32_t bme68x_get_meas_dur(const uint8_t op_mode, struct bme68x_conf *conf, struct bme68x_dev *dev)
+{
+	static const uint8_t os_to_meas_cycles[6] = {0, 1, 2, 4, 8, 16};
+	(void)dev;
+	if (conf == NULL || conf->os_temp > 5 || conf->os_pres > 5 || conf->os_hum > 5)
+	{
+		return 0;
+	}
+	uint32_t meas_cycles = os_to_meas_cycles[conf->os_temp];
+	meas_cycles += os_to_meas_cycles[conf->os_pres];
+	meas_cycles += os_to_meas_cycles[conf->os_hum];
+	uint32_t meas_dur = meas_cycles * UINT32_C(1963);
+	meas_dur += UINT32_C(477 * 4);
+	meas_dur += UINT32_C(477 * 5);
+	if (op_mode != BME68X_PARALLEL_MODE)
+	{
+		meas_dur += UINT32_C(1000);
+	}
+	return meas_dur;
+}
+
+int8_t bme68x_set_conf(struct bme68x_conf *conf, struct bme68x_dev *dev)
+{
+	uint8_t regs[5];
+	if (conf == NULL)
+	{
+		return BME68X_E_NULL_PTR;
+	}
+	bme68x_set_op_mode(BME68X_SLEEP_MODE, dev);
+	simConf = *conf;
+	simRead(dev, BME68X_REG_CTRL_GAS_1, regs, 5);
+	regs[2] = conf->os_hum;
+	regs[4] = (uint8_t)((conf->os_temp << 5) | (conf->os_pres << 2));
+	return simWrite(dev, BME68X_REG_CTRL_GAS_1, regs, 5);
+}
+
+int8_t bme68x_set_heatr_conf(uint8_t op_mode, const struct bme68x_heatr_conf *conf, struct bme68x_dev *dev)
+{
+	uint8_t regs[2];
+	if (conf == NULL)
+	{
+		return BME68X_E_NULL_PTR;
+	}
+	(void)op_mode;
+	bme68x_set_op_mode(BME68X_SLEEP_MODE, dev);
+	simHeatr = *conf;
+	regs[0] = (uint8_t)(conf->heatr_temp / 4);
+	simWrite(dev, BME68X_REG_RES_HEAT0, regs, 1);
+	regs[0] = (uint8_t)std::min<uint16_t>(conf->heatr_dur, 0xFF);
+	simWrite(dev, BME68X_REG_GAS_WAIT0, regs, 1);
+	simRead(dev, BME68X_REG_CTRL_GAS_0, regs, 2);
+	regs[1] = conf->enable ? BME68X_ENABLE_GAS_MEAS_H << 4 : 0;
+	return simWrite(dev, BME68X_REG_CTRL_GAS_0, regs, 2);
+}
+
+int8_t bme68x_get_data(uint8_t op_mode, struct bme68x_data *data, uint8_t *n_data, struct bme68x_dev *dev)
+{
+	uint8_t field[BME68X_LEN_FIELD];
+	(void)op_mode;
+	if (data == NULL || n_data == NULL)
+	{
+		return BME68X_E_NULL_PTR;
+	}
+	*n_data = 0;
+	int8_t rslt = simRead(dev, BME68X_REG_FIELD0, field, BME68X_LEN_FIELD);
+	if (rslt != BME68X_OK)
+	{
+		return rslt;
+	}
+	if (!simMeasPending || nativeSimNow() < simMeasReadyMs)
+	{
+		return BME68X_W_NO_NEW_DATA;
+	}
+	simMeasPending = false;
+
+	double day = 2.0 * PI * (double)(nativeSimNow() % 86400000ULL) / 86400000.0;
+	float t = simTempC + 2.0f * (float)sin(day);
+	float h = simHumPct + 8.0f * (float)sin(day + PI);
+	float p = simPressPa + 150.0f * (float)sin(day / 3.0);
+	float g = 90000.0f + 30000.0f * (float)cos(day * 4.0);
+
+	memset(data, 0, sizeof(*data));
+	data->status = BME68X_NEW_DATA_MSK;
+	if (simHeatr.enable)
+	{
+		data->status |= BME68X_GASM_VALID_MSK | BME68X_HEAT_STAB_MSK;
+	}
+	data->meas_index = simMeasIndex++;
+#ifdef BME68X_USE_FPU
+	data->temperature = t;
+	data->pressure = p;
+	data->humidity = h;
+	data->gas_resistance = simHeatr.enable ? g : 0.0f;
+#else
+	data->temperature = (int16_t)lroundf(t * 100.0f);
+	data->pressure = (uint32_t)lroundf(p);
+	data->humidity = (uint32_t)lroundf(h * 1000.0f);
+	data->gas_resistance = simHeatr.enable ? (uint32_t)g : 0;
+#endif
+	*n_data = 1;
+	return BME68X_OK;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file Wire.h
+ * @brief Host stand-in for the nRF52 TwoWire driver used by [env:native]
+ *
+ * Transactions are routed to simulated register-file devices registered with
+ * nativeSimI2cAttach(). Every transaction is counted in nativeSimStats and
+ * charged to the virtual clock at 400 kHz, so I2C cost per wake is visible.
+ */
+#ifndef NATIVE_SIM_WIRE_H
+#define NATIVE_SIM_WIRE_H
+
+#include <Arduino.h>
+
+/** Same receive buffer size as the nRF52 core, longer reads are truncated */
+#define NATIVE_SIM_WIRE_BUFFER_SIZE 64
+
+/**
+ * @brief Simulated I2C slave with an 8 bit register address space
+ */
+class NativeSimI2cDevice
+{
+public:
+	virtual ~NativeSimI2cDevice() = default;
+	/** Read one register, called once per byte of a read transfer */
+	virtual uint8_t readReg(uint8_t reg) = 0;
+	/** Write one register, called once per data byte of a write transfer */
+	virtual void writeReg(uint8_t reg, uint8_t value) = 0;
+	/** Register address increment between bytes of one transfer */
+	virtual uint8_t nextReg(uint8_t reg) { return reg + 1; }
+	/** Map the address byte sent by the master to a register address */
+	virtual uint8_t decodeAddr(uint8_t addr) { return addr; }
+};
+
+void nativeSimI2cAttach(uint8_t address, NativeSimI2cDevice *device);
+
+class TwoWire
+{
+public:
+	void begin(void) {}
+	void end(void) {}
+	void setClock(uint32_t clock) { _clock = clock; }
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *data, size_t quantity);
+	uint8_t endTransmission(bool stopBit = true);
+	uint8_t requestFrom(uint8_t address, size_t quantity, bool stopBit = true);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, (size_t)quantity); }
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (size_t)quantity); }
+	int available(void) { return _rxLen - _rxPos; }
+	int read(void) { return _rxPos < _rxLen ? _rxBuf[_rxPos++] : -1; }
+	int peek(void) { return _rxPos < _rxLen ? _rxBuf[_rxPos] : -1; }
+
+private:
+	void chargeBus(size_t bytes);
+
+	uint32_t _clock = 400000;
+	uint8_t _txAddr = 0;
+	uint8_t _txBuf[NATIVE_SIM_WIRE_BUFFER_SIZE];
+	size_t _txLen = 0;
+	uint8_t _rxBuf[NATIVE_SIM_WIRE_BUFFER_SIZE];
+	int _rxLen = 0;
+	int _rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file bsec.h
+ * @brief Host stand-in for the BSEC Arduino wrapper (boschsensortec/BSEC
+ * Software Library 1.8.x) used by [env:native]
+ *
+ * Mirrors the public surface of the real Bsec class. run() goes through the
+ * same bsec_sensor_control -> bme68x forced measurement -> bsec_do_steps
+ * sequence, so the heater wait and the I2C traffic show up on the simulated
+ * clock and bus counters exactly where they do on the node.
+ */
+#ifndef NATIVE_SIM_BSEC_H
+#define NATIVE_SIM_BSEC_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "bsec_interface.h"
+#include "bme68x.h"
+
+class Bsec
+{
+public:
+	bsec_version_t version;
+	int64_t nextCall;
+	int8_t bme68xStatus;
+	bsec_library_return_t bsecStatus;
+	float iaq, rawTemperature, pressure, rawHumidity, gasResistance, stabStatus, runInStatus, temperature, humidity,
+		staticIaq, co2Equivalent, breathVocEquivalent, compGasValue, gasPercentage;
+	uint8_t iaqAccuracy, staticIaqAccuracy, co2Accuracy, breathVocAccuracy, compGasAccuracy, gasPercentageAccuracy;
+	int64_t outputTimestamp;
+	static TwoWire *wireObj;
+
+	Bsec(void);
+	void begin(uint8_t i2cAddr, TwoWire &i2c, bme68x_delay_us_fptr_t idleTask = delay_us);
+	void updateSubscription(bsec_virtual_sensor_t sensorList[], uint8_t nSensors,
+							float sampleRate = BSEC_SAMPLE_RATE_ULP);
+	bool run(void);
+	void getState(uint8_t *state);
+	void setState(uint8_t *state);
+	void setConfig(const uint8_t *config);
+	void setTemperatureOffset(float tempOffset) { _tempOffset = tempOffset; }
+	int64_t getTimeMs(void);
+	uint32_t getLastTime(void) { return _lastTime; }
+
+	static void delay_us(uint32_t period, void *intfPtr);
+	static int8_t i2cRead(uint8_t regAddr, uint8_t *regData, uint32_t length, void *intfPtr);
+	static int8_t i2cWrite(uint8_t regAddr, const uint8_t *regData, uint32_t length, void *intfPtr);
+
+private:
+	void zeroOutputs(void);
+	void readProcessData(int64_t currTimeNs);
+
+	struct bme68x_dev _bme68x;
+	struct bme68x_conf _conf;
+	struct bme68x_heatr_conf _heatrConf;
+	bsec_bme_settings_t _bmeConf;
+	uint8_t _devAddr;
+	uint8_t _workBuffer[BSEC_MAX_WORKBUFFER_SIZE];
+	float _tempOffset;
+	uint32_t _lastTime;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file bsec_interface.h
+ * @brief Host stand-in for the BSEC 1.4.x core interface used by [env:native]
+ *
+ * Declares the datatypes and entry points of the precompiled libalgobsec that
+ * the Arduino wrapper and src/bsec_bme.cpp use. The simulated implementation
+ * follows the real call protocol (sensor_control -> measurement -> do_steps)
+ * and ramps iaqAccuracy with the number of processed samples, which is also
+ * what the serialized state carries.
+ */
+#ifndef NATIVE_SIM_BSEC_INTERFACE_H
+#define NATIVE_SIM_BSEC_INTERFACE_H
+
+#include <stdint.h>
+
+#define BSEC_MAX_PHYSICAL_SENSOR (8)
+#define BSEC_NUMBER_OUTPUTS (14)
+#define BSEC_MAX_WORKBUFFER_SIZE (2048)
+#define BSEC_MAX_PROPERTY_BLOB_SIZE (454)
+#define BSEC_MAX_STATE_BLOB_SIZE (139)
+#define BSEC_SAMPLE_RATE_DISABLED (65535.0f)
+#define BSEC_SAMPLE_RATE_ULP (0.0033333f)
+#define BSEC_SAMPLE_RATE_CONTINUOUS (1.0f)
+#define BSEC_SAMPLE_RATE_LP (0.33333f)
+#define BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND (0.0f)
+
+#define BSEC_PROCESS_PRESSURE (1 << (BSEC_INPUT_PRESSURE - 1))
+#define BSEC_PROCESS_TEMPERATURE (1 << (BSEC_INPUT_TEMPERATURE - 1))
+#define BSEC_PROCESS_HUMIDITY (1 << (BSEC_INPUT_HUMIDITY - 1))
+#define BSEC_PROCESS_GAS (1 << (BSEC_INPUT_GASRESISTOR - 1))
+#define BSEC_NUMBER_INPUTS (BSEC_MAX_PHYSICAL_SENSOR)
+
+typedef enum
+{
+	BSEC_INPUT_PRESSURE = 1,
+	BSEC_INPUT_HUMIDITY = 4,
+	BSEC_INPUT_TEMPERATURE = 6,
+	BSEC_INPUT_GASRESISTOR = 9,
+	BSEC_INPUT_HEATSOURCE = 14,
+	BSEC_INPUT_DISABLE_BASELINE_TRACKER = 23,
+} bsec_physical_sensor_t;
+
+typedef enum
+{
+	BSEC_OUTPUT_IAQ = 1,
+	BSEC_OUTPUT_STATIC_IAQ = 2,
+	BSEC_OUTPUT_CO2_EQUIVALENT = 3,
+	BSEC_OUTPUT_BREATH_VOC_EQUIVALENT = 4,
+	BSEC_OUTPUT_RAW_TEMPERATURE = 6,
+	BSEC_OUTPUT_RAW_PRESSURE = 7,
+	BSEC_OUTPUT_RAW_HUMIDITY = 8,
+	BSEC_OUTPUT_RAW_GAS = 9,
+	BSEC_OUTPUT_STABILIZATION_STATUS = 12,
+	BSEC_OUTPUT_RUN_IN_STATUS = 13,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE = 14,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY = 15,
+	BSEC_OUTPUT_GAS_PERCENTAGE = 21,
+} bsec_virtual_sensor_t;
+
+typedef enum
+{
+	BSEC_OK = 0,
+	BSEC_E_DOSTEPS_INVALIDINPUT = -1,
+	BSEC_E_DOSTEPS_VALUELIMITS = -2,
+	BSEC_E_SU_WRONGDATARATE = -10,
+	BSEC_E_SU_SAMPLERATELIMITS = -13,
+	BSEC_E_PARSE_SECTIONEXCEEDSWORKBUFFER = -32,
+	BSEC_E_SET_INVALIDLENGTH = -41,
+	BSEC_W_SC_CALL_TIMING_VIOLATION = 100,
+} bsec_library_return_t;
+
+typedef struct
+{
+	uint8_t major;
+	uint8_t minor;
+	uint8_t major_bugfix;
+	uint8_t minor_bugfix;
+} bsec_version_t;
+
+typedef struct
+{
+	int64_t time_stamp;
+	float signal;
+	uint8_t signal_dimensions;
+	uint8_t sensor_id;
+} bsec_input_t;
+
+typedef struct
+{
+	int64_t time_stamp;
+	float signal;
+	uint8_t signal_dimensions;
+	uint8_t sensor_id;
+	uint8_t accuracy;
+} bsec_output_t;
+
+typedef struct
+{
+	float sample_rate;
+	uint8_t sensor_id;
+} bsec_sensor_configuration_t;
+
+typedef struct
+{
+	int64_t next_call;
+	uint32_t process_data;
+	uint16_t heater_temperature;
+	uint16_t heater_duration;
+	uint8_t run_gas;
+	uint8_t pressure_oversampling;
+	uint8_t temperature_oversampling;
+	uint8_t humidity_oversampling;
+	uint8_t trigger_measurement;
+} bsec_bme_settings_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bsec_library_return_t bsec_init(void);
+bsec_library_return_t bsec_get_version(bsec_version_t *bsec_version_p);
+bsec_library_return_t bsec_update_subscription(const bsec_sensor_configuration_t *requested_virtual_sensors,
+											   uint8_t n_requested_virtual_sensors,
+											   bsec_sensor_configuration_t *required_sensor_settings,
+											   uint8_t *n_required_sensor_settings);
+bsec_library_return_t bsec_do_steps(const bsec_input_t *inputs, uint8_t n_inputs, bsec_output_t *outputs,
+									uint8_t *n_outputs);
+bsec_library_return_t bsec_sensor_control(int64_t time_stamp, bsec_bme_settings_t *sensor_settings);
+bsec_library_return_t bsec_set_configuration(const uint8_t *serialized_settings, uint32_t n_serialized_settings,
+											 uint8_t *work_buffer, uint32_t n_work_buffer_size);
+bsec_library_return_t bsec_set_state(const uint8_t *serialized_state, uint32_t n_serialized_state,
+									 uint8_t *work_buffer, uint32_t n_work_buffer_size);
+bsec_library_return_t bsec_get_state(uint8_t state_set_id, uint8_t *serialized_state,
+									 uint32_t n_serialized_state_max, uint8_t *work_buffer,
+									 uint32_t n_work_buffer, uint32_t *n_serialized_state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,13 @@
+/**
+ * @file nrf.h
+ * @brief Device selection for libraries that include the nRF MDK header
+ *
+ * Only the part macro is provided; register access (NRF_NVMC, NRF_FICR) is
+ * replaced by the simulated peripherals in this library.
+ */
+#ifndef NATIVE_SIM_NRF_H
+#define NATIVE_SIM_NRF_H
+
+#define NRF52840
+
+#endif
@@ -16,6 +16,10 @@ LIS3DH accSensor(I2C_MODE, 0x18);
 /** Required for give semaphore from ISR */
 BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
+/** Newest sample of the last capture, stands in for the drained FIFO */
+static float accLast[3];
+static bool accLastValid = false;
+
 
 /**
  * @brief Initialize LIS3DH 3-axis 
@@ -111,6 +115,13 @@ bool initACC(void)
 	accSensor.writeRegister(LIS3DH_CTRL_REG5, dataToWrite);
 	delay(100);
 
+	// FIFO in stream mode, always holds the last ACC_FIFO_DEPTH samples
+	// so a shock can be read back after INT1 woke us up
+	accSensor.settings.fifoEnabled = 1;
+	accSensor.settings.fifoMode = 2;
+	accSensor.fifoBegin();
+	accSensor.fifoStartRec();
+
 	//LIS3DH_CTRL_REG6
 	dataToWrite = 0;
 	dataToWrite |= 0x20; // I2_IA2 -- works
@@ -171,9 +182,101 @@ void clearAccInt(void)
 		myLog_d("X low");
 }
 
-//Calculate tilt along axes
-void calculateTilt(float xacc, float yacc, float zacc, uint8_t * xinc, uint8_t * yinc, uint8_t * zinc){
-	*xinc = (180/PI)*atan2( xacc, sqrt( pow(yacc,2) + pow(zacc,2) ) );
-	*yinc = (180/PI)*atan2( yacc, sqrt( pow(xacc,2) + pow(zacc,2) ) );
-	*zinc = (180/PI)*atan2( sqrt( pow(xacc,2) + pow(yacc,2) ), zacc );
+/**
+ * @brief One-shot timer callback, the FIFO now holds the shock
+ * 
+ * @param unused 
+ */
+void accCaptureWakeup(TimerHandle_t unused)
+{
+	eventType = 4;
+	xSemaphoreGiveFromISR(taskEvent, pdFALSE);
+}
+
+/**
+ * @brief Burst read the FIFO and reduce the shock to peak, RMS and duration
+ * of the deviation of |a| from 1 g
+ * @note Drains the FIFO, the next accRead() returns the newest sample of the
+ * window
+ * 
+ * @param shock receives the features, all zero if the FIFO was empty
+ * @return true If samples were read
+ */
+bool accCapture(PayloadShock *shock)
+{
+	memset(shock, 0, sizeof(*shock));
+	uint8_t fifoSrc = accSensor.fifoGetStatus();
+	// OVRN_FIFO set means all slots are unread, FSS only counts to 31
+	uint8_t count = (fifoSrc & 0x40) ? ACC_FIFO_DEPTH : (fifoSrc & 0x1F);
+	if (fifoSrc & 0x20)
+	{
+		count = 0;
+	}
+
+	uint8_t burst[ACC_FIFO_BURST * 6];
+	float peak = 0.0f;
+	float sumSq = 0.0f;
+	uint16_t above = 0;
+	uint8_t read = 0;
+	while (read < count)
+	{
+		uint8_t n = count - read > ACC_FIFO_BURST ? ACC_FIFO_BURST : count - read;
+		// Auto-increment wraps from OUT_Z_H back to OUT_X_L while the FIFO is on
+		if (accSensor.readRegisterRegion(burst, LIS3DH_OUT_X_L, n * 6) != IMU_SUCCESS)
+		{
+			break;
+		}
+		for (uint8_t s = 0; s < n; s++)
+		{
+			for (uint8_t axis = 0; axis < 3; axis++)
+			{
+				int16_t raw = (int16_t)(burst[s * 6 + axis * 2] | (burst[s * 6 + axis * 2 + 1] << 8));
+				accLast[axis] = accSensor.calcAccel(raw);
+			}
+			float dev = fabsf(sqrtf(accLast[0] * accLast[0] + accLast[1] * accLast[1] + accLast[2] * accLast[2]) - 1.0f);
+			if (dev > peak)
+			{
+				peak = dev;
+			}
+			sumSq += dev * dev;
+			if (dev * 1000.0f > ACC_SHOCK_THRESHOLD)
+			{
+				above++;
+			}
+		}
+		read += n;
+	}
+	if (read == 0)
+	{
+		return false;
+	}
+	accLastValid = true;
+
+	// |a| stays below 28 g even on the 16 g range, fits the mg fields
+	shock->peak = peak * 1000.0f + 0.5f;
+	shock->rms = sqrtf(sumSq / read) * 1000.0f + 0.5f;
+	shock->duration = (uint32_t)above * 1000 / accSensor.settings.accelSampleRate;
+	myLog_d("Shock over %i samples: peak %i mg, rms %i mg, %i ms", read, shock->peak, shock->rms, shock->duration);
+	return true;
+}
+
+/**
+ * @brief Acceleration in g for the tilt, one burst over the output registers
+ */
+void accRead(float *xacc, float *yacc, float *zacc)
+{
+	if (!accLastValid)
+	{
+		// With the FIFO on this is its oldest sample, at most 1.3 s old
+		uint8_t sample[6] = {0};
+		accSensor.readRegisterRegion(sample, LIS3DH_OUT_X_L, sizeof(sample));
+		for (uint8_t axis = 0; axis < 3; axis++)
+		{
+			accLast[axis] = accSensor.calcAccel((int16_t)(sample[axis * 2] | (sample[axis * 2 + 1] << 8)));
+		}
+	}
+	accLastValid = false;
+	*xacc = accLast[0];
+	*yacc = accLast[1];
+	*zacc = accLast[2];
 }
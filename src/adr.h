@@ -0,0 +1,209 @@
+/**
+ * @file adr.h
+ * @brief Link adaptation of lora.cpp: TX power and spreading factor from the
+ * gateway's link feedback
+ *
+ * The gateway answers an uplink with the RSSI and SNR it measured
+ * (PAYLOAD_DOWNLINK_LINK in payload.h). Each feedback is normalised to the
+ * SNR the link would have at 0 dBm, and the worst of the last ADR_HISTORY
+ * feedbacks picks the configuration. That is the one with the least PA
+ * energy per frame, supply current times airtime, which still leaves
+ * ADR_MARGIN_DB over the demodulation floor of its SF. After ADR_LOST_LIMIT
+ * uplinks without feedback the node goes back to full power, and then steps
+ * the SF up to the highest allowed.
+ *
+ * A P2P SX126x receiver demodulates one SF only, so ADR_SF_MIN and ADR_SF_MAX
+ * both default to the SF of the radio profile and only the power adapts.
+ * Widen the range for a multi-SF gateway, e.g. -DADR_SF_MAX=12.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Margin kept over the demodulation floor, covers fading between feedbacks */
+#ifndef ADR_MARGIN_DB
+#define ADR_MARGIN_DB 10
+#endif
+/* Lowest output power and the step between the powers tried, SX1262 goes down to -9 dBm */
+#define ADR_POWER_MIN -8
+#define ADR_POWER_STEP 3
+/* Feedbacks the decision looks at, the worst one counts */
+#define ADR_HISTORY 4
+/* Uplinks without feedback before the node falls back one step */
+#define ADR_LOST_LIMIT 4
+/* The SX126x packet SNR saturates at about +10 dB, above this the RSSI over
+ * the noise floor tells the margin */
+#define ADR_SNR_SATURATION 5
+/* Thermal noise in 125 kHz plus a 6 dB noise figure */
+#define ADR_NOISE_FLOOR_DBM -117
+
+struct AdrState
+{
+	uint8_t sf;					 // SF to send with
+	int8_t power;				 // output power to send with, dBm
+	int8_t powerMax;			 // power of the fallback
+	uint8_t sfMin;				 // spreading factors to choose from
+	uint8_t sfMax;
+	int8_t quality[ADR_HISTORY]; // SNR at 0 dBm output power of the last feedbacks
+	uint8_t count;				 // valid entries in quality
+	uint8_t next;				 // entry the next feedback goes to
+	uint8_t silent;				 // uplinks since the last feedback
+	uint32_t feedbacks;			 // feedbacks used
+	uint32_t changes;			 // configuration changes
+	uint32_t fallbacks;			 // changes for missing feedback
+};
+
+/**
+ * @brief Lowest SNR the SX126x demodulates at SF sf, datasheet table 6-1
+ */
+static inline float adrSnrFloor(uint8_t sf)
+{
+	return -7.5f - 2.5f * (sf - 7);
+}
+
+/**
+ * @brief SX1262 supply current in mA at the given output power, RAK4631
+ * module, the figures of sim/NativeSim/SimRadio.cpp
+ */
+static inline float adrSupplyMa(int8_t dbm)
+{
+	static const struct
+	{
+		int8_t dbm;
+		float ma;
+	} table[] = {{0, 18.0f}, {10, 32.0f}, {14, 45.0f}, {17, 90.0f}, {20, 102.0f}, {22, 118.0f}};
+	if (dbm <= table[0].dbm)
+	{
+		return table[0].ma;
+	}
+	for (uint8_t i = 1; i < sizeof(table) / sizeof(table[0]); i++)
+	{
+		if (dbm <= table[i].dbm)
+		{
+			float f = (float)(dbm - table[i - 1].dbm) / (table[i].dbm - table[i - 1].dbm);
+			return table[i - 1].ma + f * (table[i].ma - table[i - 1].ma);
+		}
+	}
+	return table[5].ma;
+}
+
+/**
+ * @brief SNR the gateway had, with the RSSI where the SNR report saturates
+ */
+static inline int16_t adrLinkSnr(int16_t rssi, int8_t snr)
+{
+	int16_t overNoise = rssi - ADR_NOISE_FLOOR_DBM;
+	return snr >= ADR_SNR_SATURATION && overNoise > snr ? overNoise : snr;
+}
+
+/**
+ * @brief Start at sf and powerMax, what the node used before link adaptation
+ */
+static inline void adrInit(AdrState *adr, uint8_t sf, int8_t powerMax)
+{
+	*adr = AdrState();
+	adr->sf = sf;
+	adr->power = powerMax;
+	adr->powerMax = powerMax;
+#ifdef ADR_SF_MIN
+	adr->sfMin = ADR_SF_MIN;
+#else
+	adr->sfMin = sf;
+#endif
+#ifdef ADR_SF_MAX
+	adr->sfMax = ADR_SF_MAX;
+#else
+	adr->sfMax = sf;
+#endif
+}
+
+/**
+ * @brief Margin over the demodulation floor the worst recent feedback leaves
+ * at sf and power, dB
+ */
+static inline float adrMargin(const AdrState *adr, uint8_t sf, int8_t power)
+{
+	int8_t worst = adr->quality[0];
+	for (uint8_t i = 1; i < adr->count; i++)
+	{
+		worst = adr->quality[i] < worst ? adr->quality[i] : worst;
+	}
+	return worst + power - adrSnrFloor(sf);
+}
+
+/**
+ * @brief Take the gateway's measurement of an uplink sent at power
+ * @note The SNR is measured over the channel bandwidth whatever the SF of
+ * the uplink, only the floor adrMargin() holds it against depends on the SF
+ *
+ * @return true if adr->sf or adr->power changed
+ */
+static inline bool adrFeedback(AdrState *adr, int16_t rssi, int8_t snr, int8_t power)
+{
+	int16_t quality = adrLinkSnr(rssi, snr) - power;
+	adr->quality[adr->next] = quality < -128 ? -128 : quality > 127 ? 127 : quality;
+	adr->next = (adr->next + 1) % ADR_HISTORY;
+	adr->count = adr->count < ADR_HISTORY ? adr->count + 1 : ADR_HISTORY;
+	adr->silent = 0;
+	adr->feedbacks++;
+
+	// Cheapest configuration with the margin, the most robust one if none has it
+	uint8_t bestSf = adr->sfMax;
+	int8_t bestPower = adr->powerMax;
+	float bestCost = 0;
+	for (uint8_t s = adr->sfMin; s <= adr->sfMax; s++)
+	{
+		for (int8_t p = adr->powerMax; p >= ADR_POWER_MIN; p -= ADR_POWER_STEP)
+		{
+			// Power descending, the last one with the margin is the cheapest at this SF
+			if (adrMargin(adr, s, p) < ADR_MARGIN_DB)
+			{
+				break;
+			}
+			float cost = adrSupplyMa(p) * (1UL << s);
+			if (bestCost == 0 || cost < bestCost)
+			{
+				bestSf = s;
+				bestPower = p;
+				bestCost = cost;
+			}
+		}
+	}
+	bool changed = bestSf != adr->sf || bestPower != adr->power;
+	adr->sf = bestSf;
+	adr->power = bestPower;
+	adr->changes += changed;
+	return changed;
+}
+
+/**
+ * @brief Count an uplink, after ADR_LOST_LIMIT without feedback go back to
+ * full power, then one SF up per further ADR_LOST_LIMIT up to sfMax
+ *
+ * @return true if adr->sf or adr->power changed
+ */
+static inline bool adrUplink(AdrState *adr)
+{
+	if (++adr->silent < ADR_LOST_LIMIT)
+	{
+		return false;
+	}
+	adr->silent = 0;
+	adr->count = 0;
+	adr->next = 0;
+	if (adr->power < adr->powerMax)
+	{
+		adr->power = adr->powerMax;
+	}
+	else if (adr->sf < adr->sfMax)
+	{
+		adr->sf++;
+	}
+	else
+	{
+		return false;
+	}
+	adr->changes++;
+	adr->fallbacks++;
+	return true;
+}
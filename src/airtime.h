@@ -0,0 +1,78 @@
+/**
+ * @file airtime.h
+ * @brief LoRa time on air, SX1261/2 datasheet 6.1.4
+ *
+ * constexpr in the single return style of C++11, the nRF52 core builds with
+ * -std=gnu++11, so frame lengths known at compile time give compile time
+ * constants. All times are in us. SF7..SF12, the low data rate optimisation
+ * is on where a symbol takes more than 16 ms, like SX126x-Arduino sets it.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Bandwidth in Hz of the SX126x-Arduino bandwidth index 0..2
+ */
+constexpr uint32_t airtimeBandwidthHz(uint8_t bw)
+{
+	return bw == 0 ? 125000UL : bw == 1 ? 250000UL : 500000UL;
+}
+
+/**
+ * @brief Symbol time, 2^sf / bandwidth
+ */
+constexpr uint32_t airtimeSymbolUs(uint8_t sf, uint8_t bw)
+{
+	return (uint32_t)((1ULL << sf) * 1000000ULL / airtimeBandwidthHz(bw));
+}
+
+constexpr bool airtimeLowDataRate(uint8_t sf, uint8_t bw)
+{
+	return airtimeSymbolUs(sf, bw) > 16000;
+}
+
+/**
+ * @brief Preamble time, preamble + 4.25 symbols
+ */
+constexpr uint32_t airtimePreambleUs(uint8_t sf, uint8_t bw, uint16_t preamble)
+{
+	return (uint32_t)((4ULL * preamble + 17) * airtimeSymbolUs(sf, bw) / 4);
+}
+
+constexpr int32_t airtimeCeilDiv(int32_t num, int32_t den)
+{
+	return num <= 0 ? 0 : (num + den - 1) / den;
+}
+
+/**
+ * @brief Symbols after the preamble: header, payload and CRC
+ *
+ * @param cr coding rate index, 1 = 4/5 .. 4 = 4/8
+ * @param implicitHeader fixed length frames without the explicit header
+ */
+constexpr uint32_t airtimePayloadSymbols(uint8_t sf, uint8_t bw, uint8_t cr, uint8_t len, bool crc, bool implicitHeader)
+{
+	return 8 + airtimeCeilDiv(8 * len - 4 * sf + 28 + (crc ? 16 : 0) - (implicitHeader ? 20 : 0),
+							  4 * (sf - (airtimeLowDataRate(sf, bw) ? 2 : 0))) *
+				   (cr + 4);
+}
+
+/**
+ * @brief Time on air of a len byte frame
+ */
+constexpr uint32_t airtimeUs(uint8_t sf, uint8_t bw, uint8_t cr, uint16_t preamble, uint8_t len, bool crc,
+							 bool implicitHeader)
+{
+	return airtimePreambleUs(sf, bw, preamble) +
+		   airtimePayloadSymbols(sf, bw, cr, len, crc, implicitHeader) * airtimeSymbolUs(sf, bw);
+}
+
+/**
+ * @brief Time on air in whole ms, rounded up, what the duty cycle is charged
+ */
+constexpr uint32_t airtimeMs(uint8_t sf, uint8_t bw, uint8_t cr, uint16_t preamble, uint8_t len, bool crc,
+							 bool implicitHeader)
+{
+	return (airtimeUs(sf, bw, cr, preamble, len, crc, implicitHeader) + 999) / 1000;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file batch.cpp
+ * @brief Ring buffer of the samples taken between two uplinks
+ *
+ * Every completed sample is stored in compact form, at send time the buffer
+ * is reduced to min/max/mean per environmental channel. The last sample
+ * itself goes out as the regular payload.
+ *
+ * BATCH_CAPACITY holds one SEND_INTERVAL at the LP rate. A longer interval
+ * set by command or a frame the duty cycle held back fills it. The oldest
+ * sample is then folded into a running min/max/sum instead of being lost,
+ * so the frame still covers every sample since the last one.
+ */
+#include "main.h"
+
+struct BatchSample
+{
+	int16_t ch[PAYLOAD_AGGREGATE_CHANNELS];
+};
+
+static BatchSample batchRing[BATCH_CAPACITY];
+static uint16_t batchHead = 0;  // next slot to write
+static uint16_t batchCount = 0; // valid samples, oldest at batchHead - batchCount
+
+/** Samples pushed out of the ring, older than all in it */
+static struct
+{
+	uint16_t count;
+	int32_t sum[PAYLOAD_AGGREGATE_CHANNELS];
+	int16_t lo[PAYLOAD_AGGREGATE_CHANNELS];
+	int16_t hi[PAYLOAD_AGGREGATE_CHANNELS];
+} batchSpill;
+
+/**
+ * @brief Fold a sample into batchSpill, it stops counting where the sample
+ * count of a frame would overflow
+ */
+static void batchFold(const BatchSample *s)
+{
+	if (batchSpill.count >= UINT16_MAX - BATCH_CAPACITY)
+	{
+		return;
+	}
+	for (uint8_t c = 0; c < PAYLOAD_AGGREGATE_CHANNELS; c++)
+	{
+		int16_t v = s->ch[c];
+		if (batchSpill.count == 0)
+		{
+			batchSpill.sum[c] = 0;
+			batchSpill.lo[c] = batchSpill.hi[c] = v;
+		}
+		batchSpill.sum[c] += v;
+		batchSpill.lo[c] = v < batchSpill.lo[c] ? v : batchSpill.lo[c];
+		batchSpill.hi[c] = v > batchSpill.hi[c] ? v : batchSpill.hi[c];
+	}
+	batchSpill.count++;
+}
+
+/**
+ * @brief Store the environmental channels of a completed payload, the oldest
+ * sample goes into batchSpill when the buffer is full
+ */
+void batchAdd(const TxdPayload *sample)
+{
+	BatchSample *s = &batchRing[batchHead];
+	if (batchCount == BATCH_CAPACITY)
+	{
+		batchFold(s);
+	}
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+		{
+			int32_t v = payloadChannel(sample, i);
+			s->ch[n++] = (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+		}
+	}
+	batchHead = (batchHead + 1) % BATCH_CAPACITY;
+	if (batchCount < BATCH_CAPACITY)
+	{
+		batchCount++;
+	}
+}
+
+/**
+ * @brief Reduce the buffered and folded samples to min/max/mean per channel
+ *
+ * @return uint16_t number of samples reduced, 0 if the buffer is empty
+ */
+uint16_t batchReduce(PayloadAggregate *agg)
+{
+	uint16_t total = batchSpill.count + batchCount;
+	agg->samples = total;
+	if (total == 0)
+	{
+		return 0;
+	}
+	int32_t sum[PAYLOAD_AGGREGATE_CHANNELS] = {0};
+	int16_t lo[PAYLOAD_AGGREGATE_CHANNELS];
+	int16_t hi[PAYLOAD_AGGREGATE_CHANNELS];
+	uint16_t idx = (batchHead + BATCH_CAPACITY - batchCount) % BATCH_CAPACITY;
+	for (uint8_t c = 0; c < PAYLOAD_AGGREGATE_CHANNELS; c++)
+	{
+		if (batchSpill.count)
+		{
+			sum[c] = batchSpill.sum[c];
+			lo[c] = batchSpill.lo[c];
+			hi[c] = batchSpill.hi[c];
+		}
+		else
+		{
+			lo[c] = hi[c] = batchRing[idx].ch[c];
+		}
+	}
+	for (uint16_t k = 0; k < batchCount; k++)
+	{
+		const BatchSample *s = &batchRing[idx];
+		for (uint8_t c = 0; c < PAYLOAD_AGGREGATE_CHANNELS; c++)
+		{
+			int16_t v = s->ch[c];
+			sum[c] += v;
+			lo[c] = v < lo[c] ? v : lo[c];
+			hi[c] = v > hi[c] ? v : hi[c];
+		}
+		idx = (idx + 1) % BATCH_CAPACITY;
+	}
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		agg->min[i] = agg->max[i] = agg->mean[i] = 0;
+		if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+		{
+			agg->min[i] = lo[n];
+			agg->max[i] = hi[n];
+			// Round half away from zero
+			int32_t half = sum[n] < 0 ? -(int32_t)(total / 2) : (int32_t)(total / 2);
+			agg->mean[i] = (sum[n] + half) / (int32_t)total;
+			n++;
+		}
+	}
+	return total;
+}
+
+/**
+ * @brief Drop the n oldest samples once they went out in a frame
+ * @note The folded samples are the oldest. Samples the ring pushed out after
+ * batchReduce() were reduced too, so n still covers all of them
+ */
+void batchDrop(uint16_t n)
+{
+	if (n >= batchSpill.count)
+	{
+		n -= batchSpill.count;
+		batchSpill.count = 0;
+	}
+	else
+	{
+		n = 0;
+	}
+	batchCount = n >= batchCount ? 0 : batchCount - n;
+}
@@ -1,22 +1,104 @@
 #include <Arduino.h> 
 #include "bsec.h"
 #include <main.h>
+#include <NVRAM.h>
 
 // Helper functions declarations
 void checkIaqSensorStatus(void);
+void loadBsecState(void);
+void updateBsecState(void);
+uint8_t stateChecksum(const uint8_t *blob, uint16_t len);
 void errLeds(void);
 
 // const uint8_t bsec_config_iaq[] = {
 // #include "config/generic_33v_3s_4d/bsec_iaq.txt"
 // };
-// #define STATE_SAVE_PERIOD	UINT32_C(360 * 60 * 1000) // 360 minutes - 4 times a day
-// uint8_t bsecState[BSEC_MAX_STATE_BLOB_SIZE] = {0};
+uint8_t bsecState[BSEC_MAX_STATE_BLOB_SIZE] = {0};
+
+/* State record in NVRAM: marker, blob length, blob, checksum. NVRAM only
+ * appends the cells that differ, so an unchanged calibration costs no flash. */
+#define BSEC_STATE_MARKER 0xB5
+#define BSEC_STATE_RECORD_SIZE (BSEC_MAX_STATE_BLOB_SIZE + 3)
+static uint8_t bsecStateStored[BSEC_STATE_RECORD_SIZE];
+static bool bsecStateSaved = false;
 
 // Create an object of the class Bsec
 Bsec iaqSensor;
 
 String output;
 
+/* Split measurement, see startBSEC()/finishBSEC().
+ * The Bsec wrapper only offers the blocking run(), so the forced-mode
+ * measurement is driven through the BSEC core and bme68x driver directly on
+ * a second handle that shares the wrapper's I2C callbacks. Outputs are still
+ * written to the iaqSensor fields so everything reading them keeps working. */
+static struct bme68x_dev bmeDev;
+static uint8_t bmeDevAddr = BME68X_I2C_ADDR_LOW;
+static bsec_bme_settings_t bmeSettings;
+static int64_t bsecNextCallMs = 0;
+static int64_t bsecMeasTimestamp = 0;
+static bool bsecMeasuringFlag = false;
+
+/* Sample rate of the subscription, a new one waits in bsecRatePending for
+ * the next startBSEC() outside a measurement */
+static bool bsecUlp = false;
+static bool bsecRatePending = false;
+
+/* BSEC output behind each payload channel it fills. The subscription is
+ * this table, so BSEC computes no output the payload does not carry. The IAQ
+ * output brings iaqAccuracy along, pressure is the raw BME68x reading. */
+struct BsecOutputField {
+  bsec_virtual_sensor_t output;
+  uint8_t channel; // PayloadChannelId
+};
+static constexpr BsecOutputField bsecOutputFields[] = {
+  {BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, PAYLOAD_CH_TEMPERATURE},
+  {BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, PAYLOAD_CH_HUMIDITY},
+  {BSEC_OUTPUT_IAQ, PAYLOAD_CH_IAQ},
+  {BSEC_OUTPUT_CO2_EQUIVALENT, PAYLOAD_CH_CO2},
+  {BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, PAYLOAD_CH_VOC},
+  {BSEC_OUTPUT_GAS_PERCENTAGE, PAYLOAD_CH_GAS},
+};
+#define BSEC_OUTPUT_FIELDS (sizeof(bsecOutputFields) / sizeof(bsecOutputFields[0]))
+/* Payload channels filled from elsewhere: battery, raw pressure, accelerometer */
+#define BSEC_OTHER_CHANNELS (1U << PAYLOAD_CH_BAT_PERC | 1U << PAYLOAD_CH_BAR_PRESS | \
+  1U << PAYLOAD_CH_INC_X | 1U << PAYLOAD_CH_INC_Y | 1U << PAYLOAD_CH_INC_Z)
+
+static constexpr uint32_t bsecFieldChannels(uint8_t i)
+{
+  return i == BSEC_OUTPUT_FIELDS ? 0 : (1U << bsecOutputFields[i].channel) | bsecFieldChannels(i + 1);
+}
+
+static constexpr uint8_t bsecBitCount(uint32_t mask)
+{
+  return mask ? (mask & 1) + bsecBitCount(mask >> 1) : 0;
+}
+
+static_assert(bsecBitCount(bsecFieldChannels(0)) == BSEC_OUTPUT_FIELDS, "bsec: two outputs fill one payload channel");
+static_assert((bsecFieldChannels(0) & BSEC_OTHER_CHANNELS) == 0, "bsec: an output fills a channel with another source");
+static_assert((bsecFieldChannels(0) | BSEC_OTHER_CHANNELS) == (1U << PAYLOAD_CHANNELS) - 1,
+              "bsec: a payload channel has no source, map it in bsecOutputFields");
+static_assert(BSEC_OUTPUT_FIELDS <= BSEC_NUMBER_OUTPUTS, "bsec: more outputs than BSEC has");
+
+/**
+ * @brief Subscribe the outputs of bsecOutputFields at the current sample rate
+ *
+ * @return uint8_t number of outputs subscribed
+ */
+uint8_t bsecSubscribe(void)
+{
+  bsec_sensor_configuration_t requested[BSEC_OUTPUT_FIELDS];
+  bsec_sensor_configuration_t required[BSEC_MAX_PHYSICAL_SENSOR];
+  uint8_t nRequired = BSEC_MAX_PHYSICAL_SENSOR;
+  for (uint8_t i = 0; i < BSEC_OUTPUT_FIELDS; i++) {
+    requested[i].sensor_id = bsecOutputFields[i].output;
+    requested[i].sample_rate = bsecUlp ? BSEC_SAMPLE_RATE_ULP : BSEC_SAMPLE_RATE_LP;
+  }
+  iaqSensor.bsecStatus = bsec_update_subscription(requested, BSEC_OUTPUT_FIELDS, required, &nRequired);
+  checkIaqSensorStatus();
+  return BSEC_OUTPUT_FIELDS;
+}
+
 void initBSEC()
 {
   /* Initializes the Serial communication */
@@ -26,69 +108,361 @@ void initBSEC()
   myLog_d("%s",output.c_str());
   checkIaqSensorStatus();
 
-  bsec_virtual_sensor_t sensorList[13] = {
-    BSEC_OUTPUT_IAQ,
-    BSEC_OUTPUT_STATIC_IAQ,
-    BSEC_OUTPUT_CO2_EQUIVALENT,
-    BSEC_OUTPUT_BREATH_VOC_EQUIVALENT,
-    BSEC_OUTPUT_RAW_TEMPERATURE,
-    BSEC_OUTPUT_RAW_PRESSURE,
-    BSEC_OUTPUT_RAW_HUMIDITY,
-    BSEC_OUTPUT_RAW_GAS,
-    BSEC_OUTPUT_STABILIZATION_STATUS,
-    BSEC_OUTPUT_RUN_IN_STATUS,
-    BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE,
-    BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY,
-    BSEC_OUTPUT_GAS_PERCENTAGE
-  };
-
-  iaqSensor.updateSubscription(sensorList, 13, BSEC_SAMPLE_RATE_LP);
+  bmeDev.intf = BME68X_I2C_INTF;
+  bmeDev.read = Bsec::i2cRead;
+  bmeDev.write = Bsec::i2cWrite;
+  bmeDev.delay_us = Bsec::delay_us;
+  bmeDev.intf_ptr = &bmeDevAddr;
+  bmeDev.amb_temp = 25;
+  iaqSensor.bme68xStatus = bme68x_init(&bmeDev);
   checkIaqSensorStatus();
+
+  loadBsecState();
+
+  bsecSubscribe();
+  bsecNextCallMs = 0;
+  bsecMeasuringFlag = false;
+  bsecRatePending = false;
+}
+
+/**
+ * @brief Switch between the LP (3 s) and ULP (300 s) sample rate, from the
+ * next startBSEC() on
+ */
+void bsecSetSampleRate(bool ulp)
+{
+  if (ulp != bsecUlp) {
+    bsecUlp = ulp;
+    bsecRatePending = true;
+  }
+}
+
+/**
+ * @brief Time between two samples at the current sample rate
+ */
+uint32_t bsecSamplePeriodMs(void)
+{
+  return bsecUlp ? BSEC_ULP_PERIOD_MS : BSEC_LP_PERIOD_MS;
+}
+
+/**
+ * @brief millis() at which BSEC wants the next startBSEC(), now while a new
+ * sample rate waits to be applied
+ */
+uint32_t bsecNextSampleMs(void)
+{
+  if (bsecRatePending) {
+    return millis();
+  }
+  return (uint32_t)bsecNextCallMs;
+}
+
+/**
+ * @brief Ask BSEC whether a sample is due and, if so, trigger a forced-mode
+ * measurement without waiting for it
+ *
+ * @return uint32_t milliseconds until finishBSEC() can collect the result,
+ * 0 if no measurement was started
+ */
+uint32_t startBSEC(void)
+{
+  if (bsecMeasuringFlag) {
+    return 0;
+  }
+  if (bsecRatePending) {
+    // BSEC starts over at the new rate, the first sample is due at once
+    bsecRatePending = false;
+    bsecSubscribe();
+    bsecNextCallMs = 0;
+  }
+
+  int64_t nowMs = iaqSensor.getTimeMs();
+  if (nowMs + BSEC_DUE_TOLERANCE_MS < bsecNextCallMs) {
+    return 0;
+  }
+  // A wakeup a few ticks early must not cost a whole sample period
+  bsecMeasTimestamp = (nowMs > bsecNextCallMs ? nowMs : bsecNextCallMs) * INT64_C(1000000);
+
+  iaqSensor.bsecStatus = bsec_sensor_control(bsecMeasTimestamp, &bmeSettings);
+  if (iaqSensor.bsecStatus < BSEC_OK) {
+    checkIaqSensorStatus();
+    return 0;
+  }
+  bsecNextCallMs = bmeSettings.next_call / INT64_C(1000000);
+  if (!bmeSettings.trigger_measurement) {
+    return 0;
+  }
+
+  struct bme68x_conf conf;
+  conf.os_hum = bmeSettings.humidity_oversampling;
+  conf.os_temp = bmeSettings.temperature_oversampling;
+  conf.os_pres = bmeSettings.pressure_oversampling;
+  conf.filter = BME68X_FILTER_OFF;
+  conf.odr = BME68X_ODR_NONE;
+  iaqSensor.bme68xStatus = bme68x_set_conf(&conf, &bmeDev);
+
+  struct bme68x_heatr_conf heatr = {};
+  heatr.enable = bmeSettings.run_gas;
+  heatr.heatr_temp = bmeSettings.heater_temperature;
+  heatr.heatr_dur = bmeSettings.heater_duration;
+  iaqSensor.bme68xStatus = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &heatr, &bmeDev);
+
+  iaqSensor.bme68xStatus = bme68x_set_op_mode(BME68X_FORCED_MODE, &bmeDev);
+  if (iaqSensor.bme68xStatus != BME68X_OK) {
+    checkIaqSensorStatus();
+    return 0;
+  }
+  bsecMeasuringFlag = true;
+
+  uint32_t measPeriod = bme68x_get_meas_dur(BME68X_FORCED_MODE, &conf, &bmeDev);
+  if (heatr.enable) {
+    measPeriod += (uint32_t)heatr.heatr_dur * 1000;
+  }
+  return (measPeriod + 999) / 1000;
+}
+
+/**
+ * @brief True between startBSEC() triggering a measurement and finishBSEC()
+ */
+bool bsecMeasuring(void)
+{
+  return bsecMeasuringFlag;
 }
 
-void readBSEC(uint8_t * t_int_pld, uint8_t * t_dec_pld, uint8_t * hum_int_pld, uint8_t * hum_dec_pld, uint16_t * press_pld,
+/**
+ * @brief Collect the measurement triggered by startBSEC(), run it through
+ * BSEC and put the results into the payload fields
+ *
+ * @return true if new data was written to the payload
+ */
+bool finishBSEC(int16_t * temp_pld, uint16_t * hum_pld, uint16_t * press_pld,
  uint16_t * iaq, uint8_t * iaqAccuracy, uint16_t * co2Equivalent, uint16_t * breathVocEquivalent, uint8_t * gasPercentage)
 {
-  myLog_d("BSEC read...");
-  delay(DEFWAIT);
-
-  //checkIaqSensorStatus();
-  myLog_d("Time: %i", iaqSensor.getLastTime());
-
-  if (iaqSensor.run()) { // If new data is available
-    unsigned long time_trigger = millis();
-    *t_int_pld = iaqSensor.temperature; //put integer part into container
-    *t_dec_pld = (iaqSensor.temperature- (*t_int_pld)) * 100; //put decimal part into container
-    *hum_int_pld = iaqSensor.humidity; //put integer part into container
-    *hum_dec_pld = (iaqSensor.humidity- (*hum_int_pld)) * 100; //put decimal part into container
-    double press = iaqSensor.pressure/100;
-    *press_pld = press; //put integer part into container
-    *iaq = iaqSensor.iaq;
-    *iaqAccuracy = iaqSensor.iaqAccuracy;
-    *co2Equivalent = iaqSensor.co2Equivalent;
-    *breathVocEquivalent = iaqSensor.breathVocEquivalent;
-    *gasPercentage = iaqSensor.gasPercentage;
-
-    //myLog_d("last time: %i", iaqSensor.getLastTime());
-    //myLog_d("time tr.: %i", time_trigger);
-    myLog_d("IAQ: %f, \tIAQ accuracy: %d, \tStatic IAQ: %f", iaqSensor.iaq, iaqSensor.iaqAccuracy, iaqSensor.staticIaq);
-    delay(DEFWAIT);
-    myLog_d("CO2 eq: %f, Breath VOC eq: %f, \traw T: %f", iaqSensor.co2Equivalent, iaqSensor.breathVocEquivalent, iaqSensor.rawTemperature);
-    delay(DEFWAIT);
-    myLog_d("Press: %f, \traw H: %f, \tgas R: %f", iaqSensor.pressure, iaqSensor.rawHumidity, iaqSensor.gasResistance);
+  if (!bsecMeasuringFlag) {
+    return false;
+  }
+  bsecMeasuringFlag = false;
+
+  struct bme68x_data data;
+  uint8_t nFields = 0;
+  iaqSensor.bme68xStatus = bme68x_get_data(BME68X_FORCED_MODE, &data, &nFields, &bmeDev);
+  if (nFields == 0) {
+    myLog_d("iaq Sensor not run");
+    checkIaqSensorStatus();
+    return false;
+  }
+
+  bsec_input_t inputs[BSEC_MAX_PHYSICAL_SENSOR];
+  uint8_t nInputs = 0;
+#ifdef BME68X_USE_FPU
+  float temperature = data.temperature;
+  float humidity = data.humidity;
+#else
+  float temperature = data.temperature / 100.0f;
+  float humidity = data.humidity / 1000.0f;
+#endif
+  if (bmeSettings.process_data & BSEC_PROCESS_TEMPERATURE) {
+    inputs[nInputs++] = {bsecMeasTimestamp, 0.0f, 1, BSEC_INPUT_HEATSOURCE};
+    inputs[nInputs++] = {bsecMeasTimestamp, temperature, 1, BSEC_INPUT_TEMPERATURE};
+  }
+  if (bmeSettings.process_data & BSEC_PROCESS_HUMIDITY) {
+    inputs[nInputs++] = {bsecMeasTimestamp, humidity, 1, BSEC_INPUT_HUMIDITY};
+  }
+  if (bmeSettings.process_data & BSEC_PROCESS_PRESSURE) {
+    inputs[nInputs++] = {bsecMeasTimestamp, (float)data.pressure, 1, BSEC_INPUT_PRESSURE};
+  }
+  if ((bmeSettings.process_data & BSEC_PROCESS_GAS) && (data.status & BME68X_GASM_VALID_MSK)) {
+    inputs[nInputs++] = {bsecMeasTimestamp, (float)data.gas_resistance, 1, BSEC_INPUT_GASRESISTOR};
+  }
+
+  bsec_output_t outputs[BSEC_NUMBER_OUTPUTS];
+  uint8_t nOutputs = BSEC_NUMBER_OUTPUTS;
+  iaqSensor.bsecStatus = bsec_do_steps(inputs, nInputs, outputs, &nOutputs);
+  if (iaqSensor.bsecStatus != BSEC_OK || nOutputs == 0) {
+    checkIaqSensorStatus();
+    return false;
+  }
+
+  for (uint8_t i = 0; i < nOutputs; i++) {
+    float signal = outputs[i].signal;
+    switch (outputs[i].sensor_id) {
+      case BSEC_OUTPUT_IAQ:
+        iaqSensor.iaq = signal;
+        iaqSensor.iaqAccuracy = outputs[i].accuracy;
+        break;
+      case BSEC_OUTPUT_CO2_EQUIVALENT:
+        iaqSensor.co2Equivalent = signal;
+        iaqSensor.co2Accuracy = outputs[i].accuracy;
+        break;
+      case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
+        iaqSensor.breathVocEquivalent = signal;
+        iaqSensor.breathVocAccuracy = outputs[i].accuracy;
+        break;
+      case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
+        iaqSensor.temperature = signal;
+        break;
+      case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
+        iaqSensor.humidity = signal;
+        break;
+      case BSEC_OUTPUT_GAS_PERCENTAGE:
+        iaqSensor.gasPercentage = signal;
+        break;
+      default:
+        break;
+    }
+  }
+
+  *temp_pld = fixedTemperature(iaqSensor.temperature);
+  *hum_pld = fixedHumidity(iaqSensor.humidity);
+#ifdef BME68X_USE_FPU
+  *press_pld = fixedPressure(data.pressure);
+#else
+  *press_pld = fixedPressurePa(data.pressure);
+#endif
+  *iaq = iaqSensor.iaq;
+  *iaqAccuracy = iaqSensor.iaqAccuracy;
+  *co2Equivalent = iaqSensor.co2Equivalent;
+  *breathVocEquivalent = iaqSensor.breathVocEquivalent;
+  *gasPercentage = iaqSensor.gasPercentage;
+
+  #if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
+    myLog_d("IAQ: %f, \tIAQ accuracy: %d", iaqSensor.iaq, iaqSensor.iaqAccuracy);
     delay(DEFWAIT);
-    myLog_d("Status: %f, \trunin status: %f, \tT (°C): %f", iaqSensor.stabStatus, iaqSensor.runInStatus, iaqSensor.temperature);
+    myLog_d("CO2 eq: %f, Breath VOC eq: %f", iaqSensor.co2Equivalent, iaqSensor.breathVocEquivalent);
     delay(DEFWAIT);
-    myLog_d("comp H (%): %f, \tgas %: %f", iaqSensor.humidity, iaqSensor.gasPercentage);
+    myLog_d("T (°C): %f, \tcomp H (%%): %f, \tgas %%: %f", iaqSensor.temperature, iaqSensor.humidity, iaqSensor.gasPercentage);
     delay(DEFWAIT);
-    myLog_d("Reading ok");
-  } else {
-    myLog_d("iaq Sensor not run");
-    checkIaqSensorStatus();
+  #endif
+  myLog_d("Reading ok");
+  updateBsecState();
+  return true;
+}
+
+/**
+ * @brief Blocking read, startBSEC() + wait + finishBSEC() in one call
+ */
+void readBSEC(int16_t * temp_pld, uint16_t * hum_pld, uint16_t * press_pld,
+ uint16_t * iaq, uint8_t * iaqAccuracy, uint16_t * co2Equivalent, uint16_t * breathVocEquivalent, uint8_t * gasPercentage)
+{
+  myLog_d("BSEC read...");
+  uint32_t wait = startBSEC();
+  if (wait == 0) {
+    return;
   }
+  delay(wait);
+  finishBSEC(temp_pld, hum_pld, press_pld, iaq, iaqAccuracy, co2Equivalent, breathVocEquivalent, gasPercentage);
 }
 
 // Helper function definitions
+uint8_t stateChecksum(const uint8_t *blob, uint16_t len)
+{
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < len; i++) {
+    sum = (uint8_t)((sum << 1) | (sum >> 7)) ^ blob[i];
+  }
+  return sum;
+}
+
+/**
+ * @brief Restore the BSEC calibration saved before the last reset
+ */
+void loadBsecState(void)
+{
+  bsecStateSaved = false;
+  NVRAM.read_block(bsecStateStored, BSEC_STATE_NVRAM_IDX, BSEC_STATE_RECORD_SIZE);
+  if (bsecStateStored[0] != BSEC_STATE_MARKER || bsecStateStored[1] != BSEC_MAX_STATE_BLOB_SIZE) {
+    myLog_d("No BSEC state in flash");
+    return;
+  }
+  if (bsecStateStored[BSEC_STATE_RECORD_SIZE - 1] != stateChecksum(&bsecStateStored[2], BSEC_MAX_STATE_BLOB_SIZE)) {
+    myLog_e("BSEC state in flash is corrupt");
+    return;
+  }
+  memcpy(bsecState, &bsecStateStored[2], BSEC_MAX_STATE_BLOB_SIZE);
+  iaqSensor.setState(bsecState);
+  if (iaqSensor.bsecStatus != BSEC_OK) {
+    // Left by a different BSEC version, start a fresh calibration instead
+    myLog_e("BSEC state rejected: %d", iaqSensor.bsecStatus);
+    iaqSensor.bsecStatus = BSEC_OK;
+    return;
+  }
+  myLog_d("BSEC state restored");
+}
+
+/**
+ * @brief Write the current BSEC state to flash if it differs from the stored one
+ */
+void saveBsecState(void)
+{
+  iaqSensor.getState(bsecState);
+  if (iaqSensor.bsecStatus != BSEC_OK) {
+    checkIaqSensorStatus();
+    return;
+  }
+  uint8_t record[BSEC_STATE_RECORD_SIZE];
+  record[0] = BSEC_STATE_MARKER;
+  record[1] = BSEC_MAX_STATE_BLOB_SIZE;
+  memcpy(&record[2], bsecState, BSEC_MAX_STATE_BLOB_SIZE);
+  record[BSEC_STATE_RECORD_SIZE - 1] = stateChecksum(bsecState, BSEC_MAX_STATE_BLOB_SIZE);
+
+  uint16_t changed = 0;
+  for (uint16_t i = 0; i < BSEC_STATE_RECORD_SIZE; i++) {
+    if (record[i] != bsecStateStored[i]) {
+      changed++;
+    }
+  }
+  bsecStateSaved = true;
+  if (changed == 0) {
+    return;
+  }
+  if (!NVRAM.write_block(record, BSEC_STATE_NVRAM_IDX, BSEC_STATE_RECORD_SIZE)) {
+    myLog_e("BSEC state save failed");
+    return;
+  }
+  memcpy(bsecStateStored, record, BSEC_STATE_RECORD_SIZE);
+  #if MYLOG_LOG_LEVEL >= MYLOG_LOG_LEVEL_DEBUG
+    // Wear is percent*100 of the rated erase cycles of the most used page, read only for the log
+    uint32_t wear = VirtualPage.wear_level();
+    myLog_d("BSEC state saved, %d bytes changed, flash wear %d.%02d %%", changed, wear / 100, wear % 100);
+  #endif
+}
+
+/**
+ * @brief One step of flash maintenance, at most one page erase
+ *
+ * Runs in idle time after a transmission. Erases released pages and starts
+ * a new page while a whole record still fits, so saveBsecState() never waits
+ * for an erase.
+ */
+void cleanUpBsecState(void)
+{
+  NVRAM.clean_up_step(BSEC_STATE_RECORD_SIZE);
+}
+
+/**
+ * @brief Save as soon as the IAQ is fully calibrated, refreshBsecState()
+ * keeps the saved state current from then on
+ */
+void updateBsecState(void)
+{
+  if (!bsecStateSaved && iaqSensor.iaqAccuracy >= 3) {
+    TRACE_BEGIN(TRACE_STATE_SAVE);
+    saveBsecState();
+    TRACE_END(TRACE_STATE_SAVE);
+  }
+}
+
+/**
+ * @brief Save again if a calibrated state was saved before, the scheduler
+ * calls it every STATE_SAVE_PERIOD
+ */
+void refreshBsecState(void)
+{
+  if (bsecStateSaved) {
+    saveBsecState();
+  }
+}
+
 void checkIaqSensorStatus(void)
 {
   myLog_d("Check IAQ sensor status...");
@@ -0,0 +1,90 @@
+/**
+ * @file command.cpp
+ * @brief Settings the gateway changes with a command downlink
+ *
+ * handleLoRaRx() hands every command downlink (PAYLOAD_DOWNLINK_COMMAND in
+ * payload.h) to handleCommand() in the loop task. Each setting of a frame for
+ * this node goes to the entry of its tag in commandTable, whose setter checks
+ * the range and applies the value. A setting that is unknown or out of range
+ * is rejected and the others of the frame still apply. Settings last until
+ * the next restart.
+ */
+#include "main.h"
+
+struct CommandEntry
+{
+	uint8_t tag;				   // PAYLOAD_CMD_*
+	bool (*apply)(uint32_t value); // false if the value is rejected
+};
+
+static bool applyRadioProfile(uint32_t value)
+{
+	return value <= UINT8_MAX && setRadioProfile(value);
+}
+
+static bool applyListen(uint32_t value)
+{
+	return value <= 1 && setRadioListen(value);
+}
+
+static const CommandEntry commandTable[] = {
+	{PAYLOAD_CMD_SEND_INTERVAL, setSendInterval},
+	{PAYLOAD_CMD_SLEEP_TIME, setSleepTime},
+	{PAYLOAD_CMD_BSEC_RATE, setBsecRate},
+	{PAYLOAD_CMD_RADIO_PROFILE, applyRadioProfile},
+	{PAYLOAD_CMD_LISTEN, applyListen},
+};
+
+static uint32_t commandFrames = 0;
+static uint32_t commandApplied = 0;
+static uint32_t commandRejected = 0;
+
+/**
+ * @brief Apply the settings of a command downlink for this node
+ *
+ * @param frame a frame payloadIsCommand() accepted
+ */
+void handleCommand(const uint8_t *frame, uint8_t size)
+{
+	if (frame[1] != NODEID)
+	{
+		return;
+	}
+	commandFrames++;
+	uint8_t pos = PAYLOAD_COMMAND_HEADER_SIZE;
+	PayloadCommand cmd;
+	while (payloadCommandNext(frame, size, &pos, &cmd))
+	{
+		bool applied = false;
+		for (uint8_t i = 0; i < sizeof(commandTable) / sizeof(commandTable[0]); i++)
+		{
+			if (commandTable[i].tag == cmd.tag)
+			{
+				applied = commandTable[i].apply(cmd.value);
+				break;
+			}
+		}
+		myLog_d("Command %d = %lu %s", cmd.tag, (unsigned long)cmd.value, applied ? "applied" : "rejected");
+		if (applied)
+		{
+			commandApplied++;
+		}
+		else
+		{
+			commandRejected++;
+		}
+	}
+}
+
+/**
+ * @brief Write the command counters since boot
+ *
+ * @param out called once per line, without line end
+ */
+void commandReport(void (*out)(const char *line))
+{
+	char line[96];
+	snprintf(line, sizeof(line), "command %lu frames, %lu settings applied, %lu rejected", (unsigned long)commandFrames,
+			 (unsigned long)commandApplied, (unsigned long)commandRejected);
+	out(line);
+}
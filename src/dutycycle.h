@@ -0,0 +1,112 @@
+/**
+ * @file dutycycle.h
+ * @brief Duty cycle budget of sendLoRa(), EU868 1 % over one hour
+ *
+ * The time on air of the last hour is kept in DUTY_SLOTS one minute slots
+ * plus the running one, so the sum covers at least the hour before now. A
+ * frame is charged to the slot in which it ends, it never drops out of the
+ * sum while part of it is still within the hour. sendLoRa() sends a frame
+ * only if it fits into DUTY_BUDGET_MS. Alarm frames leave
+ * DUTY_ALARM_RESERVE_MS for the scheduled uplinks, so a motion storm cannot
+ * starve them.
+ *
+ * The budget lives in RAM, a reboot starts with an empty hour.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/* ETSI EN 300 220 sub-band g1, 868.0..868.6 MHz: 1 % in any hour */
+#define DUTY_CYCLE_PERMILLE 10
+#define DUTY_WINDOW_MS 3600000UL
+#define DUTY_SLOTS 60
+#define DUTY_SLOT_MS (DUTY_WINDOW_MS / DUTY_SLOTS)
+#define DUTY_BUDGET_MS (DUTY_WINDOW_MS * DUTY_CYCLE_PERMILLE / 1000)
+/* Budget alarm frames leave for the scheduled uplinks */
+#define DUTY_ALARM_RESERVE_MS (DUTY_BUDGET_MS / 10)
+
+struct DutyCycle
+{
+	uint32_t slotStart;				 // millis() at the start of the running slot
+	uint32_t used;					 // sum of slotMs
+	uint16_t slotMs[DUTY_SLOTS + 1]; // ms on air per slot, [head] is the running one
+	uint8_t head;
+	bool started;
+	uint32_t blockedAlarm;	   // alarm frames held back
+	uint32_t blockedScheduled; // scheduled frames held back
+};
+
+static inline void dutyInit(DutyCycle *duty)
+{
+	memset(duty, 0, sizeof(*duty));
+}
+
+/**
+ * @brief Move the slots on to now, slots older than the hour drop out
+ */
+static inline void dutyAdvance(DutyCycle *duty, uint32_t now)
+{
+	if (!duty->started || now - duty->slotStart >= DUTY_SLOT_MS * (DUTY_SLOTS + 1))
+	{
+		// Nothing sent within the hour
+		memset(duty->slotMs, 0, sizeof(duty->slotMs));
+		duty->used = 0;
+		duty->head = 0;
+		duty->slotStart = now;
+		duty->started = true;
+		return;
+	}
+	while (now - duty->slotStart >= DUTY_SLOT_MS)
+	{
+		duty->slotStart += DUTY_SLOT_MS;
+		duty->head = (duty->head + 1) % (DUTY_SLOTS + 1);
+		duty->used -= duty->slotMs[duty->head];
+		duty->slotMs[duty->head] = 0;
+	}
+}
+
+/**
+ * @brief ms on air within the last hour
+ */
+static inline uint32_t dutyUsedMs(DutyCycle *duty, uint32_t now)
+{
+	dutyAdvance(duty, now);
+	return duty->used;
+}
+
+/**
+ * @brief True if a frame of ms on air fits into the budget, counts a frame
+ * that does not
+ *
+ * @param alarm alarm frames keep DUTY_ALARM_RESERVE_MS free
+ */
+static inline bool dutyAllow(DutyCycle *duty, uint32_t now, uint32_t ms, bool alarm)
+{
+	uint32_t limit = DUTY_BUDGET_MS - (alarm ? DUTY_ALARM_RESERVE_MS : 0);
+	if (dutyUsedMs(duty, now) + ms <= limit)
+	{
+		return true;
+	}
+	if (alarm)
+	{
+		duty->blockedAlarm++;
+	}
+	else
+	{
+		duty->blockedScheduled++;
+	}
+	return false;
+}
+
+/**
+ * @brief Charge a frame that ended at now
+ */
+static inline void dutyCharge(DutyCycle *duty, uint32_t now, uint32_t ms)
+{
+	dutyAdvance(duty, now);
+	uint32_t room = UINT16_MAX - duty->slotMs[duty->head];
+	ms = ms < room ? ms : room;
+	duty->slotMs[duty->head] += ms;
+	duty->used += ms;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file fixedpoint.h
+ * @brief Sensor readings to the fixed-point units of the payload
+ *
+ * Temperature in centi-degC (signed), humidity in centi-%RH, pressure in
+ * Pa/10. The float versions take BSEC or Adafruit driver outputs and stay in
+ * single precision, so they run on the FPU of the Cortex-M4F. The integer
+ * versions take the bme68x results of a BME68X_DO_NOT_USE_FPU build
+ * (centi-degC, milli-%RH, Pa) and use no floating point at all.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief v * scale rounded half away from zero and clamped to lo..hi, NaN
+ * gives lo
+ */
+static inline int32_t fixedScale(float v, float scale, int32_t lo, int32_t hi)
+{
+	float s = v * scale;
+	if (!(s > (float)lo))
+	{
+		return lo;
+	}
+	if (s >= (float)hi)
+	{
+		return hi;
+	}
+	return (int32_t)(s < 0.0f ? s - 0.5f : s + 0.5f);
+}
+
+/** degC to centi-degC */
+static inline int16_t fixedTemperature(float degC)
+{
+	return (int16_t)fixedScale(degC, 100.0f, INT16_MIN, INT16_MAX);
+}
+
+/** %RH to centi-%RH */
+static inline uint16_t fixedHumidity(float pct)
+{
+	return (uint16_t)fixedScale(pct, 100.0f, 0, 10000);
+}
+
+/** Pa to Pa/10 */
+static inline uint16_t fixedPressure(float pa)
+{
+	return (uint16_t)fixedScale(pa, 0.1f, 0, UINT16_MAX);
+}
+
+/** milli-%RH (bme68x integer compensation) to centi-%RH */
+static inline uint16_t fixedHumidityMilli(uint32_t milli)
+{
+	uint32_t centi = (milli + 5) / 10;
+	return (uint16_t)(centi > 10000 ? 10000 : centi);
+}
+
+/** Pa (bme68x integer compensation) to Pa/10 */
+static inline uint16_t fixedPressurePa(uint32_t pa)
+{
+	uint32_t v = (pa + 5) / 10;
+	return (uint16_t)(v > UINT16_MAX ? UINT16_MAX : v);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file lbt.h
+ * @brief Listen-before-talk retry policy of sendLoRa()/OnCadDone()
+ *
+ * A busy CAD is retried after a random backoff. The window starts at about
+ * the airtime of one frame and doubles with every retry up to
+ * LBT_BACKOFF_MAX_MS. The delay is drawn from the upper half of the window,
+ * so nodes that found the channel busy together spread out, and none retries
+ * right away. After LBT_RETRY_MAX busy CADs the frame is dropped.
+ *
+ * bench/lbt_contention_bench.cpp runs this same policy.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Busy CADs retried before the frame is dropped */
+#define LBT_RETRY_MAX 6
+/* Backoff window of the first retry, a 20 byte frame at SF7 is 57 ms on air */
+#define LBT_BACKOFF_MIN_MS 100
+/* Largest backoff window, 6 retries wait 6.3 s at most */
+#define LBT_BACKOFF_MAX_MS 3200
+
+/**
+ * @brief Outcome counters, one of sentFirst, sentRetried, dropped or
+ * superseded per frame
+ */
+struct LbtStats
+{
+	uint32_t sentFirst;	  // sent after the first CAD
+	uint32_t sentRetried; // sent after one or more busy CADs
+	uint32_t dropped;	  // LBT_RETRY_MAX + 1 busy CADs
+	uint32_t superseded;  // a new frame arrived while this one backed off
+	uint32_t busy;		  // busy CADs
+	uint32_t txTimeout;	  // sent, but the radio reported a TX timeout
+};
+
+/**
+ * @brief Delay before CAD retry number retry (0 = first retry)
+ *
+ * @param rnd any random number
+ */
+static inline uint32_t lbtBackoffMs(uint8_t retry, uint32_t rnd)
+{
+	uint32_t window = LBT_BACKOFF_MAX_MS;
+	if (retry < 16 && ((uint32_t)LBT_BACKOFF_MIN_MS << retry) < LBT_BACKOFF_MAX_MS)
+	{
+		window = (uint32_t)LBT_BACKOFF_MIN_MS << retry;
+	}
+	return window / 2 + rnd % (window / 2);
+}
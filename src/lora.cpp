@@ -11,31 +11,29 @@
 
 #include "main.h"
 
-// Define LoRa parameters
-#define RF_FREQUENCY 868300000	// Hz
-#define TX_OUTPUT_POWER 22		// dBm
-#define LORA_BANDWIDTH 0		// [0: 125 kHz, 1: 250 kHz, 2: 500 kHz, 3: Reserved]
-#define LORA_SPREADING_FACTOR 7 // [SF7..SF12]
-#define LORA_CODINGRATE 1		// [1: 4/5, 2: 4/6,  3: 4/7,  4: 4/8]
-#define LORA_PREAMBLE_LENGTH 8	// Same for Tx and Rx
-#define LORA_SYMBOL_TIMEOUT 0	// Symbols
+// Define LoRa parameters, channel and modulation come from the radio profile (radioprofile.h),
+// RADIO_PROFILE until a downlink command picks another one of radioProfiles
+static const RadioProfile *radioProfile = &RADIO_PROFILE;
 #define LORA_FIX_LENGTH_PAYLOAD_ON false
 #define LORA_IQ_INVERSION_ON false
-#define RX_TIMEOUT_VALUE 3000
-#define TX_TIMEOUT_VALUE 3000
-
-#define TSYM ((2^LORA_SPREADING_FACTOR)/125)*1000
-#define TPREAMBLE (LORA_PREAMBLE_LENGTH+4.25)*TSYM
-#define RXtime (2*TSYM)
-#define SLEEPtime (TPREAMBLE-RXtime)+(8*TSYM)
-
+// Bytes of the frame the debug log shows before a send
+#define LORA_DUMP_BYTES 32
+// Longest frame handed to the radio, a chain frame grows by one record per hop
+#ifdef IS_CHAIN_ELEMENT
+#define LORA_MAX_FRAME PAYLOAD_CHAIN_MAX_SIZE
+// Own frames of a chain element are a chain of one record, forwards go out of their RX pool slot
+#define LORA_TX_FRAME (PAYLOAD_CHAIN_HEADER_SIZE + PAYLOAD_CHAIN_RECORD_HEADER_SIZE + PAYLOAD_MAX_SIZE)
+#else
+#define LORA_MAX_FRAME PAYLOAD_MAX_SIZE
+#define LORA_TX_FRAME PAYLOAD_MAX_SIZE
+#endif
 
-// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-// to catch incoming data packages
-// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-uint32_t duty_cycle_rx_time = 17 * 15.625; //4 symbols = 17  [DURATION OF rx Preamble SYMBOLS IN us / 15.625 ^2 ]
-uint32_t duty_cycle_sleep_time = 1385 * 15.625; //338 symbols = 1385
+/** Listen with the RX duty cycle between frames, TX_ONLY nodes sleep until a command turns it on */
+#ifdef TX_ONLY
+static bool rxListen = false;
+#else
+static bool rxListen = true;
+#endif
 
 // DIO1 pin on RAK4631
 #define PIN_LORA_DIO_1 47
@@ -48,13 +46,161 @@ void OnTxTimeout(void);
 void OnRxTimeout(void);
 void OnRxError(void);
 void OnCadDone(bool cadResult);
+static void startCad(void);
+static void applyLinkConfig(void);
+static void radioIdle(void);
+static void onUplinkDone(void);
+#ifdef PAYLOAD_RETX
+static void resendLoRa(uint16_t seq, uint16_t missing);
+#endif
+#ifdef IS_CHAIN_ELEMENT
+static void chainForward(RxSlot *slot);
+static void chainRelease(void);
+#endif
+void cadRetryWakeup(TimerHandle_t unused);
 
 time_t cadTime;
+/** Start of the first CAD of the frame */
 time_t channelTimeout;
+/** Busy CADs of the frame so far */
 uint8_t channelFreeRetryNum = 0;
+/** A frame waits in backoff for cadRetryTimer */
+static volatile bool cadRetryPending = false;
+/** millis() at which the backoff of the pending frame ends */
+static volatile uint32_t cadRetryAt = 0;
+/** A flash clean-up step is due, signalled once the link RX window is over */
+static volatile bool flashGcDue = false;
+/** One-shot timer of the next CAD attempt, the loop task sleeps meanwhile */
+static SoftwareTimer cadRetryTimer;
+LbtStats lbtStats;
+/** Time on air of the last hour, EU868 1 % */
+DutyCycle dutyCycle;
+/** Time on air of the frame handed to the radio, charged when it ends */
+static uint32_t txAirtimeMs = 0;
+
+/** Link adaptation, the SF and power the gateway's feedback asks for */
+static AdrState adr;
+/** Frames the RX callback hands to handleLoRaRx() */
+static RxPool rxPool;
+
+/** SF and power the radio is configured with, 0 before the first SetTxConfig() */
+static uint8_t radioSf = 0;
+static int8_t radioPower = 0;
+/** RX window after an uplink, for the gateway's answer on the SF it is sent at */
+static uint32_t linkWindow = 0;
+/** Uplink the next link feedback must refer to, and its power */
+static uint16_t linkSeq;
+static int8_t linkPower;
+static bool linkSent = false;
+
+#ifdef PAYLOAD_COMPACT
+/** Frame handed to the radio and the payload it was encoded from */
+static uint8_t txFrame[LORA_TX_FRAME];
+static uint8_t txFrameLen = 0;
+static TxdPayload txFramePayload;
+static uint16_t txFrameSamples = 0;
+#ifndef IS_CHAIN_ELEMENT
+/** Last payload that went out, the delta reference once the gateway has it */
+static TxdPayload txSentPayload;
+/** Last payload the gateway acknowledged, the receiver decodes deltas against it */
+static TxdPayload txRefPayload;
+static bool txRefValid = false;
+static uint8_t txFramesSinceKey = 0;
+#endif
+#endif
+
+#ifdef PAYLOAD_RETX
+/** Key frames of the last uplinks, for the gateway's gap reports */
+static RetxQueue retx;
+/** txFrame holds resent uplinks, not a new one */
+static volatile bool txRetx = false;
+/** Uplinks skipped, resent ones were in CAD or on air */
+static uint32_t retxSkipped = 0;
+#endif
+
+#ifdef IS_CHAIN_ELEMENT
+/** RX pool slot of the previous node's chain frame on its way to the next
+ * node, sent instead of txFrame. NULL while no forward is in CAD, backoff or
+ * on air */
+static RxSlot *volatile txSlot = NULL;
+/** A frame, this node's or a forward, is in CAD or on air and holds the
+ * radio and txFrame. Set by startCad(), cleared by radioFree() */
+static volatile bool txBusy = false;
+/** Chain frame that came in while txBusy was set, it waits in its RX pool
+ * slot and handleLoRaRx() forwards it once the radio is free */
+static RxSlot *chainHeld = NULL;
+/** The forward in txSlot carries this node's record */
+static bool txForwardRecord = false;
+/** A forward carried this node's record since its last scheduled frame */
+static bool chainCarried = false;
+static struct
+{
+	uint32_t forwarded;	 // chain frames sent on
+	uint32_t full;		 // of those without this node's record, it did not fit
+	uint32_t ignored;	 // chain frames of other nodes than NODEID-1
+	uint32_t held;		 // chain frames that waited for a frame in CAD or on air
+	uint32_t busy;		 // chain frames dropped, another one was already waiting
+	uint32_t saved;		 // scheduled frames a forward made unnecessary
+	uint32_t turnaround; // longest RX done to radio send of a forward, ms
+} chainStats;
+#endif
+
+#ifdef PAYLOAD_COMPACT
+/**
+ * @brief The frame to send, a forward's RX pool slot or txFrame
+ */
+static uint8_t *txData(void)
+{
+#ifdef IS_CHAIN_ELEMENT
+	RxSlot *slot = txSlot;
+	if (slot != NULL)
+	{
+		return slot->frame;
+	}
+#endif
+	return txFrame;
+}
+#endif
+
+/**
+ * @brief Profile P, an invalid profile does not compile
+ */
+template <const RadioProfile &P>
+constexpr const RadioProfile *checkedProfile(void)
+{
+	static_assert(P.sf >= 7 && P.sf <= 12, "radio profile: SF7..SF12");
+	static_assert(P.bandwidth <= 2, "radio profile: bandwidth 0..2, 125..500 kHz");
+	static_assert(P.codingRate >= 1 && P.codingRate <= 4, "radio profile: coding rate 1..4, 4/5..4/8");
+	static_assert(P.preamble >= 6, "radio profile: preamble of 6 symbols or more");
+	static_assert(P.txPower >= -9 && P.txPower <= 22, "radio profile: SX1262 output power -9..22 dBm");
+	static_assert(P.lowEdgeHz() >= RADIO_SUBBAND_LOW_HZ && P.highEdgeHz() <= RADIO_SUBBAND_HIGH_HZ,
+				  "radio profile: channel outside the 868.0..868.6 MHz sub-band of the duty cycle budget");
+	static_assert(P.frameMs(LORA_MAX_FRAME) < P.txTimeoutMs, "radio profile: TX timeout below the longest frame");
+#ifndef TX_ONLY
+	// AN1200.36: the preamble must span a sleep period and two listen windows to be caught
+	static_assert(P.preamble >= P.rxDutySleepSymbols + 2 * P.rxDutyRxSymbols,
+				  "radio profile: preamble shorter than the RX duty cycle, receivers miss frames");
+#endif
+	static_assert(P.rxDutyRxTicks() > 0 && P.rxDutySleepTicks() > 0 && P.rxDutySleepTicks() < (1UL << 24),
+				  "radio profile: RX duty cycle periods out of the 24 bit SX126x range");
+	return &P;
+}
+
+#ifndef IS_CHAIN_ELEMENT
+/** Profiles PAYLOAD_CMD_RADIO_PROFILE picks from, by index. Chain elements
+ * keep the one profile all nodes of the chain share */
+static const RadioProfile *const radioProfiles[] = {
+	checkedProfile<radioProfileDefault>(),	 // 0
+	checkedProfile<radioProfileLongRange>(),	 // 1
+	checkedProfile<radioProfileLowLatency>(), // 2
+	checkedProfile<radioProfileChain>(),		 // 3
+};
+#endif
 
 bool initLoRa(void)
 {
+	radioProfile = checkedProfile<RADIO_PROFILE>();
+
 	// Initialize library
 	if (lora_rak4630_init() == 1)
 	{
@@ -70,31 +216,99 @@ bool initLoRa(void)
 	RadioEvents.CadDone = OnCadDone;
 
 	Radio.Init(&RadioEvents);
+	rxPoolInit(&rxPool);
+#ifdef PAYLOAD_RETX
+	retxInit(&retx);
+#endif
+	dutyInit(&dutyCycle);
+	cadRetryTimer.begin(LBT_BACKOFF_MIN_MS, cadRetryWakeup, NULL, false);
 
 	Radio.Sleep(); // Radio.Standby();
 
-	Radio.SetChannel(RF_FREQUENCY);
+	Radio.SetChannel(radioProfile->frequency);
 
-	Radio.SetTxConfig(MODEM_LORA, TX_OUTPUT_POWER, 0, LORA_BANDWIDTH,
-					  LORA_SPREADING_FACTOR, LORA_CODINGRATE,
-					  LORA_PREAMBLE_LENGTH, LORA_FIX_LENGTH_PAYLOAD_ON,
-					  true, 0, 0, LORA_IQ_INVERSION_ON, TX_TIMEOUT_VALUE);
+	// Full power until the gateway reports the link
+	adrInit(&adr, radioProfile->sf, radioProfile->txPower);
+	radioSf = 0;
+	applyLinkConfig();
 
-	Radio.SetRxConfig(MODEM_LORA, LORA_BANDWIDTH, LORA_SPREADING_FACTOR,
-					  LORA_CODINGRATE, 0, LORA_PREAMBLE_LENGTH,
-					  LORA_SYMBOL_TIMEOUT, LORA_FIX_LENGTH_PAYLOAD_ON,
-					  0, true, 0, 0, LORA_IQ_INVERSION_ON, true);
+	radioIdle();
+	return true;
+}
 
-#ifdef TX_ONLY
-	Radio.Sleep();
+/**
+ * @brief Switch to profile index of radioProfiles, from the next frame on
+ * @note Link adaptation starts over at the profile's SF and full power
+ *
+ * @return false for an unknown index or a chain element
+ */
+bool setRadioProfile(uint8_t index)
+{
+#ifdef IS_CHAIN_ELEMENT
+	(void)index;
+	return false;
+#else
+	if (index >= sizeof(radioProfiles) / sizeof(radioProfiles[0]))
+	{
+		return false;
+	}
+#ifdef PAYLOAD_RETX
+	// A resend in CAD or on air keeps the radio's configuration
+	if (txRetx)
+	{
+		return false;
+	}
+#endif
+	const RadioProfile *target = radioProfiles[index];
+	// The next uplink goes out with the new profile, a later command downlink
+	// needs the window for its SF and preamble, not that of the old one
+	linkWindow = target->linkWindowMs(target->sf);
+	radioProfile = target;
+	myLog_d("Radio profile %d, SF%d", index, radioProfile->sf);
+	Radio.Sleep(); // Radio.Standby();
+	Radio.SetChannel(radioProfile->frequency);
+	adrInit(&adr, radioProfile->sf, radioProfile->txPower);
+	linkSent = false;
+	radioSf = 0;
+	applyLinkConfig();
+	radioIdle();
+	return true;
+#endif
+}
+
+/**
+ * @brief Listen with the RX duty cycle between frames, or sleep and only
+ * hear the window after each uplink
+ *
+ * @return false for a chain element asked to stop, it always listens
+ */
+bool setRadioListen(bool on)
+{
+#ifdef IS_CHAIN_ELEMENT
+	return on;
 #else
+	rxListen = on;
+	radioIdle();
+	return true;
+#endif
+}
+
+/**
+ * @brief Put the radio into its state between frames
+ */
+static void radioIdle(void)
+{
+	if (!rxListen)
+	{
+		Radio.Sleep(); // Radio.Standby();
+		return;
+	}
 	// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
 	// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
 	// to catch incoming data packages
 	// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-	Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
-#endif
-	return true;
+	// Listen window and sleep time in 15.625 us steps, 4 and 330 symbols at SF7
+	Radio.SetRxDutyCycle(radioProfile->rxDutyRxTicks(), radioProfile->rxDutySleepTicks());
 }
 
 /**
@@ -104,129 +318,614 @@ bool initLoRa(void)
 void sendLoRa()
 {
 	myLog_d("Start sendLoRa");
-	// Prepare LoRa CAD
-	Radio.Sleep(); // Radio.Standby();
-	Radio.SetCadParams(LORA_CAD_08_SYMBOL, LORA_SPREADING_FACTOR + 13, 10, LORA_CAD_ONLY, 0);
-	cadTime = millis();
+#ifdef IS_CHAIN_ELEMENT
+	// A forward on its way holds the radio and this node's record, a scheduled
+	// frame after one adds nothing
+	if (txSlot != NULL || (chainCarried && !txPayload.accAlarm))
+	{
+		myLog_d("Chain: record forwarded, frame skipped");
+		chainCarried = false;
+		chainStats.saved++;
+		return;
+	}
+	chainCarried = false;
+#endif
+#ifdef PAYLOAD_RETX
+	// Resent uplinks hold txFrame for one frame time, the samples go with the next frame
+	if (txRetx && !cadRetryPending)
+	{
+		myLog_d("Resend on its way, frame skipped");
+		retxSkipped++;
+		return;
+	}
+	txRetx = false;
+#endif
+#ifdef PAYLOAD_COMPACT
+	txFramePayload = txPayload;
+	const PayloadAggregate *aggregate = NULL;
+#ifdef PAYLOAD_BATCH
+	PayloadAggregate agg;
+	txFrameSamples = batchReduce(&agg);
+	aggregate = txFrameSamples ? &agg : NULL;
+#endif
+#ifdef IS_CHAIN_ELEMENT
+	// Chain records are key frames, a lost forward must not break the next delta
+	txFrameLen = payloadChainAppend(txFrame, payloadChainStart(txFrame, NODEID), sizeof(txFrame), &txFramePayload,
+									aggregate, &accShock, 0, 0);
+#else
+	// A delta only against the uplink right before, acknowledged: the receiver
+	// keeps the last frame it decoded, and a missed uplink or feedback leaves
+	// it unknown which one that is
+	bool keyFrame = !txRefValid || txRefPayload.sentPackets != (uint16_t)(txFramePayload.sentPackets - 1) ||
+					txFramesSinceKey >= (PAYLOAD_KEYFRAME_INTERVAL - 1);
+	txFrameLen = payloadEncode(&txFramePayload, keyFrame ? NULL : &txRefPayload, aggregate, &accShock, txFrame);
+#ifdef PAYLOAD_RETX
+	// Kept as a key frame, the gateway has no delta reference for an uplink it missed
+	RetxEntry *kept = retxPut(&retx, txFramePayload.sentPackets);
+	if (keyFrame)
+	{
+		memcpy(kept->frame, txFrame, txFrameLen);
+		kept->len = txFrameLen;
+	}
+	else
+	{
+		kept->len = payloadEncode(&txFramePayload, NULL, aggregate, &accShock, kept->frame);
+	}
+#endif
+#endif
+	uint8_t frameLen = txFrameLen;
+#else
+	uint8_t frameLen = PAYLOAD_LEGACY_SIZE;
+#endif
+	// Over the duty cycle budget the frame is not sent, batched samples wait for the next one
+	uint32_t airMs = airtimeMs(adr.sf, radioProfile->bandwidth, radioProfile->codingRate, radioProfile->preamble, frameLen,
+							   true, LORA_FIX_LENGTH_PAYLOAD_ON);
+	if (!dutyAllow(&dutyCycle, millis(), airMs, txPayload.accAlarm))
+	{
+		myLog_d("Duty cycle: %ldms on air in the last hour, %ldms frame held back",
+				(long)dutyUsedMs(&dutyCycle, millis()), (long)airMs);
+		// A frame in backoff would send the new contents of txFrame, it goes too
+		if (cadRetryPending)
+		{
+			cadRetryTimer.stop();
+			cadRetryPending = false;
+			lbtStats.superseded++;
+		}
+		return;
+	}
+
+	// A frame still backing off is replaced by the new one
+	if (cadRetryPending)
+	{
+		cadRetryTimer.stop();
+		cadRetryPending = false;
+		lbtStats.superseded++;
+	}
+	channelFreeRetryNum = 0;
 	channelTimeout = millis();
+	linkSent = false;
 
 	// Switch on Indicator lights
 	#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
 		digitalWrite(LED_CONN, HIGH);
 	#endif
 
+	startCad();
+	myLog_d("out of sendLoRa");
+}
+
+/**
+ * @brief Start a CAD for the frame in txFrame, first attempt or after backoff
+ */
+static void startCad(void)
+{
+	// Prepare LoRa CAD
+	Radio.Sleep(); // Radio.Standby();
+	applyLinkConfig();
+	Radio.SetCadParams(LORA_CAD_08_SYMBOL, radioSf + 13, 10, LORA_CAD_ONLY, 0);
+	cadTime = millis();
+#ifdef IS_CHAIN_ELEMENT
+	txBusy = true;
+#endif
+
 	myLog_d("Start CAD");
 	// Start CAD
+	TRACE_BEGIN(TRACE_CAD);
 	Radio.StartCad();
-	myLog_d("out of sendLoRa");
 }
 
 /**
- * @brief Function to be executed on Radio Tx Done event
+ * @brief Configure the radio for the SF and power of the link adaptation,
+ * only if they changed since the last call
+ * @note Called with the radio asleep. The RX duty cycle timing stays the
+ * one of the radio profile's SF
  */
-void OnTxDone(void)
+static void applyLinkConfig(void)
 {
-	myLog_d("OnTxDone\n");
-	nodeSentPackets ++;
+	if (adr.sf == radioSf && adr.power == radioPower)
+	{
+		return;
+	}
+	myLog_d("Link config SF%d %d dBm", adr.sf, adr.power);
+	Radio.SetTxConfig(MODEM_LORA, adr.power, 0, radioProfile->bandwidth,
+					  adr.sf, radioProfile->codingRate,
+					  radioProfile->preamble, LORA_FIX_LENGTH_PAYLOAD_ON,
+					  true, 0, 0, LORA_IQ_INVERSION_ON, radioProfile->txTimeoutMs);
+	if (adr.sf != radioSf)
+	{
+		// The gateway answers on the SF of the uplink
+		Radio.SetRxConfig(MODEM_LORA, radioProfile->bandwidth, adr.sf,
+						  radioProfile->codingRate, 0, radioProfile->preamble,
+						  radioProfile->symbolTimeout, LORA_FIX_LENGTH_PAYLOAD_ON,
+						  0, true, 0, 0, LORA_IQ_INVERSION_ON, true);
+		linkWindow = radioProfile->linkWindowMs(adr.sf);
+	}
+	radioSf = adr.sf;
+	radioPower = adr.power;
+}
 
-#ifdef TX_ONLY
-	Radio.Sleep();
+/**
+ * @brief Take the gateway's link feedback if it is for the last uplink of
+ * this node
+ * @note Chain elements send to the next node, not to the gateway that
+ * measured the link, and stay at full power
+ */
+static void onLinkFeedback(const PayloadLink *link)
+{
+#ifdef IS_CHAIN_ELEMENT
+	(void)link;
 #else
-	// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-	// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-	// to catch incoming data packages
-	// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-	Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
+	if (link->id != NODEID || !linkSent || link->seq != linkSeq)
+	{
+		myLog_d("Link feedback for node %d seq %d ignored", link->id, link->seq);
+		return;
+	}
+	linkSent = false;
+#ifdef PAYLOAD_COMPACT
+	// The gateway has this uplink, a gap report too
+	if (txSentPayload.sentPackets == link->seq)
+	{
+		txRefPayload = txSentPayload;
+		txRefValid = true;
+	}
 #endif
+	if (adrFeedback(&adr, link->rssi, link->snr, linkPower))
+	{
+		myLog_d("Link RSSI %d dBm SNR %d dB, next uplink SF%d %d dBm", link->rssi, link->snr, adr.sf, adr.power);
+	}
+#ifdef PAYLOAD_RETX
+	if (link->missing)
+	{
+		resendLoRa(link->seq, link->missing);
+	}
+#endif
+#endif
+}
 
-	// Switch off the indicator lights
-#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
-	digitalWrite(LED_CONN, LOW);
+#ifdef PAYLOAD_RETX
+/**
+ * @brief Send the uplinks a gap report for seq lists as missing again, as
+ * many as fit into one chain frame, the rest goes with the next gap report
+ * @note Runs in the loop task for the feedback of the last uplink, no other
+ * frame has been started since
+ */
+static void resendLoRa(uint16_t seq, uint16_t missing)
+{
+	RetxEntry *missed[RETX_QUEUE];
+	uint8_t n = retxCollect(&retx, seq, missing, missed);
+	uint8_t len = payloadChainStart(txFrame, NODEID);
+	uint8_t records = 0;
+	for (; records < n; records++)
+	{
+		uint8_t next = payloadChainAppendFrame(txFrame, len, sizeof(txFrame), missed[records]->frame,
+											   missed[records]->len, 0, 0);
+		if (next == 0)
+		{
+			break;
+		}
+		len = next;
+	}
+	if (records == 0)
+	{
+		return;
+	}
+	// Resent uplinks are scheduled traffic, they leave the alarm reserve alone
+	uint32_t airMs = airtimeMs(adr.sf, radioProfile->bandwidth, radioProfile->codingRate, radioProfile->preamble, len,
+							   true, LORA_FIX_LENGTH_PAYLOAD_ON);
+	if (!dutyAllow(&dutyCycle, millis(), airMs, false))
+	{
+		myLog_d("Duty cycle: %d resent uplinks held back", records);
+		return;
+	}
+	myLog_d("Resending %d of %d missing uplinks", records, n);
+	for (uint8_t i = 0; i < records; i++)
+	{
+		missed[i]->tries++;
+	}
+	retx.resent += records;
+	txFrameLen = len;
+	txRetx = true;
+	channelFreeRetryNum = 0;
+	channelTimeout = millis();
+	startCad();
+}
 #endif
+
+/**
+ * @brief Timer event of the end of the backoff, wakes the loop task with
+ * TASK_FLAG_CAD_RETRY so the CAD starts there and not beside sendLoRa()
+ * 
+ * @param unused 
+ */
+void cadRetryWakeup(TimerHandle_t unused)
+{
+	(void)unused;
+	taskSignal(TASK_FLAG_CAD_RETRY);
 }
 
-/**@brief Function to be executed on Radio Rx Done event
+/**
+ * @brief Start the CAD of the frame in backoff, called by the loop task on
+ * TASK_FLAG_CAD_RETRY. A wakeup of a backoff that sendLoRa() has replaced
+ * since finds no pending frame, or one whose own backoff is not over yet
  */
-void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
+void handleCadRetry(void)
 {
-	/*if the node is a chain element, start receive processing
-	else, skip*/
-	#ifdef IS_CHAIN_ELEMENT
-		myLog_d("OnRxDone");
-		//delay(DEFWAIT);
-		eventType = 0;
-		// Notify task about the event
-		if (taskEvent != NULL)
+	if (!cadRetryPending || (int32_t)(millis() - cadRetryAt) < 0)
+	{
+		return;
+	}
+	cadRetryPending = false;
+	startCad();
+}
+
+/**
+ * @brief Write the listen-before-talk, duty cycle and RX pool counters since
+ * boot
+ *
+ * @param out called once per line, without line end
+ */
+void lbtReport(void (*out)(const char *line))
+{
+	char line[96];
+	snprintf(line, sizeof(line), "lbt sent %lu first, %lu retried, %lu dropped, %lu superseded",
+			 (unsigned long)lbtStats.sentFirst, (unsigned long)lbtStats.sentRetried,
+			 (unsigned long)lbtStats.dropped, (unsigned long)lbtStats.superseded);
+	out(line);
+	snprintf(line, sizeof(line), "lbt %lu busy CADs, %lu TX timeouts", (unsigned long)lbtStats.busy,
+			 (unsigned long)lbtStats.txTimeout);
+	out(line);
+	snprintf(line, sizeof(line), "duty cycle %lu ms on air last hour, held back %lu alarm %lu scheduled",
+			 (unsigned long)dutyUsedMs(&dutyCycle, millis()), (unsigned long)dutyCycle.blockedAlarm,
+			 (unsigned long)dutyCycle.blockedScheduled);
+	out(line);
+	snprintf(line, sizeof(line), "rx %lu frames, %lu overruns, longest wait %lu ms", (unsigned long)rxPool.received,
+			 (unsigned long)rxPool.overruns, (unsigned long)rxPool.maxWait);
+	out(line);
+}
+
+/**
+ * @brief Handle the frames OnRxDone() put into the RX pool, in the loop task
+ * @note Link feedback is taken at once, a chain element forwards a chain
+ * frame out of its slot and keeps the slot until the forward is over, or
+ * until the radio is free if it is busy with another frame
+ */
+void handleLoRaRx(void)
+{
+	RxSlot *slot;
+#ifdef IS_CHAIN_ELEMENT
+	// The chain frame held back while the radio was busy goes first
+	if (chainHeld != NULL && !txBusy)
+	{
+		slot = chainHeld;
+		chainHeld = NULL;
+		chainForward(slot);
+	}
+#endif
+	while ((slot = rxPoolTake(&rxPool, millis())) != NULL)
+	{
+		PayloadLink link;
+		if (payloadDecodeLink(slot->frame, slot->len, &link))
+		{
+			onLinkFeedback(&link);
+		}
+		else if (payloadIsCommand(slot->frame, slot->len))
 		{
-			xSemaphoreGive(taskEvent);
+			handleCommand(slot->frame, slot->len);
 		}
-		
-		int rcvRxPayloadIndex = size / sizeof(txPayload); //dynamic index of received payload
-		uint8_t PldBuffer [size]; //create received pld buffer
-		memcpy(&PldBuffer[0], payload, size); //copy content into buffer 
-		uint8_t receivedPldPrevID = PldBuffer [(rcvRxPayloadIndex-1) * sizeof(txPayload)]; //store previous package id
-
-		/*If the ID of the received package is NODEID-1 copy content
-		else write to debug message*/
-		if (receivedPldPrevID == (NODEID-1) ) 
+#ifdef IS_CHAIN_ELEMENT
+		else if (payloadIsChain(slot->frame, slot->len))
 		{
-			pldWrap.wrSize = size; //update wrapper size with received packet size
-			#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO //Print payload to debug
-				myLog_d("received package from node ID %i", receivedPldPrevID);
-				myLog_d("Copying %i bytes into the PldArray!", size);
-				myLog_d("RSSI: -%d dBm", txPayload.rssi_last );
-				myLog_d("snr: %d dB", txPayload.snr_last );
-				delay(DEFWAIT);
-
-				//Print payload to debug
-				char rcvdData[256 * 4] = {0};
-				int index = 0;
-				for (int idx = 0; idx < (size * 3); idx += 3)
-				{
-					//sprintf(&rcvdData[idx], "%02X ", payload[index++]); //print in hex with leading zeros
-					sprintf(&rcvdData[idx], "%02x ", payload[index++]);
-				}
-				myLog_d(rcvdData);
-				delay(DEFWAIT);	
-			#endif
-			//copy received payload 
-			memcpy(&PldArray[0], payload, size); 
-			
-			//fill received package metadata
-			txPayload.rssi_last = -1 * rssi;
-			txPayload.snr_last = snr;
+			chainForward(slot);
+			continue;
 		}
-		else 
+#endif
+		else
 		{
-			#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO 
-				myLog_d("received package from node ID %i", receivedPldPrevID);
-				myLog_d("RSSI: %d dBm", rssi );
-				myLog_d("snr: %d dB", snr );
-				myLog_d("Message does not come from previous node. Skipping, wait for next. ");
-				delay(DEFWAIT);
-			#endif
+			myLog_d("Frame of %d bytes ignored", slot->len);
 		}
+		rxPoolRelease(slot);
+	}
+}
 
-		//PldArray[rcvRxPayloadIndex-1].rssi_last = -1 * rssi;
-		//PldArray[rcvRxPayloadIndex-1].snr_last = snr;
-		//PldArray[NODEID-1].pckLength = size;
+/**
+ * @brief Write the link adaptation state and counters since boot
+ *
+ * @param out called once per line, without line end
+ */
+void linkReport(void (*out)(const char *line))
+{
+	char line[96];
+	snprintf(line, sizeof(line), "link SF%d %d dBm, margin %d dB", adr.sf, adr.power,
+			 adr.count ? (int)adrMargin(&adr, adr.sf, adr.power) : 0);
+	out(line);
+	snprintf(line, sizeof(line), "link %lu feedbacks, %lu changes, %lu for missing feedback",
+			 (unsigned long)adr.feedbacks, (unsigned long)adr.changes, (unsigned long)adr.fallbacks);
+	out(line);
+#ifdef PAYLOAD_RETX
+	snprintf(line, sizeof(line), "retx %lu asked for, %lu resent, %lu gone, %lu uplinks skipped",
+			 (unsigned long)retx.requested, (unsigned long)retx.resent, (unsigned long)retx.gone,
+			 (unsigned long)retxSkipped);
+	out(line);
+#endif
+}
 
-	#endif
+#ifdef IS_CHAIN_ELEMENT
+/**
+ * @brief Give the RX pool slot of the forward back
+ */
+static void chainRelease(void)
+{
+	RxSlot *slot = txSlot;
+	txSlot = NULL;
+	if (slot != NULL)
+	{
+		rxPoolRelease(slot);
+	}
+}
 
-	#ifdef TX_ONLY
-		Radio.Sleep(); // Radio.Standby();
-	#else
-		// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-		// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-		// to catch incoming data packages
-		// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-		Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
-	#endif
+/**
+ * @brief The radio is done with the frame in CAD or on air, sent, dropped or
+ * in backoff. Wakes the loop task for a held chain frame
+ * @note Runs in the radio callbacks
+ */
+static void radioFree(void)
+{
+	txBusy = false;
+	taskSignal(TASK_FLAG_RADIO_FREE);
+}
+
+/**
+ * @brief Send the previous node's chain frame on with this node's record
+ * appended
+ * @note The record is encoded behind the frame in its RX pool slot, which
+ * is sent as it is and released when the forward is over. The forward
+ * supersedes a frame of this node or an older forward in backoff. A frame
+ * that arrives while one is in CAD or on air waits in its slot for the
+ * radio, a second one meanwhile is dropped
+ */
+static void chainForward(RxSlot *slot)
+{
+	uint8_t *frame = slot->frame;
+	uint8_t size = slot->len;
+	if (frame[1] != NODEID - 1)
+	{
+		myLog_d("Chain frame of node %d ignored", frame[1]);
+		chainStats.ignored++;
+		rxPoolRelease(slot);
+		return;
+	}
+	if (txBusy)
+	{
+		// txFrame, txFramePayload and the radio belong to the frame in CAD or on air
+		if (chainHeld != NULL)
+		{
+			myLog_d("Chain frame dropped, another one waits for the radio");
+			chainStats.busy++;
+			rxPoolRelease(slot);
+			return;
+		}
+		myLog_d("Chain frame waits for the radio");
+		chainStats.held++;
+		chainHeld = slot;
+		return;
+	}
+	txFramePayload = txPayload;
+	txFramePayload.sentPackets = nodeSentPackets;
+	const PayloadAggregate *aggregate = NULL;
+	txFrameSamples = 0;
+#ifdef PAYLOAD_BATCH
+	PayloadAggregate agg;
+	txFrameSamples = batchReduce(&agg);
+	aggregate = txFrameSamples ? &agg : NULL;
+#endif
+	txFrameLen = payloadChainAppend(frame, size, RX_POOL_FRAME_SIZE, &txFramePayload, aggregate, &accShock,
+									slot->rssi, slot->snr);
+	txForwardRecord = txFrameLen != 0;
+	if (!txForwardRecord)
+	{
+		// Full, the frame goes on as it is and this node sends its own
+		txFrameLen = size;
+		txFrameSamples = 0;
+		chainStats.full++;
+	}
+	payloadChainForward(frame, NODEID);
+
+	// Relayed frames are scheduled traffic of the chain, they leave the alarm reserve alone
+	uint32_t airMs = airtimeMs(adr.sf, radioProfile->bandwidth, radioProfile->codingRate, radioProfile->preamble,
+							   txFrameLen, true, LORA_FIX_LENGTH_PAYLOAD_ON);
+	bool allowed = dutyAllow(&dutyCycle, millis(), airMs, false);
+	if (cadRetryPending)
+	{
+		cadRetryTimer.stop();
+		cadRetryPending = false;
+		lbtStats.superseded++;
+		chainRelease();
+	}
+	if (!allowed)
+	{
+		myLog_d("Duty cycle: chain frame of %d records held back", frame[0] & PAYLOAD_CHAIN_COUNT_MASK);
+		rxPoolRelease(slot);
+		return;
+	}
+	myLog_d("Chain: forwarding %d records, hop %d", frame[0] & PAYLOAD_CHAIN_COUNT_MASK, frame[2]);
+	txSlot = slot;
+	channelFreeRetryNum = 0;
+	// The turnaround counts from the RX done of the frame
+	channelTimeout = slot->at;
+	linkSent = false;
+	startCad();
+}
+
+/**
+ * @brief Write the relay counters since boot
+ *
+ * @param out called once per line, without line end
+ */
+void chainReport(void (*out)(const char *line))
+{
+	char line[96];
+	snprintf(line, sizeof(line), "chain %lu forwarded, %lu full, %lu of other nodes, %lu own saved",
+			 (unsigned long)chainStats.forwarded, (unsigned long)chainStats.full,
+			 (unsigned long)chainStats.ignored, (unsigned long)chainStats.saved);
+	out(line);
+	snprintf(line, sizeof(line), "chain forward turnaround max %lu ms, %lu held busy, %lu dropped busy",
+			 (unsigned long)chainStats.turnaround, (unsigned long)chainStats.held, (unsigned long)chainStats.busy);
+	out(line);
+}
+#endif
+
+/**
+ * @brief Count the frame that just went out, it becomes the delta reference
+ * when the gateway's feedback for it arrives
+ */
+static void onUplinkDone(void)
+{
+	nodeSentPackets ++;
+	adrUplink(&adr);
+#ifdef IS_CHAIN_ELEMENT
+	if (txSlot != NULL)
+	{
+		chainStats.forwarded++;
+		chainCarried = txForwardRecord;
+		chainRelease();
+	}
+#endif
+#ifdef PAYLOAD_COMPACT
+#ifndef IS_CHAIN_ELEMENT
+	// Chain frames are key frames only
+	txSentPayload = txFramePayload;
+	txFramesSinceKey = payloadIsDelta(txData(), txFrameLen) ? txFramesSinceKey + 1 : 0;
+#endif
+#ifdef PAYLOAD_BATCH
+	batchDrop(txFrameSamples);
+#endif
+#endif
+}
+
+/**
+ * @brief Function to be executed on Radio Tx Done event
+ */
+void OnTxDone(void)
+{
+	TRACE_END(TRACE_SEND);
+	TRACE_BEGIN(TRACE_TX_DONE);
+	myLog_d("OnTxDone\n");
+	dutyCharge(&dutyCycle, millis(), txAirtimeMs);
+#ifdef PAYLOAD_RETX
+	// Resent uplinks keep their sequence numbers and leave the delta reference alone
+	bool uplink = !txRetx;
+	txRetx = false;
+#else
+	bool uplink = true;
+#endif
+	if (uplink)
+	{
+		onUplinkDone();
+	}
+
+	// A page erase stalls the CPU, it waits for the loop task and, on a node
+	// with the link window, until the window is over
+	flashGcDue = true;
+#ifdef IS_CHAIN_ELEMENT
+	radioIdle();
+	radioFree();
+	taskSignal(TASK_FLAG_FLASH_GC);
+#else
+	// The gateway's downlink, nodes that do not listen hear it only now.
+	// OnRxDone()/OnRxTimeout() go back to radioIdle() after the window
+	Radio.Rx(linkWindow);
+#endif
+
+	// Switch off the indicator lights
+#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
+	digitalWrite(LED_CONN, LOW);
+#endif
+	TRACE_END(TRACE_TX_DONE);
+}
+
+/**
+ * @brief Wake the loop task for the flash clean-up step of the last uplink
+ * once its link window has ended
+ */
+static void signalFlashGc(void)
+{
+#ifndef IS_CHAIN_ELEMENT
+	if (flashGcDue)
+	{
+		taskSignal(TASK_FLAG_FLASH_GC);
+	}
+#endif
+}
+
+/**
+ * @brief Run the flash clean-up step of the last uplink, called by the loop
+ * task on TASK_FLAG_FLASH_GC
+ * @note A chain element keeps it due while a forward is in CAD or backoff,
+ * the TX done of the forward signals it again
+ */
+void handleFlashGc(void)
+{
+	if (!flashGcDue)
+	{
+		return;
+	}
+#ifdef IS_CHAIN_ELEMENT
+	if (txSlot != NULL)
+	{
+		return;
+	}
+#endif
+	flashGcDue = false;
+	TRACE_BEGIN(TRACE_FLASH_GC);
+	cleanUpBsecState();
+	TRACE_END(TRACE_FLASH_GC);
+}
+
+/**@brief Function to be executed on Radio Rx Done event
+ * @note The radio library reuses payload for the next frame. The frame is
+ * copied into the RX pool and handleLoRaRx() parses it in the loop task
+ */
+void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
+{
+	bool queued = rxPoolPut(&rxPool, payload, size, rssi, snr, millis());
+
+	radioIdle();
+	signalFlashGc();
 
 		// Switch off the indicator lights
 	#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
 		digitalWrite(LED_CONN, LOW);
 	#endif
+
+	if (queued)
+	{
+		// The loop task handles the pool on every wakeup, a pending event keeps its type
+		if (uxSemaphoreGetCount(taskEvent) == 0)
+		{
+			eventType = 0;
+		}
+		xSemaphoreGive(taskEvent);
+	}
 }
 
 /**@brief Function to be executed on Radio Tx Timeout event
@@ -234,16 +933,18 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
 void OnTxTimeout(void)
 {
 	myLog_d("OnTxTimeout");
-
-#ifdef TX_ONLY
-	Radio.Sleep(); // Radio.Standby();
-#else
-	// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-	// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-	// to catch incoming data packages
-	// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-	Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
+	lbtStats.txTimeout++;
+#ifdef IS_CHAIN_ELEMENT
+	chainRelease();
+	radioFree();
 #endif
+#ifdef PAYLOAD_RETX
+	txRetx = false;
+#endif
+	// The PA may have been on for the whole frame
+	dutyCharge(&dutyCycle, millis(), txAirtimeMs);
+
+	radioIdle();
 
 	// Switch off the indicator lights
 #if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
@@ -257,15 +958,8 @@ void OnRxTimeout(void)
 {
 	myLog_d("OnRxTimeout");
 
-#ifdef TX_ONLY
-	Radio.Sleep(); // Radio.Standby();
-#else
-	// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-	// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-	// to catch incoming data packages
-	// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-	Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
-#endif
+	radioIdle();
+	signalFlashGc();
 
 	// Switch off the indicator lights
 #if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
@@ -277,15 +971,8 @@ void OnRxTimeout(void)
  */
 void OnRxError(void)
 {
-#ifdef TX_ONLY
-	Radio.Sleep(); // Radio.Standby();
-#else
-	// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-	// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-	// to catch incoming data packages
-	// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-	Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
-#endif
+	radioIdle();
+	signalFlashGc();
 
 	// Switch off the indicator lights
 #if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
@@ -297,6 +984,7 @@ void OnRxError(void)
  */
 void OnCadDone(bool cadResult)
 {
+	TRACE_END(TRACE_CAD);
 	myLog_d("CAD done");
 	if (cadResult)
 	{
@@ -304,16 +992,34 @@ void OnCadDone(bool cadResult)
 			myLog_d("Channel Busy");
 			delay(DEFWAIT);
 		#endif
+		lbtStats.busy++;
+		if (channelFreeRetryNum < LBT_RETRY_MAX)
+		{
+			// Sleep until the next attempt, the radio listens meanwhile
+			uint32_t backoff = lbtBackoffMs(channelFreeRetryNum, Radio.Random());
+			channelFreeRetryNum++;
+			myLog_d("CAD retry %d in %ldms", channelFreeRetryNum, (long)backoff);
+			cadRetryAt = millis() + backoff;
+			cadRetryPending = true;
+			cadRetryTimer.setPeriod(backoff);
+		}
+		else
+		{
+			myLog_d("Channel busy for %ldms, frame dropped", (long)(millis() - channelTimeout));
+			lbtStats.dropped++;
+#ifdef IS_CHAIN_ELEMENT
+			chainRelease();
+#endif
+#ifdef PAYLOAD_RETX
+			txRetx = false;
+#endif
+		}
+#ifdef IS_CHAIN_ELEMENT
+		// A frame in backoff leaves the radio to a forward, see chainForward()
+		radioFree();
+#endif
 
-		#ifdef TX_ONLY
-				Radio.Sleep(); // Radio.Standby();
-		#else
-				// To get maximum power savings we use Radio.SetRxDutyCycle instead of Radio.Rx(0)
-				// This function keeps the SX1261/2 chip most of the time in sleep and only wakes up short times
-				// to catch incoming data packages
-				// See document SX1261_AN1200.36_SX1261-2_RxDutyCycle_V1.0 ==>> https://semtech.my.salesforce.com/sfc/p/#E0000000JelG/a/2R0000001O3w/zsdHpRveb0_jlgJEedwalzsBaBnALfRq_MnJ25M_wtI
-				Radio.SetRxDutyCycle(duty_cycle_rx_time, duty_cycle_sleep_time);
-		#endif
+				radioIdle();
 
 				// Switch off the indicator lights
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
@@ -324,21 +1030,64 @@ void OnCadDone(bool cadResult)
 	{
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE 
 			myLog_d("CAD returned channel free after %ldms", (long)(millis() - cadTime));
-			//print packet to send
-			myLog_d("Dimensions of payload to send: %i", sizeof(txPayload));
-			myLog_d("Payload to send: ");
-			char rcvdData[sizeof(txPayload) * 4] = {0};
-			uint8_t PldPrintBuffer [sizeof(txPayload)] = {0};
-			memcpy(PldPrintBuffer, &txPayload, sizeof(txPayload));
-			int index = 0;
-			for (int idx = 0; idx < sizeof(txPayload) * 3; idx += 3)
+			//print the frame as it goes on air, a forward or resend included
+		#ifdef PAYLOAD_COMPACT
+			const uint8_t *dumpFrame = txData();
+			uint8_t dumpLen = txFrameLen;
+		#else
+			uint8_t dumpFrame[PAYLOAD_LEGACY_SIZE];
+			payloadEncodeLegacy(&txPayload, dumpFrame);
+			uint8_t dumpLen = sizeof(dumpFrame);
+		#endif
+			myLog_d("Frame to send: %u bytes", (unsigned)dumpLen);
+			// The first LORA_DUMP_BYTES only, a chain frame is up to 255 bytes
+			char rcvdData[LORA_DUMP_BYTES * 3 + 1] = {0};
+			for (uint8_t idx = 0; idx < dumpLen && idx < LORA_DUMP_BYTES; idx++)
 			{
-				sprintf(&rcvdData[idx], "%02x ", PldPrintBuffer[index++]);
+				sprintf(&rcvdData[idx * 3], "%02x ", dumpFrame[idx]);
 			}
-			myLog_d(rcvdData);
-			delay(DEFWAIT);	
+			myLog_d("%s", rcvdData);
+		#ifndef IS_CHAIN_ELEMENT
+			// A forward leaves within the RX to TX turnaround, nothing may hold up the send
+			delay(DEFWAIT);
 		#endif
-		Radio.Send(&txPayload.id, sizeof(txPayload)); //Send packet on LoRa P2P
+		#endif
+		if (channelFreeRetryNum == 0)
+		{
+			lbtStats.sentFirst++;
+		}
+		else
+		{
+			lbtStats.sentRetried++;
+		}
+#ifdef IS_CHAIN_ELEMENT
+		uint32_t turnaround = (uint32_t)(millis() - channelTimeout);
+		if (txSlot != NULL && turnaround > chainStats.turnaround)
+		{
+			chainStats.turnaround = turnaround;
+		}
+#endif
+		linkPower = radioPower;
+#ifdef PAYLOAD_RETX
+		// The gateway answers new uplinks only
+		linkSent = !txRetx;
+#else
+		linkSent = true;
+#endif
+		TRACE_BEGIN(TRACE_SEND);
+	#ifdef PAYLOAD_COMPACT
+		linkSeq = txFramePayload.sentPackets;
+		txAirtimeMs = airtimeMs(radioSf, radioProfile->bandwidth, radioProfile->codingRate, radioProfile->preamble,
+								txFrameLen, true, LORA_FIX_LENGTH_PAYLOAD_ON);
+		Radio.Send(txData(), txFrameLen); //Send compact frame on LoRa P2P
+	#else
+		linkSeq = txPayload.sentPackets;
+		txAirtimeMs = airtimeMs(radioSf, radioProfile->bandwidth, radioProfile->codingRate, radioProfile->preamble,
+								PAYLOAD_LEGACY_SIZE, true, LORA_FIX_LENGTH_PAYLOAD_ON);
+		uint8_t legacyFrame[PAYLOAD_LEGACY_SIZE];
+		payloadEncodeLegacy(&txPayload, legacyFrame);
+		Radio.Send(legacyFrame, sizeof(legacyFrame)); //Send packet on LoRa P2P
+	#endif
 		myLog_d("radio send.");
 	}
 }
\ No newline at end of file
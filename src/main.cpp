@@ -3,12 +3,42 @@
 
 /** Semaphore used by events to wake up loop task */
 SemaphoreHandle_t taskEvent = NULL;
-/** Timer to wakeup task frequently and send message */
+/** One-shot timer that wakes the loop task at the earliest job deadline of sched */
 SoftwareTimer taskWakeupTimer;
+/** One-shot timer that wakes the loop task when a BSEC measurement is ready */
+SoftwareTimer bsecReadyTimer;
+/** One-shot timer that wakes the loop task when the FIFO holds the shock */
+SoftwareTimer accCaptureTimer;
+/** An accelerometer interrupt is waiting for its FIFO capture */
+static bool accCapturePending = false;
 
 TxdPayload txPayload;
+PayloadShock accShock;
 uint16_t nodeSentPackets = 0;
-uint32_t wakeCounter = 0;
+/** SEND_INTERVAL and SLEEP_TIME in ms until a command downlink changes them */
+static uint32_t sendIntervalMs = SEND_INTERVAL * 1000;
+static uint32_t sleepTimeMs = SLEEP_TIME;
+
+/** Periodic jobs of the loop task, see sched.h */
+static Scheduler sched;
+enum
+{
+	SCHED_BSEC_SAMPLE, // due when BSEC asks for the next sample
+	SCHED_BSEC_READY,  // collects a measurement whose ready event got lost
+	SCHED_BATTERY,	   // battery and tilt every sleepTimeMs
+	SCHED_SEND,		   // uplink every sendIntervalMs
+	SCHED_STATE_SAVE,  // BSEC state every STATE_SAVE_PERIOD once calibrated
+	SCHED_RESTART	   // restart after RESTART_INTERVAL
+};
+/** The send job fell due with a measurement in flight, the uplink waits for its result */
+static bool sendAfterBsec = false;
+/** Measurements SCHED_BSEC_READY collected, their ready event did not arrive */
+static uint32_t bsecReadyMissed = 0;
+/** LP or ULP BSEC sample rate, see ratepolicy.h */
+static RatePolicy ratePolicy;
+static void armWakeup(void);
+static void handleJobs(void);
+static void applySampleRate(void);
 //A0 Short, A1 Short : 0x18
 //A0 Open,  A1 Short : 0x19
 //A0 Short, A1 Open  : 0x1A
@@ -20,11 +50,25 @@ uint32_t wakeCounter = 0;
  * -1 => no event
  * 0 => LoRaWan data received
  * 1 => Timer wakeup
- * 2 => tbd
+ * 2 => Accelerometer interrupt
+ * 4 => Accelerometer FIFO capture
  * ...
  */
 uint8_t eventType = -1;
 
+/** TASK_FLAG_* bits of taskSignal(), taken all at once by the loop task */
+static uint8_t taskFlags = 0;
+
+/**
+ * @brief Wake the loop task for flag. Unlike eventType, a flag stays set
+ * until the loop task takes it, whatever event comes after it
+ */
+void taskSignal(uint8_t flag)
+{
+	__atomic_fetch_or(&taskFlags, flag, __ATOMIC_RELEASE);
+	xSemaphoreGiveFromISR(taskEvent, pdFALSE);
+}
+
 /**
  * @brief Timer event that wakes up the loop task frequently
  * 
@@ -41,6 +85,17 @@ void periodicWakeup(TimerHandle_t unused)
 	xSemaphoreGiveFromISR(taskEvent, pdFALSE);
 }
 
+/**
+ * @brief Timer event that wakes up the loop task to collect the BSEC measurement
+ * 
+ * @param unused 
+ */
+void bsecReadyWakeup(TimerHandle_t unused)
+{
+	(void)unused;
+	taskSignal(TASK_FLAG_BSEC_READY);
+}
+
 void setup()
 {	
 	delay(5000);	
@@ -56,6 +111,9 @@ void setup()
 		digitalWrite(LED_BUILTIN, HIGH);
 		// Start serial
 		Serial.begin(115200);
+		#ifdef MYLOG_DEFERRED
+			myLogBegin();
+		#endif
 
 		// Wait seconds for a terminal to connect
 		time_t timeout = millis();
@@ -121,12 +179,23 @@ void setup()
 		myLog_d("Init acc success");
 	txPayload.accAlarm = 0;
 
-	// Now we are connected, start the timer that will wakeup the loop frequently
+	// Now we are connected, schedule the jobs and start the timer that wakes the loop for them
 	myLog_d("Start Wakeup Timer");
-
-	taskWakeupTimer.begin(SLEEP_TIME, periodicWakeup);
-
-	taskWakeupTimer.start();
+	uint32_t now = millis();
+	rateInit(&ratePolicy, now);
+	schedInit(&sched);
+	schedAt(&sched, SCHED_BSEC_SAMPLE, now, 0);
+	schedAt(&sched, SCHED_BATTERY, now, sleepTimeMs / 2);
+	schedAt(&sched, SCHED_SEND, now + sendIntervalMs, SCHED_SLACK_MS);
+	schedAt(&sched, SCHED_STATE_SAVE, now + STATE_SAVE_PERIOD, SCHED_SLACK_MS);
+	schedAt(&sched, SCHED_RESTART, RESTART_INTERVAL, SCHED_SLACK_MS);
+
+	taskWakeupTimer.begin(1, periodicWakeup, NULL, false);
+	armWakeup();
+
+	// Period is set per measurement by handleBsecSample()
+	bsecReadyTimer.begin(SLEEP_TIME, bsecReadyWakeup, NULL, false);
+	accCaptureTimer.begin(ACC_CAPTURE_DELAY, accCaptureWakeup, NULL, false);
 
 	#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
 		// Give Serial some time to send everything
@@ -139,62 +208,76 @@ void loop()
 	// Sleep until we are woken up by an event
 	if (xSemaphoreTake(taskEvent, portMAX_DELAY) == pdTRUE)
 	{
+		TRACE_BEGIN(TRACE_WAKE);
 		// Switch on green LED to show we are awake
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
 				digitalWrite(LED_BUILTIN, HIGH);
 				delay(500); // Only so we can see the green LED
 		#endif
 
+		// Events during this wake are kept for the next one
+		uint8_t flags = __atomic_exchange_n(&taskFlags, 0, __ATOMIC_ACQUIRE);
+		uint8_t event = __atomic_exchange_n(&eventType, (uint8_t)-1, __ATOMIC_ACQUIRE);
+
+		// Received frames are handled on every wakeup, another event may have taken this one
+		handleLoRaRx();
+		if (flags & TASK_FLAG_FLASH_GC)
+		{
+			handleFlashGc();
+		}
+		if (flags & TASK_FLAG_CAD_RETRY)
+		{
+			handleCadRetry();
+		}
+		if (flags & TASK_FLAG_BSEC_READY)
+		{
+			myLog_d("BSEC wakeup");
+			handleBsecReady();
+		}
+		// So are the jobs that are due, whatever woke the loop
+		handleJobs();
+		if (sendAfterBsec && !bsecMeasuring())
+		{
+			sendAfterBsec = false;
+			handleSendInterval();
+		}
+
 		// Check the wake up reason
-		switch (eventType)
+		switch (event)
 		{
-		case 0: // Wakeup reason is package downlink arrived
+		case (uint8_t)-1: // Woken for taskFlags only, handled above
+			break;
+		case 0: // Wakeup reason is package downlink arrived, handled above
 			myLog_d("Received package over LoRa");
 			break;
-		case 1: // Wakeup reason is timer
-		{	
+		case 1: // Wakeup reason is timer, its jobs ran above
 			myLog_d("Timer wakeup");
-			txPayload.accAlarm = 0;
-			handleLoopActions();
-			
-			myLog_d("send interval in millis: %i", (SEND_INTERVAL*1000));
-			myLog_d("time millis: %i", millis());
-			uint32_t remainder = (millis() - ( wakeCounter*(SEND_INTERVAL*1000) )  );
-			myLog_d("time elapsed since last send: %i", remainder);
-
-			if( millis() > (RESTART_INTERVAL) )
-			{
-				myLog_d("SYSTEM RESET TIMER TRIGGERED!");
-				NVIC_SystemReset();
-			}
-
-			if( remainder > (SEND_INTERVAL*1000) )
+			break;
+		case 2: // Wakeup reason is accelerometer
+		{
+			myLog_d("ACC wakeup");
+			// Further interrupts of the same shock do not push the capture out
+			if (!accCapturePending)
 			{
-				wakeCounter++;
-				#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
-					myLog_d("Payload filled in loop: ");
-					char rcvdData[sizeof(txPayload) * 4] = {0};
-					uint8_t PldPrintBuffer [sizeof(txPayload)] = {0};
-					memcpy(PldPrintBuffer, &txPayload, sizeof(txPayload));
-					int index = 0;
-					for (int idx = 0; idx < sizeof(txPayload) * 3; idx += 3)
-					{
-						sprintf(&rcvdData[idx], "%02x ", PldPrintBuffer[index++]);
-					}
-					myLog_d(rcvdData);
-					delay(DEFWAIT);	
-				#endif
-				myLog_d("Initiate sending");
-				sendLoRa();
+				accCapturePending = true;
+				accCaptureTimer.setPeriod(ACC_CAPTURE_DELAY);
 			}
-
 			break;
 		}
-		case 2: // Wakeup reason is accelerometer
+		case 4: // Wakeup reason is accelerometer FIFO capture
 		{
-			myLog_d("ACC wakeup");
+			myLog_d("ACC capture");
+			accCapturePending = false;
+			TRACE_BEGIN(TRACE_ACC_CAPTURE);
+			accCapture(&accShock);
+			TRACE_END(TRACE_ACC_CAPTURE);
 			txPayload.accAlarm = 1;
-			
+			// Something happened to the node, sample the air at the LP rate again
+			if (rateUpdate(&ratePolicy, millis(), txPayload.iaq, txPayload.iaqAccuracy, txPayload.bat_perc, true))
+			{
+				applySampleRate();
+			}
+
 			handleLoopActions();
 
 			#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
@@ -207,7 +290,7 @@ void loop()
 				{
 					sprintf(&rcvdData[idx], "%02x ", PldPrintBuffer[index++]);
 				}
-				myLog_d(rcvdData);
+				myLog_d("%s", rcvdData);
 				delay(DEFWAIT);	
 			#endif
 
@@ -227,8 +310,16 @@ void loop()
 		attachInterrupt(WB_IO5, accIntHandler, CHANGE);
 		attachInterrupt(WB_IO6, accIntHandler, CHANGE);
 
-		// Go back to sleep - take the loop semaphore
-		xSemaphoreTake(taskEvent, 10);
+		TRACE_END(TRACE_WAKE);
+		// Go back to sleep - take the loop semaphore. A frame received meanwhile
+		// is handled here, any other event must wake the loop again
+		if (xSemaphoreTake(taskEvent, 10) == pdTRUE &&
+			((eventType != 0 && eventType != (uint8_t)-1) || __atomic_load_n(&taskFlags, __ATOMIC_ACQUIRE) != 0))
+		{
+			xSemaphoreGive(taskEvent);
+		}
+		handleLoRaRx();
+		armWakeup();
 
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_INFO
 				digitalWrite(LED_BUILTIN, LOW); //turn off indicator led
@@ -239,21 +330,231 @@ void loop()
 	// delay(3000);
 }
 
-/* update txPayload with sensor data*/
-void handleLoopActions(){
+/* program the wakeup timer for the earliest job deadline */
+static void armWakeup(void){
+	uint32_t wait = schedWait(&sched, millis());
+	// A deadline that has passed still gets a timer wakeup, after the current one
+	taskWakeupTimer.setPeriod(wait > 0 ? wait : 1);
+}
+
+/* run the jobs of sched that are due and put the periodic ones back */
+static void handleJobs(){
+	uint32_t jobs = schedTake(&sched, millis(), SCHED_EARLY_MS);
+	if (jobs & (1UL << SCHED_RESTART))
+	{
+		myLog_d("SYSTEM RESET TIMER TRIGGERED!");
+		// Keep the IAQ calibration across the restart
+		TRACE_BEGIN(TRACE_STATE_SAVE);
+		saveBsecState();
+		TRACE_END(TRACE_STATE_SAVE);
+		NVIC_SystemReset();
+	}
+	if (jobs & (1UL << SCHED_BSEC_READY))
+	{
+		// The ready event was lost, a measurement left pending would stop all sampling
+		myLog_d("BSEC ready event missed");
+		bsecReadyMissed++;
+		handleBsecReady();
+	}
+	if (jobs & (1UL << SCHED_BSEC_SAMPLE))
+	{
+		txPayload.accAlarm = 0;
+		handleBsecSample();
+	}
+	if (jobs & (1UL << SCHED_BATTERY))
+	{
+		handleLoopActions();
+		schedAt(&sched, SCHED_BATTERY, sched.due[SCHED_BATTERY] + sleepTimeMs, sleepTimeMs / 2);
+	}
+	if (jobs & (1UL << SCHED_STATE_SAVE))
+	{
+		TRACE_BEGIN(TRACE_STATE_SAVE);
+		refreshBsecState();
+		TRACE_END(TRACE_STATE_SAVE);
+		schedAt(&sched, SCHED_STATE_SAVE, sched.due[SCHED_STATE_SAVE] + STATE_SAVE_PERIOD, SCHED_SLACK_MS);
+	}
+	if (jobs & (1UL << SCHED_SEND))
+	{
+		// Due times follow each other, a late uplink does not push the next one out
+		schedAt(&sched, SCHED_SEND, sched.due[SCHED_SEND] + sendIntervalMs, SCHED_SLACK_MS);
+		// With a measurement in flight the uplink waits for its result
+		if (bsecMeasuring())
+		{
+			sendAfterBsec = true;
+		}
+		else
+		{
+			handleSendInterval();
+		}
+	}
+}
+
+/* send txPayload, the send job is due */
+void handleSendInterval(){
+	myLog_d("send interval in millis: %i", sendIntervalMs);
+	myLog_d("time millis: %i", millis());
 	txPayload.id = NODEID;
-	delay(DEFWAIT);
-	//bme680_get(&txPayload.temp_int, &txPayload.temp_dec, &txPayload.humdity_int, &txPayload.humdity_dec, &txPayload.bar_press);
-	readBSEC(&txPayload.temp_int, &txPayload.temp_dec, &txPayload.humdity_int, &txPayload.humdity_dec, &txPayload.bar_press,
+	txPayload.sentPackets = nodeSentPackets;
+	#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
+		myLog_d("Payload filled in loop: ");
+		char rcvdData[sizeof(txPayload) * 4] = {0};
+		uint8_t PldPrintBuffer [sizeof(txPayload)] = {0};
+		memcpy(PldPrintBuffer, &txPayload, sizeof(txPayload));
+		int index = 0;
+		for (int idx = 0; idx < sizeof(txPayload) * 3; idx += 3)
+		{
+			sprintf(&rcvdData[idx], "%02x ", PldPrintBuffer[index++]);
+		}
+		myLog_d("%s", rcvdData);
+		delay(DEFWAIT);	
+	#endif
+	#ifdef TRACE_ENABLED
+		// traceLog() writes at INFO, below it the lines go nowhere
+		traceReport(traceLog);
+		schedReport(traceLog);
+		rateReport(traceLog);
+		lbtReport(traceLog);
+		linkReport(traceLog);
+		commandReport(traceLog);
+	#ifdef IS_CHAIN_ELEMENT
+		chainReport(traceLog);
+	#endif
+	#endif
+	myLog_d("Initiate sending");
+	sendLoRa();
+}
+
+/**
+ * @brief Write the scheduler counters since boot
+ *
+ * @param out called once per line, without line end
+ */
+void schedReport(void (*out)(const char *line))
+{
+	char line[96];
+	snprintf(line, sizeof(line), "sched %lu wakes, %lu jobs, %lu coalesced, max %lu ms late",
+			 (unsigned long)sched.wakes, (unsigned long)sched.jobs, (unsigned long)sched.coalesced,
+			 (unsigned long)sched.maxLate);
+	out(line);
+	snprintf(line, sizeof(line), "sched %lu BSEC results collected without their ready event",
+			 (unsigned long)bsecReadyMissed);
+	out(line);
+}
+
+/* send interval from a command downlink, the next frame goes out one interval after the last */
+bool setSendInterval(uint32_t seconds){
+	if (seconds < SEND_INTERVAL_MIN || seconds > SEND_INTERVAL_MAX)
+	{
+		return false;
+	}
+	uint32_t last = sched.due[SCHED_SEND] - sendIntervalMs;
+	sendIntervalMs = seconds * 1000;
+	uint32_t due = last + sendIntervalMs;
+	if ((int32_t)(due - millis()) < 0)
+	{
+		due = millis();
+	}
+	schedAt(&sched, SCHED_SEND, due, SCHED_SLACK_MS);
+	return true;
+}
+
+/* battery and tilt read period from a command downlink */
+bool setSleepTime(uint32_t ms){
+	if (ms < SLEEP_TIME_MIN || ms > SLEEP_TIME_MAX)
+	{
+		return false;
+	}
+	uint32_t last = sched.due[SCHED_BATTERY] - sleepTimeMs;
+	sleepTimeMs = ms;
+	schedAt(&sched, SCHED_BATTERY, last + sleepTimeMs, sleepTimeMs / 2);
+	return true;
+}
+
+/* BSEC sample rate from a command downlink, 0 LP, 1 ULP, 2 back to the rate policy */
+bool setBsecRate(uint32_t mode){
+	static const uint8_t modes[] = {RATE_LP, RATE_ULP, RATE_AUTO};
+	if (mode >= sizeof(modes))
+	{
+		return false;
+	}
+	if (rateForce(&ratePolicy, modes[mode]))
+	{
+		applySampleRate();
+	}
+	return true;
+}
+
+/* re-subscribe BSEC at the rate the policy changed to */
+static void applySampleRate(void){
+	myLog_d("BSEC sample rate %s", ratePolicy.ulp ? "ULP" : "LP");
+	bsecSetSampleRate(ratePolicy.ulp);
+	// The new subscription starts with a sample
+	schedAt(&sched, SCHED_BSEC_SAMPLE, millis(), 0);
+}
+
+/**
+ * @brief Write the sample rate and its transitions since boot
+ *
+ * @param out called once per line, without line end
+ */
+void rateReport(void (*out)(const char *line))
+{
+	char line[128];
+	snprintf(line, sizeof(line), "rate %s%s, to ULP %lu, to LP slope %lu alarm %lu battery %lu, forced %lu",
+			 ratePolicy.ulp ? "ULP" : "LP", ratePolicy.mode == RATE_AUTO ? "" : " forced",
+			 (unsigned long)ratePolicy.toUlp, (unsigned long)ratePolicy.slopes, (unsigned long)ratePolicy.alarms,
+			 (unsigned long)ratePolicy.charged, (unsigned long)ratePolicy.forced);
+	out(line);
+}
+
+/* update txPayload with the BSEC measurement started by handleBsecSample() */
+void handleBsecReady(){
+	schedCancel(&sched, SCHED_BSEC_READY);
+	TRACE_BEGIN(TRACE_BSEC_FINISH);
+	bool sampled = finishBSEC(&txPayload.temperature, &txPayload.humidity, &txPayload.bar_press,
 	 &txPayload.iaq, &txPayload.iaqAccuracy, &txPayload.co2equivalent, &txPayload.breathVocEquivalent, &txPayload.gasPercentage);
-	myLog_d("T_INT payload: %i", txPayload.temp_int);
-	myLog_d("H_INT payload: %i", txPayload.humdity_int);
-	
+	TRACE_END(TRACE_BSEC_FINISH);
+	if (!sampled)
+	{
+		return;
+	}
+	myLog_d("T payload: %i cdegC", txPayload.temperature);
+	myLog_d("H payload: %i c%%RH", txPayload.humidity);
+#ifdef PAYLOAD_BATCH
+	batchAdd(&txPayload);
+#endif
+	if (rateUpdate(&ratePolicy, millis(), txPayload.iaq, txPayload.iaqAccuracy, txPayload.bat_perc, false))
+	{
+		applySampleRate();
+	}
+}
+
+/* start the BSEC sample that is due, the result follows on bsecReadyTimer */
+void handleBsecSample(){
+	//bme680_get(&txPayload.temperature, &txPayload.humidity, &txPayload.bar_press);
+	TRACE_BEGIN(TRACE_BSEC_START);
+	uint32_t bsecWait = startBSEC();
+	TRACE_END(TRACE_BSEC_START);
+	if (bsecWait > 0)
+	{
+		// Sleep through heater and conversion instead of blocking in BSEC
+		bsecReadyTimer.setPeriod(bsecWait);
+		schedAt(&sched, SCHED_BSEC_READY, millis() + bsecWait + BSEC_READY_MARGIN_MS, 0);
+	}
+	schedAt(&sched, SCHED_BSEC_SAMPLE, bsecNextSampleMs(), 0);
+}
+
+/* update txPayload with battery level and tilt */
+void handleLoopActions(){
+	txPayload.id = NODEID;
+	TRACE_BEGIN(TRACE_BATTERY);
 	txPayload.bat_perc = readBatt();
+	TRACE_END(TRACE_BATTERY);
 
-	float accx = accSensor.readFloatAccelX();
-	float accy = accSensor.readFloatAccelY();
-	float accz = accSensor.readFloatAccelZ();
+	TRACE_BEGIN(TRACE_ACC_READ);
+	float accx, accy, accz;
+	accRead(&accx, &accy, &accz);
+	TRACE_END(TRACE_ACC_READ);
 
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
 			myLog_d("Acc X: %f", accx ); 
@@ -261,7 +562,9 @@ void handleLoopActions(){
 			myLog_d("Acc z: %f",accz );
 			delay(DEFWAIT);
 		#endif
+		TRACE_BEGIN(TRACE_TILT);
 		calculateTilt(accx, accy, accz, &txPayload.inc_x, &txPayload.inc_y, &txPayload.inc_z);
+		TRACE_END(TRACE_TILT);
 		#if MYLOG_LOG_LEVEL > MYLOG_LOG_LEVEL_NONE
 			myLog_d("Inc X: %i", txPayload.inc_x ); 
 			myLog_d("Inc y: %i", txPayload.inc_y );
@@ -2,30 +2,65 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <Wire.h>
+#include "fixedpoint.h"
 
 //BME functions
-	#include <Adafruit_Sensor.h>
-	#include <Adafruit_BME680.h>
 	#define BMEADDR 0x76
 	#define PRESS_DIV 1000
+#ifndef NATIVE_SIM // bme.cpp and the Adafruit driver stack are not part of [env:native]
+	#include <Adafruit_Sensor.h>
+	#include <Adafruit_BME680.h>
 	//BME stuff
 	extern Adafruit_BME680 bme;
 	void init_bme680();
-	void bme680_get(uint8_t * t_int_pld, uint8_t * t_dec_pld, uint8_t * hum_int_pld, uint8_t * hum_dec_pld, uint16_t * press_pld);
+	void bme680_get(int16_t * temp_pld, uint16_t * hum_pld, uint16_t * press_pld);
+#endif
 
 //BSEC functions
+	/* A wakeup this early (ms) before BSEC's next call still takes the sample */
+	#define BSEC_DUE_TOLERANCE_MS 100
+	/* Sample periods of the LP and ULP rate */
+	#define BSEC_LP_PERIOD_MS 3000
+	#define BSEC_ULP_PERIOD_MS 300000
 	void initBSEC();
-	void readBSEC(uint8_t * t_int_pld, uint8_t * t_dec_pld, uint8_t * hum_int_pld, uint8_t * hum_dec_pld, uint16_t * press_pld,
+	uint8_t bsecSubscribe(void);
+	void readBSEC(int16_t * temp_pld, uint16_t * hum_pld, uint16_t * press_pld,
+ 		uint16_t * iaq, uint8_t * iaqAccuracy, uint16_t * co2Equivalent, uint16_t * breathVocEquivalent, uint8_t * gasPercentage);
+	uint32_t startBSEC(void);
+	bool finishBSEC(int16_t * temp_pld, uint16_t * hum_pld, uint16_t * press_pld,
  		uint16_t * iaq, uint8_t * iaqAccuracy, uint16_t * co2Equivalent, uint16_t * breathVocEquivalent, uint8_t * gasPercentage);
+	bool bsecMeasuring(void);
+	void saveBsecState(void);
+	void cleanUpBsecState(void);
+	void refreshBsecState(void);
+	/* Period of refreshBsecState() once the IAQ is calibrated, 360 minutes - 4 times a day */
+	#define STATE_SAVE_PERIOD UINT32_C(360 * 60 * 1000)
+	uint32_t bsecNextSampleMs(void);
+	void bsecSetSampleRate(bool ulp);
+	uint32_t bsecSamplePeriodMs(void);
+	/* NVRAM cell where the BSEC state record starts */
+	#define BSEC_STATE_NVRAM_IDX 0
 
 // ACC functions
 	#include <SparkFunLIS3DH.h>
 	#define INT1_PIN WB_IO5
 	extern LIS3DH accSensor;
+	/* Samples the LIS3DH FIFO holds in stream mode */
+	#define ACC_FIFO_DEPTH 32
+	/* Samples per burst read, 6 bytes each to fit the 64 byte Wire buffer */
+	#define ACC_FIFO_BURST 10
+	/* Time from INT1 to the FIFO read, leaves the onset and the rest of the shock in the FIFO */
+	#define ACC_CAPTURE_DELAY 640
+	/* Deviation of |a| from 1 g in mg that counts towards the shock duration */
+	#define ACC_SHOCK_THRESHOLD 250
 	bool initACC(void);
 	void clearAccInt(void);
 	void accIntHandler(void);
-	void calculateTilt(float xacc, float yacc, float zacc, uint8_t * xinc, uint8_t * yinc, uint8_t * zinc);
+	void accCaptureWakeup(TimerHandle_t unused);
+	bool accCapture(struct PayloadShock *shock);
+	void accRead(float *xacc, float *yacc, float *zacc);
+	extern SoftwareTimer accCaptureTimer;
+	#include "tilt.h"
 	extern SemaphoreHandle_t loopEnable;
 
 // Battery functions
@@ -45,67 +80,155 @@
 	uint8_t lorawanBattLevel(void);
 	extern uint8_t battLevel;
 
-// Debug
+// Debug, the log level comes from the build flags
 #include <myLog.h>
-#define MYLOG_LOG_LEVEL MYLOG_LOG_LEVEL_ERROR
 
 #include <SX126x-RAK4630.h>
+#ifndef IS_CHAIN_ELEMENT
+	// Chain elements listen for the previous node with the RX duty cycle
 	#define TX_ONLY
+#endif
 //default wait time for prints and stuff
+#ifdef MYLOG_DEFERRED
+	// Deferred records are sent by the myLog task, nothing to wait for
+	#define DEFWAIT 0
+#else
 	#define DEFWAIT 30
+#endif
 
 //chain elements definitions
-	//node IDentifier
+	//node IDentifier, a chain element forwards the chain frames of NODEID-1
+#ifndef NODEID
 	#define NODEID 102
-	/* Time the device is sleeping in milliseconds for the node element to perform bsec */
-	#define SLEEP_TIME 3 * 1000
+#endif
+	/* Period of the battery and tilt read in milliseconds, BSEC samples follow their own schedule */
+	#define SLEEP_TIME 60 * 1000
 	/* Time the device for tx */
 	#define SEND_INTERVAL 900
 	/*System restart interval*/
 	#define RESTART_INTERVAL 86400000
-
-struct __attribute__((packed)) TxdPayload{
-		uint8_t id = NODEID;	             // Device ID
-		uint8_t bat_perc;		 // Battery percentage
-		uint8_t temp_int;        // Temperature integer
-		uint8_t temp_dec;		 // Temperature tenths/hundredths
-		uint8_t humdity_int;	 // Humidity integer
-		uint8_t humdity_dec;	 // Humidity ones/tens/hundreds
-		uint16_t bar_press;		 // Barometric pressure in hPa
-		uint8_t inc_x;
-		uint8_t inc_y;
-		uint8_t inc_z;
-		uint16_t iaq; //iaq value
-		uint8_t iaqAccuracy; //iaq status (0-1-2)
-		uint16_t co2equivalent; //co2 estimation ppm
-		uint16_t breathVocEquivalent; //breath voc
-		uint8_t gasPercentage;
-		uint16_t sentPackets; //number of sent packets since last startup
-		uint8_t accAlarm;   //accelerometer alarm flag
-		//String code = "wmn24";
-	};
+	/* Range of the send interval (s) and wakeup period (ms) a command downlink may set */
+	#define SEND_INTERVAL_MIN 60
+	#define SEND_INTERVAL_MAX 3600
+	#define SLEEP_TIME_MIN 1000
+	#define SLEEP_TIME_MAX 3600000
+
+#include "payload.h"
+	/* Send compact delta frames (payload.h) instead of the raw TxdPayload */
+	#define PAYLOAD_COMPACT
+	/* Add min/max/mean of all samples since the last uplink to compact frames */
+	#define PAYLOAD_BATCH
+	/* One SEND_INTERVAL of samples at the BSEC LP rate, older ones are folded (batch.cpp) */
+	#define BATCH_CAPACITY (SEND_INTERVAL * 1000 / BSEC_LP_PERIOD_MS)
+	void batchAdd(const TxdPayload *sample);
+	uint16_t batchReduce(PayloadAggregate *agg);
+	void batchDrop(uint16_t n);
+	/* Resend the uplinks the gateway's gap report lists as missing (retx.h) */
+	#define PAYLOAD_RETX
+#if defined(IS_CHAIN_ELEMENT) && !defined(PAYLOAD_COMPACT)
+	#error "IS_CHAIN_ELEMENT relays chain frames of compact records, define PAYLOAD_COMPACT"
+#endif
+#if defined(IS_CHAIN_ELEMENT) || !defined(PAYLOAD_COMPACT)
+	// Resent uplinks are compact key frames for the gateway, chain elements send to the next node
+	#undef PAYLOAD_RETX
+#endif
 
 //Payload Array
 extern TxdPayload txPayload;
-
-struct __attribute__((packed)) PldWrapper {
-	int wrSize = 0;
-	TxdPayload* wrBuffer;
-};
-extern PldWrapper pldWrap;
+/* Features of the last shock, sent with txPayload.accAlarm */
+extern PayloadShock accShock;
 
 extern uint16_t nodeSentPackets;
 
+// Trace stuff
+	/* Time the phases of every wake, see trace.cpp */
+	#define TRACE_ENABLED
+	/* Recent phase events kept for the last wake timeline */
+	#define TRACE_RING_SIZE 128
+	enum TracePhase
+	{
+		TRACE_WAKE,
+		TRACE_BSEC_START,
+		TRACE_BSEC_FINISH,
+		TRACE_BATTERY,
+		TRACE_ACC_READ,
+		TRACE_ACC_CAPTURE,
+		TRACE_TILT,
+		TRACE_CAD,
+		TRACE_SEND,
+		TRACE_TX_DONE,
+		TRACE_STATE_SAVE,
+		TRACE_FLASH_GC,
+		TRACE_PHASES
+	};
+	void traceBegin(uint8_t phase);
+	void traceEnd(uint8_t phase);
+	void traceReport(void (*out)(const char *line));
+	void traceLog(const char *line);
+#ifdef TRACE_ENABLED
+	#define TRACE_BEGIN(phase) traceBegin(phase)
+	#define TRACE_END(phase) traceEnd(phase)
+#else
+	#define TRACE_BEGIN(phase)
+	#define TRACE_END(phase)
+#endif
+
 // LoRa stuff
+#include "lbt.h"
+#include "adr.h"
+#include "airtime.h"
+#include "dutycycle.h"
+#include "radioprofile.h"
+#include "rxpool.h"
+#include "retx.h"
 bool initLoRa(void);
+bool setRadioProfile(uint8_t index);
+bool setRadioListen(bool on);
 void sendLoRa(void);
+void handleLoRaRx(void);
+void handleCadRetry(void);
+void handleFlashGc(void);
+void lbtReport(void (*out)(const char *line));
+void linkReport(void (*out)(const char *line));
+void chainReport(void (*out)(const char *line));
+extern LbtStats lbtStats;
+extern DutyCycle dutyCycle;
 
 // Main loop stuff
+#include "sched.h"
+	/* A job this early (ms) before its due time runs in the current wake */
+	#define SCHED_EARLY_MS BSEC_DUE_TOLERANCE_MS
+	/* Lateness the send, state save and restart jobs tolerate to share a wake with another job */
+	#define SCHED_SLACK_MS 5000
+	/* A measurement this long (ms) past its ready time is collected without the ready event */
+	#define BSEC_READY_MARGIN_MS 500
+	/* Wake reasons that must not be overwritten by a later event, see taskSignal() */
+	#define TASK_FLAG_BSEC_READY 0x01
+	#define TASK_FLAG_CAD_RETRY 0x02
+	#define TASK_FLAG_FLASH_GC 0x04
+	/* Only wakes the loop task, handleLoRaRx() sends a held chain frame on */
+	#define TASK_FLAG_RADIO_FREE 0x08
+void taskSignal(uint8_t flag);
 void periodicWakeup(TimerHandle_t unused);
+void bsecReadyWakeup(TimerHandle_t unused);
 extern SemaphoreHandle_t taskEvent;
 extern uint8_t eventType;
 extern SoftwareTimer taskWakeupTimer;
+extern SoftwareTimer bsecReadyTimer;
 extern void handleLoopActions();
+extern void handleBsecSample();
+extern void handleBsecReady();
+extern void handleSendInterval();
+void schedReport(void (*out)(const char *line));
+#include "ratepolicy.h"
+void rateReport(void (*out)(const char *line));
+bool setSendInterval(uint32_t seconds);
+bool setSleepTime(uint32_t ms);
+bool setBsecRate(uint32_t ulp);
+
+// Command downlinks, see command.cpp
+void handleCommand(const uint8_t *frame, uint8_t size);
+void commandReport(void (*out)(const char *line));
 
 
 
@@ -0,0 +1,759 @@
+/**
+ * @file payload.cpp
+ * @brief Compact payload codec, see payload.h for the frame layout
+ */
+#include "payload.h"
+#include <string.h>
+
+static_assert(sizeof(TxdPayload) == PAYLOAD_LEGACY_SIZE, "TxdPayload must keep the legacy frame size");
+
+/**
+ * @brief Channel i of the payload as one integer
+ */
+int32_t payloadChannel(const TxdPayload *p, uint8_t i)
+{
+	switch (i)
+	{
+	case PAYLOAD_CH_BAT_PERC:
+		return p->bat_perc;
+	case PAYLOAD_CH_TEMPERATURE:
+		return p->temperature;
+	case PAYLOAD_CH_HUMIDITY:
+		return p->humidity;
+	case PAYLOAD_CH_BAR_PRESS:
+		return p->bar_press;
+	case PAYLOAD_CH_INC_X:
+		return p->inc_x;
+	case PAYLOAD_CH_INC_Y:
+		return p->inc_y;
+	case PAYLOAD_CH_INC_Z:
+		return p->inc_z;
+	case PAYLOAD_CH_IAQ:
+		return p->iaq;
+	case PAYLOAD_CH_CO2:
+		return p->co2equivalent;
+	case PAYLOAD_CH_VOC:
+		return p->breathVocEquivalent;
+	default:
+		return p->gasPercentage;
+	}
+}
+
+static void setChannel(TxdPayload *p, uint8_t i, int32_t v)
+{
+	switch (i)
+	{
+	case PAYLOAD_CH_BAT_PERC:
+		p->bat_perc = v;
+		break;
+	case PAYLOAD_CH_TEMPERATURE:
+		p->temperature = v;
+		break;
+	case PAYLOAD_CH_HUMIDITY:
+		p->humidity = v;
+		break;
+	case PAYLOAD_CH_BAR_PRESS:
+		p->bar_press = v;
+		break;
+	case PAYLOAD_CH_INC_X:
+		p->inc_x = v;
+		break;
+	case PAYLOAD_CH_INC_Y:
+		p->inc_y = v;
+		break;
+	case PAYLOAD_CH_INC_Z:
+		p->inc_z = v;
+		break;
+	case PAYLOAD_CH_IAQ:
+		p->iaq = v;
+		break;
+	case PAYLOAD_CH_CO2:
+		p->co2equivalent = v;
+		break;
+	case PAYLOAD_CH_VOC:
+		p->breathVocEquivalent = v;
+		break;
+	default:
+		p->gasPercentage = v;
+		break;
+	}
+}
+
+static uint8_t putVarint(uint8_t *frame, uint8_t pos, uint32_t v)
+{
+	while (v >= 0x80)
+	{
+		frame[pos++] = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	frame[pos++] = (uint8_t)v;
+	return pos;
+}
+
+/**
+ * @brief Read a varint, returns false if it runs past the frame end
+ */
+static bool getVarint(const uint8_t *frame, uint8_t size, uint8_t *pos, uint32_t *v)
+{
+	*v = 0;
+	for (uint8_t shift = 0; shift < 32; shift += 7)
+	{
+		if (*pos >= size)
+		{
+			return false;
+		}
+		uint8_t b = frame[(*pos)++];
+		*v |= (uint32_t)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * @brief Channel value in the units of a v1 frame, which had bar_press in hPa
+ */
+static int32_t v1Channel(const TxdPayload *p, uint8_t i)
+{
+	int32_t v = payloadChannel(p, i);
+	return i == PAYLOAD_CH_BAR_PRESS ? (v + 5) / 10 : v;
+}
+
+static void setV1Channel(TxdPayload *p, uint8_t i, int32_t v)
+{
+	setChannel(p, i, i == PAYLOAD_CH_BAR_PRESS ? v * 10 : v);
+}
+
+/**
+ * @brief Append the aggregate block, values relative to the last sample
+ */
+static uint8_t encodeAggregate(const TxdPayload *cur, const PayloadAggregate *agg, uint8_t *frame, uint8_t pos)
+{
+	pos = putVarint(frame, pos, agg->samples);
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+		{
+			int32_t last = payloadChannel(cur, i);
+			pos = putVarint(frame, pos, zigzag(agg->min[i] - last));
+			pos = putVarint(frame, pos, zigzag(agg->max[i] - last));
+			pos = putVarint(frame, pos, zigzag(agg->mean[i] - last));
+		}
+	}
+	return pos;
+}
+
+static bool decodeAggregate(const uint8_t *frame, uint8_t size, uint8_t *pos, const TxdPayload *p, bool v1,
+							PayloadAggregate *agg)
+{
+	uint32_t v;
+	if (!getVarint(frame, size, pos, &v))
+	{
+		return false;
+	}
+	agg->samples = v;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		int32_t last = v1 ? v1Channel(p, i) : payloadChannel(p, i);
+		agg->min[i] = agg->max[i] = agg->mean[i] = payloadChannel(p, i);
+		if (PAYLOAD_AGGREGATE_MASK & (1 << i))
+		{
+			int32_t *fields[3] = {&agg->min[i], &agg->max[i], &agg->mean[i]};
+			for (uint8_t f = 0; f < 3; f++)
+			{
+				if (!getVarint(frame, size, pos, &v))
+				{
+					return false;
+				}
+				*fields[f] = last + unzigzag(v);
+				if (v1 && i == PAYLOAD_CH_BAR_PRESS)
+				{
+					*fields[f] *= 10;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Append the shock block, all zero if the alarm came without features
+ */
+static uint8_t encodeShock(const PayloadShock *shock, uint8_t *frame, uint8_t pos)
+{
+	PayloadShock none = {0, 0, 0};
+	if (shock == NULL)
+	{
+		shock = &none;
+	}
+	pos = putVarint(frame, pos, shock->peak);
+	pos = putVarint(frame, pos, shock->rms);
+	return putVarint(frame, pos, shock->duration);
+}
+
+static bool decodeShock(const uint8_t *frame, uint8_t size, uint8_t *pos, PayloadShock *shock)
+{
+	uint16_t *fields[3] = {&shock->peak, &shock->rms, &shock->duration};
+	for (uint8_t f = 0; f < 3; f++)
+	{
+		uint32_t v;
+		if (!getVarint(frame, size, pos, &v) || v > UINT16_MAX)
+		{
+			return false;
+		}
+		*fields[f] = v;
+	}
+	return true;
+}
+
+/** Signed channels: temperature, inc_x and inc_y */
+#define PAYLOAD_SIGNED_CHANNELS 0x032
+
+static uint8_t encodeKey(const TxdPayload *cur, uint8_t header, uint8_t *frame)
+{
+	frame[0] = header;
+	frame[1] = cur->id;
+	uint8_t pos = putVarint(frame, 2, cur->sentPackets);
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		int32_t v = payloadChannel(cur, i);
+		pos = putVarint(frame, pos, PAYLOAD_SIGNED_CHANNELS & (1 << i) ? zigzag(v) : (uint32_t)v);
+	}
+	return pos;
+}
+
+/**
+ * @brief Replace the key frame in frame by a delta against ref if that is
+ * shorter, returns the length of whichever is kept
+ */
+static uint8_t encodeDelta(const TxdPayload *cur, const TxdPayload *ref, uint8_t header, uint8_t *frame, uint8_t keyLen)
+{
+	uint8_t delta[PAYLOAD_MAX_SIZE];
+	delta[0] = header | PAYLOAD_FLAG_DELTA;
+	delta[1] = cur->id;
+	uint8_t pos = putVarint(delta, 2, cur->sentPackets);
+	pos = putVarint(delta, pos, (uint16_t)(cur->sentPackets - ref->sentPackets));
+	uint16_t changed = 0;
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (payloadChannel(cur, i) != payloadChannel(ref, i))
+		{
+			changed |= 1 << i;
+		}
+	}
+	pos = putVarint(delta, pos, changed);
+	for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+	{
+		if (changed & (1 << i))
+		{
+			pos = putVarint(delta, pos, zigzag(payloadChannel(cur, i) - payloadChannel(ref, i)));
+		}
+	}
+	if (pos >= keyLen)
+	{
+		return keyLen;
+	}
+	memcpy(frame, delta, pos);
+	return pos;
+}
+
+/**
+ * @brief Encode cur into frame, as a delta against ref or as key frame if ref
+ * is NULL or the delta would not be smaller
+ *
+ * @param cur payload to send
+ * @param ref payload the receiver is known to hold, NULL for a key frame
+ * @param agg statistics of the samples since the last frame, NULL for none
+ * @param shock features of the shock behind cur->accAlarm, NULL sends zeros
+ * @param frame output, at least PAYLOAD_MAX_SIZE bytes
+ * @return uint8_t frame length
+ */
+uint8_t payloadEncode(const TxdPayload *cur, const TxdPayload *ref, const PayloadAggregate *agg,
+					  const PayloadShock *shock, uint8_t *frame)
+{
+	uint8_t header = PAYLOAD_FORMAT_V2 | (agg != NULL ? PAYLOAD_FLAG_AGGREGATE : 0) |
+					 (cur->accAlarm ? PAYLOAD_FLAG_ACC_ALARM : 0) | (cur->iaqAccuracy & PAYLOAD_ACCURACY_MASK);
+	uint8_t pos = encodeKey(cur, header, frame);
+	if (ref != NULL && ref->id == cur->id)
+	{
+		pos = encodeDelta(cur, ref, header, frame, pos);
+	}
+	if (cur->accAlarm)
+	{
+		pos = encodeShock(shock, frame, pos);
+	}
+	return agg != NULL ? encodeAggregate(cur, agg, frame, pos) : pos;
+}
+
+/**
+ * @brief True if frame is a compact delta frame and needs a reference to decode
+ */
+bool payloadIsDelta(const uint8_t *frame, uint8_t size)
+{
+	return payloadIsCompact(frame, size) && (frame[0] & PAYLOAD_FLAG_DELTA);
+}
+
+/**
+ * @brief True if frame is a compact frame of any version, false for legacy
+ */
+bool payloadIsCompact(const uint8_t *frame, uint8_t size)
+{
+	if (size == 0)
+	{
+		return false;
+	}
+	uint8_t format = frame[0] & PAYLOAD_FORMAT_MASK;
+	return format == PAYLOAD_FORMAT_V1 || format == PAYLOAD_FORMAT_V2;
+}
+
+/**
+ * @brief Write cur in the legacy frame layout, PAYLOAD_LEGACY_SIZE bytes
+ */
+void payloadEncodeLegacy(const TxdPayload *cur, uint8_t *frame)
+{
+	// Floor division keeps temp_dec in 0..99, -0.25 degC is -1 + 0.75
+	int16_t tempInt = cur->temperature >= 0 ? cur->temperature / 100 : -((99 - cur->temperature) / 100);
+	uint16_t hPa = (cur->bar_press + 5) / 10;
+	frame[0] = cur->id;
+	frame[1] = cur->bat_perc;
+	frame[2] = (uint8_t)(int8_t)tempInt;
+	frame[3] = (uint8_t)(cur->temperature - tempInt * 100);
+	frame[4] = cur->humidity / 100;
+	frame[5] = cur->humidity % 100;
+	memcpy(&frame[6], &hPa, 2);
+	memcpy(&frame[8], &cur->inc_x, PAYLOAD_LEGACY_SIZE - 8);
+}
+
+static void decodeLegacy(const uint8_t *frame, TxdPayload *out)
+{
+	uint16_t hPa;
+	memcpy(&hPa, &frame[6], 2);
+	out->id = frame[0];
+	out->bat_perc = frame[1];
+	out->temperature = (int8_t)frame[2] * 100 + frame[3];
+	out->humidity = frame[4] * 100 + frame[5];
+	out->bar_press = hPa * 10;
+	memcpy(&out->inc_x, &frame[8], PAYLOAD_LEGACY_SIZE - 8);
+}
+
+/**
+ * @brief Decode a compact or legacy frame
+ *
+ * @param ref last payload decoded from the same node, needed for delta frames
+ * @param agg receives the sample statistics, samples is 0 if the frame has
+ * none, may be NULL
+ * @param shock receives the shock features, all zero if the frame has none,
+ * may be NULL
+ * @return false if the frame is malformed, or is a delta against a frame
+ * other than ref
+ */
+bool payloadDecode(const uint8_t *frame, uint8_t size, const TxdPayload *ref, TxdPayload *out, PayloadAggregate *agg,
+				   PayloadShock *shock)
+{
+	PayloadAggregate aggregate;
+	aggregate.samples = 0;
+	PayloadShock features = {0, 0, 0};
+	if (size < 2)
+	{
+		return false;
+	}
+	if (!payloadIsCompact(frame, size))
+	{
+		if (size != PAYLOAD_LEGACY_SIZE)
+		{
+			return false;
+		}
+		decodeLegacy(frame, out);
+		if (agg != NULL)
+		{
+			*agg = aggregate;
+		}
+		if (shock != NULL)
+		{
+			*shock = features;
+		}
+		return true;
+	}
+
+	uint8_t header = frame[0];
+	bool v1 = (header & PAYLOAD_FORMAT_MASK) == PAYLOAD_FORMAT_V1;
+	uint8_t pos = 2;
+	uint32_t seq, v;
+	if (!getVarint(frame, size, &pos, &seq))
+	{
+		return false;
+	}
+	TxdPayload p;
+	if (header & PAYLOAD_FLAG_DELTA)
+	{
+		uint32_t distance, changed;
+		if (ref == NULL || ref->id != frame[1] || !getVarint(frame, size, &pos, &distance) ||
+			(uint16_t)(seq - distance) != ref->sentPackets || !getVarint(frame, size, &pos, &changed))
+		{
+			return false;
+		}
+		p = *ref;
+		for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+		{
+			if (changed & (1 << i))
+			{
+				if (!getVarint(frame, size, &pos, &v))
+				{
+					return false;
+				}
+				if (v1)
+				{
+					setV1Channel(&p, i, v1Channel(ref, i) + unzigzag(v));
+				}
+				else
+				{
+					setChannel(&p, i, payloadChannel(ref, i) + unzigzag(v));
+				}
+			}
+		}
+	}
+	else
+	{
+		memset(&p, 0, sizeof(p));
+		for (uint8_t i = 0; i < PAYLOAD_CHANNELS; i++)
+		{
+			if (!getVarint(frame, size, &pos, &v))
+			{
+				return false;
+			}
+			if (v1)
+			{
+				setV1Channel(&p, i, (int32_t)v);
+			}
+			else
+			{
+				setChannel(&p, i, PAYLOAD_SIGNED_CHANNELS & (1 << i) ? unzigzag(v) : (int32_t)v);
+			}
+		}
+	}
+	p.id = frame[1];
+	p.sentPackets = seq;
+	p.iaqAccuracy = header & PAYLOAD_ACCURACY_MASK;
+	p.accAlarm = (header & PAYLOAD_FLAG_ACC_ALARM) ? 1 : 0;
+	if (p.accAlarm && !v1 && !decodeShock(frame, size, &pos, &features))
+	{
+		return false;
+	}
+	if ((header & PAYLOAD_FLAG_AGGREGATE) && !decodeAggregate(frame, size, &pos, &p, v1, &aggregate))
+	{
+		return false;
+	}
+	*out = p;
+	if (agg != NULL)
+	{
+		*agg = aggregate;
+	}
+	if (shock != NULL)
+	{
+		*shock = features;
+	}
+	return pos == size;
+}
+
+/**
+ * @brief Node id and sentPackets of an uplink frame without decoding the
+ * channels, what a gateway needs to address its link feedback
+ *
+ * @return false for frames other than a single compact or legacy frame
+ */
+bool payloadUplinkSeq(const uint8_t *frame, uint8_t size, uint8_t *id, uint16_t *seq)
+{
+	if (payloadIsCompact(frame, size))
+	{
+		uint8_t pos = 2;
+		uint32_t v;
+		if (size < 3 || !getVarint(frame, size, &pos, &v) || v > UINT16_MAX)
+		{
+			return false;
+		}
+		*id = frame[1];
+		*seq = v;
+		return true;
+	}
+	if (size != PAYLOAD_LEGACY_SIZE || frame[0] >= PAYLOAD_CHAIN)
+	{
+		return false;
+	}
+	*id = frame[0];
+	*seq = frame[19] | frame[20] << 8;
+	return true;
+}
+
+/**
+ * @brief Write the link feedback downlink for link, a gap report if
+ * link->missing is set
+ *
+ * @param frame output, at least PAYLOAD_GAP_SIZE bytes
+ * @return uint8_t frame length
+ */
+uint8_t payloadEncodeLink(const PayloadLink *link, uint8_t *frame)
+{
+	int16_t rssi = link->rssi > 0 ? 0 : link->rssi < -255 ? -255 : link->rssi;
+	frame[0] = PAYLOAD_DOWNLINK | (link->missing ? PAYLOAD_DOWNLINK_GAP : PAYLOAD_DOWNLINK_LINK);
+	frame[1] = link->id;
+	frame[2] = link->seq & 0xFF;
+	frame[3] = link->seq >> 8;
+	frame[4] = (uint8_t)-rssi;
+	frame[5] = (uint8_t)link->snr;
+	if (!link->missing)
+	{
+		return PAYLOAD_LINK_SIZE;
+	}
+	frame[6] = link->missing & 0xFF;
+	frame[7] = link->missing >> 8;
+	return PAYLOAD_GAP_SIZE;
+}
+
+/**
+ * @brief Decode a link feedback or gap report downlink
+ *
+ * @return false if frame is neither
+ */
+bool payloadDecodeLink(const uint8_t *frame, uint8_t size, PayloadLink *link)
+{
+	bool feedback = size == PAYLOAD_LINK_SIZE && frame[0] == (PAYLOAD_DOWNLINK | PAYLOAD_DOWNLINK_LINK);
+	bool gap = size == PAYLOAD_GAP_SIZE && frame[0] == (PAYLOAD_DOWNLINK | PAYLOAD_DOWNLINK_GAP);
+	if (!feedback && !gap)
+	{
+		return false;
+	}
+	link->id = frame[1];
+	link->seq = frame[2] | frame[3] << 8;
+	link->rssi = -(int16_t)frame[4];
+	link->snr = (int8_t)frame[5];
+	link->missing = gap ? frame[6] | frame[7] << 8 : 0;
+	return true;
+}
+
+/**
+ * @brief Start a command downlink for node id, payloadCommandAdd() adds the
+ * settings
+ *
+ * @param frame output, PAYLOAD_COMMAND_HEADER_SIZE bytes or more
+ * @return uint8_t frame length
+ */
+uint8_t payloadCommandStart(uint8_t *frame, uint8_t id)
+{
+	frame[0] = PAYLOAD_DOWNLINK | PAYLOAD_DOWNLINK_COMMAND;
+	frame[1] = id;
+	return PAYLOAD_COMMAND_HEADER_SIZE;
+}
+
+/**
+ * @brief Append a setting to the command downlink of size bytes, value in
+ * as few bytes as it needs
+ *
+ * @param maxSize size of the frame buffer
+ * @return uint8_t new frame length, 0 if the setting does not fit
+ */
+uint8_t payloadCommandAdd(uint8_t *frame, uint8_t size, uint8_t maxSize, uint8_t tag, uint32_t value)
+{
+	uint8_t len = 1;
+	while (len < 4 && (value >> (8 * len)) != 0)
+	{
+		len++;
+	}
+	if (maxSize < size + 2 + len)
+	{
+		return 0;
+	}
+	frame[size++] = tag;
+	frame[size++] = len;
+	for (uint8_t i = 0; i < len; i++)
+	{
+		frame[size++] = (value >> (8 * i)) & 0xFF;
+	}
+	return size;
+}
+
+/**
+ * @brief Read the setting at pos of a command downlink and move pos to the
+ * next one
+ *
+ * @param pos PAYLOAD_COMMAND_HEADER_SIZE for the first setting
+ * @return false at the end of the frame or if the setting does not fit into it
+ */
+bool payloadCommandNext(const uint8_t *frame, uint8_t size, uint8_t *pos, PayloadCommand *cmd)
+{
+	if (*pos + 2 > size)
+	{
+		return false;
+	}
+	uint8_t len = frame[*pos + 1];
+	if (len < 1 || len > 4 || len > size - *pos - 2)
+	{
+		return false;
+	}
+	cmd->tag = frame[*pos];
+	cmd->value = 0;
+	for (uint8_t i = 0; i < len; i++)
+	{
+		cmd->value |= (uint32_t)frame[*pos + 2 + i] << (8 * i);
+	}
+	*pos += 2 + len;
+	return true;
+}
+
+/**
+ * @brief True if frame is a command downlink whose settings fill it exactly
+ */
+bool payloadIsCommand(const uint8_t *frame, uint8_t size)
+{
+	if (size < PAYLOAD_COMMAND_HEADER_SIZE || frame[0] != (PAYLOAD_DOWNLINK | PAYLOAD_DOWNLINK_COMMAND))
+	{
+		return false;
+	}
+	uint8_t pos = PAYLOAD_COMMAND_HEADER_SIZE;
+	PayloadCommand cmd;
+	while (payloadCommandNext(frame, size, &pos, &cmd))
+	{
+	}
+	return pos == size;
+}
+
+/**
+ * @brief Start an empty chain frame, payloadChainAppend() adds the first record
+ *
+ * @param frame output, PAYLOAD_CHAIN_HEADER_SIZE bytes or more
+ * @return uint8_t frame length
+ */
+uint8_t payloadChainStart(uint8_t *frame, uint8_t sender)
+{
+	frame[0] = PAYLOAD_CHAIN;
+	frame[1] = sender;
+	frame[2] = 0;
+	return PAYLOAD_CHAIN_HEADER_SIZE;
+}
+
+/**
+ * @brief Append the key frame of cur to the chain frame of size bytes in
+ * place, behind the records already there
+ *
+ * @param maxSize size of the frame buffer
+ * @param agg, shock as for payloadEncode()
+ * @param rssi, snr at which the chain frame was received, 0 for a new one
+ * @return uint8_t new frame length, 0 if the record does not fit and frame
+ * is unchanged
+ */
+uint8_t payloadChainAppend(uint8_t *frame, uint8_t size, uint8_t maxSize, const TxdPayload *cur,
+						   const PayloadAggregate *agg, const PayloadShock *shock, int16_t rssi, int8_t snr)
+{
+	if (size < PAYLOAD_CHAIN_HEADER_SIZE ||
+		(frame[0] & PAYLOAD_CHAIN_COUNT_MASK) == PAYLOAD_CHAIN_COUNT_MASK ||
+		maxSize < size + PAYLOAD_CHAIN_RECORD_HEADER_SIZE)
+	{
+		return 0;
+	}
+	uint8_t pos = size + PAYLOAD_CHAIN_RECORD_HEADER_SIZE;
+	if (maxSize - pos < PAYLOAD_MAX_SIZE)
+	{
+		// The tail of the buffer may be too short for the worst case
+		uint8_t record[PAYLOAD_MAX_SIZE];
+		uint8_t len = payloadEncode(cur, NULL, agg, shock, record);
+		return payloadChainAppendFrame(frame, size, maxSize, record, len, rssi, snr);
+	}
+	uint8_t len = payloadEncode(cur, NULL, agg, shock, &frame[pos]);
+	rssi = rssi > 0 ? 0 : rssi < -255 ? -255 : rssi;
+	frame[size] = len;
+	frame[size + 1] = (uint8_t)-rssi;
+	frame[size + 2] = (uint8_t)snr;
+	frame[0]++;
+	return pos + len;
+}
+
+/**
+ * @brief Append an encoded compact key frame to the chain frame of size
+ * bytes, like payloadChainAppend()
+ *
+ * @return uint8_t new frame length, 0 if the record does not fit and frame
+ * is unchanged
+ */
+uint8_t payloadChainAppendFrame(uint8_t *frame, uint8_t size, uint8_t maxSize, const uint8_t *record, uint8_t len,
+								int16_t rssi, int8_t snr)
+{
+	if (size < PAYLOAD_CHAIN_HEADER_SIZE ||
+		(frame[0] & PAYLOAD_CHAIN_COUNT_MASK) == PAYLOAD_CHAIN_COUNT_MASK ||
+		maxSize < size + PAYLOAD_CHAIN_RECORD_HEADER_SIZE + len)
+	{
+		return 0;
+	}
+	uint8_t pos = size + PAYLOAD_CHAIN_RECORD_HEADER_SIZE;
+	memcpy(&frame[pos], record, len);
+	rssi = rssi > 0 ? 0 : rssi < -255 ? -255 : rssi;
+	frame[size] = len;
+	frame[size + 1] = (uint8_t)-rssi;
+	frame[size + 2] = (uint8_t)snr;
+	frame[0]++;
+	return pos + len;
+}
+
+/**
+ * @brief Make frame the next hop's, sent by sender
+ */
+void payloadChainForward(uint8_t *frame, uint8_t sender)
+{
+	frame[1] = sender;
+	frame[2] = frame[2] < UINT8_MAX ? frame[2] + 1 : UINT8_MAX;
+}
+
+/**
+ * @brief Read the record at pos of a chain frame and move pos to the next
+ * one, start with pos = PAYLOAD_CHAIN_HEADER_SIZE
+ *
+ * @return false at the end of the frame or if the record does not fit into it
+ */
+bool payloadChainNext(const uint8_t *frame, uint8_t size, uint8_t *pos, PayloadChainRecord *rec)
+{
+	if (*pos + PAYLOAD_CHAIN_RECORD_HEADER_SIZE > size ||
+		frame[*pos] > size - *pos - PAYLOAD_CHAIN_RECORD_HEADER_SIZE)
+	{
+		return false;
+	}
+	rec->size = frame[*pos];
+	rec->rssi = -(int16_t)frame[*pos + 1];
+	rec->snr = (int8_t)frame[*pos + 2];
+	rec->frame = &frame[*pos + PAYLOAD_CHAIN_RECORD_HEADER_SIZE];
+	*pos += PAYLOAD_CHAIN_RECORD_HEADER_SIZE + rec->size;
+	return true;
+}
+
+/**
+ * @brief True if frame is a chain frame whose records fill it exactly
+ */
+bool payloadIsChain(const uint8_t *frame, uint8_t size)
+{
+	if (size < PAYLOAD_CHAIN_HEADER_SIZE || (frame[0] & PAYLOAD_CHAIN_MASK) != PAYLOAD_CHAIN ||
+		(frame[0] & PAYLOAD_CHAIN_COUNT_MASK) == 0)
+	{
+		return false;
+	}
+	uint8_t pos = PAYLOAD_CHAIN_HEADER_SIZE;
+	uint8_t records = 0;
+	PayloadChainRecord rec;
+	while (payloadChainNext(frame, size, &pos, &rec))
+	{
+		if (!payloadIsCompact(rec.frame, rec.size))
+		{
+			return false;
+		}
+		records++;
+	}
+	return pos == size && records == (frame[0] & PAYLOAD_CHAIN_COUNT_MASK);
+}
@@ -0,0 +1,236 @@
+/**
+ * @file payload.h
+ * @brief Uplink payload and its compact over-the-air encoding
+ *
+ * Plain C++ without Arduino dependencies, so the host decoder in decoders/
+ * builds from the same source as the node.
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct __attribute__((packed)) TxdPayload{
+		uint8_t id;	             // Device ID
+		uint8_t bat_perc;		 // Battery percentage
+		int16_t temperature;     // Temperature in centi-degC
+		uint16_t humidity;		 // Relative humidity in centi-%RH
+		uint16_t bar_press;		 // Barometric pressure in Pa/10
+		int8_t inc_x;            // Tilt of the x axis, -90..90 deg
+		int8_t inc_y;            // Tilt of the y axis, -90..90 deg
+		uint8_t inc_z;           // Tilt of the z axis from vertical, 0..180 deg
+		uint16_t iaq; //iaq value
+		uint8_t iaqAccuracy; //iaq status (0-1-2)
+		uint16_t co2equivalent; //co2 estimation ppm
+		uint16_t breathVocEquivalent; //breath voc
+		uint8_t gasPercentage;
+		uint16_t sentPackets; //number of sent packets since last startup
+		uint8_t accAlarm;   //accelerometer alarm flag
+		//String code = "wmn24";
+	};
+
+/*
+ * Compact frame, format v2:
+ *   header   0xE0 | aggregate << 4 | delta << 3 | accAlarm << 2 | iaqAccuracy
+ *   id       raw byte
+ *   seq      varint, sentPackets
+ *   key frame:   varint of every channel below, in order, zig-zag for the
+ *                signed temperature, inc_x and inc_y
+ *   delta frame: varint seq distance to the reference frame,
+ *                varint bitmask of changed channels,
+ *                zig-zag varint difference of each changed channel
+ *   shock block, if accAlarm: varint peak, rms and duration of the
+ *                PayloadShock that raised the alarm
+ *   aggregate block, if flagged: varint sample count, then for each channel
+ *                in PAYLOAD_AGGREGATE_MASK zig-zag varint min, max and
+ *                mean, each as difference to the channel value above
+ * Channels: bat_perc, temperature (centi-degC), humidity (centi-%RH),
+ * bar_press (Pa/10), inc_x, inc_y, inc_z, iaq, co2equivalent,
+ * breathVocEquivalent, gasPercentage
+ *
+ * Format v1 (header 0xC0) is the same with bar_press in hPa, temperature,
+ * inc_x and inc_y as plain varint and no shock block, it is still decoded.
+ *
+ * Legacy frames are the 22 byte TxdPayload layout of the first firmware and
+ * start with the node id, so node ids 0xC0..0xFF are reserved while both
+ * formats are in the field (and 0xA0..0xBF for the chain and downlink frames
+ * below):
+ *   id, bat_perc, temp_int (int8, floor), temp_dec (0..99), humidity_int,
+ *   humidity_dec, bar_press (hPa, 16 bit), inc_x (int8), inc_y (int8),
+ *   inc_z, iaq:16,
+ *   iaqAccuracy, co2equivalent:16, breathVocEquivalent:16, gasPercentage,
+ *   sentPackets:16, accAlarm
+ */
+#define PAYLOAD_FORMAT_V1 0xC0
+#define PAYLOAD_FORMAT_V2 0xE0
+#define PAYLOAD_FORMAT_MASK 0xE0
+#define PAYLOAD_FLAG_AGGREGATE 0x10
+#define PAYLOAD_FLAG_DELTA 0x08
+#define PAYLOAD_FLAG_ACC_ALARM 0x04
+#define PAYLOAD_ACCURACY_MASK 0x03
+#define PAYLOAD_LEGACY_SIZE 22
+#define PAYLOAD_CHANNELS 11
+/* Channels of payloadChannel(), in frame order */
+enum PayloadChannelId
+{
+	PAYLOAD_CH_BAT_PERC,
+	PAYLOAD_CH_TEMPERATURE,
+	PAYLOAD_CH_HUMIDITY,
+	PAYLOAD_CH_BAR_PRESS,
+	PAYLOAD_CH_INC_X,
+	PAYLOAD_CH_INC_Y,
+	PAYLOAD_CH_INC_Z,
+	PAYLOAD_CH_IAQ,
+	PAYLOAD_CH_CO2,
+	PAYLOAD_CH_VOC,
+	PAYLOAD_CH_GAS
+};
+/* Environmental channels that carry min/max/mean: T, H, P, iaq, co2, voc, gas */
+#define PAYLOAD_AGGREGATE_MASK 0x78E
+#define PAYLOAD_AGGREGATE_CHANNELS 7
+/* Worst case: header, id, 3 byte seq, 3 bytes per channel, the shock block
+ * with 3 values of up to 3 bytes, then the aggregate block with 3 byte count
+ * and 3 values of up to 5 bytes each */
+#define PAYLOAD_MAX_SIZE (5 + 3 * PAYLOAD_CHANNELS + 9 + 3 + 15 * PAYLOAD_AGGREGATE_CHANNELS)
+/* Every n-th frame is a key frame, bounds how long a lost frame hurts */
+#define PAYLOAD_KEYFRAME_INTERVAL 8
+
+/*
+ * Downlink, gateway to node, header 0xB0 | type. Legacy uplinks start with
+ * the node id, so node ids 0xB0..0xBF are reserved as well.
+ *   type 0, link feedback, PAYLOAD_LINK_SIZE bytes:
+ *     id, seq:16 of the uplink it was measured on, RSSI as -dBm (uint8),
+ *     SNR in dB (int8)
+ *   type 1, gap report, PAYLOAD_GAP_SIZE bytes: link feedback, then
+ *     missing:16, bit i set if uplink seq-1-i did not arrive. The gateway
+ *     sends it instead of the link feedback while it misses uplinks
+ *   type 2, command, PAYLOAD_COMMAND_HEADER_SIZE bytes or more: id, then
+ *     settings as tag, length 1..4 and an unsigned little-endian value of
+ *     that length, applied in order by command.cpp:
+ *       1 SEND_INTERVAL in s
+ *       2 battery and tilt read period (SLEEP_TIME) in ms
+ *       3 BSEC sample rate, 0 LP (3 s), 1 ULP (300 s), 2 rate policy
+ *       4 radio profile, index into the table of lora.cpp
+ *       5 listen with the RX duty cycle between uplinks, 0 or 1
+ */
+#define PAYLOAD_DOWNLINK 0xB0
+#define PAYLOAD_DOWNLINK_MASK 0xF0
+#define PAYLOAD_DOWNLINK_TYPE_MASK 0x0F
+#define PAYLOAD_DOWNLINK_LINK 0x00
+#define PAYLOAD_DOWNLINK_GAP 0x01
+#define PAYLOAD_DOWNLINK_COMMAND 0x02
+#define PAYLOAD_LINK_SIZE 6
+#define PAYLOAD_GAP_SIZE 8
+/* Uplinks before the acknowledged one a gap report covers */
+#define PAYLOAD_GAP_WINDOW 16
+#define PAYLOAD_COMMAND_HEADER_SIZE 2
+#define PAYLOAD_CMD_SEND_INTERVAL 0x01
+#define PAYLOAD_CMD_SLEEP_TIME 0x02
+#define PAYLOAD_CMD_BSEC_RATE 0x03
+#define PAYLOAD_CMD_RADIO_PROFILE 0x04
+#define PAYLOAD_CMD_LISTEN 0x05
+/* Largest downlink, a command with a 4 byte value for every tag */
+#define PAYLOAD_DOWNLINK_MAX_SIZE (PAYLOAD_COMMAND_HEADER_SIZE + 6 * PAYLOAD_CMD_LISTEN)
+/* The gateway starts its downlink this long (ms) after the uplink ended */
+#define PAYLOAD_DOWNLINK_DELAY_MS 20
+
+/*
+ * Chain frame, the compact frames of a line of relaying nodes (main.h
+ * IS_CHAIN_ELEMENT), node ids 0xA0..0xAF are reserved as well:
+ *   header   0xA0 | number of records, 1..15
+ *   sender   node id that sent this hop
+ *   hops     times the frame was forwarded
+ *   records, oldest first: length, RSSI as -dBm (uint8) and SNR in dB
+ *            (int8) at which the node that added the record received the
+ *            frame, 0 and 0 for the node that started it, then a compact
+ *            key frame of that length
+ * Relays append their record to the frame they received and send it on,
+ * the chain frame never holds delta frames. A node resends the uplinks a
+ * gap report lists (main.h PAYLOAD_RETX) as a chain frame of its own with
+ * hop count 0, one record per uplink.
+ */
+#define PAYLOAD_CHAIN 0xA0
+#define PAYLOAD_CHAIN_MASK 0xF0
+#define PAYLOAD_CHAIN_COUNT_MASK 0x0F
+#define PAYLOAD_CHAIN_HEADER_SIZE 3
+#define PAYLOAD_CHAIN_RECORD_HEADER_SIZE 3
+/* Largest frame the SX126x sends */
+#define PAYLOAD_CHAIN_MAX_SIZE 255
+
+/**
+ * @brief Statistics of the samples taken since the last frame, indexed by
+ * channel, only channels in PAYLOAD_AGGREGATE_MASK are used
+ */
+struct PayloadAggregate
+{
+	uint16_t samples;
+	int32_t min[PAYLOAD_CHANNELS];
+	int32_t max[PAYLOAD_CHANNELS];
+	int32_t mean[PAYLOAD_CHANNELS];
+};
+
+/**
+ * @brief Features of the accelerometer FIFO window around a shock, deviation
+ * of |a| from the 1 g at rest
+ */
+struct PayloadShock
+{
+	uint16_t peak;	   // largest deviation, mg
+	uint16_t rms;	   // RMS deviation over the window, mg
+	uint16_t duration; // time the deviation was above the node's threshold, ms
+};
+
+/**
+ * @brief Gateway measurement of one uplink
+ */
+struct PayloadLink
+{
+	uint8_t id;	  // node the feedback is for
+	uint16_t seq; // sentPackets of the uplink
+	int16_t rssi; // dBm
+	int8_t snr;	  // dB
+	uint16_t missing; // gap report, bit i: uplink seq-1-i did not arrive
+};
+
+/**
+ * @brief One setting of a command downlink
+ */
+struct PayloadCommand
+{
+	uint8_t tag;	// PAYLOAD_CMD_*
+	uint32_t value;
+};
+
+/**
+ * @brief One record of a chain frame, frame points into the chain frame
+ */
+struct PayloadChainRecord
+{
+	const uint8_t *frame; // compact key frame
+	uint8_t size;
+	int16_t rssi; // dBm at which the record's node received the chain frame, 0 for the first
+	int8_t snr;	  // dB
+};
+
+uint8_t payloadEncode(const TxdPayload *cur, const TxdPayload *ref, const PayloadAggregate *agg,
+					  const PayloadShock *shock, uint8_t *frame);
+bool payloadDecode(const uint8_t *frame, uint8_t size, const TxdPayload *ref, TxdPayload *out, PayloadAggregate *agg,
+				   PayloadShock *shock);
+int32_t payloadChannel(const TxdPayload *p, uint8_t i);
+bool payloadIsDelta(const uint8_t *frame, uint8_t size);
+bool payloadIsCompact(const uint8_t *frame, uint8_t size);
+void payloadEncodeLegacy(const TxdPayload *cur, uint8_t *frame);
+bool payloadUplinkSeq(const uint8_t *frame, uint8_t size, uint8_t *id, uint16_t *seq);
+uint8_t payloadEncodeLink(const PayloadLink *link, uint8_t *frame);
+bool payloadDecodeLink(const uint8_t *frame, uint8_t size, PayloadLink *link);
+uint8_t payloadCommandStart(uint8_t *frame, uint8_t id);
+uint8_t payloadCommandAdd(uint8_t *frame, uint8_t size, uint8_t maxSize, uint8_t tag, uint32_t value);
+bool payloadIsCommand(const uint8_t *frame, uint8_t size);
+bool payloadCommandNext(const uint8_t *frame, uint8_t size, uint8_t *pos, PayloadCommand *cmd);
+uint8_t payloadChainStart(uint8_t *frame, uint8_t sender);
+uint8_t payloadChainAppend(uint8_t *frame, uint8_t size, uint8_t maxSize, const TxdPayload *cur,
+						   const PayloadAggregate *agg, const PayloadShock *shock, int16_t rssi, int8_t snr);
+uint8_t payloadChainAppendFrame(uint8_t *frame, uint8_t size, uint8_t maxSize, const uint8_t *record, uint8_t len,
+								int16_t rssi, int8_t snr);
+void payloadChainForward(uint8_t *frame, uint8_t sender);
+bool payloadIsChain(const uint8_t *frame, uint8_t size);
+bool payloadChainNext(const uint8_t *frame, uint8_t size, uint8_t *pos, PayloadChainRecord *rec);
@@ -0,0 +1,103 @@
+/**
+ * @file radioprofile.h
+ * @brief Compile time LoRa radio profiles of lora.cpp
+ *
+ * A profile holds the channel, modulation and RX duty cycle of a build, the
+ * timings follow from it as constexpr members. checkedProfile() of lora.cpp
+ * is instantiated for the profile named by RADIO_PROFILE and for each one a
+ * command downlink may switch to, and rejects an invalid one with a
+ * static_assert. Select another profile with a build flag, see the
+ * wiscore_rak4631_long_range, wiscore_rak4631_low_latency and
+ * wiscore_rak4631_chain environments:
+ *
+ *   -DRADIO_PROFILE=radioProfileLongRange
+ */
+#pragma once
+
+#include "airtime.h"
+#include "payload.h"
+
+/* Margin of the link RX window over the gateway's delay and its downlink, ms */
+#define RADIO_LINK_MARGIN_MS 20
+
+struct RadioProfile
+{
+	uint32_t frequency;			 // Hz
+	int8_t txPower;				 // dBm, the most link adaptation may use
+	uint8_t bandwidth;			 // 0: 125 kHz, 1: 250 kHz, 2: 500 kHz
+	uint8_t sf;					 // SF7..SF12
+	uint8_t codingRate;			 // 1: 4/5, 2: 4/6, 3: 4/7, 4: 4/8
+	uint16_t preamble;			 // symbols, same for TX and RX
+	uint16_t symbolTimeout;		 // symbols
+	uint16_t rxDutyRxSymbols;	 // RX duty cycle, listen window
+	uint16_t rxDutySleepSymbols; // RX duty cycle, sleep between two windows
+	uint16_t txTimeoutMs;
+
+	constexpr uint32_t symbolUs() const
+	{
+		return airtimeSymbolUs(sf, bandwidth);
+	}
+
+	constexpr uint32_t preambleUs() const
+	{
+		return airtimePreambleUs(sf, bandwidth, preamble);
+	}
+
+	/** Time on air of a len byte frame with CRC and explicit header */
+	constexpr uint32_t frameMs(uint8_t len) const
+	{
+		return airtimeMs(sf, bandwidth, codingRate, preamble, len, true, false);
+	}
+
+	/** RX window after an uplink at linkSf, long enough for the gateway's
+	 * delay and its longest downlink on the same SF */
+	constexpr uint32_t linkWindowMs(uint8_t linkSf) const
+	{
+		return PAYLOAD_DOWNLINK_DELAY_MS +
+			   airtimeMs(linkSf, bandwidth, codingRate, preamble, PAYLOAD_DOWNLINK_MAX_SIZE, true, false) +
+			   RADIO_LINK_MARGIN_MS;
+	}
+
+	/** RX duty cycle periods in the 15.625 us steps of Radio.SetRxDutyCycle() */
+	constexpr uint32_t rxDutyRxTicks() const
+	{
+		return (uint32_t)((uint64_t)rxDutyRxSymbols * symbolUs() * 64 / 1000);
+	}
+
+	constexpr uint32_t rxDutySleepTicks() const
+	{
+		return (uint32_t)((uint64_t)rxDutySleepSymbols * symbolUs() * 64 / 1000);
+	}
+
+	/** Lowest and highest frequency the signal occupies */
+	constexpr uint32_t lowEdgeHz() const
+	{
+		return frequency - airtimeBandwidthHz(bandwidth) / 2;
+	}
+
+	constexpr uint32_t highEdgeHz() const
+	{
+		return frequency + airtimeBandwidthHz(bandwidth) / 2;
+	}
+};
+
+/* EU868 sub-band g1, the 1 % of dutycycle.h */
+#define RADIO_SUBBAND_LOW_HZ 868000000UL
+#define RADIO_SUBBAND_HIGH_HZ 868600000UL
+
+/** SF7 at 125 kHz, what every node used so far */
+constexpr RadioProfile radioProfileDefault = {868300000UL, 22, 0, 7, 1, 8, 0, 4, 330, 3000};
+/** SF12 at 125 kHz, 12.5 dB more link budget for 23 times the airtime of a 20 byte frame */
+constexpr RadioProfile radioProfileLongRange = {868300000UL, 22, 0, 12, 1, 8, 0, 4, 10, 7000};
+/** SF7 at 500 kHz, a quarter of the airtime and RX duty cycle period for 6 dB less link budget */
+constexpr RadioProfile radioProfileLowLatency = {868300000UL, 22, 2, 7, 1, 8, 0, 4, 330, 3000};
+/** SF7 at 125 kHz for IS_CHAIN_ELEMENT, which listen with the RX duty cycle:
+ * the 128 symbol preamble spans a 120 symbol sleep and two listen windows */
+constexpr RadioProfile radioProfileChain = {868300000UL, 22, 0, 7, 1, 128, 0, 4, 120, 3000};
+
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE radioProfileDefault
+#endif
+
+static_assert(radioProfileDefault.symbolUs() == 1024 && radioProfileDefault.preambleUs() == 12544,
+			  "SF7 at 125 kHz: 1.024 ms symbols, 8 + 4.25 symbol preamble");
@@ -0,0 +1,148 @@
+/**
+ * @file ratepolicy.h
+ * @brief BSEC sample rate policy of main.cpp: LP (3 s) or ULP (300 s)
+ *
+ * The BME68x heater runs for every sample, so the sample rate sets the
+ * node's largest constant current draw. The policy drops to ULP once the
+ * battery is low and the IAQ has been stable for RATE_STABLE_MS, and goes
+ * back to LP at once when
+ * - the IAQ moves by more than RATE_IAQ_STEP within RATE_SLOPE_WINDOW_MS,
+ * - the accelerometer raises an alarm, LP is then kept for RATE_ALARM_HOLD_MS,
+ * - or the battery recovers to RATE_BATT_OK.
+ * A command downlink can force either rate instead (rateForce()).
+ *
+ * rateUpdate() reports transitions only, the caller re-subscribes BSEC on
+ * those and never for a sample that keeps the rate.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Battery percent at or below which ULP is allowed, and at or above which LP returns */
+#define RATE_BATT_LOW 30
+#define RATE_BATT_OK 40
+/* IAQ change within RATE_SLOPE_WINDOW_MS that counts as a slope, one ULP period */
+#define RATE_IAQ_STEP 15
+#define RATE_SLOPE_WINDOW_MS 300000UL
+/* Time without a slope before ULP */
+#define RATE_STABLE_MS 1800000UL
+/* Time LP is kept after an accelerometer alarm */
+#define RATE_ALARM_HOLD_MS 1800000UL
+/* IAQ accuracy below which the IAQ is not trusted to be stable, the sensor is in its run-in */
+#define RATE_MIN_ACCURACY 1
+
+enum
+{
+	RATE_AUTO, // the policy decides
+	RATE_LP,   // forced by command
+	RATE_ULP
+};
+
+struct RatePolicy
+{
+	bool ulp;			  // current rate
+	uint8_t mode;		  // RATE_AUTO, RATE_LP or RATE_ULP
+	uint16_t iaqRef;	  // IAQ at the start of the slope window
+	uint32_t refAt;		  // millis() of iaqRef
+	uint32_t stableSince; // millis() of the last slope
+	uint32_t holdUntil;	  // millis() until which an alarm keeps LP
+	bool hold;
+	uint32_t toUlp;	  // transitions to ULP
+	uint32_t slopes;  // transitions to LP for an IAQ slope
+	uint32_t alarms;  // transitions to LP for an alarm
+	uint32_t charged; // transitions to LP for a recovered battery
+	uint32_t forced;  // transitions by command
+};
+
+static inline void rateInit(RatePolicy *p, uint32_t now)
+{
+	*p = RatePolicy();
+	p->refAt = now;
+	p->stableSince = now;
+}
+
+/**
+ * @brief Take a forced rate or RATE_AUTO from a command
+ *
+ * @return true if the rate changes
+ */
+static inline bool rateForce(RatePolicy *p, uint8_t mode)
+{
+	p->mode = mode;
+	bool ulp = mode == RATE_AUTO ? p->ulp : mode == RATE_ULP;
+	if (ulp == p->ulp)
+	{
+		return false;
+	}
+	p->ulp = ulp;
+	p->forced++;
+	return true;
+}
+
+/**
+ * @brief Feed a sample or an alarm to the policy
+ *
+ * @param iaq IAQ of the last sample
+ * @param battery battery level in percent
+ * @param alarm an accelerometer alarm is being sent
+ * @return true if the rate changes, the new one is p->ulp
+ */
+static inline bool rateUpdate(RatePolicy *p, uint32_t now, uint16_t iaq, uint8_t accuracy, uint8_t battery,
+							  bool alarm)
+{
+	int32_t step = (int32_t)iaq - p->iaqRef;
+	bool slope = step > RATE_IAQ_STEP || step < -RATE_IAQ_STEP;
+	if (slope || accuracy < RATE_MIN_ACCURACY)
+	{
+		p->stableSince = now;
+		p->iaqRef = iaq;
+		p->refAt = now;
+	}
+	else if (now - p->refAt >= RATE_SLOPE_WINDOW_MS)
+	{
+		// A slow drift does not add up to a slope
+		p->iaqRef = iaq;
+		p->refAt = now;
+	}
+	if (alarm)
+	{
+		p->hold = true;
+		p->holdUntil = now + RATE_ALARM_HOLD_MS;
+	}
+	else if (p->hold && (int32_t)(now - p->holdUntil) >= 0)
+	{
+		p->hold = false;
+	}
+	if (p->mode != RATE_AUTO)
+	{
+		return false;
+	}
+
+	bool ulp = p->ulp;
+	if (!ulp)
+	{
+		ulp = !p->hold && battery <= RATE_BATT_LOW && now - p->stableSince >= RATE_STABLE_MS;
+		p->toUlp += ulp;
+	}
+	else if (alarm)
+	{
+		ulp = false;
+		p->alarms++;
+	}
+	else if (slope)
+	{
+		ulp = false;
+		p->slopes++;
+	}
+	else if (battery >= RATE_BATT_OK)
+	{
+		ulp = false;
+		p->charged++;
+	}
+	if (ulp == p->ulp)
+	{
+		return false;
+	}
+	p->ulp = ulp;
+	return true;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file retx.h
+ * @brief Retransmission queue of lora.cpp: the last uplinks, kept until the
+ * gateway's gap report asks for them again
+ *
+ * Every uplink goes into the queue as a compact key frame under its
+ * sequence number, sentPackets, also when it went out as a delta frame:
+ * the gateway has lost its delta reference when it asks for it. The gateway
+ * answers an uplink with a gap report (PAYLOAD_DOWNLINK_GAP in payload.h)
+ * while uplinks before it are missing. retxCollect() picks the reported
+ * ones that are still in the queue, each at most RETX_TRIES times. The
+ * oldest uplink leaves the queue when a new one needs its entry.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "payload.h"
+
+/* Uplinks kept, PAYLOAD_GAP_WINDOW at most, a gap report does not reach further */
+#define RETX_QUEUE 8
+/* Times an uplink is resent at most */
+#define RETX_TRIES 2
+
+struct RetxEntry
+{
+	uint16_t seq;
+	uint8_t len; // 0: entry unused
+	uint8_t tries;
+	uint8_t frame[PAYLOAD_MAX_SIZE]; // compact key frame
+};
+
+struct RetxQueue
+{
+	RetxEntry entry[RETX_QUEUE];
+	uint8_t newest;		// entry of the last retxPut()
+	uint32_t requested; // uplinks gap reports asked for
+	uint32_t resent;	// uplinks sent again
+	uint32_t gone;		// asked for but no longer in the queue or out of tries
+};
+
+static_assert(RETX_QUEUE <= PAYLOAD_GAP_WINDOW, "retx: entries beyond the gap report window are never asked for");
+
+static inline void retxInit(RetxQueue *q)
+{
+	*q = RetxQueue();
+}
+
+/**
+ * @brief Entry for the key frame of uplink seq, the one of the last call if
+ * it had the same seq: that frame did not go out and seq was not used up
+ */
+static inline RetxEntry *retxPut(RetxQueue *q, uint16_t seq)
+{
+	RetxEntry *e = &q->entry[q->newest];
+	if (e->len == 0 || e->seq != seq)
+	{
+		q->newest = (q->newest + 1) % RETX_QUEUE;
+		e = &q->entry[q->newest];
+	}
+	e->seq = seq;
+	e->len = 0;
+	e->tries = 0;
+	return e;
+}
+
+/**
+ * @brief The entries of the uplinks a gap report for seq lists as missing,
+ * oldest first
+ *
+ * @param out up to RETX_QUEUE entries
+ * @return uint8_t number of entries in out
+ */
+static inline uint8_t retxCollect(RetxQueue *q, uint16_t seq, uint16_t missing, RetxEntry **out)
+{
+	uint8_t n = 0;
+	// Oldest first, the entry after the newest one
+	for (uint8_t i = 1; i <= RETX_QUEUE; i++)
+	{
+		RetxEntry *e = &q->entry[(q->newest + i) % RETX_QUEUE];
+		uint16_t back = seq - 1 - e->seq;
+		if (e->len == 0 || back >= PAYLOAD_GAP_WINDOW || !(missing & (1U << back)))
+		{
+			continue;
+		}
+		missing &= ~(1U << back);
+		q->requested++;
+		if (e->tries >= RETX_TRIES)
+		{
+			q->gone++;
+			continue;
+		}
+		out[n++] = e;
+	}
+	// Reported uplinks without an entry
+	for (; missing; missing &= missing - 1)
+	{
+		q->requested++;
+		q->gone++;
+	}
+	return n;
+}
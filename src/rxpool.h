@@ -0,0 +1,123 @@
+/**
+ * @file rxpool.h
+ * @brief Receive frame pool between the radio's RxDone callback and the
+ * loop task
+ *
+ * RX_POOL_SLOTS preallocated slots of the largest SX126x frame. The RxDone
+ * callback copies the frame out of the driver's buffer, which the next
+ * reception overwrites, into a free slot and wakes the loop task. The loop
+ * task parses the frame in place and releases the slot when done, a chain
+ * element keeps it while it forwards the frame from it. With two slots the
+ * radio receives into one while the loop task works on the other. A frame
+ * that finds no free slot is counted and dropped.
+ *
+ * One writer (the radio callback) and one reader (the loop task): a slot
+ * goes FREE -> READY on the writer side only, READY -> BUSY -> FREE on the
+ * reader side only, each step is a single atomic store.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define RX_POOL_SLOTS 2
+/* Largest frame the SX126x receives */
+#define RX_POOL_FRAME_SIZE 255
+
+enum
+{
+	RX_SLOT_FREE,
+	RX_SLOT_READY, // filled by the radio callback, waits for the loop task
+	RX_SLOT_BUSY   // taken by the loop task
+};
+
+struct RxSlot
+{
+	uint8_t frame[RX_POOL_FRAME_SIZE];
+	uint8_t len;
+	int16_t rssi;	 // dBm
+	int8_t snr;		 // dB
+	uint32_t seq;	 // arrival order
+	uint32_t at;	 // millis() of RxDone
+	uint8_t state;
+};
+
+struct RxPool
+{
+	RxSlot slot[RX_POOL_SLOTS];
+	uint32_t received; // frames put into a slot
+	uint32_t overruns; // frames dropped, no free slot
+	uint32_t maxWait;  // longest RxDone to rxPoolTake(), ms
+};
+
+static inline void rxPoolInit(RxPool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+}
+
+static inline uint8_t rxSlotState(const RxSlot *slot)
+{
+	return __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void rxSlotSetState(RxSlot *slot, uint8_t state)
+{
+	__atomic_store_n(&slot->state, state, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Radio callback side: copy a received frame into a free slot
+ *
+ * @param now millis()
+ * @return false if the frame was dropped, all slots in use or too long
+ */
+static inline bool rxPoolPut(RxPool *pool, const uint8_t *frame, uint16_t len, int16_t rssi, int8_t snr,
+							 uint32_t now)
+{
+	for (uint8_t i = 0; i < RX_POOL_SLOTS && len <= RX_POOL_FRAME_SIZE; i++)
+	{
+		RxSlot *slot = &pool->slot[i];
+		if (rxSlotState(slot) != RX_SLOT_FREE)
+		{
+			continue;
+		}
+		memcpy(slot->frame, frame, len);
+		slot->len = len;
+		slot->rssi = rssi;
+		slot->snr = snr;
+		slot->seq = pool->received++;
+		slot->at = now;
+		rxSlotSetState(slot, RX_SLOT_READY);
+		return true;
+	}
+	pool->overruns++;
+	return false;
+}
+
+/**
+ * @brief Loop task side: the oldest received frame, NULL if there is none.
+ * The slot stays the caller's until rxPoolRelease()
+ */
+static inline RxSlot *rxPoolTake(RxPool *pool, uint32_t now)
+{
+	RxSlot *oldest = NULL;
+	for (uint8_t i = 0; i < RX_POOL_SLOTS; i++)
+	{
+		RxSlot *slot = &pool->slot[i];
+		if (rxSlotState(slot) == RX_SLOT_READY && (oldest == NULL || (int32_t)(slot->seq - oldest->seq) < 0))
+		{
+			oldest = slot;
+		}
+	}
+	if (oldest != NULL)
+	{
+		rxSlotSetState(oldest, RX_SLOT_BUSY);
+		pool->maxWait = now - oldest->at > pool->maxWait ? now - oldest->at : pool->maxWait;
+	}
+	return oldest;
+}
+
+static inline void rxPoolRelease(RxSlot *slot)
+{
+	rxSlotSetState(slot, RX_SLOT_FREE);
+}
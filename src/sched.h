@@ -0,0 +1,182 @@
+/**
+ * @file sched.h
+ * @brief Deadline scheduler of the loop task: the periodic jobs of main.cpp
+ * and the one wakeup timer that serves them
+ *
+ * A job is due from its due time on and should have run by its deadline, due
+ * plus the slack it tolerates. The pending jobs sit in a min-heap on the
+ * deadline, so the wakeup timer is programmed for the top one only. Every
+ * wake takes all jobs that are due by then, SCHED_EARLY_MS ahead included:
+ * a job with slack rides along with an earlier wake of another job instead
+ * of waking the CPU itself.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define SCHED_JOBS 8
+/* pos[] of a job that is not pending */
+#define SCHED_IDLE 0xFF
+
+struct Scheduler
+{
+	uint32_t due[SCHED_JOBS];	   // earliest run time of each job, kept after it was taken
+	uint32_t deadline[SCHED_JOBS]; // latest run time
+	uint8_t heap[SCHED_JOBS];	   // pending jobs, min-heap on deadline
+	uint8_t pos[SCHED_JOBS];	   // heap index of each job, SCHED_IDLE if not pending
+	uint8_t count;
+	uint32_t wakes;		// schedTake() calls that took a job
+	uint32_t jobs;		// jobs taken
+	uint32_t coalesced; // jobs that ran in the wake of another one
+	uint32_t maxLate;	// longest time a job was taken after its deadline, ms
+};
+
+static inline void schedInit(Scheduler *s)
+{
+	*s = Scheduler();
+	for (uint8_t i = 0; i < SCHED_JOBS; i++)
+	{
+		s->pos[i] = SCHED_IDLE;
+	}
+}
+
+static inline bool schedBefore(const Scheduler *s, uint8_t a, uint8_t b)
+{
+	return (int32_t)(s->deadline[s->heap[a]] - s->deadline[s->heap[b]]) < 0;
+}
+
+static inline void schedSwap(Scheduler *s, uint8_t a, uint8_t b)
+{
+	uint8_t job = s->heap[a];
+	s->heap[a] = s->heap[b];
+	s->heap[b] = job;
+	s->pos[s->heap[a]] = a;
+	s->pos[s->heap[b]] = b;
+}
+
+static inline void schedSiftUp(Scheduler *s, uint8_t i)
+{
+	while (i > 0 && schedBefore(s, i, (i - 1) / 2))
+	{
+		schedSwap(s, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static inline void schedSiftDown(Scheduler *s, uint8_t i)
+{
+	for (;;)
+	{
+		uint8_t min = i;
+		uint8_t l = 2 * i + 1;
+		uint8_t r = l + 1;
+		if (l < s->count && schedBefore(s, l, min))
+		{
+			min = l;
+		}
+		if (r < s->count && schedBefore(s, r, min))
+		{
+			min = r;
+		}
+		if (min == i)
+		{
+			return;
+		}
+		schedSwap(s, i, min);
+		i = min;
+	}
+}
+
+static inline bool schedPending(const Scheduler *s, uint8_t job)
+{
+	return s->pos[job] != SCHED_IDLE;
+}
+
+static inline void schedCancel(Scheduler *s, uint8_t job)
+{
+	uint8_t i = s->pos[job];
+	if (i == SCHED_IDLE)
+	{
+		return;
+	}
+	s->count--;
+	if (i != s->count)
+	{
+		// The last job fills the gap and moves to its place from there
+		schedSwap(s, i, s->count);
+		uint8_t moved = s->heap[i];
+		schedSiftUp(s, i);
+		schedSiftDown(s, s->pos[moved]);
+	}
+	s->pos[job] = SCHED_IDLE;
+}
+
+/**
+ * @brief Run job from due on, by due + slack at the latest. Replaces the
+ * job's pending run if there is one
+ */
+static inline void schedAt(Scheduler *s, uint8_t job, uint32_t due, uint32_t slack)
+{
+	schedCancel(s, job);
+	s->due[job] = due;
+	s->deadline[job] = due + slack;
+	s->heap[s->count] = job;
+	s->pos[job] = s->count;
+	schedSiftUp(s, s->count++);
+}
+
+/**
+ * @brief Time until the earliest deadline, the period of the wakeup timer
+ *
+ * @return uint32_t ms, 0 if it has passed, UINT32_MAX without pending jobs
+ */
+static inline uint32_t schedWait(const Scheduler *s, uint32_t now)
+{
+	if (s->count == 0)
+	{
+		return UINT32_MAX;
+	}
+	int32_t wait = (int32_t)(s->deadline[s->heap[0]] - now);
+	return wait > 0 ? wait : 0;
+}
+
+/**
+ * @brief Take all jobs due by now + early off the schedule
+ *
+ * @param early ahead of its due time a job may run, ms
+ * @return uint32_t bit per job taken
+ */
+static inline uint32_t schedTake(Scheduler *s, uint32_t now, uint32_t early)
+{
+	uint32_t taken = 0;
+	for (uint8_t i = 0; i < s->count; i++)
+	{
+		uint8_t job = s->heap[i];
+		if ((int32_t)(s->due[job] - now) <= (int32_t)early)
+		{
+			taken |= 1UL << job;
+		}
+	}
+	uint8_t n = 0;
+	for (uint8_t job = 0; job < SCHED_JOBS; job++)
+	{
+		if (!(taken & (1UL << job)))
+		{
+			continue;
+		}
+		int32_t late = (int32_t)(now - s->deadline[job]);
+		if (late > 0 && (uint32_t)late > s->maxLate)
+		{
+			s->maxLate = late;
+		}
+		schedCancel(s, job);
+		n++;
+	}
+	if (n > 0)
+	{
+		s->wakes++;
+		s->jobs += n;
+		s->coalesced += n - 1;
+	}
+	return taken;
+}
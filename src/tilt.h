@@ -0,0 +1,65 @@
+/**
+ * @file tilt.h
+ * @brief Inclination angles from a 3-axis acceleration without libm atan2
+ *
+ * atan2 is reduced to atan on 0..1 by octant symmetry and evaluated with the
+ * polynomial of Abramowitz & Stegun 4.4.47, |error| <= 1e-5 rad before float
+ * rounding. Together with the reduction the result is within
+ * TILT_MAX_ERROR_DEG of the exact angle. Single precision with one division
+ * and one sqrtf, so it stays on the FPU of the Cortex-M4F.
+ * bench/tilt_bench.cpp checks the bound against libm and times both.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/** Bound on |tiltAtan2Deg() - atan2()| in degrees, checked by bench/tilt_bench.cpp */
+#define TILT_MAX_ERROR_DEG 0.001f
+
+/**
+ * @brief atan2(y, x) in degrees, -180..180, 0 for a zero or NaN vector
+ */
+static inline float tiltAtan2Deg(float y, float x)
+{
+	const float halfPi = 1.57079633f;
+	float ax = fabsf(x);
+	float ay = fabsf(y);
+	if (!(ax + ay > 0.0f))
+	{
+		return 0.0f;
+	}
+	bool steep = ay > ax;
+	float z = steep ? ax / ay : ay / ax;
+	float z2 = z * z;
+	float a = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f + z2 * (-0.0851330f + z2 * 0.0208351f))));
+	if (steep)
+	{
+		a = halfPi - a;
+	}
+	if (x < 0.0f)
+	{
+		a = 2.0f * halfPi - a;
+	}
+	return (y < 0.0f ? -a : a) * 57.2957795f;
+}
+
+/** Degrees rounded half away from zero */
+static inline int16_t tiltRound(float deg)
+{
+	return (int16_t)(deg < 0.0f ? deg - 0.5f : deg + 0.5f);
+}
+
+/**
+ * @brief Inclination of the x and y axes against the horizontal plane,
+ * -90..90, and of the z axis against the vertical, 0..180, in degrees
+ */
+static inline void calculateTilt(float xacc, float yacc, float zacc, int8_t *xinc, int8_t *yinc, uint8_t *zinc)
+{
+	float xx = xacc * xacc;
+	float yy = yacc * yacc;
+	float zz = zacc * zacc;
+	*xinc = (int8_t)tiltRound(tiltAtan2Deg(xacc, sqrtf(yy + zz)));
+	*yinc = (int8_t)tiltRound(tiltAtan2Deg(yacc, sqrtf(xx + zz)));
+	*zinc = (uint8_t)tiltRound(tiltAtan2Deg(sqrtf(xx + yy), zacc));
+}
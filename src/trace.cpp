@@ -0,0 +1,160 @@
+/**
+ * @file trace.cpp
+ * @brief Per-wake phase timing
+ *
+ * Each traced phase is closed into a RAM ring of recent events and a log2
+ * histogram of its duration. traceReport() prints one line per phase with
+ * count, mean, max and bucket p50/p95, followed by the phases of the last
+ * wake.
+ *
+ * Phases are traced from the loop task, the radio callbacks and the timer
+ * task, so the shared state is only changed in a critical section.
+ */
+#include "main.h"
+
+/* Histogram buckets, bucket b holds durations in [2^b, 2^(b+1)) us */
+#define TRACE_BUCKETS 24
+
+struct __attribute__((packed)) TraceEvent
+{
+	uint32_t startUs;
+	uint32_t durUs;
+	uint8_t phase;
+};
+
+static const char *const traceNames[TRACE_PHASES] = {
+	"wake", "bsec start", "bsec finish", "battery", "acc read", "acc capture", "tilt", "cad", "send", "tx done", "state save",
+	"flash gc"};
+
+static TraceEvent traceRing[TRACE_RING_SIZE];
+static uint16_t traceHead = 0;
+static uint16_t traceCount = 0;
+static uint32_t traceStart[TRACE_PHASES];
+static uint16_t traceOpen = 0; // bit per phase with a pending traceBegin()
+static uint32_t traceHist[TRACE_PHASES][TRACE_BUCKETS];
+static uint32_t traceMax[TRACE_PHASES];
+static uint64_t traceSum[TRACE_PHASES];
+
+void traceBegin(uint8_t phase)
+{
+	taskENTER_CRITICAL();
+	traceStart[phase] = micros();
+	traceOpen |= 1 << phase;
+	taskEXIT_CRITICAL();
+}
+
+void traceEnd(uint8_t phase)
+{
+	taskENTER_CRITICAL();
+	if ((traceOpen & (1 << phase)) == 0)
+	{
+		taskEXIT_CRITICAL();
+		return;
+	}
+	traceOpen &= ~(1 << phase);
+	uint32_t dur = micros() - traceStart[phase];
+
+	TraceEvent *e = &traceRing[traceHead];
+	e->startUs = traceStart[phase];
+	e->durUs = dur;
+	e->phase = phase;
+	traceHead = (traceHead + 1) % TRACE_RING_SIZE;
+	if (traceCount < TRACE_RING_SIZE)
+	{
+		traceCount++;
+	}
+
+	uint8_t bucket = 0;
+	while ((dur >> (bucket + 1)) != 0 && bucket < TRACE_BUCKETS - 1)
+	{
+		bucket++;
+	}
+	traceHist[phase][bucket]++;
+	traceSum[phase] += dur;
+	if (dur > traceMax[phase])
+	{
+		traceMax[phase] = dur;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Upper bound in us of the bucket holding the given percentile
+ */
+static uint32_t tracePercentile(uint8_t phase, uint32_t count, uint8_t percent)
+{
+	uint32_t target = (count * percent + 99) / 100;
+	uint32_t seen = 0;
+	for (uint8_t b = 0; b < TRACE_BUCKETS; b++)
+	{
+		seen += traceHist[phase][b];
+		if (seen >= target)
+		{
+			return (2UL << b) - 1;
+		}
+	}
+	return traceMax[phase];
+}
+
+/**
+ * @brief Write the phase statistics since boot and the last wake's timeline
+ *
+ * @param out called once per line, without line end
+ */
+void traceReport(void (*out)(const char *line))
+{
+	char line[96];
+	out("phase         count    mean us     max us  p50<= us  p95<= us");
+	for (uint8_t p = 0; p < TRACE_PHASES; p++)
+	{
+		uint32_t count = 0;
+		for (uint8_t b = 0; b < TRACE_BUCKETS; b++)
+		{
+			count += traceHist[p][b];
+		}
+		if (count == 0)
+		{
+			continue;
+		}
+		snprintf(line, sizeof(line), "%-12s %6lu %10lu %10lu %9lu %9lu", traceNames[p], (unsigned long)count,
+				 (unsigned long)(traceSum[p] / count), (unsigned long)traceMax[p],
+				 (unsigned long)tracePercentile(p, count, 50), (unsigned long)tracePercentile(p, count, 95));
+		out(line);
+	}
+
+	// Timeline of the phases that started during the last wake
+	uint16_t last = traceHead;
+	uint16_t n = 0;
+	do
+	{
+		if (n == traceCount)
+		{
+			return;
+		}
+		last = (last + TRACE_RING_SIZE - 1) % TRACE_RING_SIZE;
+		n++;
+	} while (traceRing[last].phase != TRACE_WAKE);
+	const TraceEvent *wake = &traceRing[last];
+	out("last wake     start us     dur us");
+	uint16_t idx = (traceHead + TRACE_RING_SIZE - traceCount) % TRACE_RING_SIZE;
+	for (uint16_t k = 0; k < traceCount; k++, idx = (idx + 1) % TRACE_RING_SIZE)
+	{
+		const TraceEvent *e = &traceRing[idx];
+		uint32_t rel = e->startUs - wake->startUs;
+		if (rel <= wake->durUs)
+		{
+			snprintf(line, sizeof(line), "%-12s %9lu %10lu", traceNames[e->phase], (unsigned long)rel,
+					 (unsigned long)e->durUs);
+			out(line);
+		}
+	}
+}
+
+/**
+ * @brief traceReport() sink for the serial log
+ */
+void traceLog(const char *line)
+{
+	(void)line;
+	myLog_i("%s", line);
+}